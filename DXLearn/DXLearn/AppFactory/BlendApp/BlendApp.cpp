@@ -1,9 +1,11 @@
 ﻿#include "BlendApp.h"
 
+#include <cstddef>
+
 #include "BlendFrameResource.h"
-#include "../../Common/DDSTextureLoader.h"
 #include "../../Common/FileManager.h"
 #include "../../Common/GeometryGenerator.h"
+#include "../../Common/TaskScheduler.h"
 
 using namespace std;
 using namespace DirectX;
@@ -20,6 +22,8 @@ void BlendApp::Draw(const GameTimer& InGameTime)
     // Reusing the command list reuses memory.
     ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mPSOs[EPSoType::Opaque].Get()));
 
+    mTextureStreamer.RecordUploads(mCommandList.Get());
+
     mCommandList->RSSetViewports(1, &mScreenViewport);
     mCommandList->RSSetScissorRects(1, &mScissorRect);
 
@@ -92,6 +96,8 @@ void BlendApp::BuildRenderItems()
     waveRItem->IndexCount = waveRItem->Geo->DrawArgs["grid"].IndexCount;
     waveRItem->StartIndexLocation = waveRItem->Geo->DrawArgs["grid"].StartIndexLocation;
     waveRItem->BaseVertexLocation = waveRItem->Geo->DrawArgs["grid"].BaseVertexLocation;
+    waveRItem->Bounds = waveRItem->Geo->DrawArgs["grid"].Bounds;
+    waveRItem->TexCoordExtent = waveRItem->Geo->DrawArgs["grid"].TexCoordExtent;
 
     mWaveRItem = waveRItem.get();
     mRItemLayers[ERenderLayer::Translucent].push_back(mWaveRItem);
@@ -106,6 +112,8 @@ void BlendApp::BuildRenderItems()
     gridRItem->IndexCount = gridRItem->Geo->DrawArgs["grid"].IndexCount;
     gridRItem->StartIndexLocation = gridRItem->Geo->DrawArgs["grid"].StartIndexLocation;
     gridRItem->BaseVertexLocation = gridRItem->Geo->DrawArgs["grid"].BaseVertexLocation;
+    gridRItem->Bounds = gridRItem->Geo->DrawArgs["grid"].Bounds;
+    gridRItem->TexCoordExtent = gridRItem->Geo->DrawArgs["grid"].TexCoordExtent;
 
     mRItemLayers[ERenderLayer::Opaque].push_back(gridRItem.get());
 
@@ -119,6 +127,8 @@ void BlendApp::BuildRenderItems()
     boxRitem->IndexCount = boxRitem->Geo->DrawArgs["grid"].IndexCount;
     boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["grid"].StartIndexLocation;
     boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
+    boxRitem->Bounds = boxRitem->Geo->DrawArgs["grid"].Bounds;
+    boxRitem->TexCoordExtent = boxRitem->Geo->DrawArgs["grid"].TexCoordExtent;
 
     mRItemLayers[ERenderLayer::AlphaTested].push_back(boxRitem.get());
 
@@ -132,7 +142,7 @@ void BlendApp::BuildMaterials()
     auto grass = std::make_unique<Material>();
     grass->Name = "grass";
     grass->MatCBIndex = 0;
-    grass->DiffuseSrvHeapIndex = 0;
+    grass->DiffuseSrvHeapIndex = TextureIndex("grassTex");
     grass->DiffuseAlbedo = DirectX::XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
     grass->FresnelR0 = XMFLOAT3(0.01f, 0.01f, 0.01f);
     grass->Roughness = 0.125f;
@@ -142,7 +152,7 @@ void BlendApp::BuildMaterials()
     auto water = std::make_unique<Material>();
     water->Name = "water";
     water->MatCBIndex = 1;
-    water->DiffuseSrvHeapIndex = 1;
+    water->DiffuseSrvHeapIndex = TextureIndex("waterTex");
     water->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 0.5f);
     water->FresnelR0 = XMFLOAT3(0.1f, 0.1f, 0.1f);
     water->Roughness = 0.0f;
@@ -150,7 +160,7 @@ void BlendApp::BuildMaterials()
     auto wirefence = std::make_unique<Material>();
     wirefence->Name = "wirefence";
     wirefence->MatCBIndex = 2;
-    wirefence->DiffuseSrvHeapIndex = 2;
+    wirefence->DiffuseSrvHeapIndex = TextureIndex("fenceTex");
     wirefence->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
     wirefence->FresnelR0 = XMFLOAT3(0.1f, 0.1f, 0.1f);
     wirefence->Roughness = 0.25f;
@@ -193,71 +203,14 @@ void BlendApp::BuildShadersAndInputLayout()
     mShaders["opaquePS"] = D3dUtil::CompileShader(shaderPath, fogDefine, "PS", "ps_5_0");
     mShaders["alphaTestedPS"] = D3dUtil::CompileShader(shaderPath, alphaTestDefine, "PS", "ps_5_0");
 
-    mInputLayout =
-    {
-        {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-        {"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-        {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}
-    };
-}
-
-void BlendApp::BuildDescriptorHeaps()
-{
-    D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-    srvHeapDesc.NumDescriptors = 3;
-    srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-    srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-    ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSrvheap)));
-
-    CD3DX12_CPU_DESCRIPTOR_HANDLE hDesc(mSrvheap->GetCPUDescriptorHandleForHeapStart());
-
-    auto grassTex = mTextures["grassTex"]->Resource;
-    auto waterTex = mTextures["waterTex"]->Resource;
-    auto fenceTex = mTextures["fenceTex"]->Resource;
-
-    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-    srvDesc.Shader4ComponentMapping =D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-    srvDesc.Format = grassTex->GetDesc().Format;
-    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-    srvDesc.Texture2D.MostDetailedMip = 0;
-    srvDesc.Texture2D.MipLevels = -1;
-    md3dDevice->CreateShaderResourceView(grassTex.Get(), &srvDesc, hDesc);
-
-    hDesc.Offset(1, mCbvHandleSize);
-    srvDesc.Format = waterTex->GetDesc().Format;
-    md3dDevice->CreateShaderResourceView(waterTex.Get(), &srvDesc, hDesc);
-
-    hDesc.Offset(1, mCbvHandleSize);
-    srvDesc.Format = fenceTex->GetDesc().Format;
-    md3dDevice->CreateShaderResourceView(fenceTex.Get(), &srvDesc, hDesc);
+    mInputLayout = LightVertexFormat::InputLayout();
 }
 
 void BlendApp::BuildTextures()
 {
-    auto grassTex = std::make_unique<Texture>();
-    grassTex->Name = "grassTex";
-    grassTex->Filename = L"AppFactory/Textures/grass.dds";
-    ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-        mCommandList.Get(), grassTex->Filename.c_str(),
-        grassTex->Resource, grassTex->UploadHeap));
-
-    auto waterTex = std::make_unique<Texture>();
-    waterTex->Name = "waterTex";
-    waterTex->Filename = L"AppFactory/Textures/water1.dds";
-    ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-        mCommandList.Get(), waterTex->Filename.c_str(),
-        waterTex->Resource, waterTex->UploadHeap));
-
-    auto fenceTex = std::make_unique<Texture>();
-    fenceTex->Name = "fenceTex";
-    fenceTex->Filename = L"AppFactory/Textures/WireFence.dds";
-    ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-        mCommandList.Get(), fenceTex->Filename.c_str(),
-        fenceTex->Resource, fenceTex->UploadHeap));
-
-    mTextures[grassTex->Name] = std::move(grassTex);
-    mTextures[waterTex->Name] = std::move(waterTex);
-    mTextures[fenceTex->Name] = std::move(fenceTex);
+    LoadTexture("grassTex", L"AppFactory/Textures/grass.dds");
+    LoadTexture("waterTex", L"AppFactory/Textures/water1.dds");
+    LoadTexture("fenceTex", L"AppFactory/Textures/WireFence.dds");
 }
 
 void BlendApp::BuildPSOs()
@@ -360,8 +313,10 @@ void BlendApp::UpdateMainPassCB(const GameTimer& InGameTime)
 void BlendApp::UpdateObjectCBs(const GameTimer& InGameTime)
 {
     auto currObjectCB = dynamic_pointer_cast<BlendFrameResource>(mCurrFrameResource)->ObjectCB.get();
-    for(auto& e : mAllRitems)
+    TaskScheduler::Get().ParallelFor(0, (int)mAllRitems.size(), 32, [&](int index)
     {
+        auto& e = mAllRitems[index];
+
         // Only update the cbuffer data if the constants have changed.  
         // This needs to be tracked per frame resource.
         if(e->NumFramesDirty > 0)
@@ -378,7 +333,7 @@ void BlendApp::UpdateObjectCBs(const GameTimer& InGameTime)
             // Next FrameResource need to be updated too.
             e->NumFramesDirty--;
         }
-    }
+    });
 }
 
 void BlendApp::UpdateMaterialCBs(const GameTimer& InGameTime)
@@ -424,8 +379,7 @@ void BlendApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::ve
             cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
             cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
     
-            CD3DX12_GPU_DESCRIPTOR_HANDLE tex(mSrvheap->GetGPUDescriptorHandleForHeapStart());
-            tex.Offset(ri->Mat->DiffuseSrvHeapIndex, mCbvHandleSize);
+            CD3DX12_GPU_DESCRIPTOR_HANDLE tex = DiffuseSrv(ri->Mat);
     
             D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + ri->ObjCBIndex*objCBByteSize;
             D3D12_GPU_VIRTUAL_ADDRESS matCBAddress = matCB->GetGPUVirtualAddress() + ri->Mat->MatCBIndex*matCBByteSize;
@@ -465,10 +419,9 @@ void BlendApp::AnimateMaterials(const GameTimer& InGameTime)
 void BlendApp::UpdateWaves(const GameTimer& InGameTime)
 {
     // Every quarter second, generate a random wave.
-    static float t_base = 0.0f;
-    if((mTimer.TotalTime() - t_base) >= 0.25f)
+    if((mTimer.TotalTime() - mWaveDisturbTime) >= 0.25f)
     {
-        t_base += 0.25f;
+        mWaveDisturbTime += 0.25f;
 
         int i = MathHelper::Rand(4, mWaves->RowCount() - 5);
         int j = MathHelper::Rand(4, mWaves->ColumnCount() - 5);
@@ -481,22 +434,16 @@ void BlendApp::UpdateWaves(const GameTimer& InGameTime)
     // Update the wave simulation.
     mWaves->Update(InGameTime.DeltaTime());
 
-    // Update the wave vertex buffer with the new solution.
-    auto currWavesVB = dynamic_pointer_cast<BlendFrameResource>(mCurrFrameResource)->WavesVB.get();
-    for(int i = 0; i < mWaves->VertexCount(); ++i)
-    {
-        Vertex v;
-
-        v.Pos = mWaves->Position(i);
-        v.Normal = mWaves->Normal(i);
-		
-        // Derive tex-coords from position by 
-        // mapping [-w/2,w/2] --> [0,1]
-        v.TexC.x = 0.5f + v.Pos.x / mWaves->Width();
-        v.TexC.y = 0.5f - v.Pos.z / mWaves->Depth();
-
-        currWavesVB->CopyData(i, v);
-    }
+    // Write the new solution straight into the wave vertex buffer.
+    // Tex-coords are derived from position by mapping [-w/2,w/2] --> [0,1].
+    auto currFrameResource = dynamic_pointer_cast<BlendFrameResource>(mCurrFrameResource);
+    auto currWavesVB = currFrameResource->WavesVB.get();
+    WaveVertexLayout layout;
+    layout.Stride = LightVertexFormat::Stride();
+    layout.PositionOffset = LightVertexFormat::OffsetOf<VertexPosition>();
+    layout.NormalOffset = LightVertexFormat::OffsetOf<VertexNormal>();
+    layout.TexCOffset = LightVertexFormat::OffsetOf<VertexTexC>();
+    mWaves->WriteChangedVertices(currWavesVB->GetMappedData(), layout, currFrameResource->WavesVersions);
 
     // Set the dynamic VB of the wave renderitem to the current frame VB.
     mWaveRItem->Geo->VertexBufferGPU = currWavesVB->GetResource();
@@ -505,43 +452,42 @@ void BlendApp::UpdateWaves(const GameTimer& InGameTime)
 std::unique_ptr<MeshGeometry> BlendApp::BuildLandGeometry()
 {
     GeometryGenerator geoGen;
-    GeometryGenerator::MeshData grid = geoGen.CreateGrid(160.0f, 160.0f, 50, 50);
+    const GeometryGenerator::MeshSize gridSize = GeometryGenerator::GridSize(50, 50);
 
-    //
-    // Extract the vertex elements we are interested and apply the height function to
-    // each vertex.  In addition, color the vertices based on their height so we have
-    // sandy looking beaches, grassy low hills, and snow mountain peaks.
-    //
-
-    std::vector<Vertex> vertices(grid.Vertices.size());
-    for(size_t i = 0; i < grid.Vertices.size(); ++i)
-    {
-        auto& p = grid.Vertices[i].Position;
-        vertices[i].Pos = p;
-        vertices[i].Pos.y = LandUtil::GetHillsHeight(p.x, p.z);
-        vertices[i].Normal = LandUtil::GetHillsNormal(p.x, p.z);
-        vertices[i].TexC = grid.Vertices[i].TexC;
-    }
-
-    const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
-
-    std::vector<std::uint16_t> indices = grid.GetIndices16();
-    const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
+    const UINT vbByteSize = gridSize.VertexCount * sizeof(Vertex);
+    const UINT ibByteSize = gridSize.IndexCount * sizeof(std::uint16_t);
 
     auto geo = std::make_unique<MeshGeometry>();
     geo->Name = "landGeo";
 
     ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-    CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
-
     ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-    CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+    Vertex* vertices = static_cast<Vertex*>(geo->VertexBufferCPU->GetBufferPointer());
+    std::uint16_t* indices = static_cast<std::uint16_t*>(geo->IndexBufferCPU->GetBufferPointer());
+
+    //
+    // Extract the vertex elements we are interested and apply the height function to
+    // each vertex as the grid is generated into the vertex buffer.
+    //
+
+    auto toHills = [](Vertex& dst, const GeometryGenerator::Vertex& src)
+    {
+        const auto& p = src.Position;
+        dst.Pos = p;
+        dst.Pos.y = LandUtil::GetHillsHeight(p.x, p.z);
+        dst.Normal = LandUtil::GetHillsNormal(p.x, p.z);
+        dst.TexC = src.TexC;
+    };
+
+    // The normal comes from the height function, not the flat grid.
+    geoGen.WriteGrid(160.0f, 160.0f, 50, 50, vertices, indices, toHills,
+        GeometryGenerator::AttributePosition | GeometryGenerator::AttributeTexC);
 
     geo->VertexBufferGPU = D3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-        mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+        mCommandList.Get(), vertices, vbByteSize, geo->VertexBufferUploader);
 
     geo->IndexBufferGPU = D3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-        mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+        mCommandList.Get(), indices, ibByteSize, geo->IndexBufferUploader);
 
     geo->VertexByteStride = sizeof(Vertex);
     geo->VertexBufferByteSize = vbByteSize;
@@ -549,9 +495,10 @@ std::unique_ptr<MeshGeometry> BlendApp::BuildLandGeometry()
     geo->IndexBufferByteSize = ibByteSize;
 
     SubMeshGeometry submesh;
-    submesh.IndexCount = (UINT)indices.size();
+    submesh.IndexCount = gridSize.IndexCount;
     submesh.StartIndexLocation = 0;
     submesh.BaseVertexLocation = 0;
+    submesh.ComputeExtents(vertices, indices);
 
     geo->DrawArgs["grid"] = submesh;
 
@@ -609,6 +556,11 @@ std::unique_ptr<MeshGeometry> BlendApp::BuildWaveGeometry()
     submesh.StartIndexLocation = 0;
     submesh.BaseVertexLocation = 0;
 
+    // The vertices only exist on the GPU. The grid maps [0,1] of texture across its width and
+    // depth, the waves stay close to the plane.
+    submesh.Bounds = BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.5f*mWaves->Width(), 1.0f, 0.5f*mWaves->Depth()));
+    submesh.TexCoordExtent = sqrtf(mWaves->Width()*mWaves->Depth());
+
     geo->DrawArgs["grid"] = submesh;
     return geo;
 }
@@ -616,36 +568,26 @@ std::unique_ptr<MeshGeometry> BlendApp::BuildWaveGeometry()
 std::unique_ptr<MeshGeometry> BlendApp::BuildBoxGeometry()
 {
     GeometryGenerator geoGen;
-    GeometryGenerator::MeshData box = geoGen.CreateBox(8.0f, 8.0f, 8.0f, 3);
-
-    std::vector<Vertex> vertices(box.Vertices.size());
-    for (size_t i = 0; i < box.Vertices.size(); ++i)
-    {
-        auto& p = box.Vertices[i].Position;
-        vertices[i].Pos = p;
-        vertices[i].Normal = box.Vertices[i].Normal;
-        vertices[i].TexC = box.Vertices[i].TexC;
-    }
-
-    const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
+    const GeometryGenerator::MeshSize boxSize = GeometryGenerator::BoxSize(3);
 
-    std::vector<std::uint16_t> indices = box.GetIndices16();
-    const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
+    const UINT vbByteSize = boxSize.VertexCount * sizeof(Vertex);
+    const UINT ibByteSize = boxSize.IndexCount * sizeof(std::uint16_t);
 
     auto geo = std::make_unique<MeshGeometry>();
     geo->Name = "boxGeo";
 
     ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-    CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
-
     ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-    CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+    Vertex* vertices = static_cast<Vertex*>(geo->VertexBufferCPU->GetBufferPointer());
+    std::uint16_t* indices = static_cast<std::uint16_t*>(geo->IndexBufferCPU->GetBufferPointer());
+
+    geoGen.WriteBox(8.0f, 8.0f, 8.0f, 3, vertices, indices, LightVertexFormat::Writer(), LightVertexFormat::GeneratorMask());
 
     geo->VertexBufferGPU = D3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-        mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+        mCommandList.Get(), vertices, vbByteSize, geo->VertexBufferUploader);
 
     geo->IndexBufferGPU = D3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-        mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+        mCommandList.Get(), indices, ibByteSize, geo->IndexBufferUploader);
 
     geo->VertexByteStride = sizeof(Vertex);
     geo->VertexBufferByteSize = vbByteSize;
@@ -653,9 +595,10 @@ std::unique_ptr<MeshGeometry> BlendApp::BuildBoxGeometry()
     geo->IndexBufferByteSize = ibByteSize;
 
     SubMeshGeometry submesh;
-    submesh.IndexCount = (UINT)indices.size();
+    submesh.IndexCount = boxSize.IndexCount;
     submesh.StartIndexLocation = 0;
     submesh.BaseVertexLocation = 0;
+    submesh.ComputeExtents(vertices, indices);
 
     geo->DrawArgs["grid"] = submesh;
 
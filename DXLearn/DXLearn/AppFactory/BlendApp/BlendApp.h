@@ -10,6 +10,7 @@ public:
         : TextureApp(hInsatnce)
     {
         mWaves = std::make_unique<Waves>(128, 128, 1.0f, 0.03f, 4.0f, 0.2f);
+        mWaves->SetActivityTracking(true);
     }
 public:
     void Draw(const GameTimer& InGameTime) override;
@@ -22,7 +23,6 @@ protected:
     void BuildMaterials() override;
     void BuildFrameResources() override;
     void BuildShadersAndInputLayout() override;
-    void BuildDescriptorHeaps() override;
     void BuildTextures() override;
     void BuildPSOs() override;
     void UpdateMainPassCB(const GameTimer& InGameTime) override;
@@ -39,6 +39,7 @@ protected:
     std::unique_ptr<MeshGeometry> BuildWaveGeometry();
     std::unique_ptr<MeshGeometry> BuildBoxGeometry();
     std::unique_ptr<Waves> mWaves;
+    float mWaveDisturbTime = 0.0f;
     RenderItem* mWaveRItem;
     std::unique_ptr<BlendPassConstants> mMainPassCB;
 };
@@ -18,6 +18,8 @@ public:
     BlendFrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount, UINT WaveCount);
 
     std::unique_ptr<UploadBuffer<Vertex>> WavesVB = nullptr;
+    // Tile versions of mWaves already written into WavesVB.
+    std::vector<std::uint32_t> WavesVersions;
     std::unique_ptr<UploadBuffer<BlendPassConstants>> PassCB = nullptr;
     std::unique_ptr<UploadBuffer<MaterialConstants>> MaterialCB = nullptr;
     std::unique_ptr<UploadBuffer<LightObjectConstants>> ObjectCB = nullptr;
@@ -3,6 +3,8 @@
 #include <array>
 #include <DirectXColors.h>
 #include <iostream>
+
+#include "../../Common/VertexFormat.h"
 using namespace DirectX;
 
 struct BoxVertex
@@ -11,6 +13,9 @@ struct BoxVertex
     XMFLOAT4 Color;
 };
 
+using BoxVertexFormat = VertexFormat<VertexPosition, VertexColor>;
+static_assert(offsetof(BoxVertex, Color) == BoxVertexFormat::OffsetOf<VertexColor>(), "BoxVertex doesn't match BoxVertexFormat");
+
 bool BoxApp::Initialize()
 {
     if (!D3dApp::Initialize())
@@ -217,11 +222,7 @@ void BoxApp::BuildShadersAndInputLayout()
     mVsByteCode = D3dUtil::CompileShader(FileName, nullptr, "VS", "vs_5_0");
     mPsByteCode = D3dUtil::CompileShader(FileName, nullptr, "PS", "ps_5_0");
 
-    mInputLayout =
-    {
-        {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-        {"COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}
-    };
+    mInputLayout = BoxVertexFormat::InputLayout();
 }
 
 void BoxApp::BuildRootSignature()
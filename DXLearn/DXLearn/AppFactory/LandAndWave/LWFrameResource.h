@@ -1,5 +1,6 @@
 ﻿#pragma once
 #include "../../Common/FrameResource.h"
+#include "../../Common/VertexFormat.h"
 
 struct LWVertex
 {
@@ -7,6 +8,9 @@ struct LWVertex
     DirectX::XMFLOAT4 Color;
 };
 
+using LWVertexFormat = VertexFormat<VertexPosition, VertexColor>;
+static_assert(offsetof(LWVertex, Color) == LWVertexFormat::OffsetOf<VertexColor>(), "LWVertex doesn't match LWVertexFormat");
+
 struct LWObjectConstants
 {
     DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
@@ -49,6 +53,11 @@ public:
     // the commands that reference it.  So each frame needs their own.
     std::unique_ptr<UploadBuffer<LWVertex>> WavesVB = nullptr;
 
+    // Wave tile versions last written into WavesVB, so only changed tiles are re-emitted.
+    std::vector<std::uint32_t> WavesVersions;
+    // Simulation frame copied into WavesVB when the waves run on their own thread.
+    std::uint64_t WavesFrame = UINT64_MAX;
+
     // Fence value to mark commands up to this fence point.  This lets us
     // check if these frame resources are still in use by the GPU.
     UINT64 Fence = 0;
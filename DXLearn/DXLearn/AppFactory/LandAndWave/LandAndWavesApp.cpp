@@ -1,10 +1,12 @@
 ﻿#include "LandAndWavesApp.h"
 
 #include <DirectXColors.h>
+#include <cstddef>
 #include <fstream>
 
 #include "LWFrameResource.h"
 #include "../../Common/GeometryGenerator.h"
+#include "../../Common/TaskScheduler.h"
 
 using namespace DirectX;
 
@@ -21,7 +23,17 @@ bool LandAndWavesApp::Initialize()
    }
    ThrowIfFailed(mCommandList->Reset(mCommandAlloctor.Get(), nullptr));
 
-   mWaves = std::make_unique<Waves>(128, 128, 1.0f, 0.03f, 4.0f, 0.2f);
+   if(mWaveEngine == EWaveEngine::Spectral)
+   {
+      // Same 128x128 footprint as the finite difference grid.
+      mWaves = std::make_unique<SpectralOcean>(128, 128.0f, 6.0f, XMFLOAT2(1.0f, 1.0f));
+   }
+   else
+   {
+      auto waves = std::make_unique<Waves>(128, 128, 1.0f, 0.03f, 4.0f, 0.2f);
+      waves->SetActivityTracking(true);
+      mWaves = std::move(waves);
+   }
    
    BuildRootSignature();
    BuildShadersAndInputLayout();
@@ -39,6 +51,12 @@ bool LandAndWavesApp::Initialize()
    mCommandQueue->ExecuteCommandLists(_countof(cmdList), cmdList);
 
    FlushCommandQueue();
+
+   if(mSimulateWavesOnThread)
+   {
+      mWaveThread = std::make_unique<WaveSimulationThread>(mWaves.get(), WaveLayout());
+      mWaveThread->Start();
+   }
    return true;
 }
 
@@ -143,24 +161,31 @@ void LandAndWavesApp::BuildShadersAndInputLayout()
    mShaders["standardVS"] = D3dUtil::CompileShader(ShaderPath, nullptr, "VS", "vs_5_1");
    mShaders["opaquePS"] = D3dUtil::CompileShader(ShaderPath, nullptr, "PS", "ps_5_1");
 
-   mInputLayout =
-   {
-      {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-      {"COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-  };
+   mInputLayout = LWVertexFormat::InputLayout();
 }
 
 void LandAndWavesApp::BuildLandGeometry()
 {
    GeometryGenerator geoGen;
-   GeometryGenerator::MeshData grid = geoGen.CreateGrid(160.f,160.f,50, 50);
+   const GeometryGenerator::MeshSize gridSize = GeometryGenerator::GridSize(50, 50);
+
+   const UINT vbByteSize = sizeof(LWVertex) * gridSize.VertexCount;
+   const UINT ibByteSize = sizeof(uint16_t) * gridSize.IndexCount;
+
+   auto geo = std::make_unique<MeshGeometry>();
+   geo->Name = "LandGeo";
+
+   ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
+   ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
+   LWVertex* vertices = static_cast<LWVertex*>(geo->VertexBufferCPU->GetBufferPointer());
+   uint16_t* indices = static_cast<uint16_t*>(geo->IndexBufferCPU->GetBufferPointer());
+
    // calculate the height of land, set the color by height to differentiate terrains
-   std::vector<LWVertex> vertices(grid.Vertices.size());
-   for (size_t i = 0; i < grid.Vertices.size(); ++i)
+   auto toLand = [](LWVertex& dst, const GeometryGenerator::Vertex& src)
    {
-      auto& pos = grid.Vertices[i].Position;
-      vertices[i].Pos = pos;
-      vertices[i].Pos.y = GetHillsHeight(pos.x, pos.z);
+      const auto& pos = src.Position;
+      dst.Pos = pos;
+      dst.Pos.y = GetHillsHeight(pos.x, pos.z);
 
       // Color the vertex based on it's height
       constexpr DirectX::XMFLOAT4 SandBeachColor(1.0f, 0.96f, 0.62f, 1.0f);
@@ -169,42 +194,31 @@ void LandAndWavesApp::BuildLandGeometry()
       constexpr DirectX::XMFLOAT4 DarkBrown(0.45f, 0.39f, 0.34f, 1.0f);
       constexpr DirectX::XMFLOAT4 WhiteSnow(1.0f, 1.0f, 1.0f, 1.0f);
 
-      if (vertices[i].Pos.y < -10.0f)
+      if (dst.Pos.y < -10.0f)
       {
-         vertices[i].Color = SandBeachColor;
+         dst.Color = SandBeachColor;
       }
-      else if (vertices[i].Pos.y < 5.0f)
+      else if (dst.Pos.y < 5.0f)
       {
-         vertices[i].Color = BrightYellowGreen;
+         dst.Color = BrightYellowGreen;
       }
-      else if (vertices[i].Pos.y < 12.0f)
+      else if (dst.Pos.y < 12.0f)
       {
-         vertices[i].Color = DarkYellowGreen;
+         dst.Color = DarkYellowGreen;
       }
-      else if (vertices[i].Pos.y < 20.0f)
+      else if (dst.Pos.y < 20.0f)
       {
-         vertices[i].Color = DarkBrown;
+         dst.Color = DarkBrown;
       }
       else
       {
-         vertices[i].Color = WhiteSnow;
+         dst.Color = WhiteSnow;
       }
-   }
-
-   const UINT vbByteSize = sizeof(LWVertex) * static_cast<UINT>(vertices.size());
-   std::vector<uint16_t> indices = grid.GetIndices16();
-   const UINT ibByteSize = sizeof(uint16_t) * static_cast<UINT>(indices.size());
-
-   auto geo = std::make_unique<MeshGeometry>();
-   geo->Name = "LandGeo";
-
-   ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-   CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
-   ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-   CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+   };
+   geoGen.WriteGrid(160.f, 160.f, 50, 50, vertices, indices, toLand, LWVertexFormat::GeneratorMask());
 
-   geo->VertexBufferGPU = D3dUtil::CreateDefaultBuffer(md3dDevice.Get(), mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
-   geo->IndexBufferGPU = D3dUtil::CreateDefaultBuffer(md3dDevice.Get(), mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+   geo->VertexBufferGPU = D3dUtil::CreateDefaultBuffer(md3dDevice.Get(), mCommandList.Get(), vertices, vbByteSize, geo->VertexBufferUploader);
+   geo->IndexBufferGPU = D3dUtil::CreateDefaultBuffer(md3dDevice.Get(), mCommandList.Get(), indices, ibByteSize, geo->IndexBufferUploader);
 
    geo->VertexByteStride = sizeof(LWVertex);
    geo->VertexBufferByteSize = vbByteSize;
@@ -212,7 +226,7 @@ void LandAndWavesApp::BuildLandGeometry()
    geo->IndexBufferByteSize = ibByteSize;
 
    SubMeshGeometry LandSubMesh;
-   LandSubMesh.IndexCount = static_cast<UINT>(indices.size());
+   LandSubMesh.IndexCount = gridSize.IndexCount;
    LandSubMesh.BaseVertexLocation = 0;
    LandSubMesh.StartIndexLocation = 0;
 
@@ -365,8 +379,11 @@ void LandAndWavesApp::OnKeyboardInput(const GameTimer& gt)
 void LandAndWavesApp::UpdateObjectCBs(const GameTimer& game_timer)
 {
    auto currObjectCB = mCurrFrameResource->ObjectCB.get();
-   for(auto& e : mAllRenderItems)
+   // Each item writes its own constant buffer slot, so items can be updated in parallel.
+   TaskScheduler::Get().ParallelFor(0, (int)mAllRenderItems.size(), 32, [&](int index)
    {
+      auto& e = mAllRenderItems[index];
+
       // Only update the cbuffer data if the constants have changed.  
       // This needs to be tracked per frame resource.
       if(e->NumFramesDirty > 0)
@@ -381,7 +398,7 @@ void LandAndWavesApp::UpdateObjectCBs(const GameTimer& game_timer)
          // Next FrameResource need to be updated too.
          e->NumFramesDirty--;
       }
-   }
+   });
 }
 
 void LandAndWavesApp::UpdateMainPassCB(const GameTimer& game_timer)
@@ -415,38 +432,56 @@ void LandAndWavesApp::UpdateMainPassCB(const GameTimer& game_timer)
 void LandAndWavesApp::UpdateWaves(const GameTimer& game_timer)
 {
    // Every quarter second, generate a random wave.
-   static float t_base = 0.0f;
-   if((mTimer.TotalTime() - t_base) >= 0.25f)
+   if((mTimer.TotalTime() - mWaveDisturbTime) >= 0.25f)
    {
-      t_base += 0.25f;
+      mWaveDisturbTime += 0.25f;
 
       int i = MathHelper::Rand(4, mWaves->RowCount() - 5);
       int j = MathHelper::Rand(4, mWaves->ColumnCount() - 5);
 
       float r = MathHelper::RandF(0.2f, 0.5f);
 
+      // Queued, safe even while the simulation thread is stepping.
       mWaves->Disturb(i, j, r);
    }
 
-   // Update the wave simulation.
-   mWaves->Update(game_timer.DeltaTime());
-
-   // Update the wave vertex buffer with the new solution.
    auto currWavesVB = mCurrFrameResource->WavesVB.get();
-   for(int i = 0; i < mWaves->VertexCount(); ++i)
+   if(mWaveThread)
    {
-      LWVertex v;
-
-      v.Pos = mWaves->Position(i);
-      v.Color = XMFLOAT4(DirectX::Colors::SkyBlue);
+      // The simulation thread has already built the vertices, take its newest frame
+      // unless this frame resource has it already.
+      std::uint64_t frameIndex = 0;
+      const void* vertices = mWaveThread->AcquireLatest(frameIndex);
+      if(frameIndex != mCurrFrameResource->WavesFrame)
+      {
+         memcpy(currWavesVB->GetMappedData(), vertices, mWaves->VertexCount()*sizeof(LWVertex));
+         mCurrFrameResource->WavesFrame = frameIndex;
+      }
+   }
+   else
+   {
+      // Update the wave simulation.
+      mWaves->Update(game_timer.DeltaTime());
 
-      currWavesVB->CopyData(i, v);
+      // Write the new solution straight into the wave vertex buffer, skipping tiles
+      // this frame resource already has.
+      mWaves->WriteChangedVertices(currWavesVB->GetMappedData(), WaveLayout(), mCurrFrameResource->WavesVersions);
    }
 
    // Set the dynamic VB of the wave renderitem to the current frame VB.
    mWaveRenderItem->Geo->VertexBufferGPU = currWavesVB->GetResource();
 }
 
+WaveVertexLayout LandAndWavesApp::WaveLayout()const
+{
+   WaveVertexLayout layout;
+   layout.Stride = LWVertexFormat::Stride();
+   layout.PositionOffset = LWVertexFormat::OffsetOf<VertexPosition>();
+   layout.ColorOffset = LWVertexFormat::OffsetOf<VertexColor>();
+   layout.Color = XMFLOAT4(DirectX::Colors::SkyBlue);
+   return layout;
+}
+
 void LandAndWavesApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList,
    const std::vector<RenderItem*>& render_items)
 {
@@ -1,14 +1,23 @@
 ﻿#pragma once
 #include "LWFrameResource.h"
+#include "SpectralOcean.h"
 #include "Waves.h"
+#include "WaveSimulationThread.h"
 #include "../../Common/D3dApp.h"
 #include "../../Common/RenderItem.h"
 
+// Which simulation drives the water, picked once at startup.
+enum class EWaveEngine : int
+{
+    FiniteDifference = 0,   // Waves, interactive ripples
+    Spectral                // SpectralOcean, wind-driven open sea
+};
+
 class LandAndWavesApp : public D3dApp
 {
 public:
-    explicit LandAndWavesApp(HINSTANCE hInsatnce)
-        : D3dApp(hInsatnce)
+    explicit LandAndWavesApp(HINSTANCE hInsatnce, EWaveEngine waveEngine = EWaveEngine::FiniteDifference)
+        : D3dApp(hInsatnce), mWaveEngine(waveEngine)
     {
     }
     virtual bool Initialize() override;
@@ -30,10 +39,18 @@ private:
     void UpdateObjectCBs(const GameTimer& game_timer);
     void UpdateMainPassCB(const GameTimer& game_timer);
     void UpdateWaves(const GameTimer& game_timer);
+    WaveVertexLayout WaveLayout()const;
     void DrawRenderItems(ID3D12GraphicsCommandList* get, const std::vector<RenderItem*>& vector);
 private:
     std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> mGeometries;
-    std::unique_ptr<Waves> mWaves;
+    EWaveEngine mWaveEngine;
+    std::unique_ptr<WaveSurface> mWaves;
+    // Time of the last random disturbance.
+    float mWaveDisturbTime = 0.0f;
+    // Step the waves on their own thread instead of inside Update().
+    bool mSimulateWavesOnThread = true;
+    // Declared after mWaves so it is stopped before the grid goes away.
+    std::unique_ptr<WaveSimulationThread> mWaveThread;
     // List of all render items
     std::vector<std::unique_ptr<RenderItem>> mAllRenderItems;
     // Render Items divided by PSO
@@ -0,0 +1,284 @@
+#include "SpectralOcean.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+#include "../../Common/TaskScheduler.h"
+
+using namespace DirectX;
+
+namespace
+{
+    const float Gravity = 9.81f;
+
+    // Rows handed to a worker at a time.
+    const int RowGrainSize = 8;
+
+    // Scale of the Phillips spectrum, it has no physical normalization of its own.
+    const float PhillipsAmplitude = 0.0005f;
+
+    // Tessendorf's Phillips spectrum, (k.w)^2 makes the waves line up with the wind and the
+    // last factor damps the tiny waves that only alias at grid resolution.
+    float PhillipsSpectrum(float kx, float kz, float k, float windSpeed, XMFLOAT2 windDir)
+    {
+        const float largestWave = windSpeed*windSpeed / Gravity;
+        const float smallestWave = largestWave * 0.001f;
+        const float kDotW = (kx*windDir.x + kz*windDir.y) / k;
+        const float k2 = k*k;
+
+        return PhillipsAmplitude * expf(-1.0f / (k2*largestWave*largestWave)) / (k2*k2)
+            * kDotW*kDotW * expf(-k2*smallestWave*smallestWave);
+    }
+
+    // JONSWAP frequency spectrum for fetch-limited seas with a cos^2 spreading function,
+    // converted to a wave-number density. Times dk^2 it is the variance of one Fourier mode.
+    float JonswapSpectrum(float kx, float kz, float k, float windSpeed, XMFLOAT2 windDir, float fetch)
+    {
+        const float omega = sqrtf(Gravity*k);
+        const float peakOmega = 22.0f * powf(Gravity*Gravity / (windSpeed*fetch), 1.0f/3.0f);
+        const float alpha = 0.076f * powf(windSpeed*windSpeed / (fetch*Gravity), 0.22f);
+        const float gamma = 3.3f;
+        const float sigma = omega <= peakOmega ? 0.07f : 0.09f;
+
+        const float ratio = peakOmega / omega;
+        const float peakDelta = (omega - peakOmega) / (sigma*peakOmega);
+        const float sOmega = alpha*Gravity*Gravity / powf(omega, 5.0f)
+            * expf(-1.25f*ratio*ratio*ratio*ratio)
+            * powf(gamma, expf(-0.5f*peakDelta*peakDelta));
+
+        // Only waves travelling downwind, normalized over the half circle.
+        const float cosTheta = (kx*windDir.x + kz*windDir.y) / k;
+        const float spreading = cosTheta > 0.0f ? cosTheta*cosTheta * (2.0f / XM_PI) : 0.0f;
+
+        const float dOmegaDk = Gravity / (2.0f*omega);
+        return sOmega * dOmegaDk / k * spreading;
+    }
+}
+
+SpectralOcean::SpectralOcean(int n, float patchSize, float windSpeed, XMFLOAT2 windDirection,
+    EOceanSpectrum spectrum, float fetch)
+    : mFFT(n, EFFTDirection::Inverse)
+{
+    assert(n >= 2 && (n & (n - 1)) == 0);
+    assert(patchSize > 0.0f && windSpeed > 0.0f);
+
+    mSize = n;
+    mPatchSize = patchSize;
+    mSpatialStep = patchSize / n;
+
+    const size_t count = static_cast<size_t>(n)*n;
+    for (FloatPlane* plane : { &mH0Re, &mH0Im, &mH0ConjRe, &mH0ConjIm, &mOmega,
+        &mHeight, &mDisplacementX, &mDisplacementZ, &mSlopeX, &mSlopeZ })
+    {
+        plane->assign(count, 0.0f);
+    }
+    for (int i = 0; i < 3; ++i)
+    {
+        mFieldRe[i].assign(count, 0.0f);
+        mFieldIm[i].assign(count, 0.0f);
+    }
+
+    BuildInitialSpectrum(windSpeed, windDirection, spectrum, fetch);
+    Evaluate();
+}
+
+void SpectralOcean::Update(float dt)
+{
+    mTime += dt;
+    Evaluate();
+}
+
+void SpectralOcean::Step(int count)
+{
+    mTime += count*mTimeStep;
+    Evaluate();
+}
+
+void SpectralOcean::BuildInitialSpectrum(float windSpeed, XMFLOAT2 windDirection, EOceanSpectrum spectrum, float fetch)
+{
+    XMFLOAT2 windDir;
+    XMStoreFloat2(&windDir, XMVector2Normalize(XMLoadFloat2(&windDirection)));
+
+    // Fixed seed, the same parameters always give the same sea.
+    std::mt19937 generator(1337);
+    std::normal_distribution<float> gaussian(0.0f, 1.0f);
+
+    const float dk = XM_2PI / mPatchSize;
+
+    // Wave vector (kx, kz) = dk * (col - N/2, row - N/2).
+    for (int row = 0; row < mSize; ++row)
+    {
+        for (int col = 0; col < mSize; ++col)
+        {
+            const int index = row*mSize + col;
+            const float kx = dk * (col - mSize/2);
+            const float kz = dk * (row - mSize/2);
+            const float k = sqrtf(kx*kx + kz*kz);
+
+            // Draw the random numbers for every cell, so the sea doesn't reshuffle when
+            // a spectrum zeroes some of them.
+            const float xiRe = gaussian(generator);
+            const float xiIm = gaussian(generator);
+
+            // Row and column 0 are the Nyquist lines, -k of those isn't on the grid, so they
+            // would leave an imaginary part in the spatial fields. Drop them with the mean.
+            if (row == 0 || col == 0 || k < 1e-6f)
+            {
+                continue;
+            }
+
+            float variance = 0.0f;
+            if (spectrum == EOceanSpectrum::Phillips)
+            {
+                variance = PhillipsSpectrum(kx, kz, k, windSpeed, windDir);
+            }
+            else
+            {
+                variance = JonswapSpectrum(kx, kz, k, windSpeed, windDir, fetch) * dk*dk;
+            }
+
+            const float scale = sqrtf(0.5f*variance);
+            mH0Re[index] = xiRe * scale;
+            mH0Im[index] = xiIm * scale;
+            mOmega[index] = sqrtf(Gravity*k);
+        }
+    }
+
+    // conj(h0(-k)), -k of column c is column N-c.
+    for (int row = 0; row < mSize; ++row)
+    {
+        const int mirrorRow = (mSize - row) % mSize;
+        for (int col = 0; col < mSize; ++col)
+        {
+            const int mirrorCol = (mSize - col) % mSize;
+            const int mirror = mirrorRow*mSize + mirrorCol;
+            mH0ConjRe[row*mSize + col] = mH0Re[mirror];
+            mH0ConjIm[row*mSize + col] = -mH0Im[mirror];
+        }
+    }
+}
+
+void SpectralOcean::Evaluate()
+{
+    const int n = mSize;
+    const float dk = XM_2PI / mPatchSize;
+    const float t = mTime;
+
+    TaskScheduler::Get().ParallelFor(0, n, RowGrainSize, [this, n, dk, t](int row)
+    {
+        const float kz = dk * (row - n/2);
+        for (int col = 0; col < n; ++col)
+        {
+            const int index = row*n + col;
+            const float kx = dk * (col - n/2);
+            const float k = sqrtf(kx*kx + kz*kz);
+
+            // h(k, t) = h0(k) e^(iwt) + conj(h0(-k)) e^(-iwt)
+            const float phase = mOmega[index]*t;
+            const float c = cosf(phase);
+            const float s = sinf(phase);
+            const float hRe = mH0Re[index]*c - mH0Im[index]*s + mH0ConjRe[index]*c + mH0ConjIm[index]*s;
+            const float hIm = mH0Re[index]*s + mH0Im[index]*c + mH0ConjIm[index]*c - mH0ConjRe[index]*s;
+
+            // Displacement D = -i k/|k| h, slope = i k h.
+            float dxRe = 0.0f, dxIm = 0.0f, dzRe = 0.0f, dzIm = 0.0f;
+            if (k > 1e-6f)
+            {
+                dxRe = kx/k * hIm;
+                dxIm = -kx/k * hRe;
+                dzRe = kz/k * hIm;
+                dzIm = -kz/k * hRe;
+            }
+            const float sxRe = -kx*hIm;
+            const float sxIm = kx*hRe;
+            const float szRe = -kz*hIm;
+            const float szIm = kz*hRe;
+
+            // Every field is real in space, so A + iB transforms to a + ib and two
+            // fields share one FFT.
+            mFieldRe[0][index] = hRe - dxIm;
+            mFieldIm[0][index] = hIm + dxRe;
+            mFieldRe[1][index] = dzRe - sxIm;
+            mFieldIm[1][index] = dzIm + sxRe;
+            mFieldRe[2][index] = szRe;
+            mFieldIm[2][index] = szIm;
+        }
+    });
+
+    for (int i = 0; i < 3; ++i)
+    {
+        mFFT.Transform2D(mFieldRe[i].data(), mFieldIm[i].data());
+    }
+
+    TaskScheduler::Get().ParallelFor(0, n, RowGrainSize, [this, n](int row)
+    {
+        for (int col = 0; col < n; ++col)
+        {
+            const int index = row*n + col;
+
+            // Undo the N/2 shift of the wave vectors.
+            const float sign = ((row + col) & 1) ? -1.0f : 1.0f;
+
+            // Rows run along +z in the spectrum but along -z in the vertex grid.
+            mHeight[index] = sign*mFieldRe[0][index];
+            mDisplacementX[index] = sign*mFieldIm[0][index];
+            mDisplacementZ[index] = -sign*mFieldRe[1][index];
+            mSlopeX[index] = sign*mFieldIm[1][index];
+            mSlopeZ[index] = -sign*mFieldRe[2][index];
+        }
+    });
+}
+
+void SpectralOcean::WriteVertices(void* dst, const WaveVertexLayout& layout)const
+{
+    assert(dst != nullptr);
+    assert(layout.Stride > 0);
+
+    unsigned char* bytes = static_cast<unsigned char*>(dst);
+    const float halfSize = 0.5f*mPatchSize;
+
+    TaskScheduler::Get().ParallelFor(0, mSize, RowGrainSize, [this, bytes, &layout, halfSize](int row)
+    {
+        const float z = halfSize - row*mSpatialStep;
+        unsigned char* v = bytes + static_cast<size_t>(row)*mSize*layout.Stride;
+        for (int col = 0; col < mSize; ++col, v += layout.Stride)
+        {
+            const int index = row*mSize + col;
+            const float x = -halfSize + col*mSpatialStep;
+
+            if (layout.PositionOffset >= 0)
+            {
+                const XMFLOAT3 pos(x + mChoppiness*mDisplacementX[index], mHeight[index], z + mChoppiness*mDisplacementZ[index]);
+                memcpy(v + layout.PositionOffset, &pos, sizeof(XMFLOAT3));
+            }
+
+            if (layout.NormalOffset >= 0)
+            {
+                XMFLOAT3 normal(-mSlopeX[index], 1.0f, -mSlopeZ[index]);
+                XMStoreFloat3(&normal, XMVector3Normalize(XMLoadFloat3(&normal)));
+                memcpy(v + layout.NormalOffset, &normal, sizeof(XMFLOAT3));
+            }
+
+            if (layout.TangentOffset >= 0)
+            {
+                XMFLOAT3 tangent(1.0f, mSlopeX[index], 0.0f);
+                XMStoreFloat3(&tangent, XMVector3Normalize(XMLoadFloat3(&tangent)));
+                memcpy(v + layout.TangentOffset, &tangent, sizeof(XMFLOAT3));
+            }
+
+            if (layout.TexCOffset >= 0)
+            {
+                // Same mapping as Waves, from the undisplaced grid so the patch tiles.
+                const XMFLOAT2 texC(0.5f + x / mPatchSize, 0.5f - z / mPatchSize);
+                memcpy(v + layout.TexCOffset, &texC, sizeof(XMFLOAT2));
+            }
+
+            if (layout.ColorOffset >= 0)
+            {
+                memcpy(v + layout.ColorOffset, &layout.Color, sizeof(XMFLOAT4));
+            }
+        }
+    });
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vector>
+#include <DirectXMath.h>
+
+#include "WaveSurface.h"
+#include "../../Common/AlignedAllocator.h"
+#include "../../Common/FFT.h"
+
+enum class EOceanSpectrum : int
+{
+    Phillips = 0,
+    JONSWAP
+};
+
+// Statistical deep-water ocean after Tessendorf, "Simulating Ocean Water".
+// A random initial spectrum h0(k) is built once from the wind, every evaluation advances
+// its phases with the deep-water dispersion w^2 = g|k| and three inverse 2D FFTs turn it
+// into height, horizontal (choppy) displacement and slope fields. The patch tiles
+// seamlessly and costs the same no matter how rough the sea is.
+class SpectralOcean : public WaveSurface
+{
+public:
+    // n: grid resolution, power of two. patchSize: side of the patch in meters.
+    // windDirection doesn't have to be normalized. fetch (meters) is only used by JONSWAP.
+    SpectralOcean(int n, float patchSize, float windSpeed, DirectX::XMFLOAT2 windDirection,
+        EOceanSpectrum spectrum = EOceanSpectrum::JONSWAP, float fetch = 50000.0f);
+    SpectralOcean(const SpectralOcean& rhs) = delete;
+    SpectralOcean& operator=(const SpectralOcean& rhs) = delete;
+
+    int RowCount()const override { return mSize; }
+    int ColumnCount()const override { return mSize; }
+    int VertexCount()const override { return mSize*mSize; }
+    int TriangleCount()const override { return (mSize - 1)*(mSize - 1)*2; }
+    float Width()const override { return mPatchSize; }
+    float Depth()const override { return mPatchSize; }
+    float TimeStep()const override { return mTimeStep; }
+
+    void Update(float dt) override;
+    void Step(int count) override;
+
+    // The spectrum has no local state to push on, disturbances are ignored.
+    using WaveSurface::Disturb;
+    void Disturb(const WaveDisturbance& disturbance) override {}
+
+    void WriteVertices(void* dst, const WaveVertexLayout& layout)const override;
+
+    // How far crests are pulled together by the horizontal displacement, 0 gives round
+    // sine-like waves, around 1 sharp ones. Too large and the surface folds over.
+    void SetChoppiness(float choppiness) { mChoppiness = choppiness; }
+    void SetTimeStep(float dt) { mTimeStep = dt; }
+
+    float Height(int i)const { return mHeight[i]; }
+
+private:
+    void BuildInitialSpectrum(float windSpeed, DirectX::XMFLOAT2 windDirection, EOceanSpectrum spectrum, float fetch);
+    void Evaluate();
+
+    using FloatPlane = std::vector<float, AlignedAllocator<float>>;
+
+    int mSize = 0;
+    float mPatchSize = 0.0f;
+    float mSpatialStep = 0.0f;
+    float mChoppiness = 1.0f;
+    float mTimeStep = 1.0f / 30.0f;
+    float mTime = 0.0f;
+
+    FFT mFFT;
+
+    // h0(k) and conj(h0(-k)) at every wave vector, plus its angular frequency.
+    FloatPlane mH0Re;
+    FloatPlane mH0Im;
+    FloatPlane mH0ConjRe;
+    FloatPlane mH0ConjIm;
+    FloatPlane mOmega;
+
+    // Spectra packed two real fields per complex transform:
+    // (height, displacement x), (displacement z, slope x), (slope z, unused).
+    FloatPlane mFieldRe[3];
+    FloatPlane mFieldIm[3];
+
+    // Spatial results in world orientation.
+    FloatPlane mHeight;
+    FloatPlane mDisplacementX;
+    FloatPlane mDisplacementZ;
+    FloatPlane mSlopeX;
+    FloatPlane mSlopeZ;
+};
@@ -0,0 +1,120 @@
+#include "WaveSimulationThread.h"
+
+#include <cassert>
+#include <chrono>
+
+WaveSimulationThread::WaveSimulationThread(WaveSurface* waves, const WaveVertexLayout& layout)
+    : mWaves(waves), mLayout(layout), mLatest(2), mQuit(false),
+      mStepsSimulated(0), mFramesPublished(0), mFramesDropped(0), mFramesDuplicated(0)
+{
+    assert(waves != nullptr);
+    assert(layout.Stride > 0);
+
+    // Slot 0 is read, 1 written, 2 is the hand-off slot. Seed all of them with the
+    // initial state so the renderer has something to draw before the first step.
+    const size_t byteSize = static_cast<size_t>(mWaves->VertexCount()) * mLayout.Stride;
+    for (auto& frame : mFrames)
+    {
+        frame.Vertices.resize(byteSize);
+        mWaves->WriteVertices(frame.Vertices.data(), mLayout);
+    }
+}
+
+WaveSimulationThread::~WaveSimulationThread()
+{
+    Stop();
+}
+
+void WaveSimulationThread::Start()
+{
+    if (IsRunning())
+    {
+        return;
+    }
+
+    mQuit.store(false);
+    mThread = std::thread(&WaveSimulationThread::Run, this);
+}
+
+void WaveSimulationThread::Stop()
+{
+    if (!IsRunning())
+    {
+        return;
+    }
+
+    mQuit.store(true);
+    mThread.join();
+}
+
+const void* WaveSimulationThread::AcquireLatest(std::uint64_t& frameIndex)
+{
+    if (mLatest.load(std::memory_order_relaxed) & FreshBit)
+    {
+        // Hand our old slot back and take the fresh one. acquire pairs with the
+        // release in Publish() so the vertex writes are visible.
+        const std::uint32_t latest = mLatest.exchange(mReadIndex, std::memory_order_acq_rel);
+        mReadIndex = latest & IndexMask;
+    }
+    else
+    {
+        mFramesDuplicated.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    frameIndex = mFrames[mReadIndex].Index;
+    return mFrames[mReadIndex].Vertices.data();
+}
+
+WaveSimulationStats WaveSimulationThread::Stats()const
+{
+    WaveSimulationStats stats;
+    stats.StepsSimulated = mStepsSimulated.load(std::memory_order_relaxed);
+    stats.FramesPublished = mFramesPublished.load(std::memory_order_relaxed);
+    stats.FramesDropped = mFramesDropped.load(std::memory_order_relaxed);
+    stats.FramesDuplicated = mFramesDuplicated.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void WaveSimulationThread::Run()
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Blocked grids advance their substeps in one sweep, one frame is published per block.
+    const int steps = mWaves->Substeps();
+    const auto period = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<float>(steps*mWaves->TimeStep()));
+
+    auto nextStep = Clock::now();
+    while (!mQuit.load())
+    {
+        mWaves->Step(steps);
+        mStepsSimulated.fetch_add(steps, std::memory_order_relaxed);
+        Publish();
+
+        // Fixed rate. If we fell more than a step behind (debugger, hitch) don't try to
+        // catch up with a burst, just carry on from now.
+        nextStep += period;
+        const auto now = Clock::now();
+        if (nextStep < now - period)
+        {
+            nextStep = now;
+        }
+        std::this_thread::sleep_until(nextStep);
+    }
+}
+
+void WaveSimulationThread::Publish()
+{
+    Frame& frame = mFrames[mWriteIndex];
+    mWaves->WriteVertices(frame.Vertices.data(), mLayout);
+    frame.Index = ++mFrameCounter;
+
+    const std::uint32_t previous = mLatest.exchange(mWriteIndex | FreshBit, std::memory_order_acq_rel);
+    mWriteIndex = previous & IndexMask;
+
+    mFramesPublished.fetch_add(1, std::memory_order_relaxed);
+    if (previous & FreshBit)
+    {
+        mFramesDropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
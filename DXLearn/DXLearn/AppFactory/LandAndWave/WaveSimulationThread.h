@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "WaveSurface.h"
+
+struct WaveSimulationStats
+{
+    std::uint64_t StepsSimulated = 0;
+    std::uint64_t FramesPublished = 0;
+    // Published frames the renderer never picked up because a newer one replaced them.
+    std::uint64_t FramesDropped = 0;
+    // Renderer frames that found no new simulation frame and reused the last one.
+    std::uint64_t FramesDuplicated = 0;
+};
+
+// Runs a wave surface on its own thread at the surface's fixed time step, Substeps() steps
+// at a time. After every block of steps the finished vertex stream is written into one slot
+// of a triple buffer and published with a single atomic exchange, so the renderer always
+// grabs the newest frame without waiting on the simulation and the simulation never waits
+// on the renderer.
+//
+// While the thread runs it owns the surface. Only WaveSurface::Disturb(), which queues,
+// may still be called from other threads. Substeps are read once, when the thread starts.
+class WaveSimulationThread
+{
+public:
+    WaveSimulationThread(WaveSurface* waves, const WaveVertexLayout& layout);
+    WaveSimulationThread(const WaveSimulationThread& rhs) = delete;
+    WaveSimulationThread& operator=(const WaveSimulationThread& rhs) = delete;
+    ~WaveSimulationThread();
+
+    void Start();
+    void Stop();
+    bool IsRunning()const { return mThread.joinable(); }
+
+    // Swaps in the newest published frame if there is one and returns its vertices,
+    // VertexCount() * layout.Stride bytes that stay valid until the next call.
+    // frameIndex receives the simulation frame the data belongs to (0 before the first one).
+    const void* AcquireLatest(std::uint64_t& frameIndex);
+
+    WaveSimulationStats Stats()const;
+
+private:
+    struct Frame
+    {
+        std::vector<unsigned char> Vertices;
+        std::uint64_t Index = 0;
+    };
+
+    void Run();
+    void Publish();
+
+    // Slot index in the low bits, set while the slot holds a frame nobody has read yet.
+    static const std::uint32_t FreshBit = 4;
+    static const std::uint32_t IndexMask = 3;
+
+    WaveSurface* mWaves = nullptr;
+    WaveVertexLayout mLayout;
+
+    Frame mFrames[3];
+    std::atomic<std::uint32_t> mLatest;
+    std::uint32_t mWriteIndex = 1;  // Simulation thread only.
+    std::uint32_t mReadIndex = 0;   // Render thread only.
+    std::uint64_t mFrameCounter = 0;
+
+    std::thread mThread;
+    std::atomic<bool> mQuit;
+
+    std::atomic<std::uint64_t> mStepsSimulated;
+    std::atomic<std::uint64_t> mFramesPublished;
+    std::atomic<std::uint64_t> mFramesDropped;
+    std::atomic<std::uint64_t> mFramesDuplicated;
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+
+// Byte layout of the vertices WriteVertices() produces, so the caller's own vertex struct
+// can be filled in place. An offset of -1 leaves that attribute out.
+struct WaveVertexLayout
+{
+    int Stride = 0;
+    int PositionOffset = -1;
+    int NormalOffset = -1;
+    int TangentOffset = -1;
+    int TexCOffset = -1;
+    int ColorOffset = -1;
+
+    // Written to every vertex when ColorOffset is set.
+    DirectX::XMFLOAT4 Color = { 1.0f, 1.0f, 1.0f, 1.0f };
+};
+
+// Run of consecutive vertices, as indices into the vertex stream.
+struct WaveVertexRange
+{
+    int First = 0;
+    int Count = 0;
+};
+
+// Shape of a disturbance around its center cell.
+enum class EWaveFalloff : int
+{
+    Point = 0,  // Center plus half on the four neighbours, Radius is ignored.
+    Linear,     // Cone, 1 - d/r.
+    Smooth      // (1 - (d/r)^2)^2, no crease at the center or the rim.
+};
+
+// Impulse added to the heights around grid point (I, J), Radius in cells.
+struct WaveDisturbance
+{
+    int I = 0;
+    int J = 0;
+    float Magnitude = 0.0f;
+    float Radius = 0.0f;
+    EWaveFalloff Falloff = EWaveFalloff::Point;
+};
+
+// Common interface of the water engines. The surface is a RowCount() x ColumnCount()
+// vertex grid triangulated like GeometryGenerator::CreateGrid, so the apps can build the
+// index buffer and upload the vertex stream without knowing which engine runs.
+class WaveSurface
+{
+public:
+    virtual ~WaveSurface() = default;
+
+    virtual int RowCount()const = 0;
+    virtual int ColumnCount()const = 0;
+    virtual int VertexCount()const = 0;
+    virtual int TriangleCount()const = 0;
+    virtual float Width()const = 0;
+    virtual float Depth()const = 0;
+
+    // Length of one fixed simulation step, Step() advances by multiples of it.
+    virtual float TimeStep()const = 0;
+
+    virtual void Update(float dt) = 0;
+    virtual void Step(int count) = 0;
+
+    // Steps the engine prefers to be advanced by at once, drivers on a fixed clock step
+    // this many every Substeps()*TimeStep().
+    virtual int Substeps()const { return 1; }
+
+    // Queues a local impulse, applied at the start of the next step. Unlike the rest of
+    // the interface this is safe to call from any thread, also while another one steps.
+    // Engines without local state may ignore it.
+    virtual void Disturb(const WaveDisturbance& disturbance) = 0;
+
+    void Disturb(int i, int j, float magnitude)
+    {
+        WaveDisturbance disturbance;
+        disturbance.I = i;
+        disturbance.J = j;
+        disturbance.Magnitude = magnitude;
+        Disturb(disturbance);
+    }
+
+    // Writes VertexCount() vertices of layout.Stride bytes into dst.
+    virtual void WriteVertices(void* dst, const WaveVertexLayout& layout)const = 0;
+
+    // Rewrites what changed since the last call with the same emittedVersions, which the
+    // caller keeps per destination buffer. Engines without change tracking rewrite everything.
+    virtual void WriteChangedVertices(void* dst, const WaveVertexLayout& layout,
+        std::vector<std::uint32_t>& emittedVersions, std::vector<WaveVertexRange>* changedRanges = nullptr)const
+    {
+        WriteVertices(dst, layout);
+        if (changedRanges)
+        {
+            WaveVertexRange all;
+            all.Count = VertexCount();
+            changedRanges->assign(1, all);
+        }
+    }
+};
@@ -0,0 +1,91 @@
+﻿#include "WaveSystem.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "../../Common/TaskScheduler.h"
+
+namespace
+{
+    // Roughly the number of cells in one work item, small enough to balance, big
+    // enough that claiming an item costs nothing next to solving it.
+    const int CellsPerWorkItem = 16 * 1024;
+}
+
+Waves* WaveSystem::Add(int m, int n, float dx, float dt, float speed, float damping)
+{
+    mWaves.push_back(std::make_unique<Waves>(m, n, dx, dt, speed, damping));
+    return mWaves.back().get();
+}
+
+void WaveSystem::Remove(Waves* waves)
+{
+    auto it = std::find_if(mWaves.begin(), mWaves.end(),
+        [waves](const std::unique_ptr<Waves>& e) { return e.get() == waves; });
+    assert(it != mWaves.end());
+
+    if (it != mWaves.end())
+    {
+        mWaves.erase(it);
+    }
+}
+
+void WaveSystem::Update(float dt)
+{
+    mRowSolved.clear();
+    mWorkItems.clear();
+
+    for (auto& waves : mWaves)
+    {
+        const int steps = waves->ConsumeTime(dt);
+        if (steps == 0)
+        {
+            continue;
+        }
+
+        if (!waves->CanSolveRows())
+        {
+            // Tiled/blocked grids schedule their own work, run their steps as one item.
+            WorkItem item;
+            item.Target = waves.get();
+            item.Steps = steps;
+            mWorkItems.push_back(item);
+            continue;
+        }
+
+        mRowSolved.push_back(waves.get());
+        waves->ApplyDisturbances();
+
+        const int rowsPerItem = std::max(1, CellsPerWorkItem / waves->ColumnCount());
+        for (int row = 1; row < waves->RowCount() - 1; row += rowsPerItem)
+        {
+            WorkItem item;
+            item.Target = waves.get();
+            item.RowBegin = row;
+            item.RowEnd = std::min(row + rowsPerItem, waves->RowCount() - 1);
+            mWorkItems.push_back(item);
+        }
+    }
+
+    // The whole-grid items are the longest, they go first so they aren't left for last.
+    std::stable_partition(mWorkItems.begin(), mWorkItems.end(),
+        [](const WorkItem& item) { return item.RowBegin < 0; });
+
+    TaskScheduler::Get().ParallelFor(0, static_cast<int>(mWorkItems.size()), 1, [this](int index)
+    {
+        const WorkItem& item = mWorkItems[index];
+        if (item.RowBegin < 0)
+        {
+            item.Target->Step(item.Steps);
+        }
+        else
+        {
+            item.Target->SolveRows(item.RowBegin, item.RowEnd);
+        }
+    });
+
+    for (Waves* waves : mRowSolved)
+    {
+        waves->FinishStep();
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "Waves.h"
+
+// Owns any number of independent wave grids. Every grid keeps its own clock and
+// parameters, and all grids that are due are advanced in one scheduled pass: the rows of
+// single step grids are cut into similar sized chunks and shared out across the workers,
+// so one big ocean and a few small ponds still balance out. Grids with substeps or
+// activity tracking advance their whole block of steps as one item.
+class WaveSystem
+{
+public:
+    WaveSystem() = default;
+    WaveSystem(const WaveSystem& rhs) = delete;
+    WaveSystem& operator=(const WaveSystem& rhs) = delete;
+
+    // The returned grid stays owned by the system and valid until Remove() or destruction.
+    Waves* Add(int m, int n, float dx, float dt, float speed, float damping);
+    void Remove(Waves* waves);
+
+    int Count()const { return static_cast<int>(mWaves.size()); }
+    Waves* Get(int index)const { return mWaves[index].get(); }
+
+    void Update(float dt);
+
+private:
+    // A run of interior rows of one grid, or Steps whole steps of it when RowBegin is -1.
+    struct WorkItem
+    {
+        Waves* Target = nullptr;
+        int RowBegin = -1;
+        int RowEnd = -1;
+        int Steps = 1;
+    };
+
+    std::vector<std::unique_ptr<Waves>> mWaves;
+
+    // Reused every update.
+    std::vector<Waves*> mRowSolved;
+    std::vector<WorkItem> mWorkItems;
+};
@@ -3,13 +3,183 @@
 //***************************************************************************************
 
 #include "Waves.h"
-#include <ppl.h>
 #include <algorithm>
 #include <vector>
 #include <cassert>
+#include <cmath>
+#include <cstring>
+#include <immintrin.h>
+
+#include "../../Common/SimdUtil.h"
+#include "../../Common/TaskScheduler.h"
 
 using namespace DirectX;
 
+namespace
+{
+    // Rows handed to a worker at a time, small grids end up running inline.
+    const int RowGrainSize = 16;
+
+    // Steps a tile has to stay below the activity epsilon before it is put to sleep.
+    const int SleepDelaySteps = 8;
+
+    // Moves heights between the stored planes and float scratch, halves are converted.
+    void LoadHeights(const float* src, float* dst, size_t count)
+    {
+        std::copy_n(src, count, dst);
+    }
+
+    void LoadHeights(const std::uint16_t* src, float* dst, size_t count)
+    {
+        SimdUtil::HalfToFloat(src, dst, count);
+    }
+
+    void StoreHeights(const float* src, float* dst, size_t count)
+    {
+        std::copy_n(src, count, dst);
+    }
+
+    void StoreHeights(const float* src, std::uint16_t* dst, size_t count)
+    {
+        SimdUtil::FloatToHalf(src, dst, count);
+    }
+
+    // One interior row of the height update:
+    //   next(j) = k1*prev(j) + k2*curr(j) + k3*(down(j) + up(j) + curr(j+1) + curr(j-1))
+    // The result is written over prev, which is safe because prev(j) is read only by
+    // the lane that writes it. All kernels evaluate the expression in the same order,
+    // so the SIMD paths produce exactly the same floats as the scalar one.
+    void SolveRowScalar(float* prev, const float* curr, const float* up, const float* down,
+        int begin, int end, float k1, float k2, float k3)
+    {
+        for(int j = begin; j < end; ++j)
+        {
+            prev[j] = k1*prev[j] + k2*curr[j] + k3*(down[j] + up[j] + curr[j+1] + curr[j-1]);
+        }
+    }
+
+    void SolveRowSSE(float* prev, const float* curr, const float* up, const float* down,
+        int begin, int end, float k1, float k2, float k3)
+    {
+        const __m128 vk1 = _mm_set1_ps(k1);
+        const __m128 vk2 = _mm_set1_ps(k2);
+        const __m128 vk3 = _mm_set1_ps(k3);
+
+        int j = begin;
+        for(; j + 4 <= end; j += 4)
+        {
+            __m128 p = _mm_loadu_ps(prev + j);
+            __m128 c = _mm_loadu_ps(curr + j);
+            __m128 sum = _mm_add_ps(_mm_loadu_ps(down + j), _mm_loadu_ps(up + j));
+            sum = _mm_add_ps(sum, _mm_loadu_ps(curr + j + 1));
+            sum = _mm_add_ps(sum, _mm_loadu_ps(curr + j - 1));
+
+            __m128 r = _mm_add_ps(_mm_mul_ps(vk1, p), _mm_mul_ps(vk2, c));
+            r = _mm_add_ps(r, _mm_mul_ps(vk3, sum));
+            _mm_storeu_ps(prev + j, r);
+        }
+
+        SolveRowScalar(prev, curr, up, down, j, end, k1, k2, k3);
+    }
+
+    SIMD_TARGET_AVX2 void SolveRowAVX2(float* prev, const float* curr, const float* up, const float* down,
+        int begin, int end, float k1, float k2, float k3)
+    {
+        const __m256 vk1 = _mm256_set1_ps(k1);
+        const __m256 vk2 = _mm256_set1_ps(k2);
+        const __m256 vk3 = _mm256_set1_ps(k3);
+
+        int j = begin;
+        for(; j + 8 <= end; j += 8)
+        {
+            __m256 p = _mm256_loadu_ps(prev + j);
+            __m256 c = _mm256_loadu_ps(curr + j);
+            __m256 sum = _mm256_add_ps(_mm256_loadu_ps(down + j), _mm256_loadu_ps(up + j));
+            sum = _mm256_add_ps(sum, _mm256_loadu_ps(curr + j + 1));
+            sum = _mm256_add_ps(sum, _mm256_loadu_ps(curr + j - 1));
+
+            // Keep mul and add separate, a fused multiply-add rounds differently
+            // from the scalar reference.
+            __m256 r = _mm256_add_ps(_mm256_mul_ps(vk1, p), _mm256_mul_ps(vk2, c));
+            r = _mm256_add_ps(r, _mm256_mul_ps(vk3, sum));
+            _mm256_storeu_ps(prev + j, r);
+        }
+
+        SolveRowSSE(prev, curr, up, down, j, end, k1, k2, k3);
+    }
+
+    // Solves cells [begin, end) of one row, the rows above and below are numCols away.
+    void SolveRow(EWaveSolver solver, float* prev, const float* curr, int numCols, int begin, int end,
+        float k1, float k2, float k3)
+    {
+        const float* up = curr - numCols;
+        const float* down = curr + numCols;
+
+        switch(solver)
+        {
+        case EWaveSolver::AVX2:
+            SolveRowAVX2(prev, curr, up, down, begin, end, k1, k2, k3);
+            break;
+        case EWaveSolver::SSE:
+            SolveRowSSE(prev, curr, up, down, begin, end, k1, k2, k3);
+            break;
+        default:
+            SolveRowScalar(prev, curr, up, down, begin, end, k1, k2, k3);
+            break;
+        }
+    }
+
+    // q is the squared distance over the squared radius.
+    inline float FalloffWeight(float q, EWaveFalloff falloff)
+    {
+        if(falloff == EWaveFalloff::Linear)
+        {
+            return std::max(0.0f, 1.0f - sqrtf(q));
+        }
+        const float t = std::max(0.0f, 1.0f - q);
+        return t*t;
+    }
+
+    inline __m128 FalloffWeight(__m128 q, EWaveFalloff falloff)
+    {
+        const __m128 one = _mm_set1_ps(1.0f);
+        if(falloff == EWaveFalloff::Linear)
+        {
+            return _mm_max_ps(_mm_setzero_ps(), _mm_sub_ps(one, _mm_sqrt_ps(q)));
+        }
+        const __m128 t = _mm_max_ps(_mm_setzero_ps(), _mm_sub_ps(one, q));
+        return _mm_mul_ps(t, t);
+    }
+
+    // Adds magnitude * falloff to count cells of one row. dx is the column offset of the
+    // first cell from the center, dzSq the squared row offset already over radius^2.
+    void AddFalloffRow(float* heights, int count, float dx, float dzSq, float invRadiusSq,
+        float magnitude, EWaveFalloff falloff)
+    {
+        const __m128 vInvRadiusSq = _mm_set1_ps(invRadiusSq);
+        const __m128 vDzSq = _mm_set1_ps(dzSq);
+        const __m128 vMagnitude = _mm_set1_ps(magnitude);
+        const __m128 four = _mm_set1_ps(4.0f);
+        __m128 vDx = _mm_add_ps(_mm_set1_ps(dx), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+
+        int k = 0;
+        for(; k + 4 <= count; k += 4)
+        {
+            const __m128 q = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(vDx, vDx), vInvRadiusSq), vDzSq);
+            const __m128 w = FalloffWeight(q, falloff);
+            _mm_storeu_ps(heights + k, _mm_add_ps(_mm_loadu_ps(heights + k), _mm_mul_ps(vMagnitude, w)));
+            vDx = _mm_add_ps(vDx, four);
+        }
+
+        for(; k < count; ++k)
+        {
+            const float x = dx + k;
+            const float q = x*x*invRadiusSq + dzSq;
+            heights[k] += magnitude*FalloffWeight(q, falloff);
+        }
+    }
+}
+
 Waves::Waves(int m, int n, float dx, float dt, float speed, float damping)
 {
     mNumRows = m;
@@ -27,28 +197,20 @@ Waves::Waves(int m, int n, float dx, float dt, float speed, float damping)
     mK2 = (4.0f - 8.0f*e) / d;
     mK3 = (2.0f*e) / d;
 
-    mPrevSolution.resize(m*n);
-    mCurrSolution.resize(m*n);
-    mNormals.resize(m*n);
-    mTangentX.resize(m*n);
+    // The grid x/z coordinates never change, Position() derives them from these.
+    mHalfWidth = (n - 1)*dx*0.5f;
+    mHalfDepth = (m - 1)*dx*0.5f;
 
-    // Generate grid vertices in system memory.
+    mPrevHeights.assign(m*n, 0.0f);
+    mCurrHeights.assign(m*n, 0.0f);
 
-    float halfWidth = (n - 1)*dx*0.5f;
-    float halfDepth = (m - 1)*dx*0.5f;
-    for(int i = 0; i < m; ++i)
-    {
-        float z = halfDepth - i*dx;
-        for(int j = 0; j < n; ++j)
-        {
-            float x = -halfWidth + j*dx;
+    mTileRows = (m + TileSize - 1) / TileSize;
+    mTileCols = (n + TileSize - 1) / TileSize;
+    mTileAwake.assign(mTileRows*mTileCols, 1);
+    mTileQuietSteps.assign(mTileRows*mTileCols, 0);
+    mTileVersions.assign(mTileRows*mTileCols, 1);
 
-            mPrevSolution[i*n + j] = XMFLOAT3(x, 0.0f, z);
-            mCurrSolution[i*n + j] = XMFLOAT3(x, 0.0f, z);
-            mNormals[i*n + j] = XMFLOAT3(0.0f, 1.0f, 0.0f);
-            mTangentX[i*n + j] = XMFLOAT3(1.0f, 0.0f, 0.0f);
-        }
-    }
+    SetSolver(EWaveSolver::Auto);
 }
 
 Waves::~Waves()
@@ -87,86 +249,792 @@ float Waves::Depth()const
 
 void Waves::Update(float dt)
 {
-	static float t = 0;
+	const int steps = ConsumeTime(dt);
+	if(steps > 0)
+	{
+		Step(steps);
+	}
+}
 
+int Waves::ConsumeTime(float dt)
+{
 	// Accumulate time.
-	t += dt;
+	mAccumulatedTime += dt;
+
+	// Only update the simulation once a whole block of time steps has passed, the
+	// blocked solver runs them in one sweep.
+	if( mAccumulatedTime >= mSubsteps*mTimeStep )
+	{
+		mAccumulatedTime = 0.0f; // reset time
+		return mSubsteps;
+	}
+	return 0;
+}
+
+bool Waves::CanSolveRows()const
+{
+	return !mTrackActivity && mSubsteps == 1 && !mCompactStorage;
+}
 
-	// Only update the simulation at the specified time step.
-	if( t >= mTimeStep )
+void Waves::SolveRows(int rowBegin, int rowEnd)
+{
+	assert(rowBegin >= 1 && rowEnd <= mNumRows - 1);
+
+	for(int i = rowBegin; i < rowEnd; ++i)
 	{
-		// Only update interior points; we use zero boundary conditions.
-		concurrency::parallel_for(1, mNumRows - 1, [this](int i)
-		//for(int i = 1; i < mNumRows-1; ++i)
+		// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
+		// Moreover, our +z axis goes "down"; this is just to 
+		// keep consistent with our row indices going down.
+		SolveRow(mSolver, &mPrevHeights[i*mNumCols], &mCurrHeights[i*mNumCols], mNumCols, 1, mNumCols - 1, mK1, mK2, mK3);
+	}
+}
+
+void Waves::FinishStep()
+{
+	// We just overwrote the previous buffer with the new data, so
+	// this data needs to become the current solution and the old
+	// current solution becomes the new previous solution.
+	std::swap(mPrevHeights, mCurrHeights);
+	TouchAllTiles();
+}
+
+void Waves::Step(int count)
+{
+	while(count > 0)
+	{
+		ApplyDisturbances();
+
+		if(mTrackActivity && !mCompactStorage)
 		{
-			for(int j = 1; j < mNumCols-1; ++j)
+			StepActive();
+			--count;
+			continue;
+		}
+
+		// Half precision state is only ever solved through the blocked path's float scratch.
+		int steps = std::min(count, mSubsteps);
+		if(steps > 1 || mCompactStorage)
+		{
+			StepBlocked(steps);
+			TouchAllTiles();
+		}
+		else
+		{
+			StepReference();
+		}
+		count -= steps;
+	}
+}
+
+void Waves::SetSubsteps(int substeps)
+{
+	assert(substeps >= 1);
+	mSubsteps = std::max(1, substeps);
+}
+
+void Waves::StepReference()
+{
+	// Only update interior points; we use zero boundary conditions.
+	TaskScheduler::Get().ParallelForRange(1, mNumRows - 1, RowGrainSize, [this](int rowBegin, int rowEnd)
+	{
+		SolveRows(rowBegin, rowEnd);
+	});
+
+	FinishStep();
+}
+
+void Waves::StepBlocked(int steps)
+{
+	if(mCompactStorage)
+	{
+		StepBlockedPlanes(steps, mPrevHalfHeights, mCurrHalfHeights, mHaloHalfHeights);
+	}
+	else
+	{
+		StepBlockedPlanes(steps, mPrevHeights, mCurrHeights, mHaloHeights);
+	}
+}
+
+template<typename T>
+void Waves::StepBlockedPlanes(int steps, HeightPlane<T>& prevPlane, HeightPlane<T>& currPlane, HeightPlane<T>& halo)
+{
+	// Temporal blocking: each band of rows is copied into scratch together with `steps`
+	// halo rows on either side and advanced `steps` times while it is still in cache.
+	// Every sub-step the valid region shrinks by one row per side, after the last one
+	// exactly the band is left. Halo rows are solved redundantly by neighbouring bands,
+	// with the same kernel and inputs, so the output matches the reference bit-for-bit.
+	//
+	// Results go straight back into the planes, so the state stays two planes. Every thread
+	// sweeps a chunk of bands top to bottom: the rows below a band are still untouched, the
+	// old rows above it are carried over from the previous band. Only the halos at chunk
+	// edges, which the neighbouring chunk may be writing, are saved up front. With compact
+	// storage the planes are halves and get converted on the way in and out of scratch.
+	const int bandRows = BlockedBandRows(steps);
+	const int interiorRows = mNumRows - 2;
+	const int bandCount = (interiorRows + bandRows - 1) / bandRows;
+	const int chunkCount = std::min(bandCount, (int)TaskScheduler::Get().Concurrency());
+	const size_t haloSize = (size_t)steps*mNumCols;
+
+	auto bandBegin = [this, bandRows](int band) { return 1 + band*bandRows; };
+	auto bandEnd = [this, bandRows](int band) { return std::min(1 + (band + 1)*bandRows, mNumRows - 1); };
+	auto firstBand = [bandCount, chunkCount](int chunk) { return chunk*bandCount/chunkCount; };
+
+	// Per chunk and plane: `steps` rows above the chunk, ending right above it, then `steps`
+	// rows below it. Rows outside the grid are left out.
+	halo.resize(4*chunkCount*haloSize);
+	T* prevHalo = halo.data();
+	T* currHalo = prevHalo + 2*chunkCount*haloSize;
+	for(int chunk = 0; chunk < chunkCount; ++chunk)
+	{
+		const int rowBegin = bandBegin(firstBand(chunk));
+		const int rowEnd = bandEnd(firstBand(chunk + 1) - 1);
+		const size_t topSize = (size_t)std::min(steps, rowBegin)*mNumCols;
+		const size_t bottomSize = (size_t)(std::min(mNumRows, rowEnd + steps) - rowEnd)*mNumCols;
+		const size_t top = 2*chunk*haloSize + haloSize - topSize;
+		const size_t bottom = 2*chunk*haloSize + haloSize;
+		std::copy_n(&prevPlane[rowBegin*mNumCols] - topSize, topSize, prevHalo + top);
+		std::copy_n(&currPlane[rowBegin*mNumCols] - topSize, topSize, currHalo + top);
+		std::copy_n(&prevPlane[rowEnd*mNumCols], bottomSize, prevHalo + bottom);
+		std::copy_n(&currPlane[rowEnd*mNumCols], bottomSize, currHalo + bottom);
+	}
+
+	TaskScheduler::Get().ParallelFor(0, chunkCount, 1, [&](int chunk)
+	{
+		// Scratch is reused by the thread across bands and calls.
+		thread_local std::vector<float, AlignedAllocator<float>> scratchA;
+		thread_local std::vector<float, AlignedAllocator<float>> scratchB;
+		thread_local std::vector<float, AlignedAllocator<float>> carry;
+		carry.resize(2*haloSize);
+
+		const int first = firstBand(chunk);
+		const int last = firstBand(chunk + 1);
+		for(int band = first; band < last; ++band)
+		{
+			const int begin = bandBegin(band);
+			const int end = bandEnd(band);
+
+			// Rows available in scratch: the band plus the halo, clamped to the grid.
+			const int copyBegin = std::max(0, begin - steps);
+			const int copyEnd = std::min(mNumRows, end + steps);
+			const size_t topSize = (size_t)(begin - copyBegin)*mNumCols;
+			const size_t bandSize = (size_t)(end - begin)*mNumCols;
+			const size_t bottomSize = (size_t)(copyEnd - end)*mNumCols;
+			scratchA.resize(topSize + bandSize + bottomSize);
+			scratchB.resize(topSize + bandSize + bottomSize);
+			float* const a = scratchA.data();
+			float* const b = scratchB.data();
+
+			if(band == first)
 			{
-				// After this update we will be discarding the old previous
-				// buffer, so overwrite that buffer with the new update.
-				// Note how we can do this inplace (read/write to same element) 
-				// because we won't need prev_ij again and the assignment happens last.
-
-				// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
-				// Moreover, our +z axis goes "down"; this is just to 
-				// keep consistent with our row indices going down.
-
-				mPrevSolution[i*mNumCols+j].y = 
-					mK1*mPrevSolution[i*mNumCols+j].y +
-					mK2*mCurrSolution[i*mNumCols+j].y +
-					mK3*(mCurrSolution[(i+1)*mNumCols+j].y + 
-					     mCurrSolution[(i-1)*mNumCols+j].y + 
-					     mCurrSolution[i*mNumCols+j+1].y + 
-						 mCurrSolution[i*mNumCols+j-1].y);
+				const size_t top = 2*chunk*haloSize + haloSize - topSize;
+				LoadHeights(prevHalo + top, a, topSize);
+				LoadHeights(currHalo + top, b, topSize);
+			}
+			else
+			{
+				// Bands before the last are full, so exactly `steps` rows are carried.
+				std::copy_n(carry.data(), topSize, a);
+				std::copy_n(carry.data() + haloSize, topSize, b);
 			}
-		});
 
-		// We just overwrote the previous buffer with the new data, so
-		// this data needs to become the current solution and the old
-		// current solution becomes the new previous solution.
-		std::swap(mPrevSolution, mCurrSolution);
+			LoadHeights(&prevPlane[begin*mNumCols], a + topSize, bandSize);
+			LoadHeights(&currPlane[begin*mNumCols], b + topSize, bandSize);
 
-		t = 0.0f; // reset time
+			if(band == last - 1)
+			{
+				const size_t bottom = 2*chunk*haloSize + haloSize;
+				LoadHeights(prevHalo + bottom, a + topSize + bandSize, bottomSize);
+				LoadHeights(currHalo + bottom, b + topSize + bandSize, bottomSize);
+			}
+			else
+			{
+				LoadHeights(&prevPlane[end*mNumCols], a + topSize + bandSize, bottomSize);
+				LoadHeights(&currPlane[end*mNumCols], b + topSize + bandSize, bottomSize);
+
+				// The next band's top halo, before this band overwrites it.
+				std::copy_n(a + topSize + bandSize - haloSize, haloSize, carry.data());
+				std::copy_n(b + topSize + bandSize - haloSize, haloSize, carry.data() + haloSize);
+			}
+
+			float* prev = a;
+			float* curr = b;
+			for(int s = 1; s <= steps; ++s)
+			{
+				// Boundary rows keep their zero heights, exactly like the reference.
+				const int solveBegin = std::max(1, begin - (steps - s));
+				const int solveEnd = std::min(mNumRows - 1, end + (steps - s));
+				for(int i = solveBegin; i < solveEnd; ++i)
+				{
+					const int local = (i - copyBegin)*mNumCols;
+					SolveRow(mSolver, prev + local, curr + local, mNumCols, 1, mNumCols - 1, mK1, mK2, mK3);
+				}
+				std::swap(prev, curr);
+			}
+
+			// Boundary rows are never written, they don't change.
+			StoreHeights(prev + topSize, &prevPlane[begin*mNumCols], bandSize);
+			StoreHeights(curr + topSize, &currPlane[begin*mNumCols], bandSize);
+		}
+	});
+}
+
+int Waves::BlockedBandRows(int steps)const
+{
+	// Keep both scratch planes (band + halo) inside a typical per-core L2.
+	const size_t cacheBudget = 512 * 1024;
+	const size_t rowBytes = 2 * sizeof(float) * mNumCols;
+	const int fittingRows = (int)(cacheBudget / rowBytes) - 2*steps;
+
+	// Narrower bands would spend more time on halo rows than on the band itself.
+	return std::max(fittingRows, 2*steps);
+}
+
+void Waves::WriteVertices(void* dst, const WaveVertexLayout& layout)const
+{
+	assert(dst != nullptr);
+	assert(layout.Stride > 0);
+
+	unsigned char* bytes = static_cast<unsigned char*>(dst);
+	TaskScheduler::Get().ParallelFor(0, mNumRows, RowGrainSize, [this, bytes, &layout](int i)
+	{
+		WriteVertexRange(bytes, layout, i, 0, mNumCols);
+	});
+}
+
+void Waves::WriteVertexRange(unsigned char* dst, const WaveVertexLayout& layout, int row, int colBegin, int colEnd)const
+{
+	const float width = Width();
+	const float depth = Depth();
+	const float z = mHalfDepth - row*mSpatialStep;
 
-		//
-		// Compute normals using finite difference scheme.
-		//
-		concurrency::parallel_for(1, mNumRows - 1, [this](int i)
-		//for(int i = 1; i < mNumRows - 1; ++i)
+	thread_local std::vector<float> scratch;
+	const float* heights = CurrRows(row, colBegin, colEnd, scratch);
+
+	unsigned char* v = dst + (size_t)(row*mNumCols + colBegin)*layout.Stride;
+	for(int j = colBegin; j < colEnd; ++j, v += layout.Stride)
+	{
+		const XMFLOAT3 pos(-mHalfWidth + j*mSpatialStep, heights[j], z);
+
+		if(layout.PositionOffset >= 0)
+		{
+			memcpy(v + layout.PositionOffset, &pos, sizeof(XMFLOAT3));
+		}
+
+		if(layout.NormalOffset >= 0 || layout.TangentOffset >= 0)
 		{
-			for(int j = 1; j < mNumCols-1; ++j)
+			XMFLOAT3 normal;
+			XMFLOAT3 tangent;
+			ComputeNormalTangent(heights, row, j, normal, tangent);
+
+			if(layout.NormalOffset >= 0)
 			{
-				float l = mCurrSolution[i*mNumCols+j-1].y;
-				float r = mCurrSolution[i*mNumCols+j+1].y;
-				float t = mCurrSolution[(i-1)*mNumCols+j].y;
-				float b = mCurrSolution[(i+1)*mNumCols+j].y;
-				mNormals[i*mNumCols+j].x = -r+l;
-				mNormals[i*mNumCols+j].y = 2.0f*mSpatialStep;
-				mNormals[i*mNumCols+j].z = b-t;
-
-				XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&mNormals[i*mNumCols+j]));
-				XMStoreFloat3(&mNormals[i*mNumCols+j], n);
-
-				mTangentX[i*mNumCols+j] = XMFLOAT3(2.0f*mSpatialStep, r-l, 0.0f);
-				XMVECTOR T = XMVector3Normalize(XMLoadFloat3(&mTangentX[i*mNumCols+j]));
-				XMStoreFloat3(&mTangentX[i*mNumCols+j], T);
+				memcpy(v + layout.NormalOffset, &normal, sizeof(XMFLOAT3));
 			}
-		});
+			if(layout.TangentOffset >= 0)
+			{
+				memcpy(v + layout.TangentOffset, &tangent, sizeof(XMFLOAT3));
+			}
+		}
+
+		if(layout.TexCOffset >= 0)
+		{
+			// Derive tex-coords from position by 
+			// mapping [-w/2,w/2] --> [0,1]
+			const XMFLOAT2 texC(0.5f + pos.x / width, 0.5f - pos.z / depth);
+			memcpy(v + layout.TexCOffset, &texC, sizeof(XMFLOAT2));
+		}
+
+		if(layout.ColorOffset >= 0)
+		{
+			memcpy(v + layout.ColorOffset, &layout.Color, sizeof(XMFLOAT4));
+		}
 	}
 }
 
-void Waves::Disturb(int i, int j, float magnitude)
+void Waves::ComputeNormalTangent(const float* rowHeights, int i, int j, XMFLOAT3& normal, XMFLOAT3& tangent)const
 {
-	// Don't disturb boundaries.
-	assert(i > 1 && i < mNumRows-2);
-	assert(j > 1 && j < mNumCols-2);
+	// The boundary is pinned at zero height, so it stays flat.
+	if(i <= 0 || i >= mNumRows-1 || j <= 0 || j >= mNumCols-1)
+	{
+		normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
+		tangent = XMFLOAT3(1.0f, 0.0f, 0.0f);
+		return;
+	}
 
-	float halfMag = 0.5f*magnitude;
+	//
+	// Compute normals using finite difference scheme.
+	//
+	float l = rowHeights[j-1];
+	float r = rowHeights[j+1];
+	float t = rowHeights[j-mNumCols];
+	float b = rowHeights[j+mNumCols];
+
+	XMFLOAT3 n(-r+l, 2.0f*mSpatialStep, b-t);
+	XMStoreFloat3(&normal, XMVector3Normalize(XMLoadFloat3(&n)));
+
+	XMFLOAT3 T(2.0f*mSpatialStep, r-l, 0.0f);
+	XMStoreFloat3(&tangent, XMVector3Normalize(XMLoadFloat3(&T)));
+}
+
+const float* Waves::CurrRows(int row, int colBegin, int colEnd, std::vector<float>& scratch)const
+{
+	// Row pointer with the rows above and below mNumCols away, like the solver uses.
+	if(!mCompactStorage)
+	{
+		return &mCurrHeights[row*mNumCols];
+	}
+
+	// Decode the three rows into scratch, one extra column either side for the normals.
+	scratch.resize(3*mNumCols);
+	const int first = std::max(0, colBegin - 1);
+	const int last = std::min(mNumCols, colEnd + 1);
+	for(int i = std::max(0, row - 1); i <= std::min(mNumRows - 1, row + 1); ++i)
+	{
+		SimdUtil::HalfToFloat(&mCurrHalfHeights[i*mNumCols + first], &scratch[(i - row + 1)*mNumCols + first], last - first);
+	}
+	return &scratch[mNumCols];
+}
+
+XMFLOAT3 Waves::Normal(int i)const
+{
+	const int row = i / mNumCols;
+	const int col = i % mNumCols;
+	std::vector<float> scratch;
+
+	XMFLOAT3 normal;
+	XMFLOAT3 tangent;
+	ComputeNormalTangent(CurrRows(row, col, col + 1, scratch), row, col, normal, tangent);
+	return normal;
+}
+
+XMFLOAT3 Waves::TangentX(int i)const
+{
+	const int row = i / mNumCols;
+	const int col = i % mNumCols;
+	std::vector<float> scratch;
+
+	XMFLOAT3 normal;
+	XMFLOAT3 tangent;
+	ComputeNormalTangent(CurrRows(row, col, col + 1, scratch), row, col, normal, tangent);
+	return tangent;
+}
+
+void Waves::Disturb(const WaveDisturbance& disturbance)
+{
+	if(disturbance.Falloff == EWaveFalloff::Point)
+	{
+		// Don't disturb boundaries.
+		assert(disturbance.I > 1 && disturbance.I < mNumRows-2);
+		assert(disturbance.J > 1 && disturbance.J < mNumCols-2);
+	}
+	else
+	{
+		assert(disturbance.Radius > 0.0f);
+	}
+
+	mDisturbQueue.Push(disturbance);
+}
+
+void Waves::ApplyDisturbances()
+{
+	if(mDisturbQueue.IsEmpty())
+	{
+		return;
+	}
+
+	mDisturbBatch.clear();
+	mDisturbQueue.Drain(mDisturbBatch);
+	for(const WaveDisturbance& disturbance : mDisturbBatch)
+	{
+		ApplyDisturbance(disturbance);
+	}
+}
+
+void Waves::ApplyDisturbance(const WaveDisturbance& disturbance)
+{
+	const int i = disturbance.I;
+	const int j = disturbance.J;
+
+	if(disturbance.Falloff == EWaveFalloff::Point)
+	{
+		float halfMag = 0.5f*disturbance.Magnitude;
+
+		// Disturb the ijth vertex height and its neighbors.
+		AddHeight(i*mNumCols+j,     disturbance.Magnitude);
+		AddHeight(i*mNumCols+j+1,   halfMag);
+		AddHeight(i*mNumCols+j-1,   halfMag);
+		AddHeight((i+1)*mNumCols+j, halfMag);
+		AddHeight((i-1)*mNumCols+j, halfMag);
+
+		// The touched cells can straddle a tile border.
+		WakeCell(i, j);
+		WakeCell(i-1, j);
+		WakeCell(i+1, j);
+		WakeCell(i, j-1);
+		WakeCell(i, j+1);
+		return;
+	}
+
+	// Cells strictly inside the radius, clipped to the interior.
+	const float radius = disturbance.Radius;
+	const int rowBegin = std::max(1, (int)floorf(i - radius) + 1);
+	const int rowEnd = std::min(mNumRows - 1, (int)ceilf(i + radius));
+	const int colBegin = std::max(1, (int)floorf(j - radius) + 1);
+	const int colEnd = std::min(mNumCols - 1, (int)ceilf(j + radius));
+	if(rowBegin >= rowEnd || colBegin >= colEnd)
+	{
+		return;
+	}
+
+	const float invRadiusSq = 1.0f / (radius*radius);
+	const int count = colEnd - colBegin;
+	std::vector<float> scratch;
+	for(int row = rowBegin; row < rowEnd; ++row)
+	{
+		const float dz = (float)(row - i);
+		float* heights = nullptr;
+		if(mCompactStorage)
+		{
+			scratch.resize(count);
+			SimdUtil::HalfToFloat(&mCurrHalfHeights[row*mNumCols + colBegin], scratch.data(), count);
+			heights = scratch.data();
+		}
+		else
+		{
+			heights = &mCurrHeights[row*mNumCols + colBegin];
+		}
+
+		AddFalloffRow(heights, count, (float)(colBegin - j), dz*dz*invRadiusSq, invRadiusSq,
+			disturbance.Magnitude, disturbance.Falloff);
+
+		if(mCompactStorage)
+		{
+			SimdUtil::FloatToHalf(scratch.data(), &mCurrHalfHeights[row*mNumCols + colBegin], count);
+		}
+	}
+
+	for(int tileRow = rowBegin / TileSize; tileRow <= (rowEnd - 1) / TileSize; ++tileRow)
+	{
+		for(int tileCol = colBegin / TileSize; tileCol <= (colEnd - 1) / TileSize; ++tileCol)
+		{
+			const int tile = tileRow*mTileCols + tileCol;
+			WakeTile(tile);
+			++mTileVersions[tile];
+		}
+	}
+}
+
+void Waves::AddHeight(int index, float delta)
+{
+	if(mCompactStorage)
+	{
+		mCurrHalfHeights[index] = SimdUtil::FloatToHalf(SimdUtil::HalfToFloat(mCurrHalfHeights[index]) + delta);
+	}
+	else
+	{
+		mCurrHeights[index] += delta;
+	}
+}
+
+void Waves::SetCompactStorage(bool enable)
+{
+	if(enable == mCompactStorage)
+	{
+		return;
+	}
+
+	// Convert the state and free the other representation, the memory is the point.
+	const size_t count = (size_t)mNumRows*mNumCols;
+	if(enable)
+	{
+		mPrevHalfHeights.resize(count);
+		mCurrHalfHeights.resize(count);
+		SimdUtil::FloatToHalf(mPrevHeights.data(), mPrevHalfHeights.data(), count);
+		SimdUtil::FloatToHalf(mCurrHeights.data(), mCurrHalfHeights.data(), count);
+
+		for(auto* plane : { &mPrevHeights, &mCurrHeights, &mHaloHeights })
+		{
+			plane->clear();
+			plane->shrink_to_fit();
+		}
+	}
+	else
+	{
+		mPrevHeights.resize(count);
+		mCurrHeights.resize(count);
+		SimdUtil::HalfToFloat(mPrevHalfHeights.data(), mPrevHeights.data(), count);
+		SimdUtil::HalfToFloat(mCurrHalfHeights.data(), mCurrHeights.data(), count);
+
+		for(auto* plane : { &mPrevHalfHeights, &mCurrHalfHeights, &mHaloHalfHeights })
+		{
+			plane->clear();
+			plane->shrink_to_fit();
+		}
+	}
+	mCompactStorage = enable;
+
+	// Sleeping tiles are only guaranteed flat while the tracked path runs, start over.
+	std::fill(mTileAwake.begin(), mTileAwake.end(), (std::uint8_t)1);
+	std::fill(mTileQuietSteps.begin(), mTileQuietSteps.end(), (std::uint8_t)0);
+	TouchAllTiles();
+}
+
+void Waves::SetActivityTracking(bool enable, float epsilon)
+{
+	assert(epsilon >= 0.0f);
+
+	mTrackActivity = enable;
+	mActivityEpsilon = epsilon;
+
+	// Start with everything awake, quiet tiles fall asleep on their own.
+	std::fill(mTileAwake.begin(), mTileAwake.end(), (std::uint8_t)1);
+	std::fill(mTileQuietSteps.begin(), mTileQuietSteps.end(), (std::uint8_t)0);
+}
+
+size_t Waves::StateBytes()const
+{
+	return (mPrevHeights.capacity() + mCurrHeights.capacity() + mHaloHeights.capacity())*sizeof(float) +
+		(mPrevHalfHeights.capacity() + mCurrHalfHeights.capacity() + mHaloHalfHeights.capacity())*sizeof(std::uint16_t);
+}
+
+int Waves::ActiveTileCount()const
+{
+	return (int)std::count(mTileAwake.begin(), mTileAwake.end(), (std::uint8_t)1);
+}
+
+void Waves::StepActive()
+{
+	mActiveTiles.clear();
+	for(int tile = 0; tile < (int)mTileAwake.size(); ++tile)
+	{
+		if(mTileAwake[tile])
+		{
+			mActiveTiles.push_back(tile);
+		}
+	}
+
+	// Sleeping tiles are flat in both planes, so with nothing awake the step is a no-op.
+	if(mActiveTiles.empty())
+	{
+		return;
+	}
+
+	// Tiles only write their own cells and the current plane is read-only during the
+	// step, so they can be solved in any order like the full-grid sweep.
+	TaskScheduler::Get().ParallelFor(0, (int)mActiveTiles.size(), 1, [this](int index)
+	{
+		const int tile = mActiveTiles[index];
+		const int tileRow = tile / mTileCols;
+		const int tileCol = tile - tileRow*mTileCols;
+
+		const int rowBegin = std::max(1, tileRow*TileSize);
+		const int rowEnd = std::min(mNumRows - 1, (tileRow + 1)*TileSize);
+		const int colBegin = std::max(1, tileCol*TileSize);
+		const int colEnd = std::min(mNumCols - 1, (tileCol + 1)*TileSize);
+
+		for(int i = rowBegin; i < rowEnd; ++i)
+		{
+			SolveRow(mSolver, &mPrevHeights[i*mNumCols], &mCurrHeights[i*mNumCols], mNumCols, colBegin, colEnd, mK1, mK2, mK3);
+		}
+	});
+
+	std::swap(mPrevHeights, mCurrHeights);
+
+	// Measure the new state of every solved tile: wake the neighbours its edges are
+	// pushing energy into, and put it to sleep once it has been flat for a while.
+	mTileWakeSides.assign(mTileAwake.size(), 0);
+	TaskScheduler::Get().ParallelFor(0, (int)mActiveTiles.size(), 1, [this](int index)
+	{
+		const int tile = mActiveTiles[index];
+		const int tileRow = tile / mTileCols;
+		const int tileCol = tile - tileRow*mTileCols;
+
+		const int rowBegin = tileRow*TileSize;
+		const int rowEnd = std::min(mNumRows, rowBegin + TileSize);
+		const int colBegin = tileCol*TileSize;
+		const int colEnd = std::min(mNumCols, colBegin + TileSize);
+
+		float amplitude = 0.0f;
+		float top = 0.0f, bottom = 0.0f, left = 0.0f, right = 0.0f;
+		for(int i = rowBegin; i < rowEnd; ++i)
+		{
+			for(int j = colBegin; j < colEnd; ++j)
+			{
+				const float h = fabsf(mCurrHeights[i*mNumCols+j]);
+				amplitude = std::max(amplitude, std::max(h, fabsf(mPrevHeights[i*mNumCols+j])));
+
+				if(i == rowBegin)  top = std::max(top, h);
+				if(i == rowEnd-1)  bottom = std::max(bottom, h);
+				if(j == colBegin)  left = std::max(left, h);
+				if(j == colEnd-1)  right = std::max(right, h);
+			}
+		}
+
+		std::uint8_t sides = 0;
+		if(top > mActivityEpsilon)    sides |= 1;
+		if(bottom > mActivityEpsilon) sides |= 2;
+		if(left > mActivityEpsilon)   sides |= 4;
+		if(right > mActivityEpsilon)  sides |= 8;
+		mTileWakeSides[tile] = sides;
+
+		if(amplitude > mActivityEpsilon)
+		{
+			mTileQuietSteps[tile] = 0;
+		}
+		else if(++mTileQuietSteps[tile] >= SleepDelaySteps)
+		{
+			// Flatten what's left so the tile is exactly at rest and neighbours read zeros.
+			for(int i = rowBegin; i < rowEnd; ++i)
+			{
+				std::fill(&mPrevHeights[i*mNumCols+colBegin], &mPrevHeights[i*mNumCols] + colEnd, 0.0f);
+				std::fill(&mCurrHeights[i*mNumCols+colBegin], &mCurrHeights[i*mNumCols] + colEnd, 0.0f);
+			}
+			mTileAwake[tile] = 0;
+		}
+	});
+
+	for(int tile : mActiveTiles)
+	{
+		++mTileVersions[tile];
+
+		const int tileRow = tile / mTileCols;
+		const int tileCol = tile - tileRow*mTileCols;
+		const std::uint8_t sides = mTileWakeSides[tile];
+		if((sides & 1) && tileRow > 0)             WakeTile(tile - mTileCols);
+		if((sides & 2) && tileRow < mTileRows - 1) WakeTile(tile + mTileCols);
+		if((sides & 4) && tileCol > 0)             WakeTile(tile - 1);
+		if((sides & 8) && tileCol < mTileCols - 1) WakeTile(tile + 1);
+	}
+}
+
+void Waves::WakeTile(int tile)
+{
+	mTileAwake[tile] = 1;
+	mTileQuietSteps[tile] = 0;
+}
+
+void Waves::WakeCell(int i, int j)
+{
+	const int tile = (i / TileSize)*mTileCols + j / TileSize;
+	WakeTile(tile);
+	++mTileVersions[tile];
+}
+
+void Waves::TouchAllTiles()
+{
+	for(auto& version : mTileVersions)
+	{
+		++version;
+	}
+}
+
+void Waves::WriteChangedVertices(void* dst, const WaveVertexLayout& layout,
+	std::vector<std::uint32_t>& emittedVersions, std::vector<WaveVertexRange>* changedRanges)const
+{
+	assert(dst != nullptr);
+	assert(layout.Stride > 0);
+
+	// Versions start at 1, so a fresh list re-emits everything.
+	const int tileCount = mTileRows*mTileCols;
+	emittedVersions.resize(tileCount, 0);
+
+	std::vector<std::uint8_t> dirty(tileCount, 0);
+	bool anyDirty = false;
+	for(int tile = 0; tile < tileCount; ++tile)
+	{
+		if(emittedVersions[tile] != mTileVersions[tile])
+		{
+			emittedVersions[tile] = mTileVersions[tile];
+			dirty[tile] = 1;
+			anyDirty = true;
+		}
+	}
+
+	std::vector<WaveVertexRange> ranges;
+	if(anyDirty)
+	{
+		// A vertex's normal depends on its four neighbours, so a changed tile also dirties
+		// the one-vertex ring around it. Per row that gives a few column segments.
+		std::vector<std::uint8_t> columnDirty(mTileCols);
+		for(int i = 0; i < mNumRows; ++i)
+		{
+			const int tileRow = i / TileSize;
+			const int rowAbove = (i - 1) / TileSize;
+			const int rowBelow = std::min(mNumRows - 1, i + 1) / TileSize;
+
+			for(int tileCol = 0; tileCol < mTileCols; ++tileCol)
+			{
+				columnDirty[tileCol] = dirty[tileRow*mTileCols + tileCol] |
+					(i > 0 ? dirty[rowAbove*mTileCols + tileCol] : (std::uint8_t)0) |
+					dirty[rowBelow*mTileCols + tileCol];
+			}
+
+			for(int tileCol = 0; tileCol < mTileCols; ++tileCol)
+			{
+				if(!columnDirty[tileCol])
+				{
+					continue;
+				}
+
+				const int colBegin = std::max(0, tileCol*TileSize - 1);
+				int colEnd = std::min(mNumCols, (tileCol + 1)*TileSize + 1);
+				while(tileCol + 1 < mTileCols && columnDirty[tileCol + 1])
+				{
+					++tileCol;
+					colEnd = std::min(mNumCols, (tileCol + 1)*TileSize + 1);
+				}
+
+				// Segments of the same row may touch after growing by one vertex, merge them.
+				const int first = i*mNumCols + colBegin;
+				if(!ranges.empty() && ranges.back().First + ranges.back().Count >= first)
+				{
+					ranges.back().Count = i*mNumCols + colEnd - ranges.back().First;
+				}
+				else
+				{
+					WaveVertexRange range;
+					range.First = first;
+					range.Count = colEnd - colBegin;
+					ranges.push_back(range);
+				}
+			}
+		}
+
+		unsigned char* bytes = static_cast<unsigned char*>(dst);
+		TaskScheduler::Get().ParallelFor(0, (int)ranges.size(), RowGrainSize, [this, bytes, &layout, &ranges](int index)
+		{
+			// Ranges were merged per row, but one can still run into the next row when a
+			// segment ends on the last column and the next starts on column 0.
+			int first = ranges[index].First;
+			const int last = first + ranges[index].Count;
+			while(first < last)
+			{
+				const int row = first / mNumCols;
+				const int colBegin = first - row*mNumCols;
+				const int colEnd = std::min(mNumCols, colBegin + (last - first));
+				WriteVertexRange(bytes, layout, row, colBegin, colEnd);
+				first += colEnd - colBegin;
+			}
+		});
+	}
+
+	if(changedRanges)
+	{
+		changedRanges->swap(ranges);
+	}
+}
+
+void Waves::SetSolver(EWaveSolver solver)
+{
+	if(solver == EWaveSolver::Auto)
+	{
+		solver = SimdUtil::HasAVX2() ? EWaveSolver::AVX2 : EWaveSolver::SSE;
+	}
+	else if(solver == EWaveSolver::AVX2 && !SimdUtil::HasAVX2())
+	{
+		solver = EWaveSolver::SSE;
+	}
 
-	// Disturb the ijth vertex height and its neighbors.
-	mCurrSolution[i*mNumCols+j].y     += magnitude;
-	mCurrSolution[i*mNumCols+j+1].y   += halfMag;
-	mCurrSolution[i*mNumCols+j-1].y   += halfMag;
-	mCurrSolution[(i+1)*mNumCols+j].y += halfMag;
-	mCurrSolution[(i-1)*mNumCols+j].y += halfMag;
+	mSolver = solver;
 }
 	
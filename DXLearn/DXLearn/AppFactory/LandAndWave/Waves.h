@@ -1,36 +1,146 @@
 ﻿#pragma once
 
+#include <cstdint>
 #include <vector>
 #include <DirectXMath.h>
 
-class Waves
+#include "WaveSurface.h"
+#include "../../Common/AlignedAllocator.h"
+#include "../../Common/MPSCQueue.h"
+#include "../../Common/SimdUtil.h"
+
+// Kernel used for the height update. All of them produce bit-identical results,
+// the wider ones just process more cells per instruction.
+enum class EWaveSolver : int
+{
+    Scalar = 0,
+    SSE,
+    AVX2,
+    Auto
+};
+
+class Waves : public WaveSurface
 {
 public:
     Waves(int m, int n, float dx, float dt, float speed, float damping);
     Waves(const Waves& rhs) = delete;
     Waves& operator=(const Waves& rhs) = delete;
-    ~Waves();
+    ~Waves() override;
 
-    int RowCount()const;
-    int ColumnCount()const;
-    int VertexCount()const;
-    int TriangleCount()const;
-    float Width()const;
-    float Depth()const;
+    int RowCount()const override;
+    int ColumnCount()const override;
+    int VertexCount()const override;
+    int TriangleCount()const override;
+    float Width()const override;
+    float Depth()const override;
+    float TimeStep()const override { return mTimeStep; }
 
     // Returns the solution at the ith grid point.
-    const DirectX::XMFLOAT3& Position(int i)const { return mCurrSolution[i]; }
+    DirectX::XMFLOAT3 Position(int i)const
+    {
+        int row = i / mNumCols;
+        int col = i - row*mNumCols;
+        return DirectX::XMFLOAT3(-mHalfWidth + col*mSpatialStep, CurrHeight(i), mHalfDepth - row*mSpatialStep);
+    }
+
+    // Returns the height of the solution at the ith grid point.
+    float Height(int i)const { return CurrHeight(i); }
 
     // Returns the solution normal at the ith grid point.
-    const DirectX::XMFLOAT3& Normal(int i)const { return mNormals[i]; }
+    DirectX::XMFLOAT3 Normal(int i)const;
 
     // Returns the unit tangent vector at the ith grid point in the local x-axis direction.
-    const DirectX::XMFLOAT3& TangentX(int i)const { return mTangentX[i]; }
+    DirectX::XMFLOAT3 TangentX(int i)const;
+
+    // Builds the whole vertex stream from the current solution in one pass. dst must hold
+    // VertexCount() vertices of layout.Stride bytes, typically a mapped upload buffer.
+    void WriteVertices(void* dst, const WaveVertexLayout& layout)const override;
+
+    // Accumulates dt on this grid's own clock and steps Substeps() time steps at once
+    // when that much time has passed.
+    void Update(float dt) override;
+
+    // Lock-free push, the queue is drained by the next step. Radius kernels are clipped
+    // to the interior, the boundary stays pinned at zero.
+    using WaveSurface::Disturb;
+    void Disturb(const WaveDisturbance& disturbance) override;
+
+    // Split form of Update() for schedulers that drive several grids at once:
+    // ConsumeTime() advances the clock and returns how many steps are due, 0 or Substeps().
+    // When CanSolveRows() is true that is a single step, which can be done as
+    // ApplyDisturbances(), any partition of SolveRows() over the interior rows
+    // [1, RowCount()-1), and one FinishStep(). Otherwise call Step() with the count.
+    int ConsumeTime(float dt);
+    bool CanSolveRows()const;
+    void ApplyDisturbances();
+    void SolveRows(int rowBegin, int rowEnd);
+    void FinishStep();
+
+    // Advances the simulation by count time steps regardless of the frame time.
+    void Step(int count) override;
+
+    // Number of time steps a band of rows is advanced while it stays in cache, and the
+    // number Update(), WaveSystem and WaveSimulationThread step at once. 1 sweeps the
+    // whole grid once per step, larger values pay off for grids that don't fit in L2.
+    // The heights are the same either way, only when they are stepped changes.
+    void SetSubsteps(int substeps);
+    int Substeps()const override { return mSubsteps; }
+
+    // Splits the grid into TileSize x TileSize tiles and only solves the awake ones.
+    // A tile wakes up when it is disturbed or a neighbour's edge rises above epsilon, and
+    // goes back to sleep (flattened to exactly zero) once it stays below epsilon.
+    // Takes precedence over substeps.
+    void SetActivityTracking(bool enable, float epsilon = 1e-4f);
+    bool IsActivityTracking()const { return mTrackActivity; }
+    int ActiveTileCount()const;
 
-    void Update(float dt);
-    void Disturb(int i, int j, float magnitude);
+    // Like WriteVertices() but only rewrites vertices whose tile changed since the last
+    // call with the same emittedVersions, which the caller keeps per destination buffer.
+    // changedRanges, if given, receives the rewritten vertex ranges.
+    void WriteChangedVertices(void* dst, const WaveVertexLayout& layout,
+        std::vector<std::uint32_t>& emittedVersions, std::vector<WaveVertexRange>* changedRanges = nullptr)const override;
+
+    static const int TileSize = 32;
+
+    // Keeps the two height planes as IEEE halves, 4 bytes of state per cell instead of 8
+    // (the old float3 position/normal/tangent arrays took 48). Steps decode bands into
+    // float scratch, solve them there and write them back in place, so only the stored
+    // state is rounded. Activity tracking needs float state and is ignored while this is on.
+    void SetCompactStorage(bool enable);
+    bool IsCompactStorage()const { return mCompactStorage; }
+
+    // Bytes held for the simulation state: the height planes and the blocked solver's
+    // halo carry. Per-thread band scratch isn't counted, it doesn't grow with the grid.
+    size_t StateBytes()const;
+
+    // Auto resolves to the widest kernel the CPU supports.
+    void SetSolver(EWaveSolver solver);
+    EWaveSolver Solver()const { return mSolver; }
 
 private:
+    template<typename T>
+    using HeightPlane = std::vector<T, AlignedAllocator<T>>;
+
+    void StepReference();
+    void StepBlocked(int steps);
+    template<typename T>
+    void StepBlockedPlanes(int steps, HeightPlane<T>& prevPlane, HeightPlane<T>& currPlane, HeightPlane<T>& halo);
+    int BlockedBandRows(int steps)const;
+    void StepActive();
+    void WakeTile(int tile);
+    void WakeCell(int i, int j);
+    void TouchAllTiles();
+    void WriteVertexRange(unsigned char* dst, const WaveVertexLayout& layout, int row, int colBegin, int colEnd)const;
+    void ComputeNormalTangent(const float* rowHeights, int i, int j, DirectX::XMFLOAT3& normal, DirectX::XMFLOAT3& tangent)const;
+    const float* CurrRows(int row, int colBegin, int colEnd, std::vector<float>& scratch)const;
+    void AddHeight(int index, float delta);
+    void ApplyDisturbance(const WaveDisturbance& disturbance);
+
+    float CurrHeight(int i)const
+    {
+        return mCompactStorage ? SimdUtil::HalfToFloat(mCurrHalfHeights[i]) : mCurrHeights[i];
+    }
+
     int mNumRows = 0;
     int mNumCols = 0;
 
@@ -43,10 +153,42 @@ private:
     float mK3 = 0.0f;
 
     float mTimeStep = 0.0f;
+    float mAccumulatedTime = 0.0f;
     float mSpatialStep = 0.0f;
+    float mHalfWidth = 0.0f;
+    float mHalfDepth = 0.0f;
+
+    EWaveSolver mSolver = EWaveSolver::Scalar;
+    int mSubsteps = 1;
+
+    // Only the heights change over time, so they live in their own tightly packed
+    // planes instead of the y component of a float3 (x and z are implied by the grid).
+    std::vector<float, AlignedAllocator<float>> mPrevHeights;
+    std::vector<float, AlignedAllocator<float>> mCurrHeights;
+
+    // Halo rows at the edges of the blocked solver's per-thread chunks, saved before the
+    // neighbouring chunk overwrites them.
+    std::vector<float, AlignedAllocator<float>> mHaloHeights;
+
+    // Half precision counterparts, only one of the two sets is allocated at a time.
+    bool mCompactStorage = false;
+    std::vector<std::uint16_t, AlignedAllocator<std::uint16_t>> mPrevHalfHeights;
+    std::vector<std::uint16_t, AlignedAllocator<std::uint16_t>> mCurrHalfHeights;
+    std::vector<std::uint16_t, AlignedAllocator<std::uint16_t>> mHaloHalfHeights;
+
+    // Activity tracking, one entry per tile. Versions are bumped whenever the tile's
+    // heights change, whether tracking is on or not.
+    bool mTrackActivity = false;
+    float mActivityEpsilon = 0.0f;
+    int mTileRows = 0;
+    int mTileCols = 0;
+    std::vector<std::uint8_t> mTileAwake;
+    std::vector<std::uint8_t> mTileQuietSteps;
+    std::vector<std::uint32_t> mTileVersions;
+    std::vector<int> mActiveTiles;
+    std::vector<std::uint8_t> mTileWakeSides;
 
-    std::vector<DirectX::XMFLOAT3> mPrevSolution;
-    std::vector<DirectX::XMFLOAT3> mCurrSolution;
-    std::vector<DirectX::XMFLOAT3> mNormals;
-    std::vector<DirectX::XMFLOAT3> mTangentX;
+    // Disturbances pushed from any thread, and the batch being applied.
+    MPSCQueue<WaveDisturbance> mDisturbQueue;
+    std::vector<WaveDisturbance> mDisturbBatch;
 };
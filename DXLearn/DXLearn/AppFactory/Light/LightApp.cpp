@@ -3,13 +3,32 @@
 #include <DirectXColors.h>
 
 #include "../../Common/d3dx12.h"
+#include "../../Common/FileManager.h"
 #include "../../Common/GeometryGenerator.h"
+#include "../../Common/MeshCodec.h"
+#include "../../Common/MeshFile.h"
+#include "../../Common/MeshOptimizer.h"
+#include "../../Common/MeshletBuilder.h"
+#include "../../Common/MeshSimplifier.h"
+#include "../../Common/ModelLoader.h"
+#include "../../Common/TaskScheduler.h"
 
 using namespace Microsoft::WRL;
 using namespace DirectX;
 using namespace std;
 using namespace std::experimental::filesystem;
 
+namespace
+{
+    // LightApp options that change the converted skull, stored in skull.mesh so a cache built
+    // with other settings is rebuilt.
+    enum SkullBuildFlag : std::uint32_t
+    {
+        SkullOptimized = 1 << 0,
+        SkullLods = 1 << 1,
+    };
+}
+
 bool LightApp::Initialize()
 {
     if (!D3dApp::Initialize())
@@ -58,6 +77,8 @@ void LightApp::Update(const GameTimer& InGameTime)
     }
 
     AnimateMaterials(InGameTime);
+    UpdateLods(InGameTime);
+    UpdateTextures(InGameTime);
     UpdateObjectCBs(InGameTime);
     UpdateMaterialCBs(InGameTime);
     UpdateMainPassCB(InGameTime);
@@ -146,12 +167,7 @@ void LightApp::BuildShadersAndInputLayout()
     mShaders["standardVS"] = D3dUtil::CompileShader(ShaderPath, nullptr, "VS", "vs_5_1");
     mShaders["opaquePS"] = D3dUtil::CompileShader(ShaderPath, nullptr, "PS", "ps_5_1");
 
-    mInputLayout =
-    {
-        {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-        {"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-        {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}
-    };
+    mInputLayout = LightVertexFormat::InputLayout();
     
 }
 
@@ -177,6 +193,8 @@ void LightApp::BuildRenderItems()
 	boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
 	boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
 	boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
+	boxRitem->Bounds = boxRitem->Geo->DrawArgs["box"].Bounds;
+	boxRitem->TexCoordExtent = boxRitem->Geo->DrawArgs["box"].TexCoordExtent;
 	mAllRitems.push_back(std::move(boxRitem));
 
     auto gridRitem = std::make_unique<RenderItem>();
@@ -189,6 +207,8 @@ void LightApp::BuildRenderItems()
     gridRitem->IndexCount = gridRitem->Geo->DrawArgs["grid"].IndexCount;
     gridRitem->StartIndexLocation = gridRitem->Geo->DrawArgs["grid"].StartIndexLocation;
     gridRitem->BaseVertexLocation = gridRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
+    gridRitem->Bounds = gridRitem->Geo->DrawArgs["grid"].Bounds;
+    gridRitem->TexCoordExtent = gridRitem->Geo->DrawArgs["grid"].TexCoordExtent;
 	mAllRitems.push_back(std::move(gridRitem));
 
 	auto skullRitem = std::make_unique<RenderItem>();
@@ -201,6 +221,13 @@ void LightApp::BuildRenderItems()
 	skullRitem->IndexCount = skullRitem->Geo->DrawArgs["skull"].IndexCount;
 	skullRitem->StartIndexLocation = skullRitem->Geo->DrawArgs["skull"].StartIndexLocation;
 	skullRitem->BaseVertexLocation = skullRitem->Geo->DrawArgs["skull"].BaseVertexLocation;
+	skullRitem->Bounds = skullRitem->Geo->DrawArgs["skull"].Bounds;
+	skullRitem->TexCoordExtent = skullRitem->Geo->DrawArgs["skull"].TexCoordExtent;
+	skullRitem->Lods.push_back(skullRitem->Geo->DrawArgs["skull"]);
+	for(UINT lod = 1; skullRitem->Geo->DrawArgs.count("skull_lod" + to_string(lod)) != 0; ++lod)
+	{
+		skullRitem->Lods.push_back(skullRitem->Geo->DrawArgs["skull_lod" + to_string(lod)]);
+	}
 	mAllRitems.push_back(std::move(skullRitem));
 
 	XMMATRIX brickTexTransform = XMMatrixScaling(1.0f, 1.0f, 1.0f);
@@ -227,6 +254,8 @@ void LightApp::BuildRenderItems()
 		leftCylRitem->IndexCount = leftCylRitem->Geo->DrawArgs["cylinder"].IndexCount;
 		leftCylRitem->StartIndexLocation = leftCylRitem->Geo->DrawArgs["cylinder"].StartIndexLocation;
 		leftCylRitem->BaseVertexLocation = leftCylRitem->Geo->DrawArgs["cylinder"].BaseVertexLocation;
+		leftCylRitem->Bounds = leftCylRitem->Geo->DrawArgs["cylinder"].Bounds;
+		leftCylRitem->TexCoordExtent = leftCylRitem->Geo->DrawArgs["cylinder"].TexCoordExtent;
 
 		XMStoreFloat4x4(&rightCylRitem->World, leftCylWorld);
 		XMStoreFloat4x4(&rightCylRitem->TexTransform, brickTexTransform);
@@ -237,6 +266,8 @@ void LightApp::BuildRenderItems()
 		rightCylRitem->IndexCount = rightCylRitem->Geo->DrawArgs["cylinder"].IndexCount;
 		rightCylRitem->StartIndexLocation = rightCylRitem->Geo->DrawArgs["cylinder"].StartIndexLocation;
 		rightCylRitem->BaseVertexLocation = rightCylRitem->Geo->DrawArgs["cylinder"].BaseVertexLocation;
+		rightCylRitem->Bounds = rightCylRitem->Geo->DrawArgs["cylinder"].Bounds;
+		rightCylRitem->TexCoordExtent = rightCylRitem->Geo->DrawArgs["cylinder"].TexCoordExtent;
 
 		XMStoreFloat4x4(&leftSphereRitem->World, leftSphereWorld);
 		leftSphereRitem->TexTransform = MathHelper::Identity4x4();
@@ -247,6 +278,8 @@ void LightApp::BuildRenderItems()
 		leftSphereRitem->IndexCount = leftSphereRitem->Geo->DrawArgs["sphere"].IndexCount;
 		leftSphereRitem->StartIndexLocation = leftSphereRitem->Geo->DrawArgs["sphere"].StartIndexLocation;
 		leftSphereRitem->BaseVertexLocation = leftSphereRitem->Geo->DrawArgs["sphere"].BaseVertexLocation;
+		leftSphereRitem->Bounds = leftSphereRitem->Geo->DrawArgs["sphere"].Bounds;
+		leftSphereRitem->TexCoordExtent = leftSphereRitem->Geo->DrawArgs["sphere"].TexCoordExtent;
 
 		XMStoreFloat4x4(&rightSphereRitem->World, rightSphereWorld);
 		rightSphereRitem->TexTransform = MathHelper::Identity4x4();
@@ -257,6 +290,8 @@ void LightApp::BuildRenderItems()
 		rightSphereRitem->IndexCount = rightSphereRitem->Geo->DrawArgs["sphere"].IndexCount;
 		rightSphereRitem->StartIndexLocation = rightSphereRitem->Geo->DrawArgs["sphere"].StartIndexLocation;
 		rightSphereRitem->BaseVertexLocation = rightSphereRitem->Geo->DrawArgs["sphere"].BaseVertexLocation;
+		rightSphereRitem->Bounds = rightSphereRitem->Geo->DrawArgs["sphere"].Bounds;
+		rightSphereRitem->TexCoordExtent = rightSphereRitem->Geo->DrawArgs["sphere"].TexCoordExtent;
 
 		mAllRitems.push_back(std::move(leftCylRitem));
 		mAllRitems.push_back(std::move(rightCylRitem));
@@ -273,12 +308,18 @@ void LightApp::BuildTextures()
 {
 }
 
+int LightApp::TextureIndex(const std::string& name)const
+{
+    auto tex = mTextures.find(name);
+    return tex != mTextures.end() ? static_cast<int>(tex->second->StreamerIndex) : -1;
+}
+
 void LightApp::BuildMaterials()
 {
     auto bricks0 = std::make_unique<Material>();
     bricks0->Name = "bricks0";
     bricks0->MatCBIndex = 0;
-    bricks0->DiffuseSrvHeapIndex = 0;
+    bricks0->DiffuseSrvHeapIndex = TextureIndex("bricksTex");
     bricks0->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
     bricks0->FresnelR0 = XMFLOAT3(0.02f, 0.02f, 0.02f);
     bricks0->Roughness = 0.1f;
@@ -286,7 +327,7 @@ void LightApp::BuildMaterials()
     auto stone0 = std::make_unique<Material>();
     stone0->Name = "stone0";
     stone0->MatCBIndex = 1;
-    stone0->DiffuseSrvHeapIndex = 1;
+    stone0->DiffuseSrvHeapIndex = TextureIndex("stoneTex");
     stone0->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
     stone0->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
     stone0->Roughness = 0.3f;
@@ -294,7 +335,7 @@ void LightApp::BuildMaterials()
     auto tile0 = std::make_unique<Material>();
     tile0->Name = "tile0";
     tile0->MatCBIndex = 2;
-    tile0->DiffuseSrvHeapIndex = 2;
+    tile0->DiffuseSrvHeapIndex = TextureIndex("tileTex");
     tile0->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
     tile0->FresnelR0 = XMFLOAT3(0.02f, 0.02f, 0.02f);
     tile0->Roughness = 0.3f;
@@ -302,7 +343,7 @@ void LightApp::BuildMaterials()
     auto skullMat = std::make_unique<Material>();
     skullMat->Name = "skullMat";
     skullMat->MatCBIndex = 3;
-    skullMat->DiffuseSrvHeapIndex = 3;
+    skullMat->DiffuseSrvHeapIndex = TextureIndex("skullTex");
     skullMat->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
     skullMat->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
     skullMat->Roughness = 0.3f;
@@ -373,11 +414,27 @@ void LightApp::AnimateMaterials(const GameTimer& InGameTime)
 {
 }
 
+void LightApp::UpdateLods(const GameTimer& InGameTime)
+{
+    const float pixelsPerUnit = mProj._22 * 0.5f * mClientHeight;
+    for (auto& ri : mAllRitems)
+    {
+        ri->SelectLod(mEyePostion, pixelsPerUnit, mLodPixelError);
+    }
+}
+
+void LightApp::UpdateTextures(const GameTimer& InGameTime)
+{
+}
+
 void LightApp::UpdateObjectCBs(const GameTimer& InGameTime)
 {
     auto currObjectCB = dynamic_pointer_cast<LightFrameResource>(mCurrFrameResource)->ObjectCB.get();
-    for(auto& e : mAllRitems)
+    // ObjCBIndex is unique per item, no two iterations touch the same slot.
+    TaskScheduler::Get().ParallelFor(0, (int)mAllRitems.size(), 32, [&](int index)
     {
+        auto& e = mAllRitems[index];
+
         // Only update the cbuffer data if the constants have changed.  
         // This needs to be tracked per frame resource.
         if(e->NumFramesDirty > 0)
@@ -394,7 +451,7 @@ void LightApp::UpdateObjectCBs(const GameTimer& InGameTime)
             // Next FrameResource need to be updated too.
             e->NumFramesDirty--;
         }
-    }
+    });
 }
 
 void LightApp::UpdateMaterialCBs(const GameTimer& InGameTime)
@@ -491,10 +548,10 @@ void LightApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::ve
 void LightApp::BuildShapeGeometry()
 {
     GeometryGenerator geoGen;
-    GeometryGenerator::MeshData box = geoGen.CreateBox(1.5f, 0.5f, 1.5f, 3);
-    GeometryGenerator::MeshData grid = geoGen.CreateGrid(20.0f, 30.0f, 60, 40);
-    GeometryGenerator::MeshData sphere = geoGen.CreateSphere(0.5f, 20, 20);
-    GeometryGenerator::MeshData cylinder = geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20);
+    const GeometryGenerator::MeshSize boxSize = GeometryGenerator::BoxSize(3);
+    const GeometryGenerator::MeshSize gridSize = GeometryGenerator::GridSize(60, 40);
+    const GeometryGenerator::MeshSize sphereSize = GeometryGenerator::SphereSize(20, 20);
+    const GeometryGenerator::MeshSize cylinderSize = GeometryGenerator::CylinderSize(20, 20);
 
     //
     // We are concatenating all the geometry into one big vertex/index buffer.  So
@@ -503,102 +560,74 @@ void LightApp::BuildShapeGeometry()
 
     // Cache the vertex offsets to each object in the concatenated vertex buffer.
     UINT boxVertexOffset = 0;
-    UINT gridVertexOffset = (UINT)box.Vertices.size();
-    UINT sphereVertexOffset = gridVertexOffset + (UINT)grid.Vertices.size();
-    UINT cylinderVertexOffset = sphereVertexOffset + (UINT)sphere.Vertices.size();
+    UINT gridVertexOffset = boxSize.VertexCount;
+    UINT sphereVertexOffset = gridVertexOffset + gridSize.VertexCount;
+    UINT cylinderVertexOffset = sphereVertexOffset + sphereSize.VertexCount;
 
     // Cache the starting index for each object in the concatenated index buffer.
     UINT boxIndexOffset = 0;
-    UINT gridIndexOffset = (UINT)box.Indices32.size();
-    UINT sphereIndexOffset = gridIndexOffset + (UINT)grid.Indices32.size();
-    UINT cylinderIndexOffset = sphereIndexOffset + (UINT)sphere.Indices32.size();
+    UINT gridIndexOffset = boxSize.IndexCount;
+    UINT sphereIndexOffset = gridIndexOffset + gridSize.IndexCount;
+    UINT cylinderIndexOffset = sphereIndexOffset + sphereSize.IndexCount;
 
     SubMeshGeometry boxSubmesh;
-    boxSubmesh.IndexCount = (UINT)box.Indices32.size();
+    boxSubmesh.IndexCount = boxSize.IndexCount;
     boxSubmesh.StartIndexLocation = boxIndexOffset;
     boxSubmesh.BaseVertexLocation = boxVertexOffset;
 
     SubMeshGeometry gridSubmesh;
-    gridSubmesh.IndexCount = (UINT)grid.Indices32.size();
+    gridSubmesh.IndexCount = gridSize.IndexCount;
     gridSubmesh.StartIndexLocation = gridIndexOffset;
     gridSubmesh.BaseVertexLocation = gridVertexOffset;
 
     SubMeshGeometry sphereSubmesh;
-    sphereSubmesh.IndexCount = (UINT)sphere.Indices32.size();
+    sphereSubmesh.IndexCount = sphereSize.IndexCount;
     sphereSubmesh.StartIndexLocation = sphereIndexOffset;
     sphereSubmesh.BaseVertexLocation = sphereVertexOffset;
 
     SubMeshGeometry cylinderSubmesh;
-    cylinderSubmesh.IndexCount = (UINT)cylinder.Indices32.size();
+    cylinderSubmesh.IndexCount = cylinderSize.IndexCount;
     cylinderSubmesh.StartIndexLocation = cylinderIndexOffset;
     cylinderSubmesh.BaseVertexLocation = cylinderVertexOffset;
 
+    const UINT totalVertexCount = cylinderVertexOffset + cylinderSize.VertexCount;
+    const UINT totalIndexCount = cylinderIndexOffset + cylinderSize.IndexCount;
 
-    //
-    // Extract the vertex elements we are interested in and pack the
-    // vertices of all the meshes into one vertex buffer.
-    //
-
-    auto totalVertexCount =
-        box.Vertices.size() +
-        grid.Vertices.size() +
-        sphere.Vertices.size() +
-        cylinder.Vertices.size();
-
-    std::vector<Vertex> vertices(totalVertexCount);
-
-    UINT k = 0;
-    for(size_t i = 0; i < box.Vertices.size(); ++i, ++k)
-    {
-        vertices[k].Pos = box.Vertices[i].Position;
-        vertices[k].Normal = box.Vertices[i].Normal;
-        vertices[k].TexC = box.Vertices[i].TexC;
-    }
-
-    for(size_t i = 0; i < grid.Vertices.size(); ++i, ++k)
-    {
-        vertices[k].Pos = grid.Vertices[i].Position;
-        vertices[k].Normal = grid.Vertices[i].Normal;
-        vertices[k].TexC = grid.Vertices[i].TexC;
-    }
-
-    for(size_t i = 0; i < sphere.Vertices.size(); ++i, ++k)
-    {
-        vertices[k].Pos = sphere.Vertices[i].Position;
-        vertices[k].Normal = sphere.Vertices[i].Normal;
-        vertices[k].TexC = sphere.Vertices[i].TexC;
-    }
-
-    for(size_t i = 0; i < cylinder.Vertices.size(); ++i, ++k)
-    {
-        vertices[k].Pos = cylinder.Vertices[i].Position;
-        vertices[k].Normal = cylinder.Vertices[i].Normal;
-        vertices[k].TexC = cylinder.Vertices[i].TexC;
-    }
-
-    std::vector<std::uint16_t> indices;
-    indices.insert(indices.end(), std::begin(box.GetIndices16()), std::end(box.GetIndices16()));
-    indices.insert(indices.end(), std::begin(grid.GetIndices16()), std::end(grid.GetIndices16()));
-    indices.insert(indices.end(), std::begin(sphere.GetIndices16()), std::end(sphere.GetIndices16()));
-    indices.insert(indices.end(), std::begin(cylinder.GetIndices16()), std::end(cylinder.GetIndices16()));
-
-    const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
-    const UINT ibByteSize = (UINT)indices.size()  * sizeof(std::uint16_t);
+    const UINT vbByteSize = totalVertexCount * sizeof(Vertex);
+    const UINT ibByteSize = totalIndexCount * sizeof(std::uint16_t);
 
     auto geo = std::make_unique<MeshGeometry>();
     geo->Name = "shapeGeo";
 
     ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-    CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
-
     ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-    CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+    Vertex* vertices = static_cast<Vertex*>(geo->VertexBufferCPU->GetBufferPointer());
+    std::uint16_t* indices = static_cast<std::uint16_t*>(geo->IndexBufferCPU->GetBufferPointer());
+
+    //
+    // Generate the vertices of all the meshes straight into the vertex buffer, only
+    // the attributes the vertex format has are computed.
+    //
+
+    const LightVertexFormat::Writer toVertex;
+    const auto attributes = LightVertexFormat::GeneratorMask();
+
+    geoGen.WriteBox(1.5f, 0.5f, 1.5f, 3, vertices + boxVertexOffset, indices + boxIndexOffset, toVertex, attributes);
+    geoGen.WriteGrid(20.0f, 30.0f, 60, 40, vertices + gridVertexOffset, indices + gridIndexOffset, toVertex, attributes);
+    geoGen.WriteSphere(0.5f, 20, 20, vertices + sphereVertexOffset, indices + sphereIndexOffset, toVertex, attributes);
+    geoGen.WriteCylinder(0.5f, 0.3f, 3.0f, 20, 20, vertices + cylinderVertexOffset, indices + cylinderIndexOffset, toVertex, attributes);
+
+    // Bounds and texel density for streaming the textures of the items using them.
+    boxSubmesh.ComputeExtents(vertices, indices);
+    gridSubmesh.ComputeExtents(vertices, indices);
+    sphereSubmesh.ComputeExtents(vertices, indices);
+    cylinderSubmesh.ComputeExtents(vertices, indices);
 
     geo->VertexBufferGPU = D3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-        mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+        mCommandList.Get(), vertices, vbByteSize, geo->VertexBufferUploader);
 
     geo->IndexBufferGPU = D3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-        mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+        mCommandList.Get(), indices, ibByteSize, geo->IndexBufferUploader);
 
     geo->VertexByteStride = sizeof(Vertex);
     geo->VertexBufferByteSize = vbByteSize;
@@ -613,76 +642,251 @@ void LightApp::BuildShapeGeometry()
     mGeometries[geo->Name] = std::move(geo);
 }
 
+// The skull after the mesh processing, what skull.mesh is written from.
+struct LightApp::SkullModel
+{
+    std::vector<Vertex> Vertices;
+    std::vector<std::uint32_t> Indices;
+    MeshletGeometry Meshlets;
+    std::vector<MeshFileContents::Submesh> Submeshes;
+    BoundingBox Bounds;
+};
+
 void LightApp::BuildSkullGeometry()
 {
-    std::ifstream fin("AppFactory/Models/skull.txt");
-    if (!fin)
+    const std::wstring sourcePath = FileManager::GetModelFullPath("skull.txt");
+    const std::wstring cachePath = FileManager::GetModelFullPath("skull.mesh");
+
+    // The text model is converted once, later runs map the binary mesh and upload straight
+    // from it without parsing anything, or decode it if it is compressed. A stale or damaged
+    // cache is converted again.
+    if (LoadSkullMesh(sourcePath, cachePath))
     {
-        MessageBox(0, TEXT("AppFactory/Models/skull.txt not found"), 0, 0);
         return;
     }
 
-    UINT vcount = 0;
-    UINT tcount = 0;
-    std::string ignore;
-
-    fin >> ignore >> vcount;
-    fin >> ignore >> tcount;
-    fin >> ignore >> ignore >> ignore >> ignore;
-
-    std::vector<Vertex> vertices(vcount);
-    for(UINT i = 0; i < vcount; ++i)
+    SkullModel skull;
+    if (!ConvertSkullModel(sourcePath, skull))
     {
-        fin >> vertices[i].Pos.x >> vertices[i].Pos.y >> vertices[i].Pos.z;
-        fin >> vertices[i].Normal.x >> vertices[i].Normal.y >> vertices[i].Normal.z;
+        MessageBox(0, TEXT("AppFactory/Models/skull.txt is missing or malformed"), 0, 0);
+        return;
     }
 
-    fin >> ignore;
-    fin >> ignore;
-    fin >> ignore;
+    // Without a cache the next run just converts again, e.g. from a read-only Models folder.
+    if (!WriteSkullMesh(sourcePath, cachePath, skull))
+    {
+        OutputDebugString(TEXT("*** skull.mesh could not be written, using the converted model\n"));
+    }
 
-    std::vector<std::int32_t> indices(3 * tcount);
-    for(UINT i = 0; i < tcount; ++i)
+    MeshGeometry* geo = CreateSkullGeometry(skull.Vertices.data(), (UINT)skull.Vertices.size(),
+        skull.Indices.data(), (UINT)skull.Indices.size(), sizeof(std::uint32_t));
+    for (const MeshFileContents::Submesh& skullSubmesh : skull.Submeshes)
     {
-        fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
+        SubMeshGeometry submesh;
+        submesh.IndexCount = skullSubmesh.IndexCount;
+        submesh.StartIndexLocation = skullSubmesh.StartIndexLocation;
+        submesh.BaseVertexLocation = skullSubmesh.BaseVertexLocation;
+        submesh.Bounds = skullSubmesh.Bounds;
+        submesh.GeometricError = skullSubmesh.GeometricError;
+        geo->DrawArgs[skullSubmesh.Name] = submesh;
     }
+    geo->MeshletArgs["skull"] = std::move(skull.Meshlets);
+}
 
-    fin.close();
+bool LightApp::LoadSkullMesh(const std::wstring& sourcePath, const std::wstring& cachePath)
+{
+    MeshFile meshFile;
+    if (!meshFile.Open(cachePath) || !meshFile.IsCurrent(sourcePath) || meshFile.Header().StreamCount != 1 ||
+        meshFile.Header().BuildFlags != SkullBuildFlags() ||
+        ((meshFile.VertexFlags(0) & MeshFileCompressed) != 0) != mCompressMeshes ||
+        ((meshFile.VertexFlags(0) & MeshFileQuantized) ? meshFile.VertexStride(0) != sizeof(QuantizedVertex) :
+            meshFile.VertexStride(0) != sizeof(Vertex)))
+    {
+        return false;
+    }
 
-    //
-    // Pack the indices of all the meshes into one index buffer.
-    //
+    const MeshFileHeader& header = meshFile.Header();
+    const UINT ibByteSize = (UINT)meshFile.IndexDataSize();
+
+    // Compressed buffers are decoded into temporaries, quantized vertices are expanded
+    // back to the float layout the shaders read.
+    const void* vertexData = nullptr;
+    const void* indexData = nullptr;
+    std::vector<Vertex> vertices;
+    std::vector<std::uint8_t> indices;
+    bool decoded = true;
+    if (meshFile.VertexFlags(0) == 0)
+    {
+        vertexData = meshFile.VertexData(0);
+    }
+    else if (meshFile.VertexFlags(0) & MeshFileQuantized)
+    {
+        std::vector<QuantizedVertex> quantized(header.VertexCount);
+        decoded = meshFile.ReadVertexData(0, quantized.data());
+        vertices.resize(header.VertexCount);
+        MeshCodec::Dequantize(vertices.data(), quantized.data(), quantized.size(), meshFile.Quantization(),
+            &Vertex::Pos, &Vertex::Normal, &Vertex::TexC);
+        vertexData = vertices.data();
+    }
+    else
+    {
+        vertices.resize(header.VertexCount);
+        decoded = meshFile.ReadVertexData(0, vertices.data());
+        vertexData = vertices.data();
+    }
+    if (meshFile.IndexFlags() == 0)
+    {
+        indexData = meshFile.IndexData();
+    }
+    else
+    {
+        indices.resize(ibByteSize);
+        decoded = decoded && meshFile.ReadIndexData(indices.data());
+        indexData = indices.data();
+    }
+    if (!decoded)
+    {
+        OutputDebugString(TEXT("*** skull.mesh is damaged, converting skull.txt again\n"));
+        return false;
+    }
 
-    const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
+    MeshGeometry* geo = CreateSkullGeometry(vertexData, header.VertexCount, indexData, header.IndexCount, header.IndexSize);
+    for (UINT i = 0; i < header.SubmeshCount; ++i)
+    {
+        const MeshFileSubmesh& fileSubmesh = meshFile.Submeshes()[i];
+
+        SubMeshGeometry submesh;
+        submesh.IndexCount = fileSubmesh.IndexCount;
+        submesh.StartIndexLocation = fileSubmesh.StartIndexLocation;
+        submesh.BaseVertexLocation = fileSubmesh.BaseVertexLocation;
+        submesh.Bounds = BoundingBox(fileSubmesh.BoundsCenter, fileSubmesh.BoundsExtents);
+        submesh.GeometricError = fileSubmesh.GeometricError;
+        geo->DrawArgs[fileSubmesh.Name] = submesh;
+    }
+    geo->MeshletArgs["skull"] = meshFile.LoadMeshlets();
+    return true;
+}
 
-    const UINT ibByteSize = (UINT)indices.size() * sizeof(std::int32_t);
+MeshGeometry* LightApp::CreateSkullGeometry(const void* vertexData, UINT vertexCount, const void* indexData,
+    UINT indexCount, UINT indexSize)
+{
+    const UINT vbByteSize = vertexCount * sizeof(Vertex);
+    const UINT ibByteSize = indexCount * indexSize;
 
     auto geo = std::make_unique<MeshGeometry>();
     geo->Name = "skullGeo";
 
-    ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-    CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
-
-    ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-    CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
-
+    // No CPU copies are kept, the mapping and the temporaries are only needed until the
+    // upload buffers are filled.
     geo->VertexBufferGPU = D3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-        mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+        mCommandList.Get(), vertexData, vbByteSize, geo->VertexBufferUploader);
 
     geo->IndexBufferGPU = D3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-        mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+        mCommandList.Get(), indexData, ibByteSize, geo->IndexBufferUploader);
 
     geo->VertexByteStride = sizeof(Vertex);
     geo->VertexBufferByteSize = vbByteSize;
-    geo->IndexFormat = DXGI_FORMAT_R32_UINT;
+    geo->IndexFormat = indexSize == 2 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
     geo->IndexBufferByteSize = ibByteSize;
 
-    SubMeshGeometry submesh;
-    submesh.IndexCount = (UINT)indices.size();
-    submesh.StartIndexLocation = 0;
-    submesh.BaseVertexLocation = 0;
+    MeshGeometry* result = geo.get();
+    mGeometries[geo->Name] = std::move(geo);
+    return result;
+}
 
-    geo->DrawArgs["skull"] = submesh;
+std::uint32_t LightApp::SkullBuildFlags()const
+{
+    return (mOptimizeMeshes ? SkullOptimized : 0) | (mGenerateLods ? SkullLods : 0);
+}
 
-    mGeometries[geo->Name] = std::move(geo);
+bool LightApp::ConvertSkullModel(const std::wstring& sourcePath, SkullModel& skull)
+{
+    ModelData model;
+    if (!ModelLoader::Load(sourcePath, model))
+    {
+        return false;
+    }
+
+    const LightVertexFormat::Writer toVertex;
+    std::vector<Vertex>& vertices = skull.Vertices;
+    vertices.resize(model.Mesh.Vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        toVertex(vertices[i], model.Mesh.Vertices[i]);
+    }
+    std::vector<std::uint32_t>& indices = skull.Indices;
+    indices = std::move(model.Mesh.Indices32);
+
+    if (mOptimizeMeshes)
+    {
+        const MeshOptimizationReport report = MeshOptimizer::Optimize(vertices, indices, &Vertex::Pos);
+
+        std::wstring info = TEXT("*** skull.txt ACMR: ");
+        info += to_wstring(report.Before.ACMR) + TEXT(" -> ") + to_wstring(report.After.ACMR);
+        info += TEXT(" ATVR: ") + to_wstring(report.Before.ATVR) + TEXT(" -> ") + to_wstring(report.After.ATVR);
+        info += TEXT("\n");
+        OutputDebugString(info.c_str());
+    }
+
+    // Reorders the indices once more, cluster by cluster, after the optimizer.
+    skull.Meshlets = MeshletBuilder::Build(vertices, indices, &Vertex::Pos);
+
+    // Coarser levels for distant views, appended after the full index list.
+    std::vector<MeshLod> lods;
+    if (mGenerateLods)
+    {
+        lods = MeshSimplifier::BuildLodChain(vertices, indices, &Vertex::Pos, &Vertex::Normal, LodChainSettings());
+        for (size_t i = 1; i < lods.size() && mOptimizeMeshes; ++i)
+        {
+            MeshOptimizer::OptimizeVertexCache(indices.data() + lods[i].StartIndex, lods[i].IndexCount, vertices.size());
+        }
+    }
+
+    // The optimizer and the simplifier only reorder and append, the bounds stay those of the file.
+    skull.Bounds = model.Bounds;
+
+    MeshFileContents::Submesh submesh;
+    submesh.Name = "skull";
+    submesh.IndexCount = lods.empty() ? (std::uint32_t)indices.size() : lods[0].IndexCount;
+    submesh.Bounds = skull.Bounds;
+    skull.Submeshes.push_back(submesh);
+
+    for (size_t i = 1; i < lods.size(); ++i)
+    {
+        submesh.Name = "skull_lod" + to_string(i);
+        submesh.IndexCount = lods[i].IndexCount;
+        submesh.StartIndexLocation = lods[i].StartIndex;
+        submesh.GeometricError = lods[i].GeometricError;
+        skull.Submeshes.push_back(submesh);
+    }
+    return true;
+}
+
+bool LightApp::WriteSkullMesh(const std::wstring& sourcePath, const std::wstring& meshPath, const SkullModel& skull)
+{
+    MeshFileContents contents;
+    contents.VertexCount = (std::uint32_t)skull.Vertices.size();
+    contents.Indices = skull.Indices.data();
+    contents.IndexCount = (std::uint32_t)skull.Indices.size();
+    contents.IndexSize = sizeof(std::uint32_t);
+
+    std::vector<QuantizedVertex> quantized;
+    if (mCompressMeshes)
+    {
+        contents.Quantization = PositionQuantization::FromBounds(skull.Bounds);
+        quantized = MeshCodec::Quantize(skull.Vertices, contents.Quantization, &Vertex::Pos, &Vertex::Normal, &Vertex::TexC);
+        contents.Streams.push_back({ quantized.data(), sizeof(QuantizedVertex), MeshFileCompressed | MeshFileQuantized });
+        contents.IndexFlags = MeshFileCompressed;
+    }
+    else
+    {
+        contents.Streams.push_back({ skull.Vertices.data(), sizeof(Vertex) });
+    }
+    contents.Meshlets = &skull.Meshlets;
+    contents.Bounds = skull.Bounds;
+    contents.Submeshes = skull.Submeshes;
+    contents.BuildFlags = SkullBuildFlags();
+    MeshFile::GetSourceStamp(sourcePath, contents.SourceSize, contents.SourceWriteTime);
+
+    return MeshFile::Write(meshPath, contents);
 }
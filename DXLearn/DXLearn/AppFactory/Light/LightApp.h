@@ -28,12 +28,18 @@ protected:
     virtual void BuildMaterials();
     virtual void BuildFrameResources();
     virtual void BuildPSOs();
+
+    // Streamer index of the texture loaded under name, for Material::DiffuseSrvHeapIndex.
+    // -1 if this app doesn't load it.
+    int TextureIndex(const std::string& name)const;
 protected:
     virtual void OnKeyboardInput(const GameTimer& InGameTime);
     virtual void AnimateMaterials(const GameTimer& InGameTime);
     virtual void UpdateObjectCBs(const GameTimer& InGameTime);
     virtual void UpdateMaterialCBs(const GameTimer& InGameTime);
     virtual void UpdateMainPassCB(const GameTimer& InGameTime);
+    virtual void UpdateLods(const GameTimer& InGameTime);
+    virtual void UpdateTextures(const GameTimer& InGameTime);
 protected:
     virtual void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& rItems);
     
@@ -66,8 +72,36 @@ protected:
 protected:
     bool mIsWireframe = false;
 
+    // Reorder loaded models for the vertex cache, overdraw and vertex fetch.
+    bool mOptimizeMeshes = true;
+
+    // Simplified levels of loaded models, switched by their error in pixels.
+    bool mGenerateLods = true;
+    float mLodPixelError = 1.0f;
+
+    // Store converted models quantized and compressed, they are decoded on load.
+    bool mCompressMeshes = true;
+
 protected:
+    struct SkullModel;
+
     void BuildShapeGeometry();
     void BuildSkullGeometry();
+
+    // Builds skullGeo from the cached skull.mesh, false if it is missing, stale or damaged.
+    bool LoadSkullMesh(const std::wstring& sourcePath, const std::wstring& cachePath);
+
+    // Uploads the skull buffers as skullGeo, the caller adds the submeshes.
+    MeshGeometry* CreateSkullGeometry(const void* vertexData, UINT vertexCount, const void* indexData,
+        UINT indexCount, UINT indexSize);
+
+    // The options above that change the converted skull, as MeshFileHeader::BuildFlags.
+    std::uint32_t SkullBuildFlags()const;
+
+    // Parses the text model and runs the mesh processing. False if it is missing or malformed.
+    bool ConvertSkullModel(const std::wstring& sourcePath, SkullModel& skull);
+
+    // Caches a converted skull as a MeshFile, false if the file can't be written.
+    bool WriteSkullMesh(const std::wstring& sourcePath, const std::wstring& meshPath, const SkullModel& skull);
 };
 
@@ -1,5 +1,6 @@
 ﻿#pragma once
 #include "../../Common/FrameResource.h"
+#include "../../Common/VertexFormat.h"
 
 struct  LightObjectConstants
 {
@@ -45,6 +46,10 @@ struct Vertex
     DirectX::XMFLOAT2 TexC;
 };
 
+using LightVertexFormat = VertexFormat<VertexPosition, VertexNormal, VertexTexC>;
+static_assert(offsetof(Vertex, Normal) == LightVertexFormat::OffsetOf<VertexNormal>() &&
+              offsetof(Vertex, TexC) == LightVertexFormat::OffsetOf<VertexTexC>(), "Vertex doesn't match LightVertexFormat");
+
 class LightFrameResource : public FrameResource
 {
 public:
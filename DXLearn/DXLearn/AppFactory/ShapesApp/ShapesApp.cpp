@@ -5,6 +5,7 @@
 #include "ShapesFrameResource.h"
 #include "../../Common/d3dx12.h"
 #include "../../Common/GeometryGenerator.h"
+#include "../../Common/TaskScheduler.h"
 
 const std::string GeoName = "shapeGeo";
 
@@ -136,106 +137,89 @@ void ShapesApp::BuildShadersAndInputLayout()
     mShaders["standardVS"] = D3dUtil::CompileShader(ShaderPath, nullptr, "VS", "vs_5_1");
     mShaders["opaquePS"] = D3dUtil::CompileShader(ShaderPath, nullptr, "PS", "ps_5_1");
 
-    mInputLayout =
-    {
-        {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-        {"COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-    };
+    mInputLayout = ShapedVertexFormat::InputLayout();
 }
 
 void ShapesApp::BuildMeshGeometry()
 {
     GeometryGenerator geoGen;
-    GeometryGenerator::MeshData box = geoGen.CreateBox(4.5f, 0.5f, 1.5f, 3);
-    GeometryGenerator::MeshData grid = geoGen.CreateGrid(20.0f, 30.0f, 60, 40);
-    GeometryGenerator::MeshData sphere = geoGen.CreateSphere(0.5f, 20, 20);
-    GeometryGenerator::MeshData cylinder = geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20);
 
-    // We are concatenating all the geometry into one big vertex/index buffer. So define the regions in the buffer each submesh covers
+    // We are concatenating all the geometry into one big vertex/index buffer. Size every shape first,
+    // then generate them straight into the CPU blobs, no per shape MeshData and no staging copy
+    const GeometryGenerator::MeshSize boxSize = GeometryGenerator::BoxSize(3);
+    const GeometryGenerator::MeshSize gridSize = GeometryGenerator::GridSize(60, 40);
+    const GeometryGenerator::MeshSize sphereSize = GeometryGenerator::SphereSize(20, 20);
+    const GeometryGenerator::MeshSize cylinderSize = GeometryGenerator::CylinderSize(20, 20);
 
     // Cache the vertex offsets to each object in the concatenated vertex buffer
     UINT boxVertexOffset = 0;
-    UINT gridVertexOffset = static_cast<UINT>(box.Vertices.size());
-    UINT sphereVertexOffset = static_cast<UINT>(gridVertexOffset + grid.Vertices.size());
-    UINT cylinderVertexOffset = static_cast<UINT>(sphereVertexOffset + sphere.Vertices.size());
+    UINT gridVertexOffset = boxSize.VertexCount;
+    UINT sphereVertexOffset = gridVertexOffset + gridSize.VertexCount;
+    UINT cylinderVertexOffset = sphereVertexOffset + sphereSize.VertexCount;
 
     // Cache the Starting index fro each object in the concatenated index buffer
     UINT boxIndexOffset = 0;
-    UINT gridIndexOffset = static_cast<UINT>(box.Indices32.size());
-    UINT sphereIndexOffset = static_cast<UINT>(gridIndexOffset + grid.Indices32.size());
-    UINT cylinderIndexOffset = static_cast<UINT>(sphereIndexOffset + sphere.Indices32.size());
+    UINT gridIndexOffset = boxSize.IndexCount;
+    UINT sphereIndexOffset = gridIndexOffset + gridSize.IndexCount;
+    UINT cylinderIndexOffset = sphereIndexOffset + sphereSize.IndexCount;
 
     // Define the submesh that cover different regions of the vertex/index buffers
 
     SubMeshGeometry boxSubMesh;
-    boxSubMesh.IndexCount =  static_cast<UINT>(box.Indices32.size());
+    boxSubMesh.IndexCount = boxSize.IndexCount;
     boxSubMesh.BaseVertexLocation = boxVertexOffset;
     boxSubMesh.StartIndexLocation = boxIndexOffset;
 
     SubMeshGeometry gridSubMesh;
-    gridSubMesh.IndexCount = static_cast<UINT>(grid.Indices32.size());
+    gridSubMesh.IndexCount = gridSize.IndexCount;
     gridSubMesh.BaseVertexLocation = gridVertexOffset;
     gridSubMesh.StartIndexLocation = gridIndexOffset;
 
     SubMeshGeometry sphereSubMesh;
-    sphereSubMesh.IndexCount = static_cast<UINT>(sphere.Indices32.size());
+    sphereSubMesh.IndexCount = sphereSize.IndexCount;
     sphereSubMesh.BaseVertexLocation = sphereVertexOffset;
     sphereSubMesh.StartIndexLocation = sphereIndexOffset;
 
     SubMeshGeometry cylinderSubMesh;
-    cylinderSubMesh.IndexCount = static_cast<UINT>(cylinder.Indices32.size());
+    cylinderSubMesh.IndexCount = cylinderSize.IndexCount;
     cylinderSubMesh.BaseVertexLocation = cylinderVertexOffset;
     cylinderSubMesh.StartIndexLocation = cylinderIndexOffset;
 
-    // Extract teh vertex elements we are intersted in and pack the vertices of all the meshes into one vertex buffer
-    auto totalVertexCount = box.Vertices.size() + grid.Vertices.size() + sphere.Vertices.size() + cylinder.Vertices.size();
+    const UINT totalVertexCount = cylinderVertexOffset + cylinderSize.VertexCount;
+    const UINT totalIndexCount = cylinderIndexOffset + cylinderSize.IndexCount;
 
-    std::vector<ShapedVertex> TotalVertices(totalVertexCount);
-    size_t TotalIndex = 0;
-    for (size_t index = 0; index < box.Vertices.size(); ++index, ++TotalIndex)
-    {
-        TotalVertices[TotalIndex].Pos = box.Vertices[index].Position;
-        TotalVertices[TotalIndex].Color = DirectX::XMFLOAT4(DirectX::Colors::DarkGreen);
-    }
-
-    for (size_t index = 0; index < grid.Vertices.size(); ++index, ++TotalIndex)
-    {
-        TotalVertices[TotalIndex].Pos = grid.Vertices[index].Position;
-        TotalVertices[TotalIndex].Color = DirectX::XMFLOAT4(DirectX::Colors::ForestGreen);
-    }
-
-    for (size_t index = 0; index < sphere.Vertices.size(); ++index, ++TotalIndex)
-    {
-        TotalVertices[TotalIndex].Pos = sphere.Vertices[index].Position;
-        TotalVertices[TotalIndex].Color = DirectX::XMFLOAT4(DirectX::Colors::Crimson);
-    }
-
-    for (size_t index = 0; index < cylinder.Vertices.size(); ++index, ++TotalIndex)
-    {
-        TotalVertices[TotalIndex].Pos = cylinder.Vertices[index].Position;
-        TotalVertices[TotalIndex].Color = DirectX::XMFLOAT4(DirectX::Colors::SteelBlue);
-    }
-
-    std::vector<uint16_t> TotaleIndices;
-    TotaleIndices.insert(TotaleIndices.end(), box.GetIndices16().begin(), box.GetIndices16().end());
-    TotaleIndices.insert(TotaleIndices.end(), grid.GetIndices16().begin(), grid.GetIndices16().end());
-    TotaleIndices.insert(TotaleIndices.end(), sphere.GetIndices16().begin(), sphere.GetIndices16().end());
-    TotaleIndices.insert(TotaleIndices.end(), cylinder.GetIndices16().begin(), cylinder.GetIndices16().end());
-
-
-    const UINT vbBytesSize = sizeof(ShapedVertex) * static_cast<UINT>(TotalVertices.size());
-    const UINT ibByteSize = sizeof(uint16_t) * static_cast<UINT>(TotaleIndices.size());
+    const UINT vbBytesSize = sizeof(ShapedVertex) * totalVertexCount;
+    const UINT ibByteSize = sizeof(uint16_t) * totalIndexCount;
 
     auto geo = std::make_unique<MeshGeometry>();
     geo->Name = GeoName;
 
     ThrowIfFailed(D3DCreateBlob(vbBytesSize, &geo->VertexBufferCPU));
-    CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), TotalVertices.data(), vbBytesSize);
     ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-    CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), TotaleIndices.data(), ibByteSize);
+    ShapedVertex* vertices = static_cast<ShapedVertex*>(geo->VertexBufferCPU->GetBufferPointer());
+    uint16_t* indices = static_cast<uint16_t*>(geo->IndexBufferCPU->GetBufferPointer());
+
+    // Extract the vertex elements we are intersted in, each shape gets a flat color
+    auto colored = [](DirectX::XMVECTORF32 color)
+    {
+        const DirectX::XMFLOAT4 rgba(color);
+        return [rgba](ShapedVertex& dst, const GeometryGenerator::Vertex& src)
+        {
+            dst.Pos = src.Position;
+            dst.Color = rgba;
+        };
+    };
+
+    // Only positions are generated, the colors don't come from the generator
+    const auto attributes = ShapedVertexFormat::GeneratorMask();
+
+    geoGen.WriteBox(4.5f, 0.5f, 1.5f, 3, vertices + boxVertexOffset, indices + boxIndexOffset, colored(DirectX::Colors::DarkGreen), attributes);
+    geoGen.WriteGrid(20.0f, 30.0f, 60, 40, vertices + gridVertexOffset, indices + gridIndexOffset, colored(DirectX::Colors::ForestGreen), attributes);
+    geoGen.WriteSphere(0.5f, 20, 20, vertices + sphereVertexOffset, indices + sphereIndexOffset, colored(DirectX::Colors::Crimson), attributes);
+    geoGen.WriteCylinder(0.5f, 0.3f, 3.0f, 20, 20, vertices + cylinderVertexOffset, indices + cylinderIndexOffset, colored(DirectX::Colors::SteelBlue), attributes);
 
-    geo->VertexBufferGPU = D3dUtil::CreateDefaultBuffer(md3dDevice.Get(), mCommandList.Get(), TotalVertices.data(), vbBytesSize, geo->VertexBufferUploader);
-    geo->IndexBufferGPU = D3dUtil::CreateDefaultBuffer(md3dDevice.Get(), mCommandList.Get(), TotaleIndices.data(), ibByteSize, geo->IndexBufferUploader);
+    geo->VertexBufferGPU = D3dUtil::CreateDefaultBuffer(md3dDevice.Get(), mCommandList.Get(), vertices, vbBytesSize, geo->VertexBufferUploader);
+    geo->IndexBufferGPU = D3dUtil::CreateDefaultBuffer(md3dDevice.Get(), mCommandList.Get(), indices, ibByteSize, geo->IndexBufferUploader);
 
     geo->VertexByteStride = sizeof(ShapedVertex);
     geo->VertexBufferByteSize = vbBytesSize;
@@ -463,8 +447,10 @@ void ShapesApp::OnKeyboardInput(const GameTimer& InGameTime)
 void ShapesApp::UpdateObjectCBs(const GameTimer& IngameTime)
 {
     auto objCBBuffer = mCurrentFrameResource->ObjectCb.get();
-    for (auto& e : mAllRenderItems)
+    TaskScheduler::Get().ParallelFor(0, (int)mAllRenderItems.size(), 32, [&](int index)
     {
+        auto& e = mAllRenderItems[index];
+
         if (e->NumFramesDirty > 0)
         {
             DirectX::XMMATRIX world = DirectX::XMLoadFloat4x4(&e->World);
@@ -476,7 +462,7 @@ void ShapesApp::UpdateObjectCBs(const GameTimer& IngameTime)
 
             e->NumFramesDirty--;
         }
-    }
+    });
 }
 
 void ShapesApp::UpdateMainPassCB(const GameTimer& InGamTime)
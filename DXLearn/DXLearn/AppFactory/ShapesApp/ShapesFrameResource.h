@@ -1,5 +1,6 @@
 ﻿#pragma once
 #include "../../Common/FrameResource.h"
+#include "../../Common/VertexFormat.h"
 
 struct shapesObjectConstants
 {
@@ -30,6 +31,9 @@ struct ShapedVertex
     DirectX::XMFLOAT4 Color;
 };
 
+using ShapedVertexFormat = VertexFormat<VertexPosition, VertexColor>;
+static_assert(offsetof(ShapedVertex, Color) == ShapedVertexFormat::OffsetOf<VertexColor>(), "ShapedVertex doesn't match ShapedVertexFormat");
+
 class ShapesFrameResource:public FrameResource
 {
 public:
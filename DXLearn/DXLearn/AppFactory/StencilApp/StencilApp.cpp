@@ -2,7 +2,6 @@
 
 #include <array>
 
-#include "../../Common/DDSTextureLoader.h"
 #include "../../Common/FileManager.h"
 using namespace std;
 using namespace DirectX;
@@ -13,6 +12,7 @@ void StencilApp::Draw(const GameTimer& InGameTime)
 
 	ThrowIfFailed(cmdListAlloc->Reset());
 	ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mPSOs[EPSoType::Opaque].Get()));
+	mTextureStreamer.RecordUploads(mCommandList.Get());
 	
 	mCommandList->RSSetViewports(1, &mScreenViewport);
 	mCommandList->RSSetScissorRects(1, &mScissorRect);
@@ -92,7 +92,7 @@ void StencilApp::BuildMaterials()
 	auto bricks = std::make_unique<Material>();
 	bricks->Name = "bricks";
 	bricks->MatCBIndex = 0;
-	bricks->DiffuseSrvHeapIndex = 0;
+	bricks->DiffuseSrvHeapIndex = TextureIndex("bricksTex");
 	bricks->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	bricks->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
 	bricks->Roughness = 0.25f;
@@ -100,7 +100,7 @@ void StencilApp::BuildMaterials()
 	auto checkertile = std::make_unique<Material>();
 	checkertile->Name = "checkertile";
 	checkertile->MatCBIndex = 1;
-	checkertile->DiffuseSrvHeapIndex = 1;
+	checkertile->DiffuseSrvHeapIndex = TextureIndex("checkboardTex");
 	checkertile->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	checkertile->FresnelR0 = XMFLOAT3(0.07f, 0.07f, 0.07f);
 	checkertile->Roughness = 0.3f;
@@ -108,7 +108,7 @@ void StencilApp::BuildMaterials()
 	auto icemirror = std::make_unique<Material>();
 	icemirror->Name = "icemirror";
 	icemirror->MatCBIndex = 2;
-	icemirror->DiffuseSrvHeapIndex = 2;
+	icemirror->DiffuseSrvHeapIndex = TextureIndex("iceTex");
 	icemirror->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 0.3f);
 	icemirror->FresnelR0 = XMFLOAT3(0.1f, 0.1f, 0.1f);
 	icemirror->Roughness = 0.5f;
@@ -116,7 +116,7 @@ void StencilApp::BuildMaterials()
 	auto skullMat = std::make_unique<Material>();
 	skullMat->Name = "skullMat";
 	skullMat->MatCBIndex = 3;
-	skullMat->DiffuseSrvHeapIndex = 3;
+	skullMat->DiffuseSrvHeapIndex = TextureIndex("white1x1Tex");
 	skullMat->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	skullMat->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
 	skullMat->Roughness = 0.3f;
@@ -124,7 +124,7 @@ void StencilApp::BuildMaterials()
 	auto shadowMat = std::make_unique<Material>();
 	shadowMat->Name = "shadowMat";
 	shadowMat->MatCBIndex = 4;
-	shadowMat->DiffuseSrvHeapIndex = 3;
+	shadowMat->DiffuseSrvHeapIndex = TextureIndex("white1x1Tex");
 	shadowMat->DiffuseAlbedo = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.5f);
 	shadowMat->FresnelR0 = XMFLOAT3(0.001f, 0.001f, 0.001f);
 	shadowMat->Roughness = 0.0f;
@@ -138,84 +138,10 @@ void StencilApp::BuildMaterials()
 
 void StencilApp::BuildTextures()
 {
-    auto bricksTex = make_unique<Texture>();
-    bricksTex->Name = "bricksTex";
-    bricksTex->Filename = FileManager::GetTextureFullPath("bricks3.dds");
-    ThrowIfFailed(CreateDDSTextureFromFile12(md3dDevice.Get(), mCommandList.Get(), bricksTex->Filename.c_str(), bricksTex->Resource, bricksTex->UploadHeap));
-
-    auto checkboardTex = std::make_unique<Texture>();
-    checkboardTex->Name = "checkboardTex";
-    checkboardTex->Filename = FileManager::GetTextureFullPath("checkboard.dds");
-    ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-        mCommandList.Get(), checkboardTex->Filename.c_str(),
-        checkboardTex->Resource, checkboardTex->UploadHeap));
-
-    auto iceTex = std::make_unique<Texture>();
-    iceTex->Name = "iceTex";
-    iceTex->Filename = FileManager::GetTextureFullPath("ice.dds");
-    ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-        mCommandList.Get(), iceTex->Filename.c_str(),
-        iceTex->Resource, iceTex->UploadHeap));
-
-    auto white1x1Tex = std::make_unique<Texture>();
-    white1x1Tex->Name = "white1x1Tex";
-    white1x1Tex->Filename = FileManager::GetTextureFullPath("white1x1.dds");
-    ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-        mCommandList.Get(), white1x1Tex->Filename.c_str(),
-        white1x1Tex->Resource, white1x1Tex->UploadHeap));
-
-    mTextures[bricksTex->Name] = move(bricksTex);
-    mTextures[checkboardTex->Name] = move(checkboardTex);
-    mTextures[iceTex->Name] = move(iceTex);
-    mTextures[white1x1Tex->Name] = move(white1x1Tex);
-}
-
-void StencilApp::BuildDescriptorHeaps()
-{
-	//
-	// Create the SRV heap.
-	//
-	D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-	srvHeapDesc.NumDescriptors = 4;
-	srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-	srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSrvheap)));
-
-	//
-	// Fill out the heap with actual descriptors.
-	//
-	CD3DX12_CPU_DESCRIPTOR_HANDLE hDescriptor(mSrvheap->GetCPUDescriptorHandleForHeapStart());
-
-	auto bricksTex = mTextures["bricksTex"]->Resource;
-	auto checkboardTex = mTextures["checkboardTex"]->Resource;
-	auto iceTex = mTextures["iceTex"]->Resource;
-	auto white1x1Tex = mTextures["white1x1Tex"]->Resource;
-
-	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = bricksTex->GetDesc().Format;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.MipLevels = -1;
-	md3dDevice->CreateShaderResourceView(bricksTex.Get(), &srvDesc, hDescriptor);
-
-	// next descriptor
-	hDescriptor.Offset(1, mCbvHandleSize);
-
-	srvDesc.Format = checkboardTex->GetDesc().Format;
-	md3dDevice->CreateShaderResourceView(checkboardTex.Get(), &srvDesc, hDescriptor);
-
-	// next descriptor
-	hDescriptor.Offset(1, mCbvHandleSize);
-
-	srvDesc.Format = iceTex->GetDesc().Format;
-	md3dDevice->CreateShaderResourceView(iceTex.Get(), &srvDesc, hDescriptor);
-
-	// next descriptor
-	hDescriptor.Offset(1, mCbvHandleSize);
-
-	srvDesc.Format = white1x1Tex->GetDesc().Format;
-	md3dDevice->CreateShaderResourceView(white1x1Tex.Get(), &srvDesc, hDescriptor);
+    LoadTexture("bricksTex", FileManager::GetTextureFullPath("bricks3.dds"));
+    LoadTexture("checkboardTex", FileManager::GetTextureFullPath("checkboard.dds"));
+    LoadTexture("iceTex", FileManager::GetTextureFullPath("ice.dds"));
+    LoadTexture("white1x1Tex", FileManager::GetTextureFullPath("white1x1.dds"));
 }
 
 void StencilApp::BuildRenderItems()
@@ -230,6 +156,8 @@ void StencilApp::BuildRenderItems()
 	floorRitem->IndexCount = floorRitem->Geo->DrawArgs["floor"].IndexCount;
 	floorRitem->StartIndexLocation = floorRitem->Geo->DrawArgs["floor"].StartIndexLocation;
 	floorRitem->BaseVertexLocation = floorRitem->Geo->DrawArgs["floor"].BaseVertexLocation;
+	floorRitem->Bounds = floorRitem->Geo->DrawArgs["floor"].Bounds;
+	floorRitem->TexCoordExtent = floorRitem->Geo->DrawArgs["floor"].TexCoordExtent;
 	mRItemLayers[ERenderLayer::Opaque].push_back(floorRitem.get());
 
 	auto wallsRitem = std::make_unique<RenderItem>();
@@ -242,6 +170,8 @@ void StencilApp::BuildRenderItems()
 	wallsRitem->IndexCount = wallsRitem->Geo->DrawArgs["wall"].IndexCount;
 	wallsRitem->StartIndexLocation = wallsRitem->Geo->DrawArgs["wall"].StartIndexLocation;
 	wallsRitem->BaseVertexLocation = wallsRitem->Geo->DrawArgs["wall"].BaseVertexLocation;
+	wallsRitem->Bounds = wallsRitem->Geo->DrawArgs["wall"].Bounds;
+	wallsRitem->TexCoordExtent = wallsRitem->Geo->DrawArgs["wall"].TexCoordExtent;
 	mRItemLayers[ERenderLayer::Opaque].push_back(wallsRitem.get());
 
 	auto skullRitem = std::make_unique<RenderItem>();
@@ -254,6 +184,8 @@ void StencilApp::BuildRenderItems()
 	skullRitem->IndexCount = skullRitem->Geo->DrawArgs["skull"].IndexCount;
 	skullRitem->StartIndexLocation = skullRitem->Geo->DrawArgs["skull"].StartIndexLocation;
 	skullRitem->BaseVertexLocation = skullRitem->Geo->DrawArgs["skull"].BaseVertexLocation;
+	skullRitem->Bounds = skullRitem->Geo->DrawArgs["skull"].Bounds;
+	skullRitem->TexCoordExtent = skullRitem->Geo->DrawArgs["skull"].TexCoordExtent;
 	mSkullRitem = skullRitem.get();
 	mRItemLayers[ERenderLayer::Opaque].push_back(skullRitem.get());
 
@@ -281,6 +213,8 @@ void StencilApp::BuildRenderItems()
 	mirrorRitem->IndexCount = mirrorRitem->Geo->DrawArgs["mirror"].IndexCount;
 	mirrorRitem->StartIndexLocation = mirrorRitem->Geo->DrawArgs["mirror"].StartIndexLocation;
 	mirrorRitem->BaseVertexLocation = mirrorRitem->Geo->DrawArgs["mirror"].BaseVertexLocation;
+	mirrorRitem->Bounds = mirrorRitem->Geo->DrawArgs["mirror"].Bounds;
+	mirrorRitem->TexCoordExtent = mirrorRitem->Geo->DrawArgs["mirror"].TexCoordExtent;
 	mRItemLayers[ERenderLayer::Mirrors].push_back(mirrorRitem.get());
 	mRItemLayers[ERenderLayer::Translucent].push_back(mirrorRitem.get());
 
@@ -488,6 +422,10 @@ void StencilApp::BuildRoomGeometry()
 	mirrorSubmesh.StartIndexLocation = 24;
 	mirrorSubmesh.BaseVertexLocation = 0;
 
+	floorSubmesh.ComputeExtents(vertices.data(), indices.data());
+	wallSubmesh.ComputeExtents(vertices.data(), indices.data());
+	mirrorSubmesh.ComputeExtents(vertices.data(), indices.data());
+
     const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
     const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
 
@@ -18,7 +18,6 @@ public:
     void BuildGeometry() override;
     void BuildMaterials() override;
     void BuildTextures() override;
-    void BuildDescriptorHeaps() override;
 
     void BuildRenderItems() override;
     void BuildFrameResources() override;
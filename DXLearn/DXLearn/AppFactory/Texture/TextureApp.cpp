@@ -1,9 +1,8 @@
 ﻿#include "TextureApp.h"
 
+#include <algorithm>
 #include <array>
 #include <DirectXColors.h>
-
-#include "../../Common/DDSTextureLoader.h"
 using namespace std;
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -21,7 +20,8 @@ void TextureApp::Draw(const GameTimer& InGameTime)
     {
         ThrowIfFailed(mCommandList->Reset(cmdAlloc.Get(), mPSOs[EPSoType::Opaque].Get()));
     }
-    
+
+    mTextureStreamer.RecordUploads(mCommandList.Get());
 
     mCommandList->RSSetViewports(1, &mScreenViewport);
     mCommandList->RSSetScissorRects(1, &mScissorRect);
@@ -94,90 +94,79 @@ void TextureApp::BuildShadersAndInputLayout()
     mShaders["standardVS"] = D3dUtil::CompileShader(ShaderPath, nullptr, "VS", "vs_5_0");
     mShaders["opaquePS"] = D3dUtil::CompileShader(ShaderPath, nullptr, "PS", "ps_5_0");
 
-    mInputLayout =
-    {
-        {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-        {"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-        {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}
-    };
+    mInputLayout = LightVertexFormat::InputLayout();
 }
 
 void TextureApp::BuildDescriptorHeaps()
 {
-    //Create SRV heap
+    // Every frame resource has its own view of each texture, the streamer rewrites the views
+    // of a frame resource only once the GPU is done with it.
     D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-    srvHeapDesc.NumDescriptors = 4;
+    srvHeapDesc.NumDescriptors = mTextureStreamer.Count() * gNumFrameResources;
     srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
     srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
     ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSrvheap)));
 
-    // Fill the srv heap by texture desc
-    CD3DX12_CPU_DESCRIPTOR_HANDLE hDesc(mSrvheap->GetCPUDescriptorHandleForHeapStart());
-    auto bricksTex = mTextures["bricksTex"]->Resource;
-    auto stoneTex = mTextures["stoneTex"]->Resource;
-    auto tileTex = mTextures["tileTex"]->Resource;
-    auto skullTex = mTextures["skullTex"]->Resource;
-
-    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-    srvDesc.Format = bricksTex->GetDesc().Format;
-    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-    srvDesc.Texture2D.MostDetailedMip = 0;
-    srvDesc.Texture2D.MipLevels = bricksTex->GetDesc().MipLevels;
-    srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-
-    md3dDevice->CreateShaderResourceView(bricksTex.Get(), &srvDesc, hDesc);
-
-    hDesc.Offset(1, mCbvHandleSize);
-    srvDesc.Format = stoneTex->GetDesc().Format;
-    srvDesc.Texture2D.MipLevels = stoneTex->GetDesc().MipLevels;
-    md3dDevice->CreateShaderResourceView(stoneTex.Get(), &srvDesc, hDesc);
-    
-    hDesc.Offset(1, mCbvHandleSize);
-    srvDesc.Format = tileTex->GetDesc().Format;
-    srvDesc.Texture2D.MipLevels = tileTex->GetDesc().MipLevels;
-    md3dDevice->CreateShaderResourceView(tileTex.Get(), &srvDesc, hDesc);
-
-    hDesc.Offset(1, mCbvHandleSize);
-    srvDesc.Format = skullTex->GetDesc().Format;
-    srvDesc.Texture2D.MipLevels = skullTex->GetDesc().MipLevels;
-    md3dDevice->CreateShaderResourceView(skullTex.Get(), &srvDesc, hDesc);
+    mTextureStreamer.CreateViews(mSrvheap.Get(), mCbvHandleSize);
 }
 
 void TextureApp::BuildTextures()
 {
-    auto bricksTex = std::make_unique<Texture>();
-    bricksTex->Name = "bricksTex";
-    bricksTex->Filename = TEXT("AppFactory/Textures/bricks.dds");
-    ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-        mCommandList.Get(), bricksTex->Filename.c_str(),
-        bricksTex->Resource, bricksTex->UploadHeap));
-
-    auto stoneTex = std::make_unique<Texture>();
-    stoneTex->Name = "stoneTex";
-    stoneTex->Filename = TEXT("AppFactory/Textures/stone.dds");
-    ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-        mCommandList.Get(), stoneTex->Filename.c_str(),
-        stoneTex->Resource, stoneTex->UploadHeap));
-
-    auto tileTex = std::make_unique<Texture>();
-    tileTex->Name = "tileTex";
-    tileTex->Filename = TEXT("AppFactory/Textures/tile.dds");
-    ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-        mCommandList.Get(), tileTex->Filename.c_str(),
-        tileTex->Resource, tileTex->UploadHeap));
-
-    auto skullTex = std::make_unique<Texture>();
-    skullTex->Name = "skullTex";
-    skullTex->Filename = TEXT("AppFactory/Textures/ice.dds");
-    ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-        mCommandList.Get(), skullTex->Filename.c_str(),
-        skullTex->Resource, skullTex->UploadHeap));
-
-    mTextures[bricksTex->Name] = move(bricksTex);
-    mTextures[stoneTex->Name] = move(stoneTex);
-    mTextures[tileTex->Name] = move(tileTex);
-    mTextures[skullTex->Name] = move(skullTex);
+    LoadTexture("bricksTex", TEXT("AppFactory/Textures/bricks.dds"));
+    LoadTexture("stoneTex", TEXT("AppFactory/Textures/stone.dds"));
+    LoadTexture("tileTex", TEXT("AppFactory/Textures/tile.dds"));
+    LoadTexture("skullTex", TEXT("AppFactory/Textures/ice.dds"));
+}
+
+void TextureApp::LoadTexture(const std::string& name, const std::wstring& filename)
+{
+    // Only the smallest mips are uploaded here, the rest stream in once they are seen.
+    auto tex = std::make_unique<Texture>();
+    tex->Name = name;
+    tex->Filename = filename;
+    ThrowIfFailed(mTextureStreamer.Add(md3dDevice.Get(), mCommandList.Get(), tex->Filename, &tex->StreamerIndex));
+
+    mTextures[tex->Name] = move(tex);
+}
+
+void TextureApp::UpdateTextures(const GameTimer& InGameTime)
+{
+    // A material asks for the finest mip any of its items is seen at.
+    for (auto& mat : mMaterials)
+    {
+        mat.second->RequestedLod = FLT_MAX;
+    }
+
+    const float pixelsPerUnit = mProj._22 * 0.5f * mClientHeight;
+    for (auto& ri : mAllRitems)
+    {
+        Material* mat = ri->Mat;
+        if (mat == nullptr || mat->DiffuseSrvHeapIndex < 0 || static_cast<UINT>(mat->DiffuseSrvHeapIndex) >= mTextureStreamer.Count())
+        {
+            continue;
+        }
+
+        const float textureSize = static_cast<float>(mTextureStreamer.Size(mat->DiffuseSrvHeapIndex));
+        mat->RequestedLod = std::min(mat->RequestedLod, ri->TextureLod(mEyePostion, pixelsPerUnit, textureSize));
+    }
+
+    for (auto& mat : mMaterials)
+    {
+        if (mat.second->RequestedLod < FLT_MAX)
+        {
+            mTextureStreamer.Request(mat.second->DiffuseSrvHeapIndex, mat.second->RequestedLod);
+        }
+    }
+
+    // Draw signals the next fence once this frame is submitted.
+    mTextureStreamer.Update(mCurrFrameResourceIndex, mFence->GetCompletedValue(), mCurrentFence + 1);
+}
+
+CD3DX12_GPU_DESCRIPTOR_HANDLE TextureApp::DiffuseSrv(const Material* mat) const
+{
+    CD3DX12_GPU_DESCRIPTOR_HANDLE tex(mSrvheap->GetGPUDescriptorHandleForHeapStart());
+    tex.Offset(static_cast<INT>(mCurrFrameResourceIndex * mTextureStreamer.Count()) + mat->DiffuseSrvHeapIndex, mCbvHandleSize);
+    return tex;
 }
 
 void TextureApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& rItems)
@@ -197,8 +186,7 @@ void TextureApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::
         cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
         cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
 
-        CD3DX12_GPU_DESCRIPTOR_HANDLE tex(mSrvheap->GetGPUDescriptorHandleForHeapStart());
-        tex.Offset(ri->Mat->DiffuseSrvHeapIndex, mCbvHandleSize);
+        CD3DX12_GPU_DESCRIPTOR_HANDLE tex = DiffuseSrv(ri->Mat);
 
         D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + ri->ObjCBIndex*objCBByteSize;
         D3D12_GPU_VIRTUAL_ADDRESS matCBAddress = matCB->GetGPUVirtualAddress() + ri->Mat->MatCBIndex*matCBByteSize;
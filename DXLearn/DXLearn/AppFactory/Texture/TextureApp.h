@@ -1,5 +1,6 @@
 ﻿#pragma once
 #include "../Light/LightApp.h"
+#include "../../Common/TextureStreamer.h"
 
 class TextureApp: public LightApp
 {
@@ -16,10 +17,20 @@ protected:
     void BuildShadersAndInputLayout() override;
     void BuildDescriptorHeaps() override;
     void BuildTextures() override;
+    void UpdateTextures(const GameTimer& InGameTime) override;
     void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& rItems) override;
 
     std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> GetStaticSamplers();
 
+    // Adds filename to the streamer, its view index is the order textures are loaded in.
+    void LoadTexture(const std::string& name, const std::wstring& filename);
+
+    // The view of mat's diffuse texture for the current frame resource.
+    CD3DX12_GPU_DESCRIPTOR_HANDLE DiffuseSrv(const Material* mat) const;
+
 protected:
     Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mSrvheap = nullptr;
+
+    // 64MB of textures, 4MB of mips uploaded a frame.
+    TextureStreamer mTextureStreamer{ 64ull << 20, 4ull << 20 };
 };
@@ -3,11 +3,21 @@
 #include <array>
 #include <iostream>
 
-#include "../../Common/DDSTextureLoader.h"
 #include "../../Common/FileManager.h"
 using namespace DirectX;
 using namespace std;
 
+namespace
+{
+    struct TreeSpriteVertex
+    {
+        XMFLOAT3 Pos;
+        XMFLOAT2 Size;
+    };
+
+    using TreeSpriteVertexFormat = VertexFormat<VertexPosition, VertexSize>;
+    static_assert(offsetof(TreeSpriteVertex, Size) == TreeSpriteVertexFormat::OffsetOf<VertexSize>(), "TreeSpriteVertex doesn't match its format");
+}
 
 TreeBillboardsApp::TreeBillboardsApp(HINSTANCE hInsatnce)
     : BlendApp(hInsatnce)
@@ -21,6 +31,7 @@ void TreeBillboardsApp::Draw(const GameTimer& InGameTime)
     ThrowIfFailed(cmdAlloc->Reset());
 
     ThrowIfFailed(mCommandList->Reset(cmdAlloc.Get(), mPSOs[EPSoType::Opaque].Get()));
+    mTextureStreamer.RecordUploads(mCommandList.Get());
     mCommandList->RSSetViewports(1, &mScreenViewport);
     mCommandList->RSSetScissorRects(1, &mScissorRect);
     mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentRenderTargetBuffer(),
@@ -69,67 +80,7 @@ void TreeBillboardsApp::BuildTextures()
 {
     BlendApp::BuildTextures();
 
-    auto treeArrayTex = std::make_unique<Texture>();
-    treeArrayTex->Name = "treeArrayTex";
-    treeArrayTex->Filename = FileManager::GetTextureFullPath("treeArray2.dds");
-    ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-        mCommandList.Get(), treeArrayTex->Filename.c_str(), treeArrayTex->Resource, treeArrayTex->UploadHeap));
-
-    mTextures[treeArrayTex->Name] = std::move(treeArrayTex);
-}
-
-void TreeBillboardsApp::BuildDescriptorHeaps()
-{
-    //
-    // Create the SRV heap.
-    //
-    D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-    srvHeapDesc.NumDescriptors = 4;
-    srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-    srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-    ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSrvheap)));
-
-    //
-    // Fill out the heap with actual descriptors.
-    //
-    CD3DX12_CPU_DESCRIPTOR_HANDLE hDescriptor(mSrvheap->GetCPUDescriptorHandleForHeapStart());
-
-    auto grassTex = mTextures["grassTex"]->Resource;
-    auto waterTex = mTextures["waterTex"]->Resource;
-    auto fenceTex = mTextures["fenceTex"]->Resource;
-    auto treeArrayTex = mTextures["treeArrayTex"]->Resource;
-
-    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-    srvDesc.Format = grassTex->GetDesc().Format;
-    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-    srvDesc.Texture2D.MostDetailedMip = 0;
-    srvDesc.Texture2D.MipLevels = -1;
-    md3dDevice->CreateShaderResourceView(grassTex.Get(), &srvDesc, hDescriptor);
-
-    // next descriptor
-    hDescriptor.Offset(1, mCbvHandleSize);
-
-    srvDesc.Format = waterTex->GetDesc().Format;
-    md3dDevice->CreateShaderResourceView(waterTex.Get(), &srvDesc, hDescriptor);
-
-    // next descriptor
-    hDescriptor.Offset(1, mCbvHandleSize);
-
-    srvDesc.Format = fenceTex->GetDesc().Format;
-    md3dDevice->CreateShaderResourceView(fenceTex.Get(), &srvDesc, hDescriptor);
-
-    // next descriptor
-    hDescriptor.Offset(1, mCbvHandleSize);
-
-    auto desc = treeArrayTex->GetDesc();
-    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
-    srvDesc.Format = treeArrayTex->GetDesc().Format;
-    srvDesc.Texture2DArray.MostDetailedMip = 0;
-    srvDesc.Texture2DArray.MipLevels = -1;
-    srvDesc.Texture2DArray.FirstArraySlice = 0;
-    srvDesc.Texture2DArray.ArraySize = treeArrayTex->GetDesc().DepthOrArraySize;
-    md3dDevice->CreateShaderResourceView(treeArrayTex.Get(), &srvDesc, hDescriptor);
+    LoadTexture("treeArrayTex", FileManager::GetTextureFullPath("treeArray2.dds"));
 }
 
 void TreeBillboardsApp::BuildMaterials()
@@ -139,7 +90,7 @@ void TreeBillboardsApp::BuildMaterials()
     auto treeSprites = std::make_unique<Material>();
     treeSprites->Name = "treeSprites";
     treeSprites->MatCBIndex = 3;
-    treeSprites->DiffuseSrvHeapIndex = 3;
+    treeSprites->DiffuseSrvHeapIndex = TextureIndex("treeArrayTex");
     treeSprites->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
     treeSprites->FresnelR0 = XMFLOAT3(0.01f, 0.01f, 0.01f);
     treeSprites->Roughness = 0.125f;
@@ -173,18 +124,8 @@ void TreeBillboardsApp::BuildShadersAndInputLayout()
     mShaders["treeSpriteGS"] = D3dUtil::CompileShader(treeSpriteShaderPath, nullptr, "GS", "gs_5_0");
     mShaders["treeSpritePS"] = D3dUtil::CompileShader(treeSpriteShaderPath, alphaTestDefines, "PS", "ps_5_0");
 
-    mInputLayouts["blend"] =
-    {
-        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-    };
-
-    mInputLayouts["treeSprite"] =
-    {
-        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "SIZE", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-    };
+    mInputLayouts["blend"] = LightVertexFormat::InputLayout();
+    mInputLayouts["treeSprite"] = TreeSpriteVertexFormat::InputLayout();
 }
 
 void TreeBillboardsApp::BuildGeometry()
@@ -207,6 +148,8 @@ void TreeBillboardsApp::BuildRenderItems()
     treeSpriteRitem->IndexCount = treeSpriteRitem->Geo->DrawArgs["points"].IndexCount;
     treeSpriteRitem->StartIndexLocation = treeSpriteRitem->Geo->DrawArgs["points"].StartIndexLocation;
     treeSpriteRitem->BaseVertexLocation = treeSpriteRitem->Geo->DrawArgs["points"].BaseVertexLocation;
+    treeSpriteRitem->Bounds = treeSpriteRitem->Geo->DrawArgs["points"].Bounds;
+    treeSpriteRitem->TexCoordExtent = treeSpriteRitem->Geo->DrawArgs["points"].TexCoordExtent;
 
     mRItemLayers[ERenderLayer::AlphaTestedTreeSprites].push_back(treeSpriteRitem.get());
 
@@ -308,12 +251,6 @@ void TreeBillboardsApp::BuildPSOs()
 
 std::unique_ptr<MeshGeometry> TreeBillboardsApp::BuildTreeSpriteGeometry()
 {
-    struct TreeSpriteVertex
-    {
-        XMFLOAT3 Pos;
-        XMFLOAT2 Size;
-    };
-
     static const int treeCount = 16;
     std::array<TreeSpriteVertex, 16> vertices;
     for(UINT i = 0; i < treeCount; ++i)
@@ -364,6 +301,13 @@ std::unique_ptr<MeshGeometry> TreeBillboardsApp::BuildTreeSpriteGeometry()
     submesh.StartIndexLocation = 0;
     submesh.BaseVertexLocation = 0;
 
+    // The geometry shader expands each point to a quad the size of the whole texture.
+    BoundingBox::CreateFromPoints(submesh.Bounds, vertices.size(), &vertices[0].Pos, sizeof(TreeSpriteVertex));
+    submesh.Bounds.Extents.x += 10.0f;
+    submesh.Bounds.Extents.y += 10.0f;
+    submesh.Bounds.Extents.z += 10.0f;
+    submesh.TexCoordExtent = 20.0f;
+
     geo->DrawArgs["points"] = submesh;
     return geo;
 }
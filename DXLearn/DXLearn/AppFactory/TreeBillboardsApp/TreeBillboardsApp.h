@@ -18,7 +18,6 @@ public:
 protected:
     
     void BuildTextures() override;
-    void BuildDescriptorHeaps() override;
     void BuildMaterials() override;
 
     void BuildShadersAndInputLayout() override;
@@ -0,0 +1,142 @@
+#include "../Common/Benchmark.h"
+#include "../Common/FFT.h"
+#include "../AppFactory/LandAndWave/SpectralOcean.h"
+
+#include <cmath>
+#include <vector>
+
+namespace
+{
+    const double Pi = 3.14159265358979323846;
+
+    // Direct O(n^2) DFT in double, the reference the FFT is checked against.
+    void NaiveDFT(const double* re, const double* im, int n, int stride, EFFTDirection direction,
+        double* outRe, double* outIm)
+    {
+        const double sign = direction == EFFTDirection::Forward ? -1.0 : 1.0;
+        for (int k = 0; k < n; ++k)
+        {
+            double sumRe = 0.0;
+            double sumIm = 0.0;
+            for (int j = 0; j < n; ++j)
+            {
+                const double angle = sign*2.0*Pi*static_cast<double>((static_cast<long long>(j)*k) % n)/n;
+                const double c = std::cos(angle);
+                const double s = std::sin(angle);
+                sumRe += re[j*stride]*c - im[j*stride]*s;
+                sumIm += re[j*stride]*s + im[j*stride]*c;
+            }
+            outRe[k*stride] = sumRe;
+            outIm[k*stride] = sumIm;
+        }
+    }
+
+    // Rows, then columns, each with the naive DFT.
+    void NaiveDFT2D(std::vector<double>& re, std::vector<double>& im, int n, EFFTDirection direction)
+    {
+        std::vector<double> outRe(re.size());
+        std::vector<double> outIm(im.size());
+        for (int row = 0; row < n; ++row)
+        {
+            NaiveDFT(&re[row*n], &im[row*n], n, 1, direction, &outRe[row*n], &outIm[row*n]);
+        }
+        for (int col = 0; col < n; ++col)
+        {
+            NaiveDFT(&outRe[col], &outIm[col], n, n, direction, &re[col], &im[col]);
+        }
+    }
+
+    // Fixed pseudo random input in [-1, 1].
+    void FillInput(std::vector<float>& re, std::vector<float>& im, unsigned seed)
+    {
+        for (size_t i = 0; i < re.size(); ++i)
+        {
+            seed = seed*1664525u + 1013904223u;
+            re[i] = static_cast<float>(seed >> 8)/8388608.0f - 1.0f;
+            seed = seed*1664525u + 1013904223u;
+            im[i] = static_cast<float>(seed >> 8)/8388608.0f - 1.0f;
+        }
+    }
+
+    // Largest error relative to the largest output magnitude.
+    double RelativeError(const std::vector<float>& re, const std::vector<float>& im,
+        const std::vector<double>& refRe, const std::vector<double>& refIm)
+    {
+        double maxError = 0.0;
+        double maxValue = 0.0;
+        for (size_t i = 0; i < re.size(); ++i)
+        {
+            maxError = std::max(maxError, std::abs(re[i] - refRe[i]));
+            maxError = std::max(maxError, std::abs(im[i] - refIm[i]));
+            maxValue = std::max(maxValue, std::sqrt(refRe[i]*refRe[i] + refIm[i]*refIm[i]));
+        }
+        return maxError/maxValue;
+    }
+}
+
+// FFT against the naive DFT in both directions, 1D and 2D, at the ocean resolutions, and
+// the time of one 2D transform next to the naive one.
+BENCHMARK(FFT)
+{
+    // Float butterflies against a double reference, log2(n) roundings deep.
+    const double MaxRelativeError = 1e-5;
+
+    bool passed = true;
+    for (int n : { 64, 128, 256 })
+    {
+        for (EFFTDirection direction : { EFFTDirection::Forward, EFFTDirection::Inverse })
+        {
+            const char* name = direction == EFFTDirection::Forward ? "forward" : "inverse";
+            FFT fft(n, direction);
+
+            std::vector<float> re(n), im(n);
+            FillInput(re, im, n);
+            std::vector<double> inRe(re.begin(), re.end()), inIm(im.begin(), im.end());
+            std::vector<double> refRe(n), refIm(n);
+            NaiveDFT(inRe.data(), inIm.data(), n, 1, direction, refRe.data(), refIm.data());
+            fft.Transform(re.data(), im.data());
+            const double error1D = RelativeError(re, im, refRe, refIm);
+
+            std::vector<float> re2D(n*n), im2D(n*n);
+            FillInput(re2D, im2D, n + 1);
+            std::vector<double> ref2DRe(re2D.begin(), re2D.end()), ref2DIm(im2D.begin(), im2D.end());
+            NaiveDFT2D(ref2DRe, ref2DIm, n, direction);
+            fft.Transform2D(re2D.data(), im2D.data());
+            const double error2D = RelativeError(re2D, im2D, ref2DRe, ref2DIm);
+
+            Benchmark::Report("  %d %s: 1D error %.2e, 2D error %.2e\n", n, name, error1D, error2D);
+            if (error1D > MaxRelativeError || error2D > MaxRelativeError)
+            {
+                passed = Benchmark::Fail("%d %s FFT is off the naive DFT by more than %.0e", n, name, MaxRelativeError);
+            }
+        }
+    }
+
+    for (int n : { 64, 128, 256, 512 })
+    {
+        FFT fft(n, EFFTDirection::Inverse);
+        std::vector<float> re(n*n), im(n*n);
+        FillInput(re, im, n);
+        const double fftMs = Benchmark::Time(20, [&]() { fft.Transform2D(re.data(), im.data()); });
+
+        // The naive transform is O(n^3), time it once and only where it finishes quickly.
+        if (n <= 128)
+        {
+            std::vector<double> naiveRe(re.begin(), re.end()), naiveIm(im.begin(), im.end());
+            const double naiveMs = Benchmark::Time(1, [&]() { NaiveDFT2D(naiveRe, naiveIm, n, EFFTDirection::Inverse); });
+            Benchmark::Report("  %dx%d 2D: FFT %.3f ms, naive DFT %.1f ms\n", n, n, fftMs, naiveMs);
+        }
+        else
+        {
+            Benchmark::Report("  %dx%d 2D: FFT %.3f ms\n", n, n, fftMs);
+        }
+    }
+
+    // Whole ocean evaluation, three inverse 2D transforms plus the spectrum update, at the
+    // app's size.
+    SpectralOcean ocean(128, 128.0f, 6.0f, DirectX::XMFLOAT2(1.0f, 1.0f));
+    const double oceanMs = Benchmark::Time(20, [&]() { ocean.Step(1); });
+    Benchmark::Report("  SpectralOcean 128x128 step: %.3f ms\n", oceanMs);
+
+    return passed;
+}
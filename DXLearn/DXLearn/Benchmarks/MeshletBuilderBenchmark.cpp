@@ -0,0 +1,97 @@
+#include "../Common/Benchmark.h"
+#include "../Common/FileManager.h"
+#include "../Common/GeometryGenerator.h"
+#include "../Common/MeshletBuilder.h"
+#include "../Common/MeshOptimizer.h"
+#include "../Common/ModelLoader.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+    // Every triangle lands in exactly one meshlet within the default limits, and the local indices
+    // point back at the reordered index buffer.
+    bool IsValid(const MeshletGeometry& geometry, const std::vector<std::uint32_t>& indices)
+    {
+        std::size_t triangles = 0;
+        for (const Meshlet& meshlet : geometry.Meshlets)
+        {
+            if (meshlet.VertexCount > 64 || meshlet.TriangleCount > 124 || meshlet.TriangleOffset != triangles)
+            {
+                return false;
+            }
+            for (std::uint32_t t = 0; t < meshlet.TriangleCount*3; ++t)
+            {
+                const std::uint8_t local = geometry.PrimitiveIndices[meshlet.TriangleOffset*3 + t];
+                if (local >= meshlet.VertexCount ||
+                    geometry.VertexIndices[meshlet.VertexOffset + local] != indices[meshlet.TriangleOffset*3 + t])
+                {
+                    return false;
+                }
+            }
+            triangles += meshlet.TriangleCount;
+        }
+        return triangles*3 == indices.size();
+    }
+
+    // Build time of one mesh, the index list is restored before every run since Build
+    // reorders it in place.
+    bool Measure(const char* name, GeometryGenerator::MeshData& mesh)
+    {
+        MeshOptimizer::OptimizeVertexCache(mesh.Indices32.data(), mesh.Indices32.size(), mesh.Vertices.size());
+        const std::vector<std::uint32_t> sourceIndices = mesh.Indices32;
+
+        MeshletGeometry geometry;
+        double bestMs = 0.0;
+        for (int run = 0; run < 3; ++run)
+        {
+            mesh.Indices32 = sourceIndices;
+            const double ms = Benchmark::Time(1, [&]()
+            {
+                geometry = MeshletBuilder::Build(mesh.Vertices, mesh.Indices32, &GeometryGenerator::Vertex::Position);
+            });
+            bestMs = run == 0 ? ms : std::min(bestMs, ms);
+        }
+
+        const std::size_t triangleCount = sourceIndices.size()/3;
+        Benchmark::Report("  %-14s %8d triangles: %8.2f ms, %6.2f MTriangles/s, %6d meshlets\n", name,
+            static_cast<int>(triangleCount), bestMs, triangleCount/(bestMs*1000.0),
+            static_cast<int>(geometry.Meshlets.size()));
+
+        if (!IsValid(geometry, mesh.Indices32))
+        {
+            return Benchmark::Fail("%s: meshlets don't cover the triangles within the limits", name);
+        }
+        return true;
+    }
+}
+
+// Meshlet build time against mesh size, on grids from 8K to 2M triangles and on skull.txt.
+// Inputs are vertex cache optimized first, as LightApp does.
+BENCHMARK(MeshletBuilder)
+{
+    bool passed = true;
+
+    ModelData skull;
+    if (ModelLoader::Load(FileManager::GetModelFullPath("skull.txt"), skull))
+    {
+        passed = Measure("skull.txt", skull.Mesh) && passed;
+    }
+    else
+    {
+        passed = Benchmark::Fail("can't load skull.txt");
+    }
+
+    GeometryGenerator geoGen;
+    for (std::uint32_t size : { 65u, 129u, 257u, 513u, 1025u })
+    {
+        GeometryGenerator::MeshData grid = geoGen.CreateGrid(100.0f, 100.0f, size, size);
+        char name[32];
+        std::snprintf(name, sizeof(name), "grid %ux%u", size, size);
+        passed = Measure(name, grid) && passed;
+    }
+
+    return passed;
+}
@@ -0,0 +1,92 @@
+#include "../Common/Benchmark.h"
+#include "../Common/FileManager.h"
+#include "../Common/ModelLoader.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace
+{
+    struct StreamModel
+    {
+        std::vector<DirectX::XMFLOAT3> Positions;
+        std::vector<DirectX::XMFLOAT3> Normals;
+        std::vector<std::uint32_t> Indices;
+    };
+
+    // The ifstream loop LightApp::ConvertSkullModel used before ModelLoader, kept as the
+    // baseline. Only understands the (pos, normal) layout of skull.txt.
+    bool StreamLoad(const std::string& path, StreamModel& model)
+    {
+        std::ifstream fin(path);
+        if (!fin)
+        {
+            return false;
+        }
+
+        std::uint32_t vcount = 0;
+        std::uint32_t tcount = 0;
+        std::string ignore;
+
+        fin >> ignore >> vcount;
+        fin >> ignore >> tcount;
+        fin >> ignore >> ignore >> ignore >> ignore;
+
+        model.Positions.resize(vcount);
+        model.Normals.resize(vcount);
+        for (std::uint32_t i = 0; i < vcount; ++i)
+        {
+            fin >> model.Positions[i].x >> model.Positions[i].y >> model.Positions[i].z;
+            fin >> model.Normals[i].x >> model.Normals[i].y >> model.Normals[i].z;
+        }
+
+        fin >> ignore;
+        fin >> ignore;
+        fin >> ignore;
+
+        model.Indices.resize(3 * tcount);
+        for (std::uint32_t i = 0; i < tcount; ++i)
+        {
+            fin >> model.Indices[i * 3 + 0] >> model.Indices[i * 3 + 1] >> model.Indices[i * 3 + 2];
+        }
+        return !fin.fail();
+    }
+}
+
+// ModelLoader against the old ifstream loop on skull.txt: same floats and indices bit for
+// bit, and the load time of both.
+BENCHMARK(ModelLoader)
+{
+    const std::wstring path = FileManager::GetModelFullPath("skull.txt");
+    // ASCII path, std::ifstream only takes narrow names outside MSVC.
+    const std::string narrowPath(path.begin(), path.end());
+
+    StreamModel streamModel;
+    ModelData model;
+    if (!StreamLoad(narrowPath, streamModel) || !ModelLoader::Load(path, model))
+    {
+        return Benchmark::Fail("can't load %s", narrowPath.c_str());
+    }
+
+    const std::vector<GeometryGenerator::Vertex>& vertices = model.Mesh.Vertices;
+    if (vertices.size() != streamModel.Positions.size() || model.Mesh.Indices32 != streamModel.Indices)
+    {
+        return Benchmark::Fail("vertex or index lists differ from the ifstream loader");
+    }
+    for (std::size_t i = 0; i < vertices.size(); ++i)
+    {
+        if (std::memcmp(&vertices[i].Position, &streamModel.Positions[i], sizeof(DirectX::XMFLOAT3)) != 0 ||
+            std::memcmp(&vertices[i].Normal, &streamModel.Normals[i], sizeof(DirectX::XMFLOAT3)) != 0)
+        {
+            return Benchmark::Fail("vertex %d differs from the ifstream loader", static_cast<int>(i));
+        }
+    }
+
+    const double streamMs = Benchmark::Time(5, [&]() { StreamLoad(narrowPath, streamModel); });
+    const double loaderMs = Benchmark::Time(5, [&]() { ModelLoader::Load(path, model); });
+    Benchmark::Report("  skull.txt, %d vertices, %d triangles: ifstream %.1f ms, ModelLoader %.1f ms\n",
+        static_cast<int>(vertices.size()), static_cast<int>(streamModel.Indices.size()/3), streamMs, loaderMs);
+    return true;
+}
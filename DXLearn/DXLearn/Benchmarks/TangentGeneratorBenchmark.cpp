@@ -0,0 +1,83 @@
+#include "../Common/Benchmark.h"
+#include "../Common/FileManager.h"
+#include "../Common/ModelLoader.h"
+#include "../Common/TangentGenerator.h"
+#include "../Common/TaskScheduler.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+    // skull.txt has no texture coordinates, wrap a sphere around its center instead.
+    void SphericalTexCoords(ModelData& model)
+    {
+        const XMFLOAT3 center = model.Bounds.Center;
+        for (GeometryGenerator::Vertex& vertex : model.Mesh.Vertices)
+        {
+            const float x = vertex.Position.x - center.x;
+            const float y = vertex.Position.y - center.y;
+            const float z = vertex.Position.z - center.z;
+            const float r = std::sqrt(x*x + y*y + z*z);
+            vertex.TexC.x = std::atan2(z, x)/XM_2PI + 0.5f;
+            vertex.TexC.y = r > 0.0f ? std::acos(y/r)/XM_PI : 0.0f;
+        }
+    }
+
+    bool SameTangents(const std::vector<GeometryGenerator::Vertex>& a, const std::vector<GeometryGenerator::Vertex>& b)
+    {
+        for (std::size_t i = 0; i < a.size(); ++i)
+        {
+            if (std::memcmp(&a[i].TangentU, &b[i].TangentU, sizeof(XMFLOAT3)) != 0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+// Tangents for skull.txt on 1, 2, 4, ... threads of the shared pool: the speedup over one
+// thread, and the same bits on every thread count.
+BENCHMARK(TangentGenerator)
+{
+    ModelData model;
+    if (!ModelLoader::Load(FileManager::GetModelFullPath("skull.txt"), model))
+    {
+        return Benchmark::Fail("can't load skull.txt");
+    }
+    SphericalTexCoords(model);
+
+    TaskScheduler& scheduler = TaskScheduler::Get();
+    std::vector<GeometryGenerator::Vertex> serialVertices;
+    double serialMs = 0.0;
+    bool passed = true;
+    for (unsigned int threads = 1; ; threads = std::min(threads*2, scheduler.Concurrency()))
+    {
+        scheduler.SetConcurrencyLimit(threads);
+        const double ms = Benchmark::Time(10, [&]() { TangentGenerator::Generate(model.Mesh); });
+
+        if (threads == 1)
+        {
+            serialVertices = model.Mesh.Vertices;
+            serialMs = ms;
+        }
+        else if (!SameTangents(serialVertices, model.Mesh.Vertices))
+        {
+            passed = Benchmark::Fail("tangents on %u threads differ from one thread", threads);
+        }
+
+        Benchmark::Report("  skull.txt, %d vertices, %u threads: %.2f ms, %.2fx\n",
+            static_cast<int>(model.Mesh.Vertices.size()), threads, ms, serialMs/ms);
+        if (threads == scheduler.Concurrency())
+        {
+            break;
+        }
+    }
+    scheduler.SetConcurrencyLimit(0);
+
+    return passed;
+}
@@ -0,0 +1,284 @@
+#include "../Common/Benchmark.h"
+#include "../AppFactory/LandAndWave/Waves.h"
+#include "../AppFactory/LandAndWave/WaveSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace
+{
+    const float SpatialStep = 1.0f;
+    const float TimeStep = 0.03f;
+    const float Speed = 4.0f;
+    const float Damping = 0.2f;
+
+    std::unique_ptr<Waves> MakeGrid(int rows, int cols, EWaveSolver solver)
+    {
+        std::unique_ptr<Waves> waves(new Waves(rows, cols, SpatialStep, TimeStep, Speed, Damping));
+        waves->SetSolver(solver);
+        return waves;
+    }
+
+    // Same drops on every grid, spread over the interior.
+    void DisturbAll(Waves* const* grids, int gridCount, int round, int drops)
+    {
+        const int rows = grids[0]->RowCount();
+        const int cols = grids[0]->ColumnCount();
+        for (int drop = 0; drop < drops; ++drop)
+        {
+            const int i = 5 + (round*37 + drop*53) % (rows - 10);
+            const int j = 5 + (round*71 + drop*29) % (cols - 10);
+            // 0.2 to 0.5, the range the apps drop.
+            const float magnitude = 0.2f + 0.1f*((round + drop) % 4);
+            for (int g = 0; g < gridCount; ++g)
+            {
+                grids[g]->Disturb(i, j, magnitude);
+            }
+        }
+    }
+
+    const char* SolverName(EWaveSolver solver)
+    {
+        switch (solver)
+        {
+        case EWaveSolver::Scalar: return "Scalar";
+        case EWaveSolver::SSE: return "SSE";
+        case EWaveSolver::AVX2: return "AVX2";
+        default: return "Auto";
+        }
+    }
+}
+
+// Temporal blocking must match stepping one at a time bit for bit, for every kernel and
+// block length, including the odd column count that leaves a scalar tail. The tall grid
+// splits into several bands per thread, so the carried halos between bands get checked.
+BENCHMARK(WavesBlocked)
+{
+    struct GridShape
+    {
+        int Rows;
+        int Cols;
+    };
+    const GridShape Shapes[] = { { 300, 257 }, { 2500, 129 } };
+    const int Rounds = 12;
+    const int StepsPerRound = 120;
+
+    bool passed = true;
+    for (const GridShape& shape : Shapes)
+    {
+        for (EWaveSolver solver : { EWaveSolver::Scalar, EWaveSolver::SSE, EWaveSolver::AVX2 })
+        {
+            for (int substeps : { 2, 3, 5, 8 })
+            {
+                std::unique_ptr<Waves> reference = MakeGrid(shape.Rows, shape.Cols, solver);
+                std::unique_ptr<Waves> blocked = MakeGrid(shape.Rows, shape.Cols, solver);
+                if (blocked->Solver() != solver)
+                {
+                    // Kernel not supported here, the grid fell back to a narrower one.
+                    continue;
+                }
+                blocked->SetSubsteps(substeps);
+
+                Waves* grids[] = { reference.get(), blocked.get() };
+                for (int round = 0; round < Rounds; ++round)
+                {
+                    DisturbAll(grids, 2, round, 3);
+                    for (int step = 0; step < StepsPerRound; ++step)
+                    {
+                        reference->Step(1);
+                    }
+                    blocked->Step(StepsPerRound);
+                }
+
+                int mismatches = 0;
+                for (int i = 0; i < reference->VertexCount(); ++i)
+                {
+                    const float a = reference->Height(i);
+                    const float b = blocked->Height(i);
+                    mismatches += std::memcmp(&a, &b, sizeof(float)) != 0 ? 1 : 0;
+                }
+                if (mismatches != 0)
+                {
+                    passed = Benchmark::Fail("%dx%d %s, %d substeps: %d heights differ from StepReference",
+                        shape.Rows, shape.Cols, SolverName(solver), substeps, mismatches);
+                }
+            }
+        }
+    }
+
+    // Throughput on a grid too large for the cache, where blocking is meant to pay off.
+    const int LargeSize = 2048;
+    const int TimedSteps = 16;
+    for (int substeps : { 1, 2, 4, 8 })
+    {
+        std::unique_ptr<Waves> waves = MakeGrid(LargeSize, LargeSize, EWaveSolver::Auto);
+        waves->SetSubsteps(substeps);
+        waves->Disturb(LargeSize/2, LargeSize/2, 0.5f);
+        const double ms = Benchmark::Time(3, [&]() { waves->Step(TimedSteps); });
+        Benchmark::Report("  %dx%d %s, %d substeps: %.3f ms/step\n", LargeSize, LargeSize,
+            SolverName(waves->Solver()), substeps, ms/TimedSteps);
+    }
+
+    return passed;
+}
+
+// Half precision state rounds every step, so the compact grid drifts from the float one.
+// Halves keep 11 significant bits and the error scales with the heights, so the bound is
+// relative: the drift must stay under 5% of the highest float height seen.
+BENCHMARK(WavesCompactDrift)
+{
+    const int Size = 128;
+    const int Steps = 2000;          // 60 seconds of simulation.
+    const int StepsPerDrop = 8;      // The apps drop every quarter second.
+    const float MaxRelativeError = 0.05f;
+
+    std::unique_ptr<Waves> reference = MakeGrid(Size, Size, EWaveSolver::Auto);
+    std::unique_ptr<Waves> compact = MakeGrid(Size, Size, EWaveSolver::Auto);
+    compact->SetCompactStorage(true);
+
+    Waves* grids[] = { reference.get(), compact.get() };
+    float maxError = 0.0f;
+    float maxHeight = 0.0f;
+    for (int step = 0; step < Steps; ++step)
+    {
+        if (step % StepsPerDrop == 0)
+        {
+            DisturbAll(grids, 2, step / StepsPerDrop, 1);
+        }
+        reference->Step(1);
+        compact->Step(1);
+
+        for (int i = 0; i < reference->VertexCount(); ++i)
+        {
+            maxError = std::max(maxError, std::abs(reference->Height(i) - compact->Height(i)));
+            maxHeight = std::max(maxHeight, std::abs(reference->Height(i)));
+        }
+    }
+
+    const float bound = MaxRelativeError*maxHeight;
+    Benchmark::Report("  %d steps on %dx%d: max error %.5f, max height %.3f, bound %.5f\n",
+        Steps, Size, Size, maxError, maxHeight, bound);
+    if (maxError > bound)
+    {
+        return Benchmark::Fail("compact storage drifted %.5f from the float solver", maxError);
+    }
+    return true;
+}
+
+// Stored state per cell after stepping, float against compact, at 1 and 4 substeps. Compact
+// must stay within 4 bytes per cell plus the halo carry, at most 5%.
+BENCHMARK(WavesCompactFootprint)
+{
+    const int Size = 2048;
+    const int TimedSteps = 8;
+    const double MaxCompactBytesPerCell = 4.2;
+
+    bool passed = true;
+    for (int substeps : { 1, 4 })
+    {
+        for (bool compact : { false, true })
+        {
+            std::unique_ptr<Waves> waves = MakeGrid(Size, Size, EWaveSolver::Auto);
+            waves->SetCompactStorage(compact);
+            waves->SetSubsteps(substeps);
+            waves->Disturb(Size/2, Size/2, 0.5f);
+            const double ms = Benchmark::Time(3, [&]() { waves->Step(TimedSteps); });
+
+            const double bytesPerCell = static_cast<double>(waves->StateBytes())/waves->VertexCount();
+            Benchmark::Report("  %dx%d %s, %d substeps: %.3f bytes/cell, %.3f ms/step\n", Size, Size,
+                compact ? "compact" : "float", substeps, bytesPerCell, ms/TimedSteps);
+            if (compact && bytesPerCell > MaxCompactBytesPerCell)
+            {
+                passed = Benchmark::Fail("compact storage holds %.3f bytes/cell, more than %.1f",
+                    bytesPerCell, MaxCompactBytesPerCell);
+            }
+        }
+    }
+    return passed;
+}
+
+// WaveSystem's shared pass over several grids against each grid stepping on its own: the
+// row-split grids, a blocked one and a tracked one must all come out bit for bit the same.
+// Also times one system update against updating the grids one after another.
+BENCHMARK(WaveSystem)
+{
+    struct GridSetup
+    {
+        int Rows;
+        int Cols;
+        int Substeps;
+        bool TrackActivity;
+    };
+    const GridSetup Setups[] =
+    {
+        { 512, 512, 1, false },
+        { 128, 128, 1, false },
+        { 300, 257, 1, false },
+        { 64, 1025, 1, false },
+        { 256, 256, 4, false },
+        { 256, 256, 1, true },
+    };
+    const int Frames = 400;
+
+    WaveSystem system;
+    std::vector<std::unique_ptr<Waves>> alone;
+    for (const GridSetup& setup : Setups)
+    {
+        Waves* shared = system.Add(setup.Rows, setup.Cols, SpatialStep, TimeStep, Speed, Damping);
+        alone.push_back(MakeGrid(setup.Rows, setup.Cols, EWaveSolver::Auto));
+        shared->SetSolver(EWaveSolver::Auto);
+        for (Waves* waves : { shared, alone.back().get() })
+        {
+            waves->SetSubsteps(setup.Substeps);
+            waves->SetActivityTracking(setup.TrackActivity);
+        }
+    }
+
+    double systemMs = 0.0;
+    double aloneMs = 0.0;
+    for (int frame = 0; frame < Frames; ++frame)
+    {
+        for (int g = 0; g < system.Count(); ++g)
+        {
+            if (frame % 8 == 0)
+            {
+                Waves* grids[] = { system.Get(g), alone[g].get() };
+                DisturbAll(grids, 2, frame/8 + g, 1);
+            }
+        }
+
+        systemMs += Benchmark::Time(1, [&]() { system.Update(TimeStep); });
+        aloneMs += Benchmark::Time(1, [&]()
+        {
+            for (auto& waves : alone)
+            {
+                waves->Update(TimeStep);
+            }
+        });
+    }
+
+    bool passed = true;
+    for (int g = 0; g < system.Count(); ++g)
+    {
+        const Waves* shared = system.Get(g);
+        int mismatches = 0;
+        for (int i = 0; i < shared->VertexCount(); ++i)
+        {
+            const float a = shared->Height(i);
+            const float b = alone[g]->Height(i);
+            mismatches += std::memcmp(&a, &b, sizeof(float)) != 0 ? 1 : 0;
+        }
+        if (mismatches != 0)
+        {
+            passed = Benchmark::Fail("%dx%d grid: %d heights differ from stepping it alone",
+                shared->RowCount(), shared->ColumnCount(), mismatches);
+        }
+    }
+
+    Benchmark::Report("  %d grids, %d frames: WaveSystem %.3f ms/frame, one by one %.3f ms/frame\n",
+        system.Count(), Frames, systemMs/Frames, aloneMs/Frames);
+    return passed;
+}
@@ -0,0 +1,639 @@
+#include "BCDecoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <emmintrin.h>
+
+#include "TaskScheduler.h"
+
+namespace
+{
+    using uint8 = std::uint8_t;
+    using uint32 = std::uint32_t;
+    using uint64 = std::uint64_t;
+
+    // Rows of blocks handed to a worker at a time.
+    const int BlockRowGrainSize = 4;
+
+    enum BlockType
+    {
+        BlockNone,
+        BlockBC1,                       // color, 1 bit alpha
+        BlockBC2,                       // explicit 4 bit alpha + color
+        BlockBC3,                       // interpolated alpha + color
+        BlockBC4,                       // one interpolated channel
+        BlockBC5,                       // two interpolated channels
+    };
+
+    struct BlockFormat
+    {
+        BlockType Type;
+        bool IsSigned;
+    };
+
+    BlockFormat GetBlockFormat(DXGI_FORMAT format)
+    {
+        switch (format)
+        {
+        case DXGI_FORMAT_BC1_TYPELESS:
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+            return{ BlockBC1, false };
+
+        case DXGI_FORMAT_BC2_TYPELESS:
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+            return{ BlockBC2, false };
+
+        case DXGI_FORMAT_BC3_TYPELESS:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+            return{ BlockBC3, false };
+
+        case DXGI_FORMAT_BC4_TYPELESS:
+        case DXGI_FORMAT_BC4_UNORM:
+            return{ BlockBC4, false };
+        case DXGI_FORMAT_BC4_SNORM:
+            return{ BlockBC4, true };
+
+        case DXGI_FORMAT_BC5_TYPELESS:
+        case DXGI_FORMAT_BC5_UNORM:
+            return{ BlockBC5, false };
+        case DXGI_FORMAT_BC5_SNORM:
+            return{ BlockBC5, true };
+
+        default:
+            return{ BlockNone, false };
+        }
+    }
+
+    inline std::size_t BlockSize(BlockType type)
+    {
+        return type == BlockBC1 || type == BlockBC4 ? 8 : 16;
+    }
+
+    // Division rounded to the nearest, halves away from zero.
+    inline int RoundDivide(int value, int divisor)
+    {
+        return value >= 0 ? (value + divisor/2) / divisor : -((divisor/2 - value) / divisor);
+    }
+
+    inline uint32 ColorIndices(const uint8* block)
+    {
+        uint32 indices;
+        std::memcpy(&indices, block + 4, sizeof(indices));
+        return indices;
+    }
+
+    inline uint64 ChannelIndices(const uint8* block)
+    {
+        uint64 indices = 0;
+        std::memcpy(&indices, block + 2, 6);
+        return indices;
+    }
+
+    //
+    // Scalar reference, one pixel at a time.
+    //
+
+    void DecodeBlockScalar(const BlockFormat& format, const uint8* block, uint32 pixels[16])
+    {
+        const uint8* colorBlock = format.Type == BlockBC1 ? block : block + 8;
+        uint32 colors[4] = {};
+        uint32 colorIndices = 0;
+        if (format.Type <= BlockBC3)
+        {
+            BCDecoder::ColorPalette(colorBlock, format.Type != BlockBC1, colors);
+            colorIndices = ColorIndices(colorBlock);
+        }
+
+        // Red for BC4 and BC5, alpha for BC3, green for BC5.
+        const uint8* firstChannel = format.Type == BlockBC3 || format.Type == BlockBC4 || format.Type == BlockBC5 ? block : nullptr;
+        const uint8* secondChannel = format.Type == BlockBC5 ? block + 8 : nullptr;
+        uint8 firstValues[8] = {};
+        uint8 secondValues[8] = {};
+        uint64 firstIndices = 0;
+        uint64 secondIndices = 0;
+        if (firstChannel)
+        {
+            BCDecoder::ChannelPalette(firstChannel, format.IsSigned, firstValues);
+            firstIndices = ChannelIndices(firstChannel);
+        }
+        if (secondChannel)
+        {
+            BCDecoder::ChannelPalette(secondChannel, format.IsSigned, secondValues);
+            secondIndices = ChannelIndices(secondChannel);
+        }
+
+        for (int i = 0; i < 16; ++i)
+        {
+            const uint32 color = colors[(colorIndices >> 2*i) & 3];
+            const uint32 first = firstValues[(firstIndices >> 3*i) & 7];
+            const uint32 second = secondValues[(secondIndices >> 3*i) & 7];
+            switch (format.Type)
+            {
+            case BlockBC1:
+                pixels[i] = color;
+                break;
+
+            case BlockBC2:
+                pixels[i] = (color & 0x00ffffff) | (((block[i/2] >> 4*(i & 1)) & 0xf)*17) << 24;
+                break;
+
+            case BlockBC3:
+                pixels[i] = (color & 0x00ffffff) | first << 24;
+                break;
+
+            case BlockBC4:
+                pixels[i] = first | 0xff000000;
+                break;
+
+            case BlockBC5:
+                pixels[i] = first | second << 8 | 0xff000000;
+                break;
+
+            default:
+                pixels[i] = 0;
+            }
+        }
+    }
+
+    //
+    // SSE2, a row of pixels or a whole block per register.
+    //
+
+    // The sixteen 3 bit indices of a channel block in 16 bit lanes, pixels 0-7 and 8-15. Every
+    // lane gets the window holding its index, a multiply moves the index to the top and a shift
+    // back down.
+    inline void ChannelIndicesSSE2(const uint8* block, __m128i indices[2])
+    {
+        const uint64 bits = ChannelIndices(block);
+        const __m128i multipliers = _mm_setr_epi16(1 << 13, 1 << 10, 1 << 7, 1 << 4, 1 << 1, 1 << 6, 1 << 3, 1 << 0);
+        for (int i = 0; i < 2; ++i)
+        {
+            const uint32 half = static_cast<uint32>(bits >> 24*i) & 0xffffff;
+            const short window0 = static_cast<short>(half & 0xffff);
+            const short window1 = static_cast<short>(half >> 8);
+            indices[i] = _mm_srli_epi16(_mm_mullo_epi16(_mm_setr_epi16(window0, window0, window0, window0,
+                window0, window1, window1, window1), multipliers), 13);
+        }
+    }
+
+    // Sixteen values of a channel block, one per byte, the same as looking the indices up in
+    // ChannelPalette. Instead of building the palette every pixel interpolates its own value,
+    // index i >= 2 weights the endpoints by (divisor - i + 1, i - 1), in five value mode 6 and 7
+    // are the ends of the range. No interpolation falls on a half, so SNORM values can be moved
+    // to 0..254 first and rounded up like UNORM ones, the bias is one more then.
+    inline __m128i DecodeChannelSSE2(const uint8* block, bool isSigned)
+    {
+        int value0 = block[0];
+        int value1 = block[1];
+        bool sixValues = value0 > value1;
+        int maximum = 255;
+        int bias = 0;
+        if (isSigned)
+        {
+            const int signed0 = static_cast<std::int8_t>(block[0]);
+            const int signed1 = static_cast<std::int8_t>(block[1]);
+            sixValues = signed0 > signed1;
+            value0 = std::max(signed0, -127) + 127;
+            value1 = std::max(signed1, -127) + 127;
+            maximum = 254;
+            bias = 1;
+        }
+
+        // Division by 7 or 5 as a multiply with 65536/divisor rounded up, exact below 2^11.
+        const int divisor = sixValues ? 7 : 5;
+        const __m128i divisorVector = _mm_set1_epi16(static_cast<short>(divisor));
+        const __m128i reciprocal = _mm_set1_epi16(static_cast<short>(sixValues ? 9363 : 13108));
+        const __m128i rounding = _mm_set1_epi16(static_cast<short>(divisor / 2));
+        const __m128i endpoint0 = _mm_set1_epi16(static_cast<short>(value0));
+        const __m128i endpoint1 = _mm_set1_epi16(static_cast<short>(value1));
+        const __m128i rangeEnds = _mm_set1_epi16(sixValues ? 0 : -1);
+        const __m128i maximumVector = _mm_set1_epi16(static_cast<short>(maximum));
+        const __m128i biasVector = _mm_set1_epi16(static_cast<short>(bias));
+        const __m128i one = _mm_set1_epi16(1);
+
+        __m128i values[2];
+        ChannelIndicesSSE2(block, values);
+        for (int i = 0; i < 2; ++i)
+        {
+            const __m128i indices = values[i];
+            const __m128i weight1 = _mm_or_si128(_mm_subs_epu16(indices, one),
+                _mm_and_si128(_mm_cmpeq_epi16(indices, one), divisorVector));
+            const __m128i weight0 = _mm_sub_epi16(divisorVector, weight1);
+            const __m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(weight0, endpoint0),
+                _mm_mullo_epi16(weight1, endpoint1)), rounding);
+            __m128i value = _mm_mulhi_epu16(sum, reciprocal);
+
+            const __m128i six = _mm_and_si128(_mm_cmpeq_epi16(indices, _mm_set1_epi16(6)), rangeEnds);
+            const __m128i seven = _mm_and_si128(_mm_cmpeq_epi16(indices, _mm_set1_epi16(7)), rangeEnds);
+            value = _mm_or_si128(_mm_andnot_si128(_mm_or_si128(six, seven), value), _mm_and_si128(seven, maximumVector));
+            values[i] = _mm_add_epi16(value, biasVector);
+        }
+        return _mm_packus_epi16(values[0], values[1]);
+    }
+
+    // Four rows of RGBA from a color block.
+    inline void DecodeColorSSE2(const uint8* block, bool alwaysFourColors, __m128i rows[4])
+    {
+        uint32 palette[4];
+        BCDecoder::ColorPalette(block, alwaysFourColors, palette);
+        const uint32 indices = ColorIndices(block);
+
+        // Every lane keeps the bits of its own pixel and compares them with each index value.
+        const __m128i laneMask = _mm_setr_epi32(0x3, 0xc, 0x30, 0xc0);
+        const __m128i color0 = _mm_set1_epi32(static_cast<int>(palette[0]));
+        const __m128i color1 = _mm_set1_epi32(static_cast<int>(palette[1]));
+        const __m128i color2 = _mm_set1_epi32(static_cast<int>(palette[2]));
+        const __m128i color3 = _mm_set1_epi32(static_cast<int>(palette[3]));
+        for (int y = 0; y < 4; ++y)
+        {
+            const __m128i lanes = _mm_and_si128(_mm_set1_epi32(static_cast<int>(indices >> 8*y)), laneMask);
+            __m128i row = _mm_and_si128(_mm_cmpeq_epi32(lanes, _mm_setzero_si128()), color0);
+            row = _mm_or_si128(row, _mm_and_si128(_mm_cmpeq_epi32(lanes, _mm_setr_epi32(0x1, 0x4, 0x10, 0x40)), color1));
+            row = _mm_or_si128(row, _mm_and_si128(_mm_cmpeq_epi32(lanes, _mm_setr_epi32(0x2, 0x8, 0x20, 0x80)), color2));
+            row = _mm_or_si128(row, _mm_and_si128(_mm_cmpeq_epi32(lanes, laneMask), color3));
+            rows[y] = row;
+        }
+    }
+
+    // Sixteen bytes, one per pixel, moved to the alpha byte of four rows of RGBA.
+    inline void OrAlphaSSE2(__m128i alpha, __m128i rows[4])
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i colorMask = _mm_set1_epi32(0x00ffffff);
+        const __m128i low = _mm_unpacklo_epi8(zero, alpha);
+        const __m128i high = _mm_unpackhi_epi8(zero, alpha);
+        rows[0] = _mm_or_si128(_mm_and_si128(rows[0], colorMask), _mm_unpacklo_epi16(zero, low));
+        rows[1] = _mm_or_si128(_mm_and_si128(rows[1], colorMask), _mm_unpackhi_epi16(zero, low));
+        rows[2] = _mm_or_si128(_mm_and_si128(rows[2], colorMask), _mm_unpacklo_epi16(zero, high));
+        rows[3] = _mm_or_si128(_mm_and_si128(rows[3], colorMask), _mm_unpackhi_epi16(zero, high));
+    }
+
+    // Red and green bytes to four rows of (r, g, 0, 1).
+    inline void ExpandChannelsSSE2(__m128i red, __m128i green, __m128i rows[4])
+    {
+        const __m128i blueAlpha = _mm_set1_epi16(static_cast<short>(0xff00));
+        const __m128i low = _mm_unpacklo_epi8(red, green);
+        const __m128i high = _mm_unpackhi_epi8(red, green);
+        rows[0] = _mm_unpacklo_epi16(low, blueAlpha);
+        rows[1] = _mm_unpackhi_epi16(low, blueAlpha);
+        rows[2] = _mm_unpacklo_epi16(high, blueAlpha);
+        rows[3] = _mm_unpackhi_epi16(high, blueAlpha);
+    }
+
+    template<BlockType Type>
+    inline void DecodeBlockSSE2(const uint8* block, bool isSigned, __m128i rows[4])
+    {
+        switch (Type)
+        {
+        case BlockBC1:
+            DecodeColorSSE2(block, false, rows);
+            break;
+
+        case BlockBC2:
+        {
+            // Two 4 bit alphas per byte, low nibble first, spread to a byte each and scaled by 17.
+            const __m128i packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(block));
+            const __m128i nibbleMask = _mm_set1_epi8(0x0f);
+            const __m128i alpha = _mm_unpacklo_epi8(_mm_and_si128(packed, nibbleMask),
+                _mm_and_si128(_mm_srli_epi16(packed, 4), nibbleMask));
+            DecodeColorSSE2(block + 8, true, rows);
+            OrAlphaSSE2(_mm_or_si128(alpha, _mm_slli_epi16(alpha, 4)), rows);
+            break;
+        }
+
+        case BlockBC3:
+            DecodeColorSSE2(block + 8, true, rows);
+            OrAlphaSSE2(DecodeChannelSSE2(block, false), rows);
+            break;
+
+        case BlockBC4:
+            ExpandChannelsSSE2(DecodeChannelSSE2(block, isSigned), _mm_setzero_si128(), rows);
+            break;
+
+        case BlockBC5:
+            ExpandChannelsSSE2(DecodeChannelSSE2(block, isSigned), DecodeChannelSSE2(block + 8, isSigned), rows);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    // The visible part of a block, for blocks sticking out of the surface.
+    inline void CopyPartialBlock(const uint32 pixels[16], uint8* dest, std::size_t destRowPitch,
+        uint32 width, uint32 height)
+    {
+        for (uint32 y = 0; y < height; ++y)
+        {
+            std::memcpy(dest + y*destRowPitch, pixels + 4*y, 4*width);
+        }
+    }
+
+    template<BlockType Type>
+    void DecodeSurfaceSSE2(const uint8* blocks, std::size_t blockRowPitch, bool isSigned,
+        uint32 width, uint32 height, uint8* rgba, std::size_t destRowPitch)
+    {
+        const std::size_t blockSize = BlockSize(Type);
+        const uint32 blocksWide = (width + 3) / 4;
+        const uint32 blocksHigh = (height + 3) / 4;
+
+        for (uint32 by = 0; by < blocksHigh; ++by)
+        {
+            const uint8* block = blocks + by*blockRowPitch;
+            uint8* destRow = rgba + 4*by*destRowPitch;
+            const uint32 visibleHeight = std::min(height - 4*by, 4u);
+
+            for (uint32 bx = 0; bx < blocksWide; ++bx, block += blockSize)
+            {
+                __m128i rows[4];
+                DecodeBlockSSE2<Type>(block, isSigned, rows);
+
+                uint8* dest = destRow + 16*bx;
+                const uint32 visibleWidth = std::min(width - 4*bx, 4u);
+                if (visibleWidth == 4 && visibleHeight == 4)
+                {
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), rows[0]);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + destRowPitch), rows[1]);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + 2*destRowPitch), rows[2]);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + 3*destRowPitch), rows[3]);
+                }
+                else
+                {
+                    uint32 pixels[16];
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels), rows[0]);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + 4), rows[1]);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + 8), rows[2]);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + 12), rows[3]);
+                    CopyPartialBlock(pixels, dest, destRowPitch, visibleWidth, visibleHeight);
+                }
+            }
+        }
+    }
+
+    // 8 bit values to floats, SNORM channels undo the bias of 128 and clamp -128 to -1.
+    struct FloatTables
+    {
+        float Unorm[256];
+        float Snorm[256];
+
+        FloatTables()
+        {
+            for (int i = 0; i < 256; ++i)
+            {
+                Unorm[i] = i / 255.0f;
+                Snorm[i] = std::max(i - 128, -127) / 127.0f;
+            }
+        }
+    };
+
+    template<typename T>
+    bool DecodeImage(const DDSImage& image, std::vector<Surface<T>>& surfaces)
+    {
+        surfaces.clear();
+        if (!BCDecoder::IsSupported(image.Format))
+        {
+            return false;
+        }
+
+        // One job per row of blocks of every depth slice of every subresource.
+        struct RowJob
+        {
+            uint32 Subresource;
+            uint32 Slice;
+            uint32 BlockRow;
+        };
+        std::vector<RowJob> jobs;
+
+        surfaces.resize(image.Subresources.size());
+        for (std::size_t i = 0; i < image.Subresources.size(); ++i)
+        {
+            const DDSSubresource& subresource = image.Subresources[i];
+            Surface<T>& surface = surfaces[i];
+            surface.Width = subresource.Width;
+            surface.Height = subresource.Height;
+            surface.Depth = subresource.Depth;
+            surface.Pixels.resize(std::size_t(4)*subresource.Width*subresource.Height*subresource.Depth);
+
+            for (uint32 slice = 0; slice < subresource.Depth; ++slice)
+            {
+                for (uint32 row = 0; row < subresource.RowCount; ++row)
+                {
+                    jobs.push_back({ static_cast<uint32>(i), slice, row });
+                }
+            }
+        }
+
+        TaskScheduler::Get().ParallelFor(0, static_cast<int>(jobs.size()), BlockRowGrainSize, [&](int j)
+        {
+            const RowJob& job = jobs[j];
+            const DDSSubresource& subresource = image.Subresources[job.Subresource];
+            Surface<T>& surface = surfaces[job.Subresource];
+
+            const std::size_t destRowPitch = 4*sizeof(T)*surface.Width;
+            const uint8* blocks = subresource.Data + job.Slice*subresource.SlicePitch + job.BlockRow*subresource.RowPitch;
+            T* dest = surface.Pixels.data() + 4*(std::size_t(job.Slice)*surface.Height + 4*job.BlockRow)*surface.Width;
+            BCDecoder::DecodeSurface(image.Format, blocks, subresource.RowPitch, surface.Width,
+                std::min(surface.Height - 4*job.BlockRow, 4u), dest, destRowPitch);
+        });
+
+        return true;
+    }
+}
+
+bool BCDecoder::IsSupported(DXGI_FORMAT format)
+{
+    return GetBlockFormat(format).Type != BlockNone;
+}
+
+bool BCDecoder::DecodeSurface(DXGI_FORMAT format, const uint8* blocks, std::size_t blockRowPitch,
+    uint32 width, uint32 height, uint8* rgba, std::size_t destRowPitch)
+{
+    const BlockFormat blockFormat = GetBlockFormat(format);
+    switch (blockFormat.Type)
+    {
+    case BlockBC1:
+        DecodeSurfaceSSE2<BlockBC1>(blocks, blockRowPitch, blockFormat.IsSigned, width, height, rgba, destRowPitch);
+        return true;
+    case BlockBC2:
+        DecodeSurfaceSSE2<BlockBC2>(blocks, blockRowPitch, blockFormat.IsSigned, width, height, rgba, destRowPitch);
+        return true;
+    case BlockBC3:
+        DecodeSurfaceSSE2<BlockBC3>(blocks, blockRowPitch, blockFormat.IsSigned, width, height, rgba, destRowPitch);
+        return true;
+    case BlockBC4:
+        DecodeSurfaceSSE2<BlockBC4>(blocks, blockRowPitch, blockFormat.IsSigned, width, height, rgba, destRowPitch);
+        return true;
+    case BlockBC5:
+        DecodeSurfaceSSE2<BlockBC5>(blocks, blockRowPitch, blockFormat.IsSigned, width, height, rgba, destRowPitch);
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool BCDecoder::DecodeSurface(DXGI_FORMAT format, const uint8* blocks, std::size_t blockRowPitch,
+    uint32 width, uint32 height, float* rgba, std::size_t destRowPitch)
+{
+    const BlockFormat blockFormat = GetBlockFormat(format);
+    if (blockFormat.Type == BlockNone)
+    {
+        return false;
+    }
+
+    static const FloatTables tables;
+    const int signedChannels = !blockFormat.IsSigned ? 0 : blockFormat.Type == BlockBC4 ? 1 : 2;
+    const float* channelTables[4];
+    for (int c = 0; c < 4; ++c)
+    {
+        channelTables[c] = c < signedChannels ? tables.Snorm : tables.Unorm;
+    }
+
+    // A row of blocks at a time through the 8 bit decoder.
+    std::vector<uint8> rows(std::size_t(16)*width);
+    for (uint32 y = 0; y < height; y += 4)
+    {
+        const uint32 rowCount = std::min(height - y, 4u);
+        DecodeSurface(format, blocks + (y / 4)*blockRowPitch, blockRowPitch, width, rowCount, rows.data(), 4*width);
+
+        for (uint32 row = 0; row < rowCount; ++row)
+        {
+            const uint8* src = rows.data() + std::size_t(4)*width*row;
+            float* dest = reinterpret_cast<float*>(reinterpret_cast<uint8*>(rgba) + (y + row)*destRowPitch);
+            for (uint32 x = 0; x < 4*width; x += 4)
+            {
+                dest[x + 0] = channelTables[0][src[x + 0]];
+                dest[x + 1] = channelTables[1][src[x + 1]];
+                dest[x + 2] = channelTables[2][src[x + 2]];
+                dest[x + 3] = channelTables[3][src[x + 3]];
+            }
+        }
+    }
+    return true;
+}
+
+bool BCDecoder::DecodeSurfaceScalar(DXGI_FORMAT format, const uint8* blocks, std::size_t blockRowPitch,
+    uint32 width, uint32 height, uint8* rgba, std::size_t destRowPitch)
+{
+    const BlockFormat blockFormat = GetBlockFormat(format);
+    if (blockFormat.Type == BlockNone)
+    {
+        return false;
+    }
+
+    const std::size_t blockSize = BlockSize(blockFormat.Type);
+    for (uint32 by = 0; by < (height + 3) / 4; ++by)
+    {
+        for (uint32 bx = 0; bx < (width + 3) / 4; ++bx)
+        {
+            uint32 pixels[16];
+            DecodeBlockScalar(blockFormat, blocks + by*blockRowPitch + bx*blockSize, pixels);
+            CopyPartialBlock(pixels, rgba + 4*by*destRowPitch + 16*bx, destRowPitch,
+                std::min(width - 4*bx, 4u), std::min(height - 4*by, 4u));
+        }
+    }
+    return true;
+}
+
+void BCDecoder::ColorPalette(const uint8* block, bool alwaysFourColors, uint32 palette[4])
+{
+    const uint32 color0 = block[0] | block[1] << 8;
+    const uint32 color1 = block[2] | block[3] << 8;
+
+    int channels[2][3];
+    const uint32 colors[2] = { color0, color1 };
+    for (int i = 0; i < 2; ++i)
+    {
+        const uint32 r = colors[i] >> 11;
+        const uint32 g = (colors[i] >> 5) & 0x3f;
+        const uint32 b = colors[i] & 0x1f;
+        channels[i][0] = (r << 3) | (r >> 2);
+        channels[i][1] = (g << 2) | (g >> 4);
+        channels[i][2] = (b << 3) | (b >> 2);
+    }
+
+    uint32 entries[4] = { 0xff000000, 0xff000000, 0xff000000, 0xff000000 };
+    const bool fourColors = alwaysFourColors || color0 > color1;
+    for (int c = 0; c < 3; ++c)
+    {
+        const int c0 = channels[0][c];
+        const int c1 = channels[1][c];
+        entries[0] |= c0 << 8*c;
+        entries[1] |= c1 << 8*c;
+        if (fourColors)
+        {
+            entries[2] |= RoundDivide(2*c0 + c1, 3) << 8*c;
+            entries[3] |= RoundDivide(c0 + 2*c1, 3) << 8*c;
+        }
+        else
+        {
+            entries[2] |= RoundDivide(c0 + c1, 2) << 8*c;
+        }
+    }
+    if (!fourColors)
+    {
+        entries[3] = 0;
+    }
+
+    std::memcpy(palette, entries, sizeof(entries));
+}
+
+void BCDecoder::ChannelPalette(const uint8* block, bool isSigned, uint8 palette[8])
+{
+    int values[8];
+    int minimum = 0;
+    int maximum = 255;
+    bool sixValues;
+    if (isSigned)
+    {
+        // -128 is another -1.
+        const int value0 = static_cast<std::int8_t>(block[0]);
+        const int value1 = static_cast<std::int8_t>(block[1]);
+        sixValues = value0 > value1;
+        values[0] = std::max(value0, -127);
+        values[1] = std::max(value1, -127);
+        minimum = -127;
+        maximum = 127;
+    }
+    else
+    {
+        values[0] = block[0];
+        values[1] = block[1];
+        sixValues = values[0] > values[1];
+    }
+
+    if (sixValues)
+    {
+        for (int i = 1; i <= 6; ++i)
+        {
+            values[i + 1] = RoundDivide((7 - i)*values[0] + i*values[1], 7);
+        }
+    }
+    else
+    {
+        for (int i = 1; i <= 4; ++i)
+        {
+            values[i + 1] = RoundDivide((5 - i)*values[0] + i*values[1], 5);
+        }
+        values[6] = minimum;
+        values[7] = maximum;
+    }
+
+    const int bias = isSigned ? 128 : 0;
+    for (int i = 0; i < 8; ++i)
+    {
+        palette[i] = static_cast<uint8>(values[i] + bias);
+    }
+}
+
+bool BCDecoder::Decode(const DDSImage& image, std::vector<Surface<uint8>>& surfaces)
+{
+    return DecodeImage(image, surfaces);
+}
+
+bool BCDecoder::Decode(const DDSImage& image, std::vector<Surface<float>>& surfaces)
+{
+    return DecodeImage(image, surfaces);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <dxgiformat.h>
+
+#include "DDSParser.h"
+#include "Surface.h"
+
+// CPU decoding of BC1 to BC5 textures for previews, image diffs and software paths.
+// Decoded pixels follow the D3D rules: BC1 blocks with color0 <= color1 have a transparent
+// black entry, BC2 and BC3 always interpolate four colors, BC4 decodes to (r, 0, 0, 1) and BC5
+// to (r, g, 0, 1). Interpolated values are rounded to the nearest 8 bit value, the float output
+// is the 8 bit one scaled, so both agree.
+//
+// The 8 bit version stores SNORM channels biased by 128, -1 as 1, 0 as 128 and 1 as 255.
+//
+// Palettes are built per block, the SSE2 path then selects all pixels of a row of four with
+// compares instead of extracting every index, full blocks are written with one store per row.
+class BCDecoder
+{
+public:
+    using uint8 = std::uint8_t;
+    using uint32 = std::uint32_t;
+
+    static bool IsSupported(DXGI_FORMAT format);
+
+    // One width x height surface from rows of 4x4 blocks blockRowPitch bytes apart into RGBA
+    // rows destRowPitch bytes apart. False for unsupported formats.
+    static bool DecodeSurface(DXGI_FORMAT format, const uint8* blocks, std::size_t blockRowPitch,
+        uint32 width, uint32 height, uint8* rgba, std::size_t destRowPitch);
+    static bool DecodeSurface(DXGI_FORMAT format, const uint8* blocks, std::size_t blockRowPitch,
+        uint32 width, uint32 height, float* rgba, std::size_t destRowPitch);
+
+    // Same output as DecodeSurface, one pixel at a time in plain C++. Reference for the SSE2
+    // path and for measuring it.
+    static bool DecodeSurfaceScalar(DXGI_FORMAT format, const uint8* blocks, std::size_t blockRowPitch,
+        uint32 width, uint32 height, uint8* rgba, std::size_t destRowPitch);
+
+    // Every subresource of the image, surfaces[i] for image.Subresources[i]. Rows of blocks of
+    // all mips and slices are decoded in parallel, so small mips don't wait on large ones.
+    static bool Decode(const DDSImage& image, std::vector<Surface<uint8>>& surfaces);
+    static bool Decode(const DDSImage& image, std::vector<Surface<float>>& surfaces);
+
+    // Palettes as decoded, the four RGBA colors of a BC1 style color block (alwaysFourColors for
+    // BC2 and BC3) and the eight values of a channel block, SNORM ones biased by 128.
+    static void ColorPalette(const uint8* block, bool alwaysFourColors, uint32 palette[4]);
+    static void ChannelPalette(const uint8* block, bool isSigned, uint8 palette[8]);
+};
@@ -0,0 +1,869 @@
+#include "BCEncoder.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+
+#include "BCDecoder.h"
+#include "DDSParser.h"
+#include "TaskScheduler.h"
+
+namespace
+{
+    using uint8 = std::uint8_t;
+    using uint16 = std::uint16_t;
+    using uint32 = std::uint32_t;
+    using uint64 = std::uint64_t;
+
+    // Rows of blocks handed to a worker at a time, a row is slow enough on its own.
+    const int BlockRowGrainSize = 1;
+
+    // Least squares rounds and passes of single step endpoint nudging.
+    const int NormalRefinements = 1;
+    const int HighRefinements = 8;
+    const int HighNudgePasses = 2;
+
+    // Half the window searched around channel endpoints at normal and high quality.
+    const int NormalChannelRadius = 1;
+    const int HighChannelRadius = 3;
+
+    // BC1 pixels below this alpha become transparent.
+    const int AlphaThreshold = 128;
+
+    enum BlockType
+    {
+        BlockNone,
+        BlockBC1,
+        BlockBC3,
+        BlockBC4,
+        BlockBC5,
+    };
+
+    struct BlockFormat
+    {
+        BlockType Type;
+        bool IsSigned;
+    };
+
+    BlockFormat GetBlockFormat(DXGI_FORMAT format)
+    {
+        switch (format)
+        {
+        case DXGI_FORMAT_BC1_TYPELESS:
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+            return{ BlockBC1, false };
+
+        case DXGI_FORMAT_BC3_TYPELESS:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+            return{ BlockBC3, false };
+
+        case DXGI_FORMAT_BC4_TYPELESS:
+        case DXGI_FORMAT_BC4_UNORM:
+            return{ BlockBC4, false };
+        case DXGI_FORMAT_BC4_SNORM:
+            return{ BlockBC4, true };
+
+        case DXGI_FORMAT_BC5_TYPELESS:
+        case DXGI_FORMAT_BC5_UNORM:
+            return{ BlockBC5, false };
+        case DXGI_FORMAT_BC5_SNORM:
+            return{ BlockBC5, true };
+
+        default:
+            return{ BlockNone, false };
+        }
+    }
+
+    inline std::size_t BlockSize(BlockType type)
+    {
+        return type == BlockBC1 || type == BlockBC4 ? 8 : 16;
+    }
+
+    // The 4x4 pixels of a block, clamped to the surface.
+    void FetchBlock(const uint8* rgba, std::size_t rowPitch, uint32 width, uint32 height,
+        uint32 blockX, uint32 blockY, uint8 pixels[64])
+    {
+        for (uint32 y = 0; y < 4; ++y)
+        {
+            const uint8* row = rgba + std::min(4*blockY + y, height - 1)*rowPitch;
+            for (uint32 x = 0; x < 4; ++x)
+            {
+                std::memcpy(pixels + 16*y + 4*x, row + 4*std::min(4*blockX + x, width - 1), 4);
+            }
+        }
+    }
+
+    //
+    // Color blocks
+    //
+
+    // Pixels as floats in 0..255, in groups of four for SSE2 and per pixel for the least squares.
+    struct ColorBlock
+    {
+        __m128 Red[4];
+        __m128 Green[4];
+        __m128 Blue[4];
+        __m128 Opaque[4];               // all bits set for pixels that need a color
+        float Pixels[16][3];
+        bool HasTransparent;
+        bool AllTransparent;
+        bool SingleColor;               // all opaque pixels equal
+    };
+
+    struct ColorCandidate
+    {
+        uint16 Color0 = 0;
+        uint16 Color1 = 0;
+        uint32 Indices = 0;
+        float Error = FLT_MAX;
+    };
+
+    void LoadColorBlock(const uint8 pixels[64], bool punchThrough, ColorBlock& block)
+    {
+        alignas(16) float red[16];
+        alignas(16) float green[16];
+        alignas(16) float blue[16];
+        alignas(16) uint32 opaque[16];
+
+        block.HasTransparent = false;
+        block.AllTransparent = true;
+        block.SingleColor = true;
+        int firstOpaque = -1;
+        for (int i = 0; i < 16; ++i)
+        {
+            const uint8* pixel = pixels + 4*i;
+            red[i] = block.Pixels[i][0] = pixel[0];
+            green[i] = block.Pixels[i][1] = pixel[1];
+            blue[i] = block.Pixels[i][2] = pixel[2];
+
+            const bool transparent = punchThrough && pixel[3] < AlphaThreshold;
+            opaque[i] = transparent ? 0 : 0xffffffff;
+            block.HasTransparent |= transparent;
+            if (!transparent)
+            {
+                block.AllTransparent = false;
+                if (firstOpaque < 0)
+                {
+                    firstOpaque = i;
+                }
+                else if (std::memcmp(pixel, pixels + 4*firstOpaque, 3) != 0)
+                {
+                    block.SingleColor = false;
+                }
+            }
+        }
+
+        for (int group = 0; group < 4; ++group)
+        {
+            block.Red[group] = _mm_load_ps(red + 4*group);
+            block.Green[group] = _mm_load_ps(green + 4*group);
+            block.Blue[group] = _mm_load_ps(blue + 4*group);
+            block.Opaque[group] = _mm_castsi128_ps(_mm_load_si128(reinterpret_cast<const __m128i*>(opaque + 4*group)));
+        }
+    }
+
+    inline uint16 Pack565(const float color[3])
+    {
+        const int r = std::min(std::max(static_cast<int>(color[0]*31.0f/255.0f + 0.5f), 0), 31);
+        const int g = std::min(std::max(static_cast<int>(color[1]*63.0f/255.0f + 0.5f), 0), 63);
+        const int b = std::min(std::max(static_cast<int>(color[2]*31.0f/255.0f + 0.5f), 0), 31);
+        return static_cast<uint16>(r << 11 | g << 5 | b);
+    }
+
+    inline __m128 Distance(const ColorBlock& block, int group, __m128 red, __m128 green, __m128 blue)
+    {
+        const __m128 r = _mm_sub_ps(block.Red[group], red);
+        const __m128 g = _mm_sub_ps(block.Green[group], green);
+        const __m128 b = _mm_sub_ps(block.Blue[group], blue);
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, r), _mm_mul_ps(g, g)), _mm_mul_ps(b, b));
+    }
+
+    // Closest of the first count palette entries for every pixel and the summed squared error.
+    // With a transparent entry pixels that aren't opaque take entry 3 for free.
+    float FitColorIndices(const ColorBlock& block, const uint32 palette[4], int count, bool transparentEntry,
+        uint32& indices)
+    {
+        __m128 red[4];
+        __m128 green[4];
+        __m128 blue[4];
+        for (int k = 0; k < count; ++k)
+        {
+            red[k] = _mm_set1_ps(static_cast<float>(palette[k] & 0xff));
+            green[k] = _mm_set1_ps(static_cast<float>((palette[k] >> 8) & 0xff));
+            blue[k] = _mm_set1_ps(static_cast<float>((palette[k] >> 16) & 0xff));
+        }
+
+        __m128 error = _mm_setzero_ps();
+        indices = 0;
+        for (int group = 0; group < 4; ++group)
+        {
+            __m128 best = Distance(block, group, red[0], green[0], blue[0]);
+            __m128i bestIndex = _mm_setzero_si128();
+            for (int k = 1; k < count; ++k)
+            {
+                const __m128 distance = Distance(block, group, red[k], green[k], blue[k]);
+                const __m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+                best = _mm_min_ps(distance, best);
+                bestIndex = _mm_or_si128(_mm_andnot_si128(closer, bestIndex), _mm_and_si128(closer, _mm_set1_epi32(k)));
+            }
+            if (transparentEntry)
+            {
+                const __m128i opaque = _mm_castps_si128(block.Opaque[group]);
+                best = _mm_and_ps(best, block.Opaque[group]);
+                bestIndex = _mm_or_si128(_mm_and_si128(opaque, bestIndex), _mm_andnot_si128(opaque, _mm_set1_epi32(3)));
+            }
+            error = _mm_add_ps(error, best);
+
+            alignas(16) uint32 groupIndices[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(groupIndices), bestIndex);
+            for (int i = 0; i < 4; ++i)
+            {
+                indices |= groupIndices[i] << 2*(4*group + i);
+            }
+        }
+
+        alignas(16) float errors[4];
+        _mm_store_ps(errors, error);
+        return (errors[0] + errors[1]) + (errors[2] + errors[3]);
+    }
+
+    // Indices and error of a pair of endpoints, kept in best if lower. BC1 decodes color0 > color1
+    // as four colors and the rest as three colors with transparent black, the endpoints are
+    // swapped to get the asked for mode.
+    void EvaluateColors(const ColorBlock& block, uint16 color0, uint16 color1, bool alwaysFourColors,
+        bool threeColors, ColorCandidate& best)
+    {
+        if (threeColors ? color0 > color1 : color0 < color1)
+        {
+            std::swap(color0, color1);
+        }
+
+        const uint8 endpoints[4] = { static_cast<uint8>(color0), static_cast<uint8>(color0 >> 8),
+            static_cast<uint8>(color1), static_cast<uint8>(color1 >> 8) };
+        uint32 palette[4];
+        BCDecoder::ColorPalette(endpoints, alwaysFourColors, palette);
+
+        const bool threeColorMode = !alwaysFourColors && color0 <= color1;
+        if (block.HasTransparent && !threeColorMode)
+        {
+            return;
+        }
+
+        uint32 indices;
+        const float error = FitColorIndices(block, palette, threeColorMode ? 3 : 4, threeColorMode, indices);
+        if (error < best.Error)
+        {
+            best.Color0 = color0;
+            best.Color1 = color1;
+            best.Indices = indices;
+            best.Error = error;
+        }
+    }
+
+    void EvaluateColors(const ColorBlock& block, const float endpoint0[3], const float endpoint1[3],
+        bool alwaysFourColors, bool threeColors, ColorCandidate& best)
+    {
+        EvaluateColors(block, Pack565(endpoint0), Pack565(endpoint1), alwaysFourColors, threeColors, best);
+    }
+
+    // Bounding box of the opaque pixels, inset by 1/16 and flipped along the diagonal the pixels
+    // follow, red and blue against green.
+    void BoundingBoxEndpoints(const ColorBlock& block, float endpoint0[3], float endpoint1[3])
+    {
+        float minimum[3] = { 255.0f, 255.0f, 255.0f };
+        float maximum[3] = { 0.0f, 0.0f, 0.0f };
+        float mean[3] = { 0.0f, 0.0f, 0.0f };
+        int count = 0;
+        for (int i = 0; i < 16; ++i)
+        {
+            if (!block.HasTransparent || _mm_movemask_ps(block.Opaque[i / 4]) & (1 << (i % 4)))
+            {
+                for (int c = 0; c < 3; ++c)
+                {
+                    minimum[c] = std::min(minimum[c], block.Pixels[i][c]);
+                    maximum[c] = std::max(maximum[c], block.Pixels[i][c]);
+                    mean[c] += block.Pixels[i][c];
+                }
+                ++count;
+            }
+        }
+
+        float redGreen = 0.0f;
+        float blueGreen = 0.0f;
+        for (int c = 0; c < 3; ++c)
+        {
+            mean[c] /= static_cast<float>(std::max(count, 1));
+        }
+        for (int i = 0; i < 16; ++i)
+        {
+            if (!block.HasTransparent || _mm_movemask_ps(block.Opaque[i / 4]) & (1 << (i % 4)))
+            {
+                const float green = block.Pixels[i][1] - mean[1];
+                redGreen += (block.Pixels[i][0] - mean[0])*green;
+                blueGreen += (block.Pixels[i][2] - mean[2])*green;
+            }
+        }
+
+        for (int c = 0; c < 3; ++c)
+        {
+            const float inset = (maximum[c] - minimum[c]) / 16.0f;
+            endpoint0[c] = maximum[c] - inset;
+            endpoint1[c] = minimum[c] + inset;
+        }
+        if (redGreen < 0.0f)
+        {
+            std::swap(endpoint0[0], endpoint1[0]);
+        }
+        if (blueGreen < 0.0f)
+        {
+            std::swap(endpoint0[2], endpoint1[2]);
+        }
+    }
+
+    // Ends of the opaque pixels projected on their principal axis, found by power iteration on
+    // the covariance.
+    void PrincipalAxisEndpoints(const ColorBlock& block, float endpoint0[3], float endpoint1[3])
+    {
+        float mean[3] = { 0.0f, 0.0f, 0.0f };
+        int count = 0;
+        bool used[16];
+        for (int i = 0; i < 16; ++i)
+        {
+            used[i] = !block.HasTransparent || (_mm_movemask_ps(block.Opaque[i / 4]) & (1 << (i % 4))) != 0;
+            if (used[i])
+            {
+                for (int c = 0; c < 3; ++c)
+                {
+                    mean[c] += block.Pixels[i][c];
+                }
+                ++count;
+            }
+        }
+        for (int c = 0; c < 3; ++c)
+        {
+            mean[c] /= static_cast<float>(std::max(count, 1));
+        }
+
+        float covariance[6] = {};       // rr, rg, rb, gg, gb, bb
+        for (int i = 0; i < 16; ++i)
+        {
+            if (used[i])
+            {
+                const float r = block.Pixels[i][0] - mean[0];
+                const float g = block.Pixels[i][1] - mean[1];
+                const float b = block.Pixels[i][2] - mean[2];
+                covariance[0] += r*r;
+                covariance[1] += r*g;
+                covariance[2] += r*b;
+                covariance[3] += g*g;
+                covariance[4] += g*b;
+                covariance[5] += b*b;
+            }
+        }
+
+        float axis[3] = { 1.0f, 1.0f, 1.0f };
+        for (int iteration = 0; iteration < 8; ++iteration)
+        {
+            const float x = covariance[0]*axis[0] + covariance[1]*axis[1] + covariance[2]*axis[2];
+            const float y = covariance[1]*axis[0] + covariance[3]*axis[1] + covariance[4]*axis[2];
+            const float z = covariance[2]*axis[0] + covariance[4]*axis[1] + covariance[5]*axis[2];
+            const float length = std::max(std::max(std::fabs(x), std::fabs(y)), std::fabs(z));
+            if (length < FLT_MIN)
+            {
+                break;
+            }
+            axis[0] = x / length;
+            axis[1] = y / length;
+            axis[2] = z / length;
+        }
+        const float lengthSq = axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2];
+
+        float lowest = FLT_MAX;
+        float highest = -FLT_MAX;
+        for (int i = 0; i < 16; ++i)
+        {
+            if (used[i])
+            {
+                const float t = (block.Pixels[i][0] - mean[0])*axis[0] + (block.Pixels[i][1] - mean[1])*axis[1] +
+                    (block.Pixels[i][2] - mean[2])*axis[2];
+                lowest = std::min(lowest, t);
+                highest = std::max(highest, t);
+            }
+        }
+        if (count == 0 || lengthSq < FLT_MIN)
+        {
+            lowest = highest = 0.0f;
+        }
+
+        for (int c = 0; c < 3; ++c)
+        {
+            const float direction = lengthSq > FLT_MIN ? axis[c] / lengthSq : 0.0f;
+            endpoint0[c] = std::min(std::max(mean[c] + highest*direction, 0.0f), 255.0f);
+            endpoint1[c] = std::min(std::max(mean[c] + lowest*direction, 0.0f), 255.0f);
+        }
+    }
+
+    // Endpoints minimizing the squared error for the given indices, unquantized. False if the
+    // indices don't pin both down.
+    bool SolveColorEndpoints(const ColorBlock& block, uint32 indices, bool threeColorMode,
+        float endpoint0[3], float endpoint1[3])
+    {
+        // Weight of endpoint 0 for every palette entry, as BCDecoder interpolates.
+        static const float FourColorWeights[4] = { 1.0f, 0.0f, 2.0f/3.0f, 1.0f/3.0f };
+        static const float ThreeColorWeights[4] = { 1.0f, 0.0f, 0.5f, 0.0f };
+        const float* weights = threeColorMode ? ThreeColorWeights : FourColorWeights;
+
+        float aa = 0.0f;
+        float ab = 0.0f;
+        float bb = 0.0f;
+        float ax[3] = { 0.0f, 0.0f, 0.0f };
+        float bx[3] = { 0.0f, 0.0f, 0.0f };
+        for (int i = 0; i < 16; ++i)
+        {
+            const uint32 index = (indices >> 2*i) & 3;
+            if (threeColorMode && index == 3)
+            {
+                continue;
+            }
+
+            const float a = weights[index];
+            const float b = 1.0f - a;
+            aa += a*a;
+            ab += a*b;
+            bb += b*b;
+            for (int c = 0; c < 3; ++c)
+            {
+                ax[c] += a*block.Pixels[i][c];
+                bx[c] += b*block.Pixels[i][c];
+            }
+        }
+
+        const float determinant = aa*bb - ab*ab;
+        if (std::fabs(determinant) < 1e-6f)
+        {
+            return false;
+        }
+        for (int c = 0; c < 3; ++c)
+        {
+            endpoint0[c] = std::min(std::max((ax[c]*bb - bx[c]*ab) / determinant, 0.0f), 255.0f);
+            endpoint1[c] = std::min(std::max((bx[c]*aa - ax[c]*ab) / determinant, 0.0f), 255.0f);
+        }
+        return true;
+    }
+
+    // For every 8 bit value the 5 or 6 bit endpoint pair whose 2/3 : 1/3 mix decodes closest.
+    struct SingleColorTable
+    {
+        uint8 Endpoint0[256];
+        uint8 Endpoint1[256];
+
+        explicit SingleColorTable(int bits)
+        {
+            const int levels = 1 << bits;
+            for (int value = 0; value < 256; ++value)
+            {
+                int bestError = 256;
+                for (int e0 = 0; e0 < levels && bestError > 0; ++e0)
+                {
+                    for (int e1 = 0; e1 < levels; ++e1)
+                    {
+                        const int expanded0 = bits == 5 ? (e0 << 3 | e0 >> 2) : (e0 << 2 | e0 >> 4);
+                        const int expanded1 = bits == 5 ? (e1 << 3 | e1 >> 2) : (e1 << 2 | e1 >> 4);
+                        const int error = std::abs((2*expanded0 + expanded1 + 1) / 3 - value);
+                        if (error < bestError)
+                        {
+                            bestError = error;
+                            Endpoint0[value] = static_cast<uint8>(e0);
+                            Endpoint1[value] = static_cast<uint8>(e1);
+                        }
+                    }
+                }
+            }
+        }
+    };
+
+    void EncodeColorBlock(const ColorBlock& block, BCQuality quality, bool alwaysFourColors, uint8* dest)
+    {
+        ColorCandidate best;
+        const bool threeColors = block.HasTransparent;
+
+        if (block.AllTransparent)
+        {
+            best.Color0 = best.Color1 = 0;
+            best.Indices = 0xffffffff;
+        }
+        else if (block.SingleColor)
+        {
+            int first = 0;
+            while (block.HasTransparent && !(_mm_movemask_ps(block.Opaque[first / 4]) & (1 << (first % 4))))
+            {
+                ++first;
+            }
+            EvaluateColors(block, block.Pixels[first], block.Pixels[first], alwaysFourColors, threeColors, best);
+
+            if (!threeColors && quality != BCQualityFast)
+            {
+                static const SingleColorTable Table5(5);
+                static const SingleColorTable Table6(6);
+                const int r = static_cast<int>(block.Pixels[first][0]);
+                const int g = static_cast<int>(block.Pixels[first][1]);
+                const int b = static_cast<int>(block.Pixels[first][2]);
+                const uint16 color0 = static_cast<uint16>(Table5.Endpoint0[r] << 11 | Table6.Endpoint0[g] << 5 | Table5.Endpoint0[b]);
+                const uint16 color1 = static_cast<uint16>(Table5.Endpoint1[r] << 11 | Table6.Endpoint1[g] << 5 | Table5.Endpoint1[b]);
+                EvaluateColors(block, color0, color1, alwaysFourColors, false, best);
+            }
+        }
+        else
+        {
+            float endpoint0[3];
+            float endpoint1[3];
+            if (quality == BCQualityFast)
+            {
+                BoundingBoxEndpoints(block, endpoint0, endpoint1);
+            }
+            else
+            {
+                PrincipalAxisEndpoints(block, endpoint0, endpoint1);
+            }
+            EvaluateColors(block, endpoint0, endpoint1, alwaysFourColors, threeColors, best);
+
+            const int refinements = quality == BCQualityHigh ? HighRefinements : quality == BCQualityNormal ? NormalRefinements : 0;
+            for (int i = 0; i < refinements; ++i)
+            {
+                const float previousError = best.Error;
+                const bool threeColorMode = !alwaysFourColors && best.Color0 <= best.Color1;
+                if (!SolveColorEndpoints(block, best.Indices, threeColorMode, endpoint0, endpoint1))
+                {
+                    break;
+                }
+                EvaluateColors(block, endpoint0, endpoint1, alwaysFourColors, threeColors, best);
+                if (best.Error >= previousError)
+                {
+                    break;
+                }
+            }
+
+            // One 565 step on every endpoint component while that helps.
+            for (int pass = 0; quality == BCQualityHigh && pass < HighNudgePasses; ++pass)
+            {
+                const float previousError = best.Error;
+                static const int Shifts[3] = { 11, 5, 0 };
+                static const int Limits[3] = { 31, 63, 31 };
+                for (int endpoint = 0; endpoint < 2; ++endpoint)
+                {
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        for (int step = -1; step <= 1; step += 2)
+                        {
+                            uint16 colors[2] = { best.Color0, best.Color1 };
+                            const int value = ((colors[endpoint] >> Shifts[c]) & Limits[c]) + step;
+                            if (value < 0 || value > Limits[c])
+                            {
+                                continue;
+                            }
+                            colors[endpoint] = static_cast<uint16>((colors[endpoint] & ~(Limits[c] << Shifts[c])) | value << Shifts[c]);
+                            EvaluateColors(block, colors[0], colors[1], alwaysFourColors, threeColors, best);
+                        }
+                    }
+                }
+                if (best.Error >= previousError)
+                {
+                    break;
+                }
+            }
+        }
+
+        dest[0] = static_cast<uint8>(best.Color0);
+        dest[1] = static_cast<uint8>(best.Color0 >> 8);
+        dest[2] = static_cast<uint8>(best.Color1);
+        dest[3] = static_cast<uint8>(best.Color1 >> 8);
+        std::memcpy(dest + 4, &best.Indices, sizeof(best.Indices));
+    }
+
+    //
+    // Channel blocks, BC3 alpha and BC4/BC5
+    //
+
+    // Values in the 8 bit space of BCDecoder, SNORM ones biased by 128 so they run from 1 to 255.
+    struct ChannelBlock
+    {
+        __m128 Values[4];
+        int Minimum;
+        int Maximum;
+        int InnerMinimum;               // smallest above the range, -1 if none
+        int InnerMaximum;               // largest below the range
+        int Lowest;                     // bottom of the range, 0 or 1
+    };
+
+    struct ChannelCandidate
+    {
+        uint8 Endpoint0 = 0;
+        uint8 Endpoint1 = 0;
+        uint64 Indices = 0;
+        float Error = FLT_MAX;
+    };
+
+    void LoadChannelBlock(const uint8 pixels[64], int channel, bool isSigned, ChannelBlock& block)
+    {
+        alignas(16) float values[16];
+        block.Lowest = isSigned ? 1 : 0;
+        block.Minimum = 255;
+        block.Maximum = 0;
+        block.InnerMinimum = 256;
+        block.InnerMaximum = -1;
+        for (int i = 0; i < 16; ++i)
+        {
+            int value = pixels[4*i + channel];
+            if (isSigned)
+            {
+                value = (value*254 + 127) / 255 + 1;
+            }
+            values[i] = static_cast<float>(value);
+            block.Minimum = std::min(block.Minimum, value);
+            block.Maximum = std::max(block.Maximum, value);
+            if (value > block.Lowest && value < 255)
+            {
+                block.InnerMinimum = std::min(block.InnerMinimum, value);
+                block.InnerMaximum = std::max(block.InnerMaximum, value);
+            }
+        }
+        if (block.InnerMaximum < 0)
+        {
+            block.InnerMinimum = -1;
+        }
+
+        for (int group = 0; group < 4; ++group)
+        {
+            block.Values[group] = _mm_load_ps(values + 4*group);
+        }
+    }
+
+    // Closest of the eight palette entries for every value and the summed squared error.
+    float FitChannelIndices(const ChannelBlock& block, const uint8 palette[8], uint64& indices)
+    {
+        __m128 entries[8];
+        for (int k = 0; k < 8; ++k)
+        {
+            entries[k] = _mm_set1_ps(static_cast<float>(palette[k]));
+        }
+
+        __m128 error = _mm_setzero_ps();
+        indices = 0;
+        for (int group = 0; group < 4; ++group)
+        {
+            const __m128 values = block.Values[group];
+            __m128 difference = _mm_sub_ps(values, entries[0]);
+            __m128 best = _mm_mul_ps(difference, difference);
+            __m128i bestIndex = _mm_setzero_si128();
+            for (int k = 1; k < 8; ++k)
+            {
+                difference = _mm_sub_ps(values, entries[k]);
+                const __m128 distance = _mm_mul_ps(difference, difference);
+                const __m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+                best = _mm_min_ps(distance, best);
+                bestIndex = _mm_or_si128(_mm_andnot_si128(closer, bestIndex), _mm_and_si128(closer, _mm_set1_epi32(k)));
+            }
+            error = _mm_add_ps(error, best);
+
+            alignas(16) uint32 groupIndices[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(groupIndices), bestIndex);
+            for (int i = 0; i < 4; ++i)
+            {
+                indices |= uint64(groupIndices[i]) << 3*(4*group + i);
+            }
+        }
+
+        alignas(16) float errors[4];
+        _mm_store_ps(errors, error);
+        return (errors[0] + errors[1]) + (errors[2] + errors[3]);
+    }
+
+    // value0 > value1 gives the eight value mode, the rest six values plus both ends of the range.
+    void EvaluateChannel(const ChannelBlock& block, int value0, int value1, bool isSigned, ChannelCandidate& best)
+    {
+        value0 = std::min(std::max(value0, block.Lowest), 255);
+        value1 = std::min(std::max(value1, block.Lowest), 255);
+
+        const uint8 endpoints[2] =
+        {
+            static_cast<uint8>(isSigned ? value0 - 128 : value0),
+            static_cast<uint8>(isSigned ? value1 - 128 : value1),
+        };
+        uint8 palette[8];
+        BCDecoder::ChannelPalette(endpoints, isSigned, palette);
+
+        uint64 indices;
+        const float error = FitChannelIndices(block, palette, indices);
+        if (error < best.Error)
+        {
+            best.Endpoint0 = endpoints[0];
+            best.Endpoint1 = endpoints[1];
+            best.Indices = indices;
+            best.Error = error;
+        }
+    }
+
+    void EncodeChannelBlock(const ChannelBlock& block, BCQuality quality, bool isSigned, uint8* dest)
+    {
+        ChannelCandidate best;
+        EvaluateChannel(block, block.Maximum, block.Minimum, isSigned, best);
+
+        const bool hasInner = block.InnerMinimum >= 0;
+        const int radius = quality == BCQualityHigh ? HighChannelRadius : quality == BCQualityNormal ? NormalChannelRadius : 0;
+        if (radius > 0 && hasInner)
+        {
+            EvaluateChannel(block, block.InnerMinimum, block.InnerMaximum, isSigned, best);
+        }
+
+        for (int step0 = -radius; step0 <= radius && block.Minimum != block.Maximum; ++step0)
+        {
+            for (int step1 = -radius; step1 <= radius; ++step1)
+            {
+                EvaluateChannel(block, block.Maximum + step0, block.Minimum + step1, isSigned, best);
+                if (hasInner && quality == BCQualityHigh)
+                {
+                    EvaluateChannel(block, block.InnerMinimum + step0, block.InnerMaximum + step1, isSigned, best);
+                }
+            }
+        }
+
+        dest[0] = best.Endpoint0;
+        dest[1] = best.Endpoint1;
+        for (int i = 0; i < 6; ++i)
+        {
+            dest[2 + i] = static_cast<uint8>(best.Indices >> 8*i);
+        }
+    }
+
+    void EncodeBlock(const BlockFormat& format, BCQuality quality, const uint8 pixels[64], uint8* dest)
+    {
+        switch (format.Type)
+        {
+        case BlockBC1:
+        {
+            ColorBlock block;
+            LoadColorBlock(pixels, true, block);
+            EncodeColorBlock(block, quality, false, dest);
+            break;
+        }
+
+        case BlockBC3:
+        {
+            ChannelBlock alpha;
+            LoadChannelBlock(pixels, 3, false, alpha);
+            EncodeChannelBlock(alpha, quality, false, dest);
+
+            ColorBlock block;
+            LoadColorBlock(pixels, false, block);
+            EncodeColorBlock(block, quality, true, dest + 8);
+            break;
+        }
+
+        case BlockBC4:
+        case BlockBC5:
+        {
+            ChannelBlock red;
+            LoadChannelBlock(pixels, 0, format.IsSigned, red);
+            EncodeChannelBlock(red, quality, format.IsSigned, dest);
+            if (format.Type == BlockBC5)
+            {
+                ChannelBlock green;
+                LoadChannelBlock(pixels, 1, format.IsSigned, green);
+                EncodeChannelBlock(green, quality, format.IsSigned, dest + 8);
+            }
+            break;
+        }
+
+        default:
+            break;
+        }
+    }
+}
+
+bool BCEncoder::IsSupported(DXGI_FORMAT format)
+{
+    return GetBlockFormat(format).Type != BlockNone;
+}
+
+bool BCEncoder::EncodeSurface(DXGI_FORMAT format, BCQuality quality, const uint8* rgba, std::size_t rowPitch,
+    uint32 width, uint32 height, uint8* blocks, std::size_t blockRowPitch)
+{
+    const BlockFormat blockFormat = GetBlockFormat(format);
+    if (blockFormat.Type == BlockNone)
+    {
+        return false;
+    }
+
+    const std::size_t blockSize = BlockSize(blockFormat.Type);
+    for (uint32 by = 0; by < (height + 3) / 4; ++by)
+    {
+        for (uint32 bx = 0; bx < (width + 3) / 4; ++bx)
+        {
+            uint8 pixels[64];
+            FetchBlock(rgba, rowPitch, width, height, bx, by, pixels);
+            EncodeBlock(blockFormat, quality, pixels, blocks + by*blockRowPitch + bx*blockSize);
+        }
+    }
+    return true;
+}
+
+bool BCEncoder::Encode(DXGI_FORMAT format, BCQuality quality, const std::vector<Surface<uint8>>& surfaces,
+    std::vector<std::vector<uint8>>& encoded)
+{
+    encoded.clear();
+    if (!IsSupported(format))
+    {
+        return false;
+    }
+
+    // One job per row of blocks of every depth slice of every surface.
+    struct RowJob
+    {
+        uint32 Surface;
+        uint32 Slice;
+        uint32 BlockRow;
+    };
+    std::vector<RowJob> jobs;
+    std::vector<std::size_t> rowPitches(surfaces.size());
+    std::vector<std::size_t> slicePitches(surfaces.size());
+
+    encoded.resize(surfaces.size());
+    for (std::size_t i = 0; i < surfaces.size(); ++i)
+    {
+        const Surface<uint8>& surface = surfaces[i];
+        if (surface.Width == 0 || surface.Height == 0)
+        {
+            continue;
+        }
+
+        std::size_t rowCount;
+        DDSParser::GetSurfaceInfo(surface.Width, surface.Height, format, &slicePitches[i], &rowPitches[i], &rowCount);
+        encoded[i].resize(slicePitches[i]*surface.Depth);
+
+        for (uint32 slice = 0; slice < surface.Depth; ++slice)
+        {
+            for (uint32 row = 0; row < rowCount; ++row)
+            {
+                jobs.push_back({ static_cast<uint32>(i), slice, row });
+            }
+        }
+    }
+
+    TaskScheduler::Get().ParallelFor(0, static_cast<int>(jobs.size()), BlockRowGrainSize, [&](int j)
+    {
+        const RowJob& job = jobs[j];
+        const Surface<uint8>& surface = surfaces[job.Surface];
+
+        const std::size_t rowPitch = std::size_t(4)*surface.Width;
+        const uint8* rgba = surface.Pixels.data() + (std::size_t(job.Slice)*surface.Height + 4*job.BlockRow)*rowPitch;
+        uint8* blocks = encoded[job.Surface].data() + job.Slice*slicePitches[job.Surface] + job.BlockRow*rowPitches[job.Surface];
+        EncodeSurface(format, quality, rgba, rowPitch, surface.Width, std::min(surface.Height - 4*job.BlockRow, 4u),
+            blocks, rowPitches[job.Surface]);
+    });
+
+    return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <dxgiformat.h>
+
+#include "Surface.h"
+
+enum BCQuality
+{
+    BCQualityFast,
+    BCQualityNormal,
+    BCQualityHigh,
+};
+
+// Block compression of RGBA8 images to BC1, BC3, BC4 and BC5 for the asset pipeline.
+//   Fast     color endpoints from the bounding box of the block, channel endpoints from the
+//            smallest and largest value.
+//   Normal   color endpoints from the ends of the principal axis, refined once by least squares
+//            on the chosen indices. Channel blocks search one step around both endpoints and
+//            try the six value mode, whose 0 and 255 entries leave the interpolation to the
+//            values in between.
+//   High     least squares until it stops improving, then every endpoint component is nudged
+//            by one step while that lowers the error. Channel blocks search three steps around
+//            both endpoints in both modes.
+// Candidates are compared by their squared error against the palette BCDecoder decodes, all
+// sixteen pixels of a block at once with SSE2.
+//
+// BC1 blocks with pixels below half alpha use the three color mode, whose fourth entry is
+// transparent black. BC4 stores red, BC5 red and green, the SNORM variants map 0..255 to -1..1.
+class BCEncoder
+{
+public:
+    using uint8 = std::uint8_t;
+    using uint32 = std::uint32_t;
+
+    static bool IsSupported(DXGI_FORMAT format);
+
+    // A width x height surface of RGBA rows rowPitch bytes apart to rows of blocks blockRowPitch
+    // bytes apart. Blocks sticking out of the surface repeat its last row and column.
+    static bool EncodeSurface(DXGI_FORMAT format, BCQuality quality, const uint8* rgba, std::size_t rowPitch,
+        uint32 width, uint32 height, uint8* blocks, std::size_t blockRowPitch);
+
+    // Every surface (a mip chain, array slices) to its block data, depth slices one after the
+    // other with DDS pitches. Rows of blocks of all surfaces are encoded in parallel.
+    static bool Encode(DXGI_FORMAT format, BCQuality quality, const std::vector<Surface<uint8>>& surfaces,
+        std::vector<std::vector<uint8>>& encoded);
+};
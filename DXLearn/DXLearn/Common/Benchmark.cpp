@@ -0,0 +1,85 @@
+#include "Benchmark.h"
+
+#include <cstdarg>
+#include <cstdio>
+
+Benchmark::Registrar::Registrar(const char* name, Function function)
+{
+    Entry entry;
+    entry.Name = name;
+    entry.Run = function;
+    Entries().push_back(entry);
+}
+
+std::vector<Benchmark::Entry>& Benchmark::Entries()
+{
+    static std::vector<Entry> entries;
+    return entries;
+}
+
+int Benchmark::RunCommandLine(int argc, wchar_t** argv)
+{
+    std::vector<std::string> names;
+    for (int i = 0; i < argc; ++i)
+    {
+        // Benchmark names are plain ASCII.
+        std::string name;
+        for (const wchar_t* c = argv[i]; *c; ++c)
+        {
+            name += static_cast<char>(*c);
+        }
+        names.push_back(name);
+    }
+
+    int failed = 0;
+    int run = 0;
+    for (const Entry& entry : Entries())
+    {
+        if (!names.empty() && std::find(names.begin(), names.end(), entry.Name) == names.end())
+        {
+            continue;
+        }
+
+        Report("== %s\n", entry.Name.c_str());
+        ++run;
+        if (!entry.Run())
+        {
+            Report("FAILED %s\n", entry.Name.c_str());
+            ++failed;
+        }
+    }
+
+    if (run == 0)
+    {
+        Report("No benchmark matches, available:\n");
+        for (const Entry& entry : Entries())
+        {
+            Report("  %s\n", entry.Name.c_str());
+        }
+        return 1;
+    }
+
+    Report("%d of %d passed\n", run - failed, run);
+    return failed;
+}
+
+void Benchmark::Report(const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    std::vfprintf(stdout, format, args);
+    va_end(args);
+    std::fflush(stdout);
+}
+
+bool Benchmark::Fail(const char* format, ...)
+{
+    std::fputs("  check failed: ", stdout);
+    va_list args;
+    va_start(args, format);
+    std::vfprintf(stdout, format, args);
+    va_end(args);
+    std::fputc('\n', stdout);
+    std::fflush(stdout);
+    return false;
+}
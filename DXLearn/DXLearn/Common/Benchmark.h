@@ -0,0 +1,67 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Headless checks and benchmarks, run instead of the app as
+//
+//   DXLearn.exe -bench [name ...]
+//
+// Without names every registered benchmark runs. Each one prints its timings and returns
+// false when one of its correctness checks fails, the exit code is the number of failures.
+// Benchmarks live in Benchmarks/ and register themselves with BENCHMARK(name).
+class Benchmark
+{
+public:
+    using Function = bool(*)();
+
+    struct Registrar
+    {
+        Registrar(const char* name, Function function);
+    };
+
+    static int RunCommandLine(int argc, wchar_t** argv);
+
+    // Best of runs calls of body, in milliseconds.
+    template<typename Body>
+    static double Time(int runs, const Body& body);
+
+    // printf to stdout, flushed so the output survives a crash in the next benchmark.
+    static void Report(const char* format, ...);
+
+    // Reports a failed check and returns false, for `return Benchmark::Fail(...)`.
+    static bool Fail(const char* format, ...);
+
+private:
+    struct Entry
+    {
+        std::string Name;
+        Function Run = nullptr;
+    };
+
+    // Function local so registrars in other translation units can't run before it exists.
+    static std::vector<Entry>& Entries();
+};
+
+#define BENCHMARK(name) \
+    static bool name##Benchmark(); \
+    static const Benchmark::Registrar name##Registrar(#name, &name##Benchmark); \
+    static bool name##Benchmark()
+
+template<typename Body>
+double Benchmark::Time(int runs, const Body& body)
+{
+    using Clock = std::chrono::steady_clock;
+
+    double best = 0.0;
+    for (int run = 0; run < runs; ++run)
+    {
+        const auto start = Clock::now();
+        body();
+        const double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        best = run == 0 ? elapsed : std::min(best, elapsed);
+    }
+    return best;
+}
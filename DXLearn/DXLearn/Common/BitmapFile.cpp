@@ -0,0 +1,230 @@
+#include "BitmapFile.h"
+
+#include "MappedFile.h"
+
+namespace
+{
+    using int32 = std::int32_t;
+    using uint8 = std::uint8_t;
+    using uint16 = std::uint16_t;
+    using uint32 = std::uint32_t;
+    using uint64 = std::uint64_t;
+
+    const uint16 BitmapMagic = 0x4D42;      // "BM"
+
+    const uint32 BitmapFileHeaderSize = 14;
+    const uint32 BitmapInfoHeaderSize = 40;
+
+    // Same values as the BI_ constants of wingdi.h.
+    const uint32 CompressionRGB = 0;
+    const uint32 CompressionBitFields = 3;
+    const uint32 CompressionAlphaBitFields = 6;
+
+    // Larger images are rejected rather than trusted with an allocation.
+    const uint32 MaxDimension = 16384;
+
+    // Little endian reads at any alignment.
+    inline uint16 Read16(const uint8* p)
+    {
+        return static_cast<uint16>(p[0] | p[1] << 8);
+    }
+
+    inline uint32 Read32(const uint8* p)
+    {
+        return uint32(p[0]) | uint32(p[1]) << 8 | uint32(p[2]) << 16 | uint32(p[3]) << 24;
+    }
+
+    // A channel of a bit field pixel, scaled to 8 bits.
+    struct Channel
+    {
+        uint32 Mask = 0;
+        uint32 Shift = 0;
+        uint32 Max = 0;
+
+        explicit Channel(uint32 mask = 0) : Mask(mask)
+        {
+            if (mask != 0)
+            {
+                while (!(mask & 1))
+                {
+                    mask >>= 1;
+                    ++Shift;
+                }
+                Max = mask;
+            }
+        }
+
+        uint8 Extract(uint32 pixel, uint8 missing)const
+        {
+            if (Mask == 0)
+            {
+                return missing;
+            }
+            const uint32 value = (pixel & Mask) >> Shift;
+            return static_cast<uint8>(Max == 255 ? value : (uint64(value)*255 + Max/2) / Max);
+        }
+    };
+}
+
+bool BitmapFile::Load(const std::wstring& path, Surface<uint8>& surface)
+{
+    MappedFile file;
+    if (!file.Open(path))
+    {
+        surface = Surface<uint8>();
+        return false;
+    }
+
+    return Parse(file.Data(), file.Size(), surface);
+}
+
+bool BitmapFile::Parse(const void* data, std::size_t size, Surface<uint8>& surface)
+{
+    surface = Surface<uint8>();
+
+    const uint8* bytes = static_cast<const uint8*>(data);
+    if (size < BitmapFileHeaderSize + BitmapInfoHeaderSize || Read16(bytes) != BitmapMagic)
+    {
+        return false;
+    }
+
+    const uint32 pixelOffset = Read32(bytes + 10);
+    const uint8* info = bytes + BitmapFileHeaderSize;
+    const uint32 infoSize = Read32(info);
+    if (infoSize < BitmapInfoHeaderSize || infoSize > size - BitmapFileHeaderSize)
+    {
+        return false;
+    }
+
+    const int32 width = static_cast<int32>(Read32(info + 4));
+    const int32 height = static_cast<int32>(Read32(info + 8));
+    const uint32 bitCount = Read16(info + 14);
+    const uint32 compression = Read32(info + 16);
+    const uint32 paletteSize = Read32(info + 32);
+
+    const bool topDown = height < 0;
+    const uint32 rows = topDown ? 0u - static_cast<uint32>(height) : static_cast<uint32>(height);
+    if (width <= 0 || rows == 0 || static_cast<uint32>(width) > MaxDimension || rows > MaxDimension)
+    {
+        return false;
+    }
+    const uint32 columns = static_cast<uint32>(width);
+
+    // Masks follow a plain info header and are part of the larger ones.
+    Channel red;
+    Channel green;
+    Channel blue;
+    Channel alpha;
+    bool hasMasks = false;
+    bool alphaFromData = false;
+    if (compression == CompressionBitFields || compression == CompressionAlphaBitFields)
+    {
+        const uint32 maskBytes = compression == CompressionAlphaBitFields ? 16 : 12;
+        const uint8* masks = info + BitmapInfoHeaderSize;
+        if ((bitCount != 16 && bitCount != 32) ||
+            uint64(BitmapFileHeaderSize) + BitmapInfoHeaderSize + maskBytes > size)
+        {
+            return false;
+        }
+        red = Channel(Read32(masks));
+        green = Channel(Read32(masks + 4));
+        blue = Channel(Read32(masks + 8));
+        if (maskBytes == 16 || infoSize >= BitmapInfoHeaderSize + 16)
+        {
+            alpha = Channel(Read32(masks + 12));
+        }
+        hasMasks = true;
+    }
+    else if (compression == CompressionRGB)
+    {
+        switch (bitCount)
+        {
+        case 16:
+            red = Channel(0x7c00);
+            green = Channel(0x03e0);
+            blue = Channel(0x001f);
+            hasMasks = true;
+            break;
+        case 32:
+            alphaFromData = true;
+            break;
+        case 8:
+        case 24:
+            break;
+        default:
+            return false;
+        }
+    }
+    else
+    {
+        return false;
+    }
+
+    // 8 bit images index a BGRX palette right after the headers.
+    const uint8* palette = nullptr;
+    uint32 paletteCount = 0;
+    if (bitCount == 8)
+    {
+        paletteCount = paletteSize == 0 || paletteSize > 256 ? 256 : paletteSize;
+        const uint64 paletteOffset = uint64(BitmapFileHeaderSize) + infoSize;
+        if (paletteOffset + uint64(paletteCount)*4 > size)
+        {
+            return false;
+        }
+        palette = bytes + paletteOffset;
+    }
+
+    const uint64 stride = (uint64(columns)*bitCount + 31) / 32*4;
+    if (pixelOffset > size || stride*rows > size - pixelOffset)
+    {
+        return false;
+    }
+
+    surface.Width = columns;
+    surface.Height = rows;
+    surface.Pixels.resize(std::size_t(4)*columns*rows);
+
+    bool anyAlpha = false;
+    for (uint32 y = 0; y < rows; ++y)
+    {
+        const uint8* src = bytes + pixelOffset + stride*(topDown ? y : rows - 1 - y);
+        uint8* dest = surface.Pixels.data() + std::size_t(4)*columns*y;
+        for (uint32 x = 0; x < columns; ++x, dest += 4)
+        {
+            if (hasMasks)
+            {
+                const uint32 pixel = bitCount == 16 ? Read16(src + 2*x) : Read32(src + 4*x);
+                dest[0] = red.Extract(pixel, 0);
+                dest[1] = green.Extract(pixel, 0);
+                dest[2] = blue.Extract(pixel, 0);
+                dest[3] = alpha.Extract(pixel, 255);
+            }
+            else if (bitCount == 8)
+            {
+                const uint8* entry = palette + 4*(src[x] < paletteCount ? src[x] : 0);
+                dest[0] = entry[2];
+                dest[1] = entry[1];
+                dest[2] = entry[0];
+                dest[3] = 255;
+            }
+            else
+            {
+                const uint8* pixel = src + x*(bitCount / 8);
+                dest[0] = pixel[2];
+                dest[1] = pixel[1];
+                dest[2] = pixel[0];
+                dest[3] = alphaFromData ? pixel[3] : 255;
+                anyAlpha |= alphaFromData && pixel[3] != 0;
+            }
+        }
+    }
+
+    if (alphaFromData && !anyAlpha)
+    {
+        for (std::size_t i = 3; i < surface.Pixels.size(); i += 4)
+        {
+            surface.Pixels[i] = 255;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "Surface.h"
+
+// Reader of uncompressed Windows bitmaps, the source images of the texture pipeline. Handles
+// 8 bit palettized, 24 bit and 16/32 bit images with or without bit field masks, bottom-up
+// or top-down. Pixels come out as top-down RGBA. The fourth byte of a 32 bit BI_RGB image is
+// taken as alpha unless it is zero everywhere, as most writers leave it.
+class BitmapFile
+{
+public:
+    // False if the file is missing, malformed or RLE compressed, the surface is left empty then.
+    static bool Load(const std::wstring& path, Surface<std::uint8_t>& surface);
+
+    // Same for a file already in memory.
+    static bool Parse(const void* data, std::size_t size, Surface<std::uint8_t>& surface);
+};
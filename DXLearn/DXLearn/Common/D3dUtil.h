@@ -1,4 +1,5 @@
 ﻿#pragma once
+#include <climits>
 #include <string>
 #include <windows.h>
 #include <wrl.h>
@@ -12,6 +13,7 @@
 #include <fstream>
 
 #include "MathHelper.h"
+#include "MeshletBuilder.h"
 
 constexpr int gNumFrameResources = 3;
 
@@ -72,8 +74,55 @@ public:
     UINT BaseVertexLocation = 0;
 
     DirectX::BoundingBox Bounds;
+
+    // How far a simplified level may be from the full mesh, in mesh units. 0 at full detail.
+    float GeometricError = 0.0f;
+
+    // Mesh units one unit of texture coordinates covers, on average over the surface. 0 if
+    // unknown. Textures are streamed in at the mip this puts on the screen.
+    float TexCoordExtent = 0.0f;
+
+    // Bounds and TexCoordExtent from the triangles of the submesh, vertices have Pos and TexC.
+    template<typename TVertex, typename TIndex>
+    void ComputeExtents(const TVertex* vertices, const TIndex* indices);
 };
 
+template<typename TVertex, typename TIndex>
+void SubMeshGeometry::ComputeExtents(const TVertex* vertices, const TIndex* indices)
+{
+    using namespace DirectX;
+
+    if (IndexCount < 3)
+    {
+        return;
+    }
+
+    XMVECTOR minPoint = XMVectorReplicate(FLT_MAX);
+    XMVECTOR maxPoint = XMVectorReplicate(-FLT_MAX);
+    float area = 0.0f;
+    float texCoordArea = 0.0f;
+    for (UINT i = 0; i + 2 < IndexCount; i += 3)
+    {
+        XMVECTOR p[3];
+        XMVECTOR t[3];
+        for (UINT k = 0; k < 3; ++k)
+        {
+            const TVertex& v = vertices[BaseVertexLocation + static_cast<UINT>(indices[StartIndexLocation + i + k])];
+            p[k] = XMLoadFloat3(&v.Pos);
+            t[k] = XMLoadFloat2(&v.TexC);
+            minPoint = XMVectorMin(minPoint, p[k]);
+            maxPoint = XMVectorMax(maxPoint, p[k]);
+        }
+
+        // Both doubled, the ratio is the same.
+        area += XMVectorGetX(XMVector3Length(XMVector3Cross(p[1] - p[0], p[2] - p[0])));
+        texCoordArea += fabsf(XMVectorGetX(XMVector2Cross(t[1] - t[0], t[2] - t[0])));
+    }
+
+    BoundingBox::CreateFromPoints(Bounds, minPoint, maxPoint);
+    TexCoordExtent = texCoordArea > 0.0f ? sqrtf(area/texCoordArea) : 0.0f;
+}
+
 class MeshGeometry
 {
 public:
@@ -97,6 +146,10 @@ public:
     // Use this container to define the submesh geometry so we can draw teh submesh individualy
     std::unordered_map<std::string, SubMeshGeometry> DrawArgs;
 
+    // Optional cluster split of a submesh, keyed like DrawArgs. Meshlet triangle offsets are
+    // relative to the submesh's StartIndexLocation.
+    std::unordered_map<std::string, MeshletGeometry> MeshletArgs;
+
     D3D12_VERTEX_BUFFER_VIEW VertexBufferView() const
     {
         D3D12_VERTEX_BUFFER_VIEW vbv;
@@ -170,6 +223,10 @@ struct Material
 	// Index into SRV heap for normal texture.
 	int NormalSrvHeapIndex = -1;
 
+	// Mip of the diffuse texture the material is seen at this frame, the finest of all the
+	// items drawn with it. Asked for from the texture streamer.
+	float RequestedLod = 0.0f;
+
 	// Dirty flag indicating the material has changed and we need to update the constant buffer.
 	// Because we have a material constant buffer for each FrameResource, we have to apply the
 	// update to each FrameResource.  Thus, when we modify a material we should set 
@@ -192,6 +249,10 @@ struct Texture
 
 	Microsoft::WRL::ComPtr<ID3D12Resource> Resource = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12Resource> UploadHeap = nullptr;
+
+	// Index of a streamed texture in its TextureStreamer, which owns its resource. UINT_MAX
+	// until it is added.
+	UINT StreamerIndex = UINT_MAX;
 };
 
 class LandUtil
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <dxgiformat.h>
+
+#include "MappedFile.h"
+
+//--------------------------------------------------------------------------------------
+// DDS file structure definitions
+//
+// See DDS.h in the 'Texconv' sample and the 'DirectXTex' library
+//--------------------------------------------------------------------------------------
+#ifndef MAKEFOURCC
+    #define MAKEFOURCC(ch0, ch1, ch2, ch3)                              \
+                ((uint32_t)(uint8_t)(ch0) | ((uint32_t)(uint8_t)(ch1) << 8) |       \
+                ((uint32_t)(uint8_t)(ch2) << 16) | ((uint32_t)(uint8_t)(ch3) << 24 ))
+#endif /* defined(MAKEFOURCC) */
+
+#pragma pack(push,1)
+
+const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+
+struct DDS_PIXELFORMAT
+{
+    uint32_t    size;
+    uint32_t    flags;
+    uint32_t    fourCC;
+    uint32_t    RGBBitCount;
+    uint32_t    RBitMask;
+    uint32_t    GBitMask;
+    uint32_t    BBitMask;
+    uint32_t    ABitMask;
+};
+
+#define DDS_FOURCC      0x00000004  // DDPF_FOURCC
+#define DDS_RGB         0x00000040  // DDPF_RGB
+#define DDS_LUMINANCE   0x00020000  // DDPF_LUMINANCE
+#define DDS_ALPHA       0x00000002  // DDPF_ALPHA
+
+#define DDS_HEADER_FLAGS_VOLUME         0x00800000  // DDSD_DEPTH
+
+#define DDS_HEIGHT 0x00000002 // DDSD_HEIGHT
+#define DDS_WIDTH  0x00000004 // DDSD_WIDTH
+
+#define DDS_CUBEMAP_POSITIVEX 0x00000600 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEX
+#define DDS_CUBEMAP_NEGATIVEX 0x00000a00 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEX
+#define DDS_CUBEMAP_POSITIVEY 0x00001200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEY
+#define DDS_CUBEMAP_NEGATIVEY 0x00002200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEY
+#define DDS_CUBEMAP_POSITIVEZ 0x00004200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEZ
+#define DDS_CUBEMAP_NEGATIVEZ 0x00008200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEZ
+
+#define DDS_CUBEMAP_ALLFACES ( DDS_CUBEMAP_POSITIVEX | DDS_CUBEMAP_NEGATIVEX |\
+                               DDS_CUBEMAP_POSITIVEY | DDS_CUBEMAP_NEGATIVEY |\
+                               DDS_CUBEMAP_POSITIVEZ | DDS_CUBEMAP_NEGATIVEZ )
+
+#define DDS_CUBEMAP 0x00000200 // DDSCAPS2_CUBEMAP
+
+enum DDS_MISC_FLAGS2
+{
+    DDS_MISC_FLAGS2_ALPHA_MODE_MASK = 0x7L,
+};
+
+struct DDS_HEADER
+{
+    uint32_t        size;
+    uint32_t        flags;
+    uint32_t        height;
+    uint32_t        width;
+    uint32_t        pitchOrLinearSize;
+    uint32_t        depth; // only if DDS_HEADER_FLAGS_VOLUME is set in flags
+    uint32_t        mipMapCount;
+    uint32_t        reserved1[11];
+    DDS_PIXELFORMAT ddspf;
+    uint32_t        caps;
+    uint32_t        caps2;
+    uint32_t        caps3;
+    uint32_t        caps4;
+    uint32_t        reserved2;
+};
+
+struct DDS_HEADER_DXT10
+{
+    DXGI_FORMAT     dxgiFormat;
+    uint32_t        resourceDimension;
+    uint32_t        miscFlag; // see D3D11_RESOURCE_MISC_FLAG
+    uint32_t        arraySize;
+    uint32_t        miscFlags2;
+};
+
+#pragma pack(pop)
+
+// Same values as D3D11_RESOURCE_DIMENSION and D3D12_RESOURCE_DIMENSION.
+enum DDSDimension : std::uint32_t
+{
+    DDSDimensionTexture1D = 2,
+    DDSDimensionTexture2D = 3,
+    DDSDimensionTexture3D = 4,
+};
+
+// Same values as DirectX::DDS_ALPHA_MODE.
+enum DDSAlphaMode : std::uint32_t
+{
+    DDSAlphaModeUnknown       = 0,
+    DDSAlphaModeStraight      = 1,
+    DDSAlphaModePremultiplied = 2,
+    DDSAlphaModeOpaque        = 3,
+    DDSAlphaModeCustom        = 4,
+};
+
+// One mip level of one array slice (or cube face), all depth slices of a volume included.
+struct DDSSubresource
+{
+    const std::uint8_t* Data = nullptr; // into the parsed memory
+    std::size_t RowPitch = 0;           // bytes per row of pixels or of 4x4 blocks
+    std::size_t SlicePitch = 0;         // bytes per depth slice
+    std::size_t RowCount = 0;           // rows of RowPitch bytes in a slice
+    std::uint32_t Width = 0;
+    std::uint32_t Height = 0;
+    std::uint32_t Depth = 0;
+};
+
+struct DDSImage
+{
+    DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+    DDSDimension Dimension = DDSDimensionTexture2D;
+    DDSAlphaMode AlphaMode = DDSAlphaModeUnknown;
+    bool IsCubeMap = false;
+
+    // Size of mip 0.
+    std::uint32_t Width = 0;
+    std::uint32_t Height = 0;
+    std::uint32_t Depth = 0;
+
+    std::uint32_t MipCount = 0;
+    std::uint32_t ArraySize = 0;        // six per cube for cube maps
+
+    // ArraySize*MipCount entries in D3D12 subresource order, slice major: slice*MipCount + mip.
+    std::vector<DDSSubresource> Subresources;
+
+    const DDSSubresource& Subresource(std::uint32_t mip, std::uint32_t slice)const { return Subresources[slice*MipCount + mip]; }
+};
+
+// Device independent DDS reader, builds on any platform with just dxgiformat.h. Parse()
+// validates the headers against the hardware limits D3D12 enforces and checks that every
+// subresource lies inside the data, the table it returns points into that data and nothing
+// is copied.
+class DDSParser
+{
+public:
+    // False for malformed files and for formats D3D can't sample (palettized, unknown).
+    static bool Parse(const void* data, std::size_t size, DDSImage& image);
+
+    // Format helpers, see the 'DirectXTex' library.
+    static std::size_t BitsPerPixel(DXGI_FORMAT fmt);
+    static void GetSurfaceInfo(std::size_t width, std::size_t height, DXGI_FORMAT fmt,
+        std::size_t* outNumBytes, std::size_t* outRowBytes, std::size_t* outNumRows);
+    static DXGI_FORMAT GetDXGIFormat(const DDS_PIXELFORMAT& ddpf);
+};
+
+// A mapped DDS file and its subresource table, the table stays valid while the file is open.
+class DDSFile
+{
+public:
+    bool Open(const std::wstring& path);
+    void Close();
+
+    bool IsOpen()const { return mFile.IsOpen(); }
+    const DDSImage& Image()const { return mImage; }
+
+private:
+    MappedFile mFile;
+    DDSImage mImage;
+};
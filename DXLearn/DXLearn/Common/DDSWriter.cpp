@@ -0,0 +1,225 @@
+#include "DDSWriter.h"
+
+#include <cstring>
+#include <fstream>
+#include <windows.h>
+
+namespace
+{
+    using uint8 = std::uint8_t;
+    using uint32 = std::uint32_t;
+    using uint64 = std::uint64_t;
+
+    // Header flags and caps, see DDS.h in the 'DirectXTex' library.
+    const uint32 HeaderFlagsCaps = 0x00000001;          // DDSD_CAPS
+    const uint32 HeaderFlagsPitch = 0x00000008;         // DDSD_PITCH
+    const uint32 HeaderFlagsPixelFormat = 0x00001000;   // DDSD_PIXELFORMAT
+    const uint32 HeaderFlagsMipCount = 0x00020000;      // DDSD_MIPMAPCOUNT
+    const uint32 HeaderFlagsLinearSize = 0x00080000;    // DDSD_LINEARSIZE
+
+    const uint32 SurfaceFlagsComplex = 0x00000008;      // DDSCAPS_COMPLEX
+    const uint32 SurfaceFlagsTexture = 0x00001000;      // DDSCAPS_TEXTURE
+    const uint32 SurfaceFlagsMipmap = 0x00400000;       // DDSCAPS_MIPMAP
+    const uint32 Caps2Volume = 0x00200000;              // DDSCAPS2_VOLUME
+
+    const uint32 PixelFormatAlphaPixels = 0x00000001;   // DDPF_ALPHAPIXELS
+
+    const uint32 ResourceMiscTextureCube = 0x4;         // D3D11_RESOURCE_MISC_TEXTURECUBE
+
+    inline bool IsCompressed(DXGI_FORMAT format)
+    {
+        return (format >= DXGI_FORMAT_BC1_TYPELESS && format <= DXGI_FORMAT_BC5_SNORM) ||
+            (format >= DXGI_FORMAT_BC6H_TYPELESS && format <= DXGI_FORMAT_BC7_UNORM_SRGB);
+    }
+
+    // The legacy pixel format of format, false if only the DX10 header can name it.
+    bool LegacyPixelFormat(DXGI_FORMAT format, DDS_PIXELFORMAT& pixelFormat)
+    {
+        std::memset(&pixelFormat, 0, sizeof(pixelFormat));
+        pixelFormat.size = sizeof(DDS_PIXELFORMAT);
+
+        uint32 fourCC = 0;
+        switch (format)
+        {
+        case DXGI_FORMAT_BC1_UNORM: fourCC = MAKEFOURCC('D', 'X', 'T', '1'); break;
+        case DXGI_FORMAT_BC2_UNORM: fourCC = MAKEFOURCC('D', 'X', 'T', '3'); break;
+        case DXGI_FORMAT_BC3_UNORM: fourCC = MAKEFOURCC('D', 'X', 'T', '5'); break;
+        case DXGI_FORMAT_BC4_UNORM: fourCC = MAKEFOURCC('A', 'T', 'I', '1'); break;
+        case DXGI_FORMAT_BC4_SNORM: fourCC = MAKEFOURCC('B', 'C', '4', 'S'); break;
+        case DXGI_FORMAT_BC5_UNORM: fourCC = MAKEFOURCC('A', 'T', 'I', '2'); break;
+        case DXGI_FORMAT_BC5_SNORM: fourCC = MAKEFOURCC('B', 'C', '5', 'S'); break;
+
+        case DXGI_FORMAT_R8G8B8A8_UNORM:
+            pixelFormat.flags = DDS_RGB | PixelFormatAlphaPixels;
+            pixelFormat.RGBBitCount = 32;
+            pixelFormat.RBitMask = 0x000000ff;
+            pixelFormat.GBitMask = 0x0000ff00;
+            pixelFormat.BBitMask = 0x00ff0000;
+            pixelFormat.ABitMask = 0xff000000;
+            return true;
+
+        case DXGI_FORMAT_B8G8R8A8_UNORM:
+            pixelFormat.flags = DDS_RGB | PixelFormatAlphaPixels;
+            pixelFormat.RGBBitCount = 32;
+            pixelFormat.RBitMask = 0x00ff0000;
+            pixelFormat.GBitMask = 0x0000ff00;
+            pixelFormat.BBitMask = 0x000000ff;
+            pixelFormat.ABitMask = 0xff000000;
+            return true;
+
+        default:
+            return false;
+        }
+
+        pixelFormat.flags = DDS_FOURCC;
+        pixelFormat.fourCC = fourCC;
+        return true;
+    }
+}
+
+bool DDSWriter::Serialize(const DDSImage& image, std::vector<uint8>& file)
+{
+    file.clear();
+    if (image.Width == 0 || image.Height == 0 || image.Depth == 0 || image.MipCount == 0 || image.ArraySize == 0 ||
+        image.Subresources.size() != std::size_t(image.MipCount)*image.ArraySize ||
+        (image.IsCubeMap && image.ArraySize % 6 != 0) || DDSParser::BitsPerPixel(image.Format) == 0)
+    {
+        return false;
+    }
+
+    const bool isVolume = image.Dimension == DDSDimensionTexture3D;
+    DDS_PIXELFORMAT pixelFormat;
+    const bool legacy = LegacyPixelFormat(image.Format, pixelFormat) && image.AlphaMode == DDSAlphaModeUnknown &&
+        image.Dimension != DDSDimensionTexture1D && image.ArraySize == (image.IsCubeMap ? 6u : 1u);
+
+    DDS_HEADER header = {};
+    header.size = sizeof(DDS_HEADER);
+    header.flags = HeaderFlagsCaps | DDS_HEIGHT | DDS_WIDTH | HeaderFlagsPixelFormat;
+    header.width = image.Width;
+    header.height = image.Height;
+    header.depth = isVolume ? image.Depth : 0;
+    header.mipMapCount = image.MipCount;
+    header.caps = SurfaceFlagsTexture;
+
+    std::size_t slicePitch;
+    std::size_t rowPitch;
+    std::size_t rowCount;
+    DDSParser::GetSurfaceInfo(image.Width, image.Height, image.Format, &slicePitch, &rowPitch, &rowCount);
+    if (IsCompressed(image.Format))
+    {
+        header.flags |= HeaderFlagsLinearSize;
+        header.pitchOrLinearSize = static_cast<uint32>(slicePitch);
+    }
+    else
+    {
+        header.flags |= HeaderFlagsPitch;
+        header.pitchOrLinearSize = static_cast<uint32>(rowPitch);
+    }
+    if (image.MipCount > 1)
+    {
+        header.flags |= HeaderFlagsMipCount;
+        header.caps |= SurfaceFlagsMipmap | SurfaceFlagsComplex;
+    }
+    if (isVolume)
+    {
+        header.flags |= DDS_HEADER_FLAGS_VOLUME;
+        header.caps |= SurfaceFlagsComplex;
+        header.caps2 |= Caps2Volume;
+    }
+    if (image.IsCubeMap)
+    {
+        header.caps |= SurfaceFlagsComplex;
+        header.caps2 |= DDS_CUBEMAP_ALLFACES;
+    }
+
+    DDS_HEADER_DXT10 extension = {};
+    if (legacy)
+    {
+        header.ddspf = pixelFormat;
+    }
+    else
+    {
+        header.ddspf.size = sizeof(DDS_PIXELFORMAT);
+        header.ddspf.flags = DDS_FOURCC;
+        header.ddspf.fourCC = MAKEFOURCC('D', 'X', '1', '0');
+
+        extension.dxgiFormat = image.Format;
+        extension.resourceDimension = image.Dimension;
+        extension.miscFlag = image.IsCubeMap ? ResourceMiscTextureCube : 0;
+        extension.arraySize = image.IsCubeMap ? image.ArraySize / 6 : image.ArraySize;
+        extension.miscFlags2 = image.AlphaMode;
+    }
+
+    // Sizes first, so the file is allocated once.
+    uint64 total = sizeof(uint32) + sizeof(DDS_HEADER) + (legacy ? 0 : sizeof(DDS_HEADER_DXT10));
+    for (const DDSSubresource& subresource : image.Subresources)
+    {
+        DDSParser::GetSurfaceInfo(subresource.Width, subresource.Height, image.Format, &slicePitch, &rowPitch, &rowCount);
+        if (!subresource.Data || subresource.RowPitch < rowPitch || subresource.RowCount < rowCount ||
+            subresource.SlicePitch < subresource.RowPitch*(rowCount - 1) + rowPitch)
+        {
+            return false;
+        }
+        total += uint64(slicePitch)*subresource.Depth;
+    }
+
+    file.resize(static_cast<std::size_t>(total));
+    uint8* dest = file.data();
+    std::memcpy(dest, &DDS_MAGIC, sizeof(uint32));
+    dest += sizeof(uint32);
+    std::memcpy(dest, &header, sizeof(header));
+    dest += sizeof(header);
+    if (!legacy)
+    {
+        std::memcpy(dest, &extension, sizeof(extension));
+        dest += sizeof(extension);
+    }
+
+    for (const DDSSubresource& subresource : image.Subresources)
+    {
+        DDSParser::GetSurfaceInfo(subresource.Width, subresource.Height, image.Format, &slicePitch, &rowPitch, &rowCount);
+        for (uint32 z = 0; z < subresource.Depth; ++z)
+        {
+            const uint8* src = subresource.Data + z*subresource.SlicePitch;
+            for (std::size_t row = 0; row < rowCount; ++row)
+            {
+                std::memcpy(dest, src + row*subresource.RowPitch, rowPitch);
+                dest += rowPitch;
+            }
+        }
+    }
+    return true;
+}
+
+bool DDSWriter::Write(const std::wstring& path, const DDSImage& image)
+{
+    std::vector<uint8> contents;
+    if (!Serialize(image, contents))
+    {
+        return false;
+    }
+
+    const std::wstring temporaryPath = path + L".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            return false;
+        }
+
+        file.write(reinterpret_cast<const char*>(contents.data()), static_cast<std::streamsize>(contents.size()));
+        file.close();
+        if (file.fail())
+        {
+            DeleteFileW(temporaryPath.c_str());
+            return false;
+        }
+    }
+
+    if (!MoveFileExW(temporaryPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+    {
+        DeleteFileW(temporaryPath.c_str());
+        return false;
+    }
+    return true;
+}
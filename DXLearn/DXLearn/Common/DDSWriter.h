@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "DDSParser.h"
+
+// Writer of the DDS files DDSParser and the texture loaders read. Formats and layouts the
+// legacy header can describe (DXT1/3/5, ATI1/ATI2, BC4S/BC5S, 8 bit RGBA and BGRA, cubes and
+// volumes) are written with it so older tools open them too, the rest (sRGB, arrays, alpha
+// modes) gets the DX10 extension header. Subresources are written in the order of the image
+// table, rows packed to the pitches GetSurfaceInfo gives.
+class DDSWriter
+{
+public:
+    // False if the image is empty or its table doesn't match its size and format.
+    static bool Serialize(const DDSImage& image, std::vector<std::uint8_t>& file);
+
+    // Writes to a temporary file and moves it over path, so a failed write never leaves a
+    // truncated texture behind.
+    static bool Write(const std::wstring& path, const DDSImage& image);
+};
@@ -0,0 +1,276 @@
+#include "FFT.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <emmintrin.h>
+
+#include "TaskScheduler.h"
+
+namespace
+{
+    // Complex multiply of four lanes: (ar + i*ai) * (br + i*bi).
+    inline void ComplexMul(__m128 ar, __m128 ai, __m128 br, __m128 bi, __m128& outRe, __m128& outIm)
+    {
+        outRe = _mm_sub_ps(_mm_mul_ps(ar, br), _mm_mul_ps(ai, bi));
+        outIm = _mm_add_ps(_mm_mul_ps(ar, bi), _mm_mul_ps(ai, br));
+    }
+
+    // Block size for the 2D transpose, 16x16 floats of each plane stay in L1.
+    const int TransposeBlock = 16;
+
+    void TransposeSquare(float* data, int n)
+    {
+        const int blocks = (n + TransposeBlock - 1) / TransposeBlock;
+
+        // Block row bi swaps itself with the blocks right of the diagonal, so every
+        // pair of elements is owned by exactly one task.
+        TaskScheduler::Get().ParallelFor(0, blocks, 1, [data, n, blocks](int bi)
+        {
+            const int rowBegin = bi*TransposeBlock;
+            const int rowEnd = std::min(n, rowBegin + TransposeBlock);
+            for (int bj = bi; bj < blocks; ++bj)
+            {
+                const int colBegin = bj*TransposeBlock;
+                const int colEnd = std::min(n, colBegin + TransposeBlock);
+                for (int i = rowBegin; i < rowEnd; ++i)
+                {
+                    for (int j = std::max(colBegin, i + 1); j < colEnd; ++j)
+                    {
+                        std::swap(data[i*n + j], data[j*n + i]);
+                    }
+                }
+            }
+        });
+    }
+}
+
+FFT::FFT(int size, EFFTDirection direction)
+{
+    assert(size >= 2 && (size & (size - 1)) == 0);
+
+    mSize = size;
+    while ((1 << mLog2Size) < size)
+    {
+        ++mLog2Size;
+    }
+
+    mBitReverse.resize(size);
+    for (int i = 0; i < size; ++i)
+    {
+        int reversed = 0;
+        for (int bit = 0; bit < mLog2Size; ++bit)
+        {
+            reversed |= ((i >> bit) & 1) << (mLog2Size - 1 - bit);
+        }
+        mBitReverse[i] = reversed;
+    }
+
+    const double sign = direction == EFFTDirection::Inverse ? 1.0 : -1.0;
+    const double pi = 3.14159265358979323846;
+    mTwiddleRe.resize(size - 1);
+    mTwiddleIm.resize(size - 1);
+    for (int span = 2; span <= size; span *= 2)
+    {
+        const int offset = span/2 - 1;
+        for (int j = 0; j < span/2; ++j)
+        {
+            // Computed in double so large sizes don't accumulate rounding.
+            const double angle = sign * 2.0 * pi * j / span;
+            mTwiddleRe[offset + j] = static_cast<float>(cos(angle));
+            mTwiddleIm[offset + j] = static_cast<float>(sin(angle));
+        }
+    }
+}
+
+void FFT::Transform(float* re, float* im)const
+{
+    BitReverse(re, im);
+
+    int half = 1;
+    int stagesLeft = mLog2Size;
+    if (stagesLeft & 1)
+    {
+        Radix2Pass(re, im, half);
+        half *= 2;
+        --stagesLeft;
+    }
+
+    for (; stagesLeft > 0; stagesLeft -= 2)
+    {
+        Radix4Pass(re, im, half);
+        half *= 4;
+    }
+}
+
+void FFT::Transform2D(float* re, float* im)const
+{
+    const int n = mSize;
+    auto transformRows = [this, re, im, n](int row)
+    {
+        Transform(re + row*n, im + row*n);
+    };
+
+    TaskScheduler::Get().ParallelFor(0, n, 4, transformRows);
+
+    // Columns are done as rows of the transpose, strided butterflies would miss the
+    // cache on every access.
+    TransposeSquare(re, n);
+    TransposeSquare(im, n);
+    TaskScheduler::Get().ParallelFor(0, n, 4, transformRows);
+    TransposeSquare(re, n);
+    TransposeSquare(im, n);
+}
+
+void FFT::BitReverse(float* re, float* im)const
+{
+    for (int i = 0; i < mSize; ++i)
+    {
+        const int j = mBitReverse[i];
+        if (i < j)
+        {
+            std::swap(re[i], re[j]);
+            std::swap(im[i], im[j]);
+        }
+    }
+}
+
+void FFT::Radix2Pass(float* re, float* im, int half)const
+{
+    const float* twRe = &mTwiddleRe[half - 1];
+    const float* twIm = &mTwiddleIm[half - 1];
+
+    for (int block = 0; block < mSize; block += 2*half)
+    {
+        float* aRe = re + block;
+        float* aIm = im + block;
+        float* bRe = aRe + half;
+        float* bIm = aIm + half;
+
+        int j = 0;
+        if (half >= 4)
+        {
+            for (; j + 4 <= half; j += 4)
+            {
+                __m128 tRe, tIm;
+                ComplexMul(_mm_loadu_ps(bRe + j), _mm_loadu_ps(bIm + j),
+                    _mm_loadu_ps(twRe + j), _mm_loadu_ps(twIm + j), tRe, tIm);
+
+                const __m128 xRe = _mm_loadu_ps(aRe + j);
+                const __m128 xIm = _mm_loadu_ps(aIm + j);
+                _mm_storeu_ps(aRe + j, _mm_add_ps(xRe, tRe));
+                _mm_storeu_ps(aIm + j, _mm_add_ps(xIm, tIm));
+                _mm_storeu_ps(bRe + j, _mm_sub_ps(xRe, tRe));
+                _mm_storeu_ps(bIm + j, _mm_sub_ps(xIm, tIm));
+            }
+        }
+
+        for (; j < half; ++j)
+        {
+            const float tRe = bRe[j]*twRe[j] - bIm[j]*twIm[j];
+            const float tIm = bRe[j]*twIm[j] + bIm[j]*twRe[j];
+            const float xRe = aRe[j];
+            const float xIm = aIm[j];
+            aRe[j] = xRe + tRe;
+            aIm[j] = xIm + tIm;
+            bRe[j] = xRe - tRe;
+            bIm[j] = xIm - tIm;
+        }
+    }
+}
+
+void FFT::Radix4Pass(float* re, float* im, int half)const
+{
+    // Two radix-2 stages in one sweep: spans 2*half and 4*half. For every j the four
+    // points j, j+half, j+2*half and j+3*half only ever combine with each other.
+    const float* tw1Re = &mTwiddleRe[half - 1];
+    const float* tw1Im = &mTwiddleIm[half - 1];
+    const float* tw2Re = &mTwiddleRe[2*half - 1];
+    const float* tw2Im = &mTwiddleIm[2*half - 1];
+    const float* tw3Re = tw2Re + half;
+    const float* tw3Im = tw2Im + half;
+
+    for (int block = 0; block < mSize; block += 4*half)
+    {
+        float* p0Re = re + block;
+        float* p0Im = im + block;
+        float* p1Re = p0Re + half;
+        float* p1Im = p0Im + half;
+        float* p2Re = p1Re + half;
+        float* p2Im = p1Im + half;
+        float* p3Re = p2Re + half;
+        float* p3Im = p2Im + half;
+
+        int j = 0;
+        if (half >= 4)
+        {
+            for (; j + 4 <= half; j += 4)
+            {
+                const __m128 w1Re = _mm_loadu_ps(tw1Re + j);
+                const __m128 w1Im = _mm_loadu_ps(tw1Im + j);
+
+                // First stage: (p0, p1) and (p2, p3).
+                __m128 tRe, tIm;
+                ComplexMul(_mm_loadu_ps(p1Re + j), _mm_loadu_ps(p1Im + j), w1Re, w1Im, tRe, tIm);
+                __m128 aRe = _mm_loadu_ps(p0Re + j);
+                __m128 aIm = _mm_loadu_ps(p0Im + j);
+                const __m128 bRe = _mm_sub_ps(aRe, tRe);
+                const __m128 bIm = _mm_sub_ps(aIm, tIm);
+                aRe = _mm_add_ps(aRe, tRe);
+                aIm = _mm_add_ps(aIm, tIm);
+
+                ComplexMul(_mm_loadu_ps(p3Re + j), _mm_loadu_ps(p3Im + j), w1Re, w1Im, tRe, tIm);
+                __m128 cRe = _mm_loadu_ps(p2Re + j);
+                __m128 cIm = _mm_loadu_ps(p2Im + j);
+                const __m128 dRe = _mm_sub_ps(cRe, tRe);
+                const __m128 dIm = _mm_sub_ps(cIm, tIm);
+                cRe = _mm_add_ps(cRe, tRe);
+                cIm = _mm_add_ps(cIm, tIm);
+
+                // Second stage: (a, c) and (b, d).
+                ComplexMul(cRe, cIm, _mm_loadu_ps(tw2Re + j), _mm_loadu_ps(tw2Im + j), tRe, tIm);
+                _mm_storeu_ps(p0Re + j, _mm_add_ps(aRe, tRe));
+                _mm_storeu_ps(p0Im + j, _mm_add_ps(aIm, tIm));
+                _mm_storeu_ps(p2Re + j, _mm_sub_ps(aRe, tRe));
+                _mm_storeu_ps(p2Im + j, _mm_sub_ps(aIm, tIm));
+
+                ComplexMul(dRe, dIm, _mm_loadu_ps(tw3Re + j), _mm_loadu_ps(tw3Im + j), tRe, tIm);
+                _mm_storeu_ps(p1Re + j, _mm_add_ps(bRe, tRe));
+                _mm_storeu_ps(p1Im + j, _mm_add_ps(bIm, tIm));
+                _mm_storeu_ps(p3Re + j, _mm_sub_ps(bRe, tRe));
+                _mm_storeu_ps(p3Im + j, _mm_sub_ps(bIm, tIm));
+            }
+        }
+
+        for (; j < half; ++j)
+        {
+            float tRe = p1Re[j]*tw1Re[j] - p1Im[j]*tw1Im[j];
+            float tIm = p1Re[j]*tw1Im[j] + p1Im[j]*tw1Re[j];
+            const float aRe = p0Re[j] + tRe;
+            const float aIm = p0Im[j] + tIm;
+            const float bRe = p0Re[j] - tRe;
+            const float bIm = p0Im[j] - tIm;
+
+            tRe = p3Re[j]*tw1Re[j] - p3Im[j]*tw1Im[j];
+            tIm = p3Re[j]*tw1Im[j] + p3Im[j]*tw1Re[j];
+            const float cRe = p2Re[j] + tRe;
+            const float cIm = p2Im[j] + tIm;
+            const float dRe = p2Re[j] - tRe;
+            const float dIm = p2Im[j] - tIm;
+
+            tRe = cRe*tw2Re[j] - cIm*tw2Im[j];
+            tIm = cRe*tw2Im[j] + cIm*tw2Re[j];
+            p0Re[j] = aRe + tRe;
+            p0Im[j] = aIm + tIm;
+            p2Re[j] = aRe - tRe;
+            p2Im[j] = aIm - tIm;
+
+            tRe = dRe*tw3Re[j] - dIm*tw3Im[j];
+            tIm = dRe*tw3Im[j] + dIm*tw3Re[j];
+            p1Re[j] = bRe + tRe;
+            p1Im[j] = bIm + tIm;
+            p3Re[j] = bRe - tRe;
+            p3Im[j] = bIm - tIm;
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+
+#include "AlignedAllocator.h"
+
+enum class EFFTDirection : int
+{
+    Forward = 0,    // exp(-i...)
+    Inverse         // exp(+i...), not scaled by 1/N
+};
+
+// Power-of-two complex FFT on split (SoA) real/imaginary arrays.
+// Iterative decimation in time. Pairs of radix-2 stages are fused into radix-4 passes
+// so the data is streamed half as often, and the butterflies run four at a time with
+// SSE once a stage is wide enough. Twiddles are stored per stage so the vector loads
+// stay contiguous.
+class FFT
+{
+public:
+    FFT(int size, EFFTDirection direction);
+
+    int Size()const { return mSize; }
+
+    // In-place transform of one sequence of Size() values.
+    void Transform(float* re, float* im)const;
+
+    // In-place 2D transform of a Size() x Size() row-major grid. Rows and columns are
+    // spread over the task scheduler.
+    void Transform2D(float* re, float* im)const;
+
+private:
+    void BitReverse(float* re, float* im)const;
+    void Radix2Pass(float* re, float* im, int half)const;
+    void Radix4Pass(float* re, float* im, int half)const;
+
+    int mSize = 0;
+    int mLog2Size = 0;
+    std::vector<int> mBitReverse;
+
+    // Twiddles of the stage with span s (s = 2, 4, ..., Size) start at s/2 - 1.
+    std::vector<float, AlignedAllocator<float>> mTwiddleRe;
+    std::vector<float, AlignedAllocator<float>> mTwiddleIm;
+};
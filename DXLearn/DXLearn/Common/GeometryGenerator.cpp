@@ -3,10 +3,54 @@
 //***************************************************************************************
 
 #include "GeometryGenerator.h"
+#include "TaskScheduler.h"
 #include <algorithm>
 
 using namespace DirectX;
 
+namespace
+{
+    const std::uint32_t NoMidpoint = 0xffffffff;
+    const std::uint64_t NoEdge = ~0ull;
+
+    // Open-addressing map from an undirected edge (pair of vertex indices) to the index
+    // of its midpoint vertex. Sized up front, so it never rehashes while subdividing.
+    class EdgeMidpointCache
+    {
+    public:
+        explicit EdgeMidpointCache(std::size_t edgeCount)
+        {
+            // At most half full keeps the probe sequences short.
+            std::size_t capacity = 16;
+            while(capacity < edgeCount*2)
+                capacity *= 2;
+
+            mMask = capacity - 1;
+            mKeys.assign(capacity, NoEdge);
+            mValues.assign(capacity, NoMidpoint);
+        }
+
+        // Returns the slot of edge (a, b), NoMidpoint if it hasn't been stored yet.
+        std::uint32_t& Find(std::uint32_t a, std::uint32_t b)
+        {
+            const std::uint64_t key = a < b ? ((std::uint64_t)a << 32 | b) : ((std::uint64_t)b << 32 | a);
+
+            // Fibonacci hashing spreads the sequential indices over the table.
+            std::size_t slot = (std::size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & mMask;
+            while(mKeys[slot] != key && mKeys[slot] != NoEdge)
+                slot = (slot + 1) & mMask;
+
+            mKeys[slot] = key;
+            return mValues[slot];
+        }
+
+    private:
+        std::size_t mMask = 0;
+        std::vector<std::uint64_t> mKeys;
+        std::vector<std::uint32_t> mValues;
+    };
+}
+
 GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float height, float depth, uint32 numSubdivisions)
 {
     MeshData meshData;
@@ -103,7 +147,13 @@ GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float heig
 GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount)
 {
     MeshData meshData;
+    MeshSink sink = MeshDataSink(meshData, SphereSize(sliceCount, stackCount));
+    BuildSphere(radius, sliceCount, stackCount, sink);
+    return meshData;
+}
 
+void GeometryGenerator::BuildSphere(float radius, uint32 sliceCount, uint32 stackCount, MeshSink& sink)
+{
 	//
 	// Compute the vertices stating at the top pole and moving down the stacks.
 	//
@@ -114,7 +164,7 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 	Vertex topVertex(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
 	Vertex bottomVertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
 
-	meshData.Vertices.push_back( topVertex );
+	sink.AddVertex( topVertex );
 
 	float phiStep   = XM_PI/stackCount;
 	float thetaStep = 2.0f*XM_PI/sliceCount;
@@ -136,25 +186,31 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 			v.Position.y = radius*cosf(phi);
 			v.Position.z = radius*sinf(phi)*sinf(theta);
 
-			// Partial derivative of P with respect to theta
-			v.TangentU.x = -radius*sinf(phi)*sinf(theta);
-			v.TangentU.y = 0.0f;
-			v.TangentU.z = +radius*sinf(phi)*cosf(theta);
+			if(sink.Wants(AttributeTangentU))
+			{
+				// Partial derivative of P with respect to theta
+				v.TangentU.x = -radius*sinf(phi)*sinf(theta);
+				v.TangentU.y = 0.0f;
+				v.TangentU.z = +radius*sinf(phi)*cosf(theta);
 
-			XMVECTOR T = XMLoadFloat3(&v.TangentU);
-			XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
+				XMVECTOR T = XMLoadFloat3(&v.TangentU);
+				XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
+			}
 
-			XMVECTOR p = XMLoadFloat3(&v.Position);
-			XMStoreFloat3(&v.Normal, XMVector3Normalize(p));
+			if(sink.Wants(AttributeNormal))
+			{
+				XMVECTOR p = XMLoadFloat3(&v.Position);
+				XMStoreFloat3(&v.Normal, XMVector3Normalize(p));
+			}
 
 			v.TexC.x = theta / XM_2PI;
 			v.TexC.y = phi / XM_PI;
 
-			meshData.Vertices.push_back( v );
+			sink.AddVertex( v );
 		}
 	}
 
-	meshData.Vertices.push_back( bottomVertex );
+	sink.AddVertex( bottomVertex );
 
 	//
 	// Compute indices for top stack.  The top stack was written first to the vertex buffer
@@ -163,9 +219,9 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 
     for(uint32 i = 1; i <= sliceCount; ++i)
 	{
-		meshData.Indices32.push_back(0);
-		meshData.Indices32.push_back(i+1);
-		meshData.Indices32.push_back(i);
+		sink.AddIndex(0);
+		sink.AddIndex(i+1);
+		sink.AddIndex(i);
 	}
 	
 	//
@@ -180,13 +236,13 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 	{
 		for(uint32 j = 0; j < sliceCount; ++j)
 		{
-			meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j);
-			meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j+1);
-			meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j);
+			sink.AddIndex(baseIndex + i*ringVertexCount + j);
+			sink.AddIndex(baseIndex + i*ringVertexCount + j+1);
+			sink.AddIndex(baseIndex + (i+1)*ringVertexCount + j);
 
-			meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j);
-			meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j+1);
-			meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j+1);
+			sink.AddIndex(baseIndex + (i+1)*ringVertexCount + j);
+			sink.AddIndex(baseIndex + i*ringVertexCount + j+1);
+			sink.AddIndex(baseIndex + (i+1)*ringVertexCount + j+1);
 		}
 	}
 
@@ -196,29 +252,44 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 	//
 
 	// South pole vertex was added last.
-	uint32 southPoleIndex = (uint32)meshData.Vertices.size()-1;
+	uint32 southPoleIndex = sink.VertexCount()-1;
 
 	// Offset the indices to the index of the first vertex in the last ring.
 	baseIndex = southPoleIndex - ringVertexCount;
 	
 	for(uint32 i = 0; i < sliceCount; ++i)
 	{
-		meshData.Indices32.push_back(southPoleIndex);
-		meshData.Indices32.push_back(baseIndex+i);
-		meshData.Indices32.push_back(baseIndex+i+1);
+		sink.AddIndex(southPoleIndex);
+		sink.AddIndex(baseIndex+i);
+		sink.AddIndex(baseIndex+i+1);
 	}
-
-    return meshData;
 }
  
 void GeometryGenerator::Subdivide(MeshData& meshData)
 {
-	// Save a copy of the input geometry.
-	MeshData inputCopy = meshData;
+	// The old indices are moved out, not copied, and the vertices grow in place: the
+	// corners keep their indices and each edge midpoint is appended once, shared by the
+	// triangles on both sides of the edge.
+	std::vector<uint32> input;
+	input.swap(meshData.Indices32);
+
+	const uint32 numTris = (uint32)input.size()/3;
 
+	// A closed mesh has 3/2 edges per triangle, open edges only add a few more.
+	meshData.Vertices.reserve(meshData.Vertices.size() + numTris*3/2 + 1);
+	meshData.Indices32.resize(numTris*12);
 
-	meshData.Vertices.resize(0);
-	meshData.Indices32.resize(0);
+	EdgeMidpointCache cache(numTris*3/2 + 1);
+	auto midpoint = [this, &meshData, &cache](uint32 a, uint32 b)
+	{
+		uint32& index = cache.Find(a, b);
+		if(index == NoMidpoint)
+		{
+			index = (uint32)meshData.Vertices.size();
+			meshData.Vertices.push_back(MidPoint(meshData.Vertices[a], meshData.Vertices[b]));
+		}
+		return index;
+	};
 
 	//       v1
 	//       *
@@ -230,47 +301,29 @@ void GeometryGenerator::Subdivide(MeshData& meshData)
 	// *-----*-----*
 	// v0    m2     v2
 
-	uint32 numTris = (uint32)inputCopy.Indices32.size()/3;
 	for(uint32 i = 0; i < numTris; ++i)
 	{
-		Vertex v0 = inputCopy.Vertices[ inputCopy.Indices32[i*3+0] ];
-		Vertex v1 = inputCopy.Vertices[ inputCopy.Indices32[i*3+1] ];
-		Vertex v2 = inputCopy.Vertices[ inputCopy.Indices32[i*3+2] ];
+		const uint32 v0 = input[i*3+0];
+		const uint32 v1 = input[i*3+1];
+		const uint32 v2 = input[i*3+2];
 
 		//
 		// Generate the midpoints.
 		//
 
-        Vertex m0 = MidPoint(v0, v1);
-        Vertex m1 = MidPoint(v1, v2);
-        Vertex m2 = MidPoint(v0, v2);
+		const uint32 m0 = midpoint(v0, v1);
+		const uint32 m1 = midpoint(v1, v2);
+		const uint32 m2 = midpoint(v0, v2);
 
 		//
 		// Add new geometry.
 		//
 
-		meshData.Vertices.push_back(v0); // 0
-		meshData.Vertices.push_back(v1); // 1
-		meshData.Vertices.push_back(v2); // 2
-		meshData.Vertices.push_back(m0); // 3
-		meshData.Vertices.push_back(m1); // 4
-		meshData.Vertices.push_back(m2); // 5
- 
-		meshData.Indices32.push_back(i*6+0);
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+5);
-
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+4);
-		meshData.Indices32.push_back(i*6+5);
-
-		meshData.Indices32.push_back(i*6+5);
-		meshData.Indices32.push_back(i*6+4);
-		meshData.Indices32.push_back(i*6+2);
-
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+1);
-		meshData.Indices32.push_back(i*6+4);
+		uint32* out = &meshData.Indices32[i*12];
+		out[0] = v0; out[1]  = m0; out[2]  = m2;
+		out[3] = m0; out[4]  = m1; out[5]  = m2;
+		out[6] = m2; out[7]  = m1; out[8]  = v2;
+		out[9] = m0; out[10] = v1; out[11] = m1;
 	}
 }
 
@@ -305,6 +358,11 @@ GeometryGenerator::Vertex GeometryGenerator::MidPoint(const Vertex& v0, const Ve
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uint32 numSubdivisions)
+{
+    return GenerateGeosphere(radius, numSubdivisions, AttributeAll);
+}
+
+GeometryGenerator::MeshData GeometryGenerator::GenerateGeosphere(float radius, uint32 numSubdivisions, uint32 attributes)
 {
     MeshData meshData;
 
@@ -344,7 +402,8 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uin
 		Subdivide(meshData);
 
 	// Project vertices onto sphere and scale.
-	for(uint32 i = 0; i < meshData.Vertices.size(); ++i)
+	// Every vertex is independent, so split them over the task scheduler.
+	TaskScheduler::Get().ParallelFor(0, (int)meshData.Vertices.size(), 1024, [&meshData, radius, attributes](int i)
 	{
 		// Project onto unit sphere.
 		XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&meshData.Vertices[i].Position));
@@ -355,6 +414,10 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uin
 		XMStoreFloat3(&meshData.Vertices[i].Position, p);
 		XMStoreFloat3(&meshData.Vertices[i].Normal, n);
 
+		// The spherical coordinates are only needed by the texture coordinates and the tangent.
+		if((attributes & (AttributeTexC | AttributeTangentU)) == 0)
+			return;
+
 		// Derive texture coordinates from spherical coordinates.
         float theta = atan2f(meshData.Vertices[i].Position.z, meshData.Vertices[i].Position.x);
 
@@ -374,7 +437,7 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uin
 
 		XMVECTOR T = XMLoadFloat3(&meshData.Vertices[i].TangentU);
 		XMStoreFloat3(&meshData.Vertices[i].TangentU, XMVector3Normalize(T));
-	}
+	});
 
     return meshData;
 }
@@ -382,7 +445,13 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uin
 GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount)
 {
     MeshData meshData;
+    MeshSink sink = MeshDataSink(meshData, CylinderSize(sliceCount, stackCount));
+    BuildCylinder(bottomRadius, topRadius, height, sliceCount, stackCount, sink);
+    return meshData;
+}
 
+void GeometryGenerator::BuildCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshSink& sink)
+{
 	//
 	// Build Stacks.
 	// 
@@ -436,15 +505,18 @@ GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius
 			// This is unit length.
 			vertex.TangentU = XMFLOAT3(-s, 0.0f, c);
 
-			float dr = bottomRadius-topRadius;
-			XMFLOAT3 bitangent(dr*c, -height, dr*s);
+			if(sink.Wants(AttributeNormal))
+			{
+				float dr = bottomRadius-topRadius;
+				XMFLOAT3 bitangent(dr*c, -height, dr*s);
 
-			XMVECTOR T = XMLoadFloat3(&vertex.TangentU);
-			XMVECTOR B = XMLoadFloat3(&bitangent);
-			XMVECTOR N = XMVector3Normalize(XMVector3Cross(T, B));
-			XMStoreFloat3(&vertex.Normal, N);
+				XMVECTOR T = XMLoadFloat3(&vertex.TangentU);
+				XMVECTOR B = XMLoadFloat3(&bitangent);
+				XMVECTOR N = XMVector3Normalize(XMVector3Cross(T, B));
+				XMStoreFloat3(&vertex.Normal, N);
+			}
 
-			meshData.Vertices.push_back(vertex);
+			sink.AddVertex(vertex);
 		}
 	}
 
@@ -457,26 +529,24 @@ GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius
 	{
 		for(uint32 j = 0; j < sliceCount; ++j)
 		{
-			meshData.Indices32.push_back(i*ringVertexCount + j);
-			meshData.Indices32.push_back((i+1)*ringVertexCount + j);
-			meshData.Indices32.push_back((i+1)*ringVertexCount + j+1);
+			sink.AddIndex(i*ringVertexCount + j);
+			sink.AddIndex((i+1)*ringVertexCount + j);
+			sink.AddIndex((i+1)*ringVertexCount + j+1);
 
-			meshData.Indices32.push_back(i*ringVertexCount + j);
-			meshData.Indices32.push_back((i+1)*ringVertexCount + j+1);
-			meshData.Indices32.push_back(i*ringVertexCount + j+1);
+			sink.AddIndex(i*ringVertexCount + j);
+			sink.AddIndex((i+1)*ringVertexCount + j+1);
+			sink.AddIndex(i*ringVertexCount + j+1);
 		}
 	}
 
-	BuildCylinderTopCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
-	BuildCylinderBottomCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
-
-    return meshData;
+	BuildCylinderTopCap(bottomRadius, topRadius, height, sliceCount, stackCount, sink);
+	BuildCylinderBottomCap(bottomRadius, topRadius, height, sliceCount, stackCount, sink);
 }
 
 void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius, float height,
-											uint32 sliceCount, uint32 stackCount, MeshData& meshData)
+											uint32 sliceCount, uint32 stackCount, MeshSink& sink)
 {
-	uint32 baseIndex = (uint32)meshData.Vertices.size();
+	uint32 baseIndex = sink.VertexCount();
 
 	float y = 0.5f*height;
 	float dTheta = 2.0f*XM_PI/sliceCount;
@@ -492,31 +562,31 @@ void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius,
 		float u = x/height + 0.5f;
 		float v = z/height + 0.5f;
 
-		meshData.Vertices.push_back( Vertex(x, y, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v) );
+		sink.AddVertex( Vertex(x, y, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v) );
 	}
 
 	// Cap center vertex.
-	meshData.Vertices.push_back( Vertex(0.0f, y, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f) );
+	sink.AddVertex( Vertex(0.0f, y, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f) );
 
 	// Index of center vertex.
-	uint32 centerIndex = (uint32)meshData.Vertices.size()-1;
+	uint32 centerIndex = sink.VertexCount()-1;
 
 	for(uint32 i = 0; i < sliceCount; ++i)
 	{
-		meshData.Indices32.push_back(centerIndex);
-		meshData.Indices32.push_back(baseIndex + i+1);
-		meshData.Indices32.push_back(baseIndex + i);
+		sink.AddIndex(centerIndex);
+		sink.AddIndex(baseIndex + i+1);
+		sink.AddIndex(baseIndex + i);
 	}
 }
 
 void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadius, float height,
-											   uint32 sliceCount, uint32 stackCount, MeshData& meshData)
+											   uint32 sliceCount, uint32 stackCount, MeshSink& sink)
 {
 	// 
 	// Build bottom cap.
 	//
 
-	uint32 baseIndex = (uint32)meshData.Vertices.size();
+	uint32 baseIndex = sink.VertexCount();
 	float y = -0.5f*height;
 
 	// vertices of ring
@@ -531,30 +601,33 @@ void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadi
 		float u = x/height + 0.5f;
 		float v = z/height + 0.5f;
 
-		meshData.Vertices.push_back( Vertex(x, y, z, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v) );
+		sink.AddVertex( Vertex(x, y, z, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v) );
 	}
 
 	// Cap center vertex.
-	meshData.Vertices.push_back( Vertex(0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f) );
+	sink.AddVertex( Vertex(0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f) );
 
 	// Cache the index of center vertex.
-	uint32 centerIndex = (uint32)meshData.Vertices.size()-1;
+	uint32 centerIndex = sink.VertexCount()-1;
 
 	for(uint32 i = 0; i < sliceCount; ++i)
 	{
-		meshData.Indices32.push_back(centerIndex);
-		meshData.Indices32.push_back(baseIndex + i);
-		meshData.Indices32.push_back(baseIndex + i+1);
+		sink.AddIndex(centerIndex);
+		sink.AddIndex(baseIndex + i);
+		sink.AddIndex(baseIndex + i+1);
 	}
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float depth, uint32 m, uint32 n)
 {
     MeshData meshData;
+    MeshSink sink = MeshDataSink(meshData, GridSize(m, n));
+    BuildGrid(width, depth, m, n, sink);
+    return meshData;
+}
 
-	uint32 vertexCount = m*n;
-	uint32 faceCount   = (m-1)*(n-1)*2;
-
+void GeometryGenerator::BuildGrid(float width, float depth, uint32 m, uint32 n, MeshSink& sink)
+{
 	//
 	// Create the vertices.
 	//
@@ -568,90 +641,168 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float dep
 	float du = 1.0f / (n-1);
 	float dv = 1.0f / (m-1);
 
-	meshData.Vertices.resize(vertexCount);
-	for(uint32 i = 0; i < m; ++i)
+	TaskScheduler::Get().ParallelFor(0, (int)m, 8, [&](int row)
 	{
+		uint32 i = (uint32)row;
 		float z = halfDepth - i*dz;
 		for(uint32 j = 0; j < n; ++j)
 		{
 			float x = -halfWidth + j*dx;
 
-			meshData.Vertices[i*n+j].Position = XMFLOAT3(x, 0.0f, z);
-			meshData.Vertices[i*n+j].Normal   = XMFLOAT3(0.0f, 1.0f, 0.0f);
-			meshData.Vertices[i*n+j].TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
+			Vertex v;
+			v.Position = XMFLOAT3(x, 0.0f, z);
+			v.Normal   = XMFLOAT3(0.0f, 1.0f, 0.0f);
+			v.TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
 
 			// Stretch texture over grid.
-			meshData.Vertices[i*n+j].TexC.x = j*du;
-			meshData.Vertices[i*n+j].TexC.y = i*dv;
+			v.TexC.x = j*du;
+			v.TexC.y = i*dv;
+
+			sink.SetVertex(i*n+j, v);
 		}
-	}
+	});
  
     //
 	// Create the indices.
 	//
 
-	meshData.Indices32.resize(faceCount*3); // 3 indices per face
-
 	// Iterate over each quad and compute indices.
-	uint32 k = 0;
-	for(uint32 i = 0; i < m-1; ++i)
+	// Each row of quads owns a fixed slice of the index buffer, so rows can be filled in parallel.
+	TaskScheduler::Get().ParallelFor(0, (int)(m-1), 8, [&](int row)
 	{
+		uint32 i = (uint32)row;
+		uint32 k = i*(n-1)*6;
 		for(uint32 j = 0; j < n-1; ++j)
 		{
-			meshData.Indices32[k]   = i*n+j;
-			meshData.Indices32[k+1] = i*n+j+1;
-			meshData.Indices32[k+2] = (i+1)*n+j;
+			sink.SetIndex(k,   i*n+j);
+			sink.SetIndex(k+1, i*n+j+1);
+			sink.SetIndex(k+2, (i+1)*n+j);
 
-			meshData.Indices32[k+3] = (i+1)*n+j;
-			meshData.Indices32[k+4] = i*n+j+1;
-			meshData.Indices32[k+5] = (i+1)*n+j+1;
+			sink.SetIndex(k+3, (i+1)*n+j);
+			sink.SetIndex(k+4, i*n+j+1);
+			sink.SetIndex(k+5, (i+1)*n+j+1);
 
 			k += 6; // next quad
 		}
-	}
-
-    return meshData;
+	});
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateQuad(float x, float y, float w, float h, float depth)
 {
     MeshData meshData;
+    MeshSink sink = MeshDataSink(meshData, QuadSize());
+    BuildQuad(x, y, w, h, depth, sink);
+    return meshData;
+}
 
-	meshData.Vertices.resize(4);
-	meshData.Indices32.resize(6);
-
+void GeometryGenerator::BuildQuad(float x, float y, float w, float h, float depth, MeshSink& sink)
+{
 	// Position coordinates specified in NDC space.
-	meshData.Vertices[0] = Vertex(
+	sink.SetVertex(0, Vertex(
         x, y - h, depth,
 		0.0f, 0.0f, -1.0f,
 		1.0f, 0.0f, 0.0f,
-		0.0f, 1.0f);
+		0.0f, 1.0f));
 
-	meshData.Vertices[1] = Vertex(
+	sink.SetVertex(1, Vertex(
 		x, y, depth,
 		0.0f, 0.0f, -1.0f,
 		1.0f, 0.0f, 0.0f,
-		0.0f, 0.0f);
+		0.0f, 0.0f));
 
-	meshData.Vertices[2] = Vertex(
+	sink.SetVertex(2, Vertex(
 		x+w, y, depth,
 		0.0f, 0.0f, -1.0f,
 		1.0f, 0.0f, 0.0f,
-		1.0f, 0.0f);
+		1.0f, 0.0f));
 
-	meshData.Vertices[3] = Vertex(
+	sink.SetVertex(3, Vertex(
 		x+w, y-h, depth,
 		0.0f, 0.0f, -1.0f,
 		1.0f, 0.0f, 0.0f,
-		1.0f, 1.0f);
+		1.0f, 1.0f));
 
-	meshData.Indices32[0] = 0;
-	meshData.Indices32[1] = 1;
-	meshData.Indices32[2] = 2;
+	sink.SetIndex(0, 0);
+	sink.SetIndex(1, 1);
+	sink.SetIndex(2, 2);
 
-	meshData.Indices32[3] = 0;
-	meshData.Indices32[4] = 2;
-	meshData.Indices32[5] = 3;
+	sink.SetIndex(3, 0);
+	sink.SetIndex(4, 2);
+	sink.SetIndex(5, 3);
+}
 
-    return meshData;
+GeometryGenerator::MeshSize GeometryGenerator::BoxSize(uint32 numSubdivisions)
+{
+    // Every face is welded into its own (2^s+1)^2 vertex grid.
+    numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
+    const uint32 edge = (1u << numSubdivisions) + 1;
+
+    MeshSize size;
+    size.VertexCount = 6*edge*edge;
+    size.IndexCount = 36u << (2*numSubdivisions);
+    return size;
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::SphereSize(uint32 sliceCount, uint32 stackCount)
+{
+    MeshSize size;
+    size.VertexCount = (stackCount-1)*(sliceCount+1) + 2;
+    size.IndexCount = 6*sliceCount*(stackCount-1);
+    return size;
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::GeosphereSize(uint32 numSubdivisions)
+{
+    numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
+
+    MeshSize size;
+    size.VertexCount = (10u << (2*numSubdivisions)) + 2;
+    size.IndexCount = 60u << (2*numSubdivisions);
+    return size;
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::CylinderSize(uint32 sliceCount, uint32 stackCount)
+{
+    // Rings, then two caps of a ring plus center each.
+    MeshSize size;
+    size.VertexCount = (stackCount+1)*(sliceCount+1) + 2*(sliceCount+2);
+    size.IndexCount = 6*sliceCount*stackCount + 6*sliceCount;
+    return size;
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::GridSize(uint32 m, uint32 n)
+{
+    MeshSize size;
+    size.VertexCount = m*n;
+    size.IndexCount = (m-1)*(n-1)*6;
+    return size;
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::QuadSize()
+{
+    MeshSize size;
+    size.VertexCount = 4;
+    size.IndexCount = 6;
+    return size;
+}
+
+GeometryGenerator::MeshSink GeometryGenerator::MeshDataSink(MeshData& meshData, MeshSize size)
+{
+    meshData.Vertices.resize(size.VertexCount);
+    meshData.Indices32.resize(size.IndexCount);
+
+    auto writeVertex = [](void* context, uint32 index, const Vertex& v)
+    {
+        static_cast<MeshData*>(context)->Vertices[index] = v;
+    };
+    return MeshSink(writeVertex, &meshData, meshData.Indices32.data());
+}
+
+void GeometryGenerator::EmitMesh(const MeshData& meshData, MeshSink& sink)
+{
+    for(uint32 i = 0; i < (uint32)meshData.Vertices.size(); ++i)
+        sink.SetVertex(i, meshData.Vertices[i]);
+
+    for(uint32 i = 0; i < (uint32)meshData.Indices32.size(); ++i)
+        sink.SetIndex(i, meshData.Indices32[i]);
 }
@@ -110,10 +110,191 @@ public:
 	///</summary>
     MeshData CreateQuad(float x, float y, float w, float h, float depth);
 
+	///<summary>
+	/// Vertex and index counts of each shape, so a buffer shared by several shapes can be
+	/// sized before any of them is generated.
+	///</summary>
+    struct MeshSize
+    {
+        uint32 VertexCount = 0;
+        uint32 IndexCount = 0;
+    };
+
+    static MeshSize BoxSize(uint32 numSubdivisions);
+    static MeshSize SphereSize(uint32 sliceCount, uint32 stackCount);
+    static MeshSize GeosphereSize(uint32 numSubdivisions);
+    static MeshSize CylinderSize(uint32 sliceCount, uint32 stackCount);
+    static MeshSize GridSize(uint32 m, uint32 n);
+    static MeshSize QuadSize();
+
+	///<summary>
+	/// Vertex attributes a Write* caller actually reads, see VertexFormat. The others
+	/// are left undefined and their math is skipped. Position is always generated.
+	///</summary>
+    enum EAttribute : uint32
+    {
+        AttributePosition = 1 << 0,
+        AttributeNormal   = 1 << 1,
+        AttributeTangentU = 1 << 2,
+        AttributeTexC     = 1 << 3,
+        AttributeAll      = AttributePosition | AttributeNormal | AttributeTangentU | AttributeTexC
+    };
+
+	///<summary>
+	/// Same shapes as the Create* functions, written straight into caller memory such as
+	/// a slice of a combined vertex/index buffer. writer(VertexT& dst, const Vertex& src)
+	/// converts each vertex to the caller's format and may be called from several threads
+	/// at once. IndexT is uint16 or uint32, indices are relative to the shape's first
+	/// vertex. The buffers must hold the counts the matching *Size() returns, which is
+	/// also what these return. attributes is a mask of EAttribute. Box and geosphere are
+	/// subdivided in a scratch MeshData first, the other shapes are generated in place.
+	///</summary>
+    template<typename VertexT, typename IndexT, typename Writer>
+    MeshSize WriteBox(float width, float height, float depth, uint32 numSubdivisions, VertexT* vertices, IndexT* indices, Writer writer, uint32 attributes = AttributeAll);
+
+    template<typename VertexT, typename IndexT, typename Writer>
+    MeshSize WriteSphere(float radius, uint32 sliceCount, uint32 stackCount, VertexT* vertices, IndexT* indices, Writer writer, uint32 attributes = AttributeAll);
+
+    template<typename VertexT, typename IndexT, typename Writer>
+    MeshSize WriteGeosphere(float radius, uint32 numSubdivisions, VertexT* vertices, IndexT* indices, Writer writer, uint32 attributes = AttributeAll);
+
+    template<typename VertexT, typename IndexT, typename Writer>
+    MeshSize WriteCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, VertexT* vertices, IndexT* indices, Writer writer, uint32 attributes = AttributeAll);
+
+    template<typename VertexT, typename IndexT, typename Writer>
+    MeshSize WriteGrid(float width, float depth, uint32 m, uint32 n, VertexT* vertices, IndexT* indices, Writer writer, uint32 attributes = AttributeAll);
+
+    template<typename VertexT, typename IndexT, typename Writer>
+    MeshSize WriteQuad(float x, float y, float w, float h, float depth, VertexT* vertices, IndexT* indices, Writer writer, uint32 attributes = AttributeAll);
+
 private:
+    // Where the shape builders put their output, a MeshData or caller memory. Vertices
+    // go through a function pointer so the builders don't have to be templates.
+    class MeshSink
+    {
+    public:
+        using VertexFn = void(*)(void* context, uint32 index, const Vertex& v);
+
+        MeshSink(VertexFn writeVertex, void* context, uint16* indices)
+            : mWriteVertex(writeVertex), mContext(context), mIndices16(indices) {}
+        MeshSink(VertexFn writeVertex, void* context, uint32* indices)
+            : mWriteVertex(writeVertex), mContext(context), mIndices32(indices) {}
+
+        void SetVertex(uint32 index, const Vertex& v) { mWriteVertex(mContext, index, v); }
+        void SetIndex(uint32 at, uint32 value)
+        {
+            if(mIndices16)
+                mIndices16[at] = static_cast<uint16>(value);
+            else
+                mIndices32[at] = value;
+        }
+
+        // Sequential form, for builders that produce vertices and indices in order.
+        void AddVertex(const Vertex& v) { SetVertex(mVertexCount++, v); }
+        void AddIndex(uint32 value) { SetIndex(mIndexCount++, value); }
+        uint32 VertexCount()const { return mVertexCount; }
+
+        void SetAttributes(uint32 attributes) { mAttributes = attributes; }
+        bool Wants(uint32 attribute)const { return (mAttributes & attribute) != 0; }
+
+    private:
+        VertexFn mWriteVertex = nullptr;
+        void* mContext = nullptr;
+        uint16* mIndices16 = nullptr;
+        uint32* mIndices32 = nullptr;
+        uint32 mVertexCount = 0;
+        uint32 mIndexCount = 0;
+        uint32 mAttributes = AttributeAll;
+    };
+
+    template<typename VertexT, typename Writer>
+    struct VertexWriter
+    {
+        VertexT* Vertices;
+        Writer* Write;
+
+        static void Invoke(void* context, uint32 index, const Vertex& v)
+        {
+            VertexWriter* self = static_cast<VertexWriter*>(context);
+            (*self->Write)(self->Vertices[index], v);
+        }
+    };
+
+    template<typename VertexT, typename IndexT, typename Writer, typename Build>
+    static void WriteMesh(VertexT* vertices, IndexT* indices, Writer& writer, uint32 attributes, Build build)
+    {
+        VertexWriter<VertexT, Writer> context = { vertices, &writer };
+        MeshSink sink(&VertexWriter<VertexT, Writer>::Invoke, &context, indices);
+        sink.SetAttributes(attributes);
+        build(sink);
+    }
+
+    static MeshSink MeshDataSink(MeshData& meshData, MeshSize size);
+    static void EmitMesh(const MeshData& meshData, MeshSink& sink);
+
+    MeshData GenerateGeosphere(float radius, uint32 numSubdivisions, uint32 attributes);
+
+    void BuildSphere(float radius, uint32 sliceCount, uint32 stackCount, MeshSink& sink);
+    void BuildCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshSink& sink);
+    void BuildGrid(float width, float depth, uint32 m, uint32 n, MeshSink& sink);
+    void BuildQuad(float x, float y, float w, float h, float depth, MeshSink& sink);
+
 	void Subdivide(MeshData& meshData);
     Vertex MidPoint(const Vertex& v0, const Vertex& v1);
-    void BuildCylinderTopCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
-    void BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
+    void BuildCylinderTopCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshSink& sink);
+    void BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshSink& sink);
 };
 
+template<typename VertexT, typename IndexT, typename Writer>
+GeometryGenerator::MeshSize GeometryGenerator::WriteBox(float width, float height, float depth, uint32 numSubdivisions,
+    VertexT* vertices, IndexT* indices, Writer writer, uint32 attributes)
+{
+    const MeshData box = CreateBox(width, height, depth, numSubdivisions);
+    WriteMesh(vertices, indices, writer, attributes, [&box](MeshSink& sink) { EmitMesh(box, sink); });
+    return BoxSize(numSubdivisions);
+}
+
+template<typename VertexT, typename IndexT, typename Writer>
+GeometryGenerator::MeshSize GeometryGenerator::WriteSphere(float radius, uint32 sliceCount, uint32 stackCount,
+    VertexT* vertices, IndexT* indices, Writer writer, uint32 attributes)
+{
+    WriteMesh(vertices, indices, writer, attributes, [&](MeshSink& sink) { BuildSphere(radius, sliceCount, stackCount, sink); });
+    return SphereSize(sliceCount, stackCount);
+}
+
+template<typename VertexT, typename IndexT, typename Writer>
+GeometryGenerator::MeshSize GeometryGenerator::WriteGeosphere(float radius, uint32 numSubdivisions,
+    VertexT* vertices, IndexT* indices, Writer writer, uint32 attributes)
+{
+    const MeshData geosphere = GenerateGeosphere(radius, numSubdivisions, attributes);
+    WriteMesh(vertices, indices, writer, attributes, [&geosphere](MeshSink& sink) { EmitMesh(geosphere, sink); });
+    return GeosphereSize(numSubdivisions);
+}
+
+template<typename VertexT, typename IndexT, typename Writer>
+GeometryGenerator::MeshSize GeometryGenerator::WriteCylinder(float bottomRadius, float topRadius, float height,
+    uint32 sliceCount, uint32 stackCount, VertexT* vertices, IndexT* indices, Writer writer, uint32 attributes)
+{
+    WriteMesh(vertices, indices, writer, attributes, [&](MeshSink& sink)
+    {
+        BuildCylinder(bottomRadius, topRadius, height, sliceCount, stackCount, sink);
+    });
+    return CylinderSize(sliceCount, stackCount);
+}
+
+template<typename VertexT, typename IndexT, typename Writer>
+GeometryGenerator::MeshSize GeometryGenerator::WriteGrid(float width, float depth, uint32 m, uint32 n,
+    VertexT* vertices, IndexT* indices, Writer writer, uint32 attributes)
+{
+    WriteMesh(vertices, indices, writer, attributes, [&](MeshSink& sink) { BuildGrid(width, depth, m, n, sink); });
+    return GridSize(m, n);
+}
+
+template<typename VertexT, typename IndexT, typename Writer>
+GeometryGenerator::MeshSize GeometryGenerator::WriteQuad(float x, float y, float w, float h, float depth,
+    VertexT* vertices, IndexT* indices, Writer writer, uint32 attributes)
+{
+    WriteMesh(vertices, indices, writer, attributes, [&](MeshSink& sink) { BuildQuad(x, y, w, h, depth, sink); });
+    return QuadSize();
+}
+
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+// Unbounded multi-producer queue with a batch consumer. Push() is lock-free, a single
+// CAS on the list head from any thread. Drain() takes everything pushed so far with one
+// exchange, which is what batch consumers want anyway and avoids the ABA problem of
+// popping nodes one at a time.
+template<typename T>
+class MPSCQueue
+{
+public:
+    MPSCQueue() : mHead(nullptr) {}
+    MPSCQueue(const MPSCQueue& rhs) = delete;
+    MPSCQueue& operator=(const MPSCQueue& rhs) = delete;
+
+    ~MPSCQueue()
+    {
+        Node* node = mHead.exchange(nullptr);
+        while (node)
+        {
+            Node* next = node->Next;
+            delete node;
+            node = next;
+        }
+    }
+
+    void Push(const T& value)
+    {
+        Node* node = new Node{ value, mHead.load(std::memory_order_relaxed) };
+
+        // release publishes the node's contents to the thread that drains it.
+        while (!mHead.compare_exchange_weak(node->Next, node, std::memory_order_release, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    bool IsEmpty()const { return mHead.load(std::memory_order_relaxed) == nullptr; }
+
+    // Appends all queued items to out, oldest first for any one producer.
+    template<typename Container>
+    void Drain(Container& out)
+    {
+        Node* node = mHead.exchange(nullptr, std::memory_order_acquire);
+
+        // The list is newest first, reverse it.
+        Node* oldest = nullptr;
+        while (node)
+        {
+            Node* next = node->Next;
+            node->Next = oldest;
+            oldest = node;
+            node = next;
+        }
+
+        while (oldest)
+        {
+            out.push_back(std::move(oldest->Value));
+            Node* next = oldest->Next;
+            delete oldest;
+            oldest = next;
+        }
+    }
+
+private:
+    struct Node
+    {
+        T Value;
+        Node* Next;
+    };
+
+    std::atomic<Node*> mHead;
+};
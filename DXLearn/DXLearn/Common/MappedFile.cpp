@@ -0,0 +1,171 @@
+#include "MappedFile.h"
+
+#include <utility>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    // Paths are UTF-8 outside Windows.
+    std::string ToUtf8(const std::wstring& path)
+    {
+        std::string utf8;
+        for (wchar_t c : path)
+        {
+            const unsigned long code = static_cast<unsigned long>(c);
+            if (code < 0x80)
+            {
+                utf8 += static_cast<char>(code);
+            }
+            else if (code < 0x800)
+            {
+                utf8 += static_cast<char>(0xc0 | (code >> 6));
+                utf8 += static_cast<char>(0x80 | (code & 0x3f));
+            }
+            else if (code < 0x10000)
+            {
+                utf8 += static_cast<char>(0xe0 | (code >> 12));
+                utf8 += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+                utf8 += static_cast<char>(0x80 | (code & 0x3f));
+            }
+            else
+            {
+                utf8 += static_cast<char>(0xf0 | (code >> 18));
+                utf8 += static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+                utf8 += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+                utf8 += static_cast<char>(0x80 | (code & 0x3f));
+            }
+        }
+        return utf8;
+    }
+}
+#endif
+
+MappedFile::MappedFile(MappedFile&& other)
+{
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other)
+{
+    if (this != &other)
+    {
+        Close();
+#if defined(_WIN32)
+        std::swap(mFile, other.mFile);
+        std::swap(mMapping, other.mMapping);
+#endif
+        std::swap(mData, other.mData);
+        std::swap(mSize, other.mSize);
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#if defined(_WIN32)
+bool MappedFile::Open(const std::wstring& path)
+{
+    Close();
+
+    mFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (mFile == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    // Empty files can't be mapped.
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(mFile, &size) || size.QuadPart == 0 ||
+        static_cast<unsigned long long>(size.QuadPart) > static_cast<std::size_t>(-1))
+    {
+        Close();
+        return false;
+    }
+
+    mMapping = CreateFileMappingW(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mMapping == nullptr)
+    {
+        Close();
+        return false;
+    }
+
+    mData = MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+    if (mData == nullptr)
+    {
+        Close();
+        return false;
+    }
+
+    mSize = static_cast<std::size_t>(size.QuadPart);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (mData)
+    {
+        UnmapViewOfFile(mData);
+        mData = nullptr;
+    }
+    if (mMapping)
+    {
+        CloseHandle(mMapping);
+        mMapping = nullptr;
+    }
+    if (mFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(mFile);
+        mFile = INVALID_HANDLE_VALUE;
+    }
+    mSize = 0;
+}
+#else
+bool MappedFile::Open(const std::wstring& path)
+{
+    Close();
+
+    const int file = open(ToUtf8(path).c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        return false;
+    }
+
+    // Empty files can't be mapped. The mapping keeps its own reference, the descriptor isn't
+    // needed past this.
+    struct stat status;
+    void* data = MAP_FAILED;
+    if (fstat(file, &status) == 0 && S_ISREG(status.st_mode) && status.st_size > 0 &&
+        static_cast<unsigned long long>(status.st_size) <= static_cast<std::size_t>(-1))
+    {
+        data = mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+    }
+    close(file);
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    mData = data;
+    mSize = static_cast<std::size_t>(status.st_size);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (mData)
+    {
+        munmap(const_cast<void*>(mData), mSize);
+        mData = nullptr;
+    }
+    mSize = 0;
+}
+#endif
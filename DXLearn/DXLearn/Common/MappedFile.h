@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+// Read-only memory mapping of a whole file. Pages are read on first touch, so opening is
+// nearly free and only the parts actually used ever come from disk. Builds on POSIX too, so
+// the loaders on top of it can be used by tools outside the renderer.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile& other) = delete;
+    MappedFile& operator=(const MappedFile& other) = delete;
+    MappedFile(MappedFile&& other);
+    MappedFile& operator=(MappedFile&& other);
+
+    ~MappedFile();
+
+public:
+    // False if the file doesn't exist, is empty or can't be mapped.
+    bool Open(const std::wstring& path);
+    void Close();
+
+    bool IsOpen()const { return mData != nullptr; }
+    const void* Data()const { return mData; }
+    std::size_t Size()const { return mSize; }
+
+private:
+#if defined(_WIN32)
+    HANDLE mFile = INVALID_HANDLE_VALUE;
+    HANDLE mMapping = nullptr;
+#endif
+    const void* mData = nullptr;
+    std::size_t mSize = 0;
+};
@@ -0,0 +1,586 @@
+#include "MeshCodec.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+
+#include "SimdUtil.h"
+
+using namespace DirectX;
+
+namespace
+{
+    using uint8 = std::uint8_t;
+    using uint16 = std::uint16_t;
+    using uint32 = std::uint32_t;
+
+    static_assert(sizeof(QuantizedVertex) == 16, "QuantizedVertex is stored as it is in memory");
+
+    // First byte of every encoded buffer, bump when the layout changes.
+    const uint8 CodecVersion = 1;
+
+    // Values packed with one bit width, and the largest vertex the block buffers take.
+    const std::size_t GroupSize = 16;
+    const std::size_t MaxStride = 256;
+
+    // Items decoded at once, sized so a block of planes stays in L1.
+    const std::size_t BlockBytes = 8192;
+    const std::size_t MaxBlockItems = 256;
+
+    // Payload bytes of a group for each 2-bit width code: 0, 2, 4 and 8 bits per value.
+    const std::size_t GroupBytes[4] = { 0, 4, 8, 16 };
+
+    std::size_t BlockItems(std::size_t stride)
+    {
+        return std::min(MaxBlockItems, std::max(GroupSize, (BlockBytes / stride) & ~(GroupSize - 1)));
+    }
+
+    inline uint8 ZigZag8(uint8 delta)
+    {
+        return static_cast<uint8>((delta << 1) ^ (static_cast<std::int8_t>(delta) >> 7));
+    }
+
+    inline uint32 ZigZag32(uint32 delta)
+    {
+        return (delta << 1) ^ static_cast<uint32>(static_cast<std::int32_t>(delta) >> 31);
+    }
+
+    inline uint32 UnZigZag32(uint32 value)
+    {
+        return (value >> 1) ^ (0u - (value & 1));
+    }
+
+    //
+    // Encoding of one byte plane: a header of 2-bit width codes, four groups per byte,
+    // followed by the group payloads. Within a payload value i sits at
+    //   2 bits: bits 2*(i/4) of byte i%4
+    //   4 bits: bits 4*(i/8) of byte i%8
+    // which SSE2 unpacks with shifts, masks and unpacks.
+    //
+
+    void EncodePlane(std::vector<uint8>& out, const uint8* values, std::size_t groupCount)
+    {
+        const std::size_t headerOffset = out.size();
+        out.resize(out.size() + (groupCount + 3) / 4, 0);
+
+        for (std::size_t g = 0; g < groupCount; ++g)
+        {
+            const uint8* v = values + g*GroupSize;
+            const uint8 maxValue = *std::max_element(v, v + GroupSize);
+            const uint8 code = maxValue == 0 ? 0 : maxValue < 4 ? 1 : maxValue < 16 ? 2 : 3;
+            out[headerOffset + g/4] |= static_cast<uint8>(code << (2*(g % 4)));
+
+            if (code == 1)
+            {
+                for (std::size_t j = 0; j < 4; ++j)
+                {
+                    out.push_back(static_cast<uint8>(v[j] | (v[j + 4] << 2) | (v[j + 8] << 4) | (v[j + 12] << 6)));
+                }
+            }
+            else if (code == 2)
+            {
+                for (std::size_t j = 0; j < 8; ++j)
+                {
+                    out.push_back(static_cast<uint8>(v[j] | (v[j + 8] << 4)));
+                }
+            }
+            else if (code == 3)
+            {
+                out.insert(out.end(), v, v + GroupSize);
+            }
+        }
+    }
+
+    // Unpacks groupCount groups into values, false if the plane runs past end.
+    bool DecodePlane(const uint8*& p, const uint8* end, uint8* values, std::size_t groupCount)
+    {
+        const std::size_t headerSize = (groupCount + 3) / 4;
+        if (static_cast<std::size_t>(end - p) < headerSize)
+        {
+            return false;
+        }
+
+        const uint8* header = p;
+        std::size_t payloadSize = 0;
+        for (std::size_t g = 0; g < groupCount; ++g)
+        {
+            payloadSize += GroupBytes[(header[g/4] >> (2*(g % 4))) & 3];
+        }
+        if (static_cast<std::size_t>(end - p) - headerSize < payloadSize)
+        {
+            return false;
+        }
+
+        const uint8* data = p + headerSize;
+        const __m128i mask2 = _mm_set1_epi8(3);
+        const __m128i mask4 = _mm_set1_epi8(15);
+        for (std::size_t g = 0; g < groupCount; ++g)
+        {
+            __m128i v;
+            switch ((header[g/4] >> (2*(g % 4))) & 3)
+            {
+            case 0:
+                v = _mm_setzero_si128();
+                break;
+            case 1:
+            {
+                int bits;
+                std::memcpy(&bits, data, sizeof(bits));
+                const __m128i x = _mm_cvtsi32_si128(bits);
+                const __m128i a = _mm_and_si128(x, mask2);
+                const __m128i b = _mm_and_si128(_mm_srli_epi16(x, 2), mask2);
+                const __m128i c = _mm_and_si128(_mm_srli_epi16(x, 4), mask2);
+                const __m128i d = _mm_and_si128(_mm_srli_epi16(x, 6), mask2);
+                v = _mm_unpacklo_epi64(_mm_unpacklo_epi32(a, b), _mm_unpacklo_epi32(c, d));
+                data += 4;
+                break;
+            }
+            case 2:
+            {
+                const __m128i x = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(data));
+                v = _mm_unpacklo_epi64(_mm_and_si128(x, mask4), _mm_and_si128(_mm_srli_epi16(x, 4), mask4));
+                data += 8;
+                break;
+            }
+            default:
+                v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+                data += 16;
+                break;
+            }
+            _mm_store_si128(reinterpret_cast<__m128i*>(values + g*GroupSize), v);
+        }
+
+        p = data;
+        return true;
+    }
+
+    // Four planes of 16 bytes to 16 interleaved 4-byte values: out[i] = (p0[i], p1[i], p2[i], p3[i]).
+    inline void Interleave4(const uint8* p0, const uint8* p1, const uint8* p2, const uint8* p3, __m128i out[4])
+    {
+        const __m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(p0));
+        const __m128i b = _mm_load_si128(reinterpret_cast<const __m128i*>(p1));
+        const __m128i c = _mm_load_si128(reinterpret_cast<const __m128i*>(p2));
+        const __m128i d = _mm_load_si128(reinterpret_cast<const __m128i*>(p3));
+
+        const __m128i abLo = _mm_unpacklo_epi8(a, b);
+        const __m128i abHi = _mm_unpackhi_epi8(a, b);
+        const __m128i cdLo = _mm_unpacklo_epi8(c, d);
+        const __m128i cdHi = _mm_unpackhi_epi8(c, d);
+
+        out[0] = _mm_unpacklo_epi16(abLo, cdLo);
+        out[1] = _mm_unpackhi_epi16(abLo, cdLo);
+        out[2] = _mm_unpacklo_epi16(abHi, cdHi);
+        out[3] = _mm_unpackhi_epi16(abHi, cdHi);
+    }
+
+    // Aligned scratch for one block of planes, BlockItems() keeps stride*items within it.
+    struct alignas(16) BlockBuffer
+    {
+        uint8 Data[BlockBytes];
+    };
+}
+
+PositionQuantization PositionQuantization::FromBounds(const BoundingBox& bounds)
+{
+    PositionQuantization quantization;
+    quantization.Offset = XMFLOAT3(bounds.Center.x - bounds.Extents.x, bounds.Center.y - bounds.Extents.y,
+        bounds.Center.z - bounds.Extents.z);
+    quantization.Scale = XMFLOAT3(bounds.Extents.x*2.0f / 65535.0f, bounds.Extents.y*2.0f / 65535.0f,
+        bounds.Extents.z*2.0f / 65535.0f);
+    return quantization;
+}
+
+void MeshCodec::EncodeOctahedral(const XMFLOAT3& normal, std::int16_t encoded[2])
+{
+    // Project onto the octahedron |x| + |y| + |z| = 1 and fold the lower half over the diagonals.
+    const float length = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+    float x = length > 0.0f ? normal.x / length : 0.0f;
+    float y = length > 0.0f ? normal.y / length : 0.0f;
+    if (normal.z < 0.0f)
+    {
+        const float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        const float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+
+    encoded[0] = static_cast<std::int16_t>(std::lround(std::min(std::max(x, -1.0f), 1.0f) * 32767.0f));
+    encoded[1] = static_cast<std::int16_t>(std::lround(std::min(std::max(y, -1.0f), 1.0f) * 32767.0f));
+}
+
+XMFLOAT3 MeshCodec::DecodeOctahedral(const std::int16_t encoded[2])
+{
+    float x = std::max(encoded[0] / 32767.0f, -1.0f);
+    float y = std::max(encoded[1] / 32767.0f, -1.0f);
+    const float z = 1.0f - std::fabs(x) - std::fabs(y);
+
+    // Unfold the lower half.
+    const float t = std::max(-z, 0.0f);
+    x += x >= 0.0f ? -t : t;
+    y += y >= 0.0f ? -t : t;
+
+    const float invLength = 1.0f / std::sqrt(x*x + y*y + z*z);
+    return XMFLOAT3(x*invLength, y*invLength, z*invLength);
+}
+
+void MeshCodec::Quantize(QuantizedVertex* dest, std::size_t count, const PositionQuantization& quantization,
+    const float* positions, const float* normals, const float* texCoords, std::size_t stride)
+{
+    const float* offset = &quantization.Offset.x;
+    const float* scale = &quantization.Scale.x;
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const std::size_t first = i*stride / sizeof(float);
+        QuantizedVertex& q = dest[i];
+
+        const float* p = positions + first;
+        for (int c = 0; c < 3; ++c)
+        {
+            const float steps = scale[c] > 0.0f ? (p[c] - offset[c]) / scale[c] : 0.0f;
+            q.Position[c] = static_cast<uint16>(std::lround(std::min(std::max(steps, 0.0f), 65535.0f)));
+        }
+        q.Position[3] = 0;
+
+        if (normals)
+        {
+            const float* n = normals + first;
+            EncodeOctahedral(XMFLOAT3(n[0], n[1], n[2]), q.Normal);
+        }
+        else
+        {
+            q.Normal[0] = q.Normal[1] = 0;
+        }
+
+        q.TexC[0] = texCoords ? SimdUtil::FloatToHalf(texCoords[first]) : 0;
+        q.TexC[1] = texCoords ? SimdUtil::FloatToHalf(texCoords[first + 1]) : 0;
+    }
+}
+
+void MeshCodec::Dequantize(float* positions, float* normals, float* texCoords, std::size_t stride,
+    const QuantizedVertex* src, std::size_t count, const PositionQuantization& quantization)
+{
+    assert(stride % sizeof(float) == 0);
+    const std::size_t step = stride / sizeof(float);
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const QuantizedVertex& q = src[i];
+
+        float* p = positions + i*step;
+        p[0] = quantization.Offset.x + q.Position[0]*quantization.Scale.x;
+        p[1] = quantization.Offset.y + q.Position[1]*quantization.Scale.y;
+        p[2] = quantization.Offset.z + q.Position[2]*quantization.Scale.z;
+
+        if (normals)
+        {
+            const XMFLOAT3 n = DecodeOctahedral(q.Normal);
+            float* dst = normals + i*step;
+            dst[0] = n.x;
+            dst[1] = n.y;
+            dst[2] = n.z;
+        }
+        if (texCoords)
+        {
+            float* dst = texCoords + i*step;
+            dst[0] = SimdUtil::HalfToFloat(q.TexC[0]);
+            dst[1] = SimdUtil::HalfToFloat(q.TexC[1]);
+        }
+    }
+}
+
+std::vector<MeshCodec::uint8> MeshCodec::EncodeVertexBuffer(const void* vertices, std::size_t count, std::size_t stride)
+{
+    assert(stride > 0 && stride % 4 == 0 && stride <= MaxStride);
+
+    const uint8* bytes = static_cast<const uint8*>(vertices);
+    const std::size_t blockItems = BlockItems(stride);
+
+    std::vector<uint8> out;
+    out.reserve(count*stride / 2 + 16);
+    out.push_back(CodecVersion);
+
+    std::vector<uint8> previous(stride, 0);
+    std::vector<uint8> plane(blockItems);
+    for (std::size_t first = 0; first < count; first += blockItems)
+    {
+        const std::size_t itemCount = std::min(blockItems, count - first);
+        const std::size_t groupCount = (itemCount + GroupSize - 1) / GroupSize;
+
+        for (std::size_t k = 0; k < stride; ++k)
+        {
+            // Padding past the last vertex repeats it, a zero delta.
+            std::fill(plane.begin(), plane.end(), uint8(0));
+            uint8 last = previous[k];
+            for (std::size_t i = 0; i < itemCount; ++i)
+            {
+                const uint8 value = bytes[(first + i)*stride + k];
+                plane[i] = ZigZag8(static_cast<uint8>(value - last));
+                last = value;
+            }
+            previous[k] = last;
+
+            EncodePlane(out, plane.data(), groupCount);
+        }
+    }
+    return out;
+}
+
+bool MeshCodec::DecodeVertexBuffer(void* vertices, std::size_t count, std::size_t stride,
+    const uint8* encoded, std::size_t encodedSize)
+{
+    if (stride == 0 || stride % 4 != 0 || stride > MaxStride || encodedSize == 0 || encoded[0] != CodecVersion)
+    {
+        return false;
+    }
+
+    uint8* bytes = static_cast<uint8*>(vertices);
+    const std::size_t blockItems = BlockItems(stride);
+    const uint8* p = encoded + 1;
+    const uint8* end = encoded + encodedSize;
+
+    BlockBuffer block;
+    alignas(16) uint8 previous[MaxStride] = {};
+
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i low7 = _mm_set1_epi8(0x7f);
+    for (std::size_t first = 0; first < count; first += blockItems)
+    {
+        const std::size_t itemCount = std::min(blockItems, count - first);
+        const std::size_t groupCount = (itemCount + GroupSize - 1) / GroupSize;
+
+        for (std::size_t k = 0; k < stride; ++k)
+        {
+            uint8* plane = block.Data + k*blockItems;
+            if (!DecodePlane(p, end, plane, groupCount))
+            {
+                return false;
+            }
+
+            // Undo the zigzag, then a running sum over the vertices restores the bytes.
+            __m128i last = _mm_set1_epi8(static_cast<char>(previous[k]));
+            for (std::size_t g = 0; g < groupCount; ++g)
+            {
+                __m128i* group = reinterpret_cast<__m128i*>(plane + g*GroupSize);
+                const __m128i v = _mm_load_si128(group);
+                const __m128i sign = _mm_cmpeq_epi8(_mm_and_si128(v, one), one);
+                __m128i sum = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(v, 1), low7), sign);
+
+                sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 1));
+                sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 2));
+                sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 4));
+                sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 8));
+                sum = _mm_add_epi8(sum, last);
+                _mm_store_si128(group, sum);
+
+                // Broadcast byte 15 without a round trip through memory.
+                last = _mm_unpackhi_epi8(sum, sum);
+                last = _mm_shuffle_epi32(_mm_shufflehi_epi16(last, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+            }
+            previous[k] = plane[itemCount - 1];
+        }
+
+        // Planes back to vertices. Sixteen bytes of 16 vertices at a time are a 4x4 transpose of
+        // the interleaved quads, what's left of the stride goes out four bytes per vertex.
+        uint8* dest = bytes + first*stride;
+        const std::size_t fullItems = itemCount & ~(GroupSize - 1);
+        std::size_t k = 0;
+        for (; k + 16 <= stride; k += 16)
+        {
+            const uint8* planes = block.Data + k*blockItems;
+            for (std::size_t i = 0; i < fullItems; i += GroupSize)
+            {
+                __m128i quads[4][4];
+                for (int c = 0; c < 4; ++c)
+                {
+                    const uint8* plane = planes + 4*c*blockItems + i;
+                    Interleave4(plane, plane + blockItems, plane + 2*blockItems, plane + 3*blockItems, quads[c]);
+                }
+
+                uint8* d = dest + i*stride + k;
+                for (int q = 0; q < 4; ++q)
+                {
+                    const __m128i t0 = _mm_unpacklo_epi32(quads[0][q], quads[1][q]);
+                    const __m128i t1 = _mm_unpacklo_epi32(quads[2][q], quads[3][q]);
+                    const __m128i t2 = _mm_unpackhi_epi32(quads[0][q], quads[1][q]);
+                    const __m128i t3 = _mm_unpackhi_epi32(quads[2][q], quads[3][q]);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(d), _mm_unpacklo_epi64(t0, t1));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(d + stride), _mm_unpackhi_epi64(t0, t1));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(d + 2*stride), _mm_unpacklo_epi64(t2, t3));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(d + 3*stride), _mm_unpackhi_epi64(t2, t3));
+                    d += 4*stride;
+                }
+            }
+        }
+        for (; k < stride; k += 4)
+        {
+            const uint8* planes = block.Data + k*blockItems;
+            for (std::size_t i = 0; i < fullItems; i += GroupSize)
+            {
+                __m128i quads[4];
+                Interleave4(planes + i, planes + blockItems + i, planes + 2*blockItems + i, planes + 3*blockItems + i, quads);
+
+                uint8* d = dest + i*stride + k;
+                for (int q = 0; q < 4; ++q)
+                {
+                    __m128i x = quads[q];
+                    for (int j = 0; j < 4; ++j)
+                    {
+                        const int value = _mm_cvtsi128_si32(x);
+                        std::memcpy(d, &value, sizeof(value));
+                        d += stride;
+                        x = _mm_srli_si128(x, 4);
+                    }
+                }
+            }
+        }
+        for (std::size_t i = fullItems; i < itemCount; ++i)
+        {
+            for (k = 0; k < stride; ++k)
+            {
+                dest[i*stride + k] = block.Data[k*blockItems + i];
+            }
+        }
+    }
+
+    return p == end;
+}
+
+std::vector<MeshCodec::uint8> MeshCodec::EncodeIndexBuffer(const void* indices, std::size_t count, std::size_t indexSize)
+{
+    assert(indexSize == 2 || indexSize == 4);
+
+    const std::size_t blockItems = MaxBlockItems;
+
+    std::vector<uint8> out;
+    out.reserve(count + 16);
+    out.push_back(CodecVersion);
+
+    std::vector<uint8> planes(4*blockItems);
+    uint32 previous = 0;
+    for (std::size_t first = 0; first < count; first += blockItems)
+    {
+        const std::size_t itemCount = std::min(blockItems, count - first);
+        const std::size_t groupCount = (itemCount + GroupSize - 1) / GroupSize;
+
+        std::fill(planes.begin(), planes.end(), uint8(0));
+        for (std::size_t i = 0; i < itemCount; ++i)
+        {
+            uint32 index;
+            if (indexSize == 2)
+            {
+                index = static_cast<const uint16*>(indices)[first + i];
+            }
+            else
+            {
+                index = static_cast<const uint32*>(indices)[first + i];
+            }
+
+            const uint32 value = ZigZag32(index - previous);
+            previous = index;
+            for (std::size_t b = 0; b < 4; ++b)
+            {
+                planes[b*blockItems + i] = static_cast<uint8>(value >> (8*b));
+            }
+        }
+
+        for (std::size_t b = 0; b < 4; ++b)
+        {
+            EncodePlane(out, planes.data() + b*blockItems, groupCount);
+        }
+    }
+    return out;
+}
+
+bool MeshCodec::DecodeIndexBuffer(void* indices, std::size_t count, std::size_t indexSize,
+    const uint8* encoded, std::size_t encodedSize)
+{
+    if ((indexSize != 2 && indexSize != 4) || encodedSize == 0 || encoded[0] != CodecVersion)
+    {
+        return false;
+    }
+
+    const std::size_t blockItems = MaxBlockItems;
+    const uint8* p = encoded + 1;
+    const uint8* end = encoded + encodedSize;
+
+    BlockBuffer block;
+    uint32 previous = 0;
+
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i bias = _mm_set1_epi32(0x8000);
+    const __m128i bias16 = _mm_set1_epi16(static_cast<short>(0x8000));
+    for (std::size_t first = 0; first < count; first += blockItems)
+    {
+        const std::size_t itemCount = std::min(blockItems, count - first);
+        const std::size_t groupCount = (itemCount + GroupSize - 1) / GroupSize;
+
+        for (std::size_t b = 0; b < 4; ++b)
+        {
+            if (!DecodePlane(p, end, block.Data + b*blockItems, groupCount))
+            {
+                return false;
+            }
+        }
+
+        const uint8* planes = block.Data;
+        const std::size_t fullItems = itemCount & ~(GroupSize - 1);
+        __m128i last = _mm_set1_epi32(static_cast<int>(previous));
+        for (std::size_t i = 0; i < fullItems; i += GroupSize)
+        {
+            __m128i values[4];
+            Interleave4(planes + i, planes + blockItems + i, planes + 2*blockItems + i, planes + 3*blockItems + i, values);
+
+            for (int q = 0; q < 4; ++q)
+            {
+                // Undo the zigzag and sum up the deltas.
+                const __m128i v = values[q];
+                __m128i sum = _mm_xor_si128(_mm_srli_epi32(v, 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(v, one)));
+                sum = _mm_add_epi32(sum, _mm_slli_si128(sum, 4));
+                sum = _mm_add_epi32(sum, _mm_slli_si128(sum, 8));
+                sum = _mm_add_epi32(sum, last);
+                last = _mm_shuffle_epi32(sum, _MM_SHUFFLE(3, 3, 3, 3));
+                values[q] = sum;
+            }
+
+            if (indexSize == 4)
+            {
+                __m128i* dest = reinterpret_cast<__m128i*>(static_cast<uint32*>(indices) + first + i);
+                for (int q = 0; q < 4; ++q)
+                {
+                    _mm_storeu_si128(dest + q, values[q]);
+                }
+            }
+            else
+            {
+                // SSE2 only packs with signed saturation, shift the range to fit.
+                __m128i* dest = reinterpret_cast<__m128i*>(static_cast<uint16*>(indices) + first + i);
+                for (int q = 0; q < 4; q += 2)
+                {
+                    const __m128i packed = _mm_packs_epi32(_mm_sub_epi32(values[q], bias), _mm_sub_epi32(values[q + 1], bias));
+                    _mm_storeu_si128(dest + q/2, _mm_xor_si128(packed, bias16));
+                }
+            }
+        }
+        previous = static_cast<uint32>(_mm_cvtsi128_si32(last));
+
+        for (std::size_t i = fullItems; i < itemCount; ++i)
+        {
+            const uint32 value = planes[i] | (planes[blockItems + i] << 8) | (planes[2*blockItems + i] << 16) |
+                (uint32(planes[3*blockItems + i]) << 24);
+            previous += UnZigZag32(value);
+            if (indexSize == 4)
+            {
+                static_cast<uint32*>(indices)[first + i] = previous;
+            }
+            else
+            {
+                static_cast<uint16*>(indices)[first + i] = static_cast<uint16>(previous);
+            }
+        }
+    }
+
+    return p == end;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <DirectXCollision.h>
+#include <DirectXMath.h>
+
+// Storage format of a vertex, 16 bytes instead of the 32 of position, normal and texC as floats.
+struct QuantizedVertex
+{
+    std::uint16_t Position[4];          // fractions of the mesh bounds, w is padding
+    std::int16_t Normal[2];             // octahedral, snorm
+    std::uint16_t TexC[2];              // half floats
+};
+
+// Maps 16-bit positions to the mesh bounds: position = Offset + q*Scale.
+struct PositionQuantization
+{
+    DirectX::XMFLOAT3 Offset = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+    DirectX::XMFLOAT3 Scale = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+    static PositionQuantization FromBounds(const DirectX::BoundingBox& bounds);
+};
+
+// Compression of stored meshes in two independent parts:
+//   1. Quantize/Dequantize convert vertices to and from QuantizedVertex. Positions lose
+//      precision beyond 1/65535 of the bounds, normals within about 0.05 degrees.
+//   2. Encode*/Decode* compress vertex and index buffers losslessly. Every vertex byte is
+//      stored as the difference to the same byte of the previous vertex, indices as the
+//      difference to the previous index, both zigzag encoded so small changes in either
+//      direction become small numbers. The values are split into byte planes (all first
+//      bytes, all second bytes, ...) and packed with 0, 2, 4 or 8 bits per value in groups
+//      of 16. Decoding is branch free within a group and runs on SSE2.
+// Run OptimizeVertexFetch first, vertices close in the buffer then tend to be close in space.
+class MeshCodec
+{
+public:
+    using uint8 = std::uint8_t;
+    using uint32 = std::uint32_t;
+
+    // Both on unit vectors.
+    static void EncodeOctahedral(const DirectX::XMFLOAT3& normal, std::int16_t encoded[2]);
+    static DirectX::XMFLOAT3 DecodeOctahedral(const std::int16_t encoded[2]);
+
+    // positions, normals and texCoords point at the first vertex's member and advance by
+    // stride bytes. normals and texCoords may be null, they are stored as zero then.
+    static void Quantize(QuantizedVertex* dest, std::size_t count, const PositionQuantization& quantization,
+        const float* positions, const float* normals, const float* texCoords, std::size_t stride);
+    static void Dequantize(float* positions, float* normals, float* texCoords, std::size_t stride,
+        const QuantizedVertex* src, std::size_t count, const PositionQuantization& quantization);
+
+    // Member pointer versions, normal and texC may be null.
+    template<typename VertexT>
+    static std::vector<QuantizedVertex> Quantize(const std::vector<VertexT>& vertices,
+        const PositionQuantization& quantization, DirectX::XMFLOAT3 VertexT::* position,
+        DirectX::XMFLOAT3 VertexT::* normal, DirectX::XMFLOAT2 VertexT::* texC);
+
+    template<typename VertexT>
+    static void Dequantize(VertexT* vertices, const QuantizedVertex* src, std::size_t count,
+        const PositionQuantization& quantization, DirectX::XMFLOAT3 VertexT::* position,
+        DirectX::XMFLOAT3 VertexT::* normal, DirectX::XMFLOAT2 VertexT::* texC);
+
+    // stride has to be a multiple of 4 and at most 256.
+    static std::vector<uint8> EncodeVertexBuffer(const void* vertices, std::size_t count, std::size_t stride);
+    static bool DecodeVertexBuffer(void* vertices, std::size_t count, std::size_t stride,
+        const uint8* encoded, std::size_t encodedSize);
+
+    // indexSize is 2 or 4 bytes, for the source and the destination.
+    static std::vector<uint8> EncodeIndexBuffer(const void* indices, std::size_t count, std::size_t indexSize);
+    static bool DecodeIndexBuffer(void* indices, std::size_t count, std::size_t indexSize,
+        const uint8* encoded, std::size_t encodedSize);
+};
+
+template<typename VertexT>
+std::vector<QuantizedVertex> MeshCodec::Quantize(const std::vector<VertexT>& vertices,
+    const PositionQuantization& quantization, DirectX::XMFLOAT3 VertexT::* position,
+    DirectX::XMFLOAT3 VertexT::* normal, DirectX::XMFLOAT2 VertexT::* texC)
+{
+    std::vector<QuantizedVertex> quantized(vertices.size());
+    if (!vertices.empty())
+    {
+        Quantize(quantized.data(), vertices.size(), quantization, &(vertices[0].*position).x,
+            normal ? &(vertices[0].*normal).x : nullptr, texC ? &(vertices[0].*texC).x : nullptr, sizeof(VertexT));
+    }
+    return quantized;
+}
+
+template<typename VertexT>
+void MeshCodec::Dequantize(VertexT* vertices, const QuantizedVertex* src, std::size_t count,
+    const PositionQuantization& quantization, DirectX::XMFLOAT3 VertexT::* position,
+    DirectX::XMFLOAT3 VertexT::* normal, DirectX::XMFLOAT2 VertexT::* texC)
+{
+    if (count > 0)
+    {
+        Dequantize(&(vertices[0].*position).x, normal ? &(vertices[0].*normal).x : nullptr,
+            texC ? &(vertices[0].*texC).x : nullptr, sizeof(VertexT), src, count, quantization);
+    }
+}
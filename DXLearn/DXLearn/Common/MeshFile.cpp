@@ -0,0 +1,437 @@
+#include "MeshFile.h"
+
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+#include <windows.h>
+
+using namespace DirectX;
+
+namespace
+{
+    using uint32 = std::uint32_t;
+    using uint64 = std::uint64_t;
+
+    const uint32 MeshFileMagic = 0x48534D44;    // "DMSH"
+
+    // Bump whenever a struct of the format changes, older files are rebuilt.
+    const uint32 MeshFileVersion = 3;
+
+    // Cache line, and enough for any SIMD load straight out of the mapping.
+    const uint64 SectionAlignment = 64;
+
+    static_assert(std::is_trivially_copyable<Meshlet>::value, "meshlets are stored as they are in memory");
+
+    inline uint64 AlignSection(uint64 offset)
+    {
+        return (offset + SectionAlignment - 1) & ~(SectionAlignment - 1);
+    }
+
+    // Writes size bytes and pads with zeros up to the next section.
+    bool WriteSection(std::ofstream& file, const void* data, uint64 size)
+    {
+        static const char padding[SectionAlignment] = {};
+        if (size > 0)
+        {
+            file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        }
+        file.write(padding, static_cast<std::streamsize>(AlignSection(size) - size));
+        return file.good();
+    }
+
+    bool SectionFits(uint64 offset, uint64 size, uint64 fileSize)
+    {
+        return offset % SectionAlignment == 0 && offset <= fileSize && size <= fileSize - offset;
+    }
+
+    // Every index has to name a vertex, and so does every index of a submesh once its base
+    // vertex is added. Submesh ranges are already known to lie in the index buffer.
+    template<typename Index>
+    bool IndicesInRange(const Index* indices, const MeshFileHeader& header, const MeshFileSubmesh* submeshes)
+    {
+        for (uint32 i = 0; i < header.IndexCount; ++i)
+        {
+            if (indices[i] >= header.VertexCount)
+            {
+                return false;
+            }
+        }
+
+        for (uint32 i = 0; i < header.SubmeshCount; ++i)
+        {
+            const MeshFileSubmesh& submesh = submeshes[i];
+            for (uint32 j = 0; j < submesh.IndexCount; ++j)
+            {
+                const std::int64_t vertex = std::int64_t(submesh.BaseVertexLocation) + indices[submesh.StartIndexLocation + j];
+                if (vertex < 0 || vertex >= header.VertexCount)
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    bool IndexDataInRange(const void* indices, const MeshFileHeader& header, const MeshFileSubmesh* submeshes)
+    {
+        return header.IndexSize == 2 ?
+            IndicesInRange(static_cast<const std::uint16_t*>(indices), header, submeshes) :
+            IndicesInRange(static_cast<const uint32*>(indices), header, submeshes);
+    }
+
+    // Meshlets have to stay inside the meshlet arrays and only name vertices of the mesh,
+    // their triangles only vertices of the meshlet.
+    bool MeshletsInRange(const unsigned char* bytes, const MeshFileHeader& header)
+    {
+        const Meshlet* meshlets = reinterpret_cast<const Meshlet*>(bytes + header.MeshletOffset);
+        const uint32* vertexIndices = reinterpret_cast<const uint32*>(bytes + header.MeshletVertexOffset);
+        const std::uint8_t* primitiveIndices = bytes + header.MeshletPrimitiveOffset;
+        for (uint32 i = 0; i < header.MeshletCount; ++i)
+        {
+            const Meshlet& meshlet = meshlets[i];
+            if (uint64(meshlet.VertexOffset) + meshlet.VertexCount > header.MeshletVertexCount ||
+                uint64(meshlet.TriangleOffset) + meshlet.TriangleCount > header.MeshletTriangleCount)
+            {
+                return false;
+            }
+            for (uint32 j = 0; j < meshlet.VertexCount; ++j)
+            {
+                if (vertexIndices[meshlet.VertexOffset + j] >= header.VertexCount)
+                {
+                    return false;
+                }
+            }
+            for (uint32 j = 0; j < meshlet.TriangleCount*3; ++j)
+            {
+                if (primitiveIndices[std::size_t(meshlet.TriangleOffset)*3 + j] >= meshlet.VertexCount)
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+}
+
+bool MeshFile::Write(const std::wstring& path, const MeshFileContents& contents)
+{
+    assert(contents.IndexSize == 2 || contents.IndexSize == 4);
+
+    MeshFileHeader header = {};
+    header.Magic = MeshFileMagic;
+    header.Version = MeshFileVersion;
+    header.SourceSize = contents.SourceSize;
+    header.SourceWriteTime = contents.SourceWriteTime;
+    header.BuildFlags = contents.BuildFlags;
+    header.VertexCount = contents.VertexCount;
+    header.StreamCount = static_cast<uint32>(contents.Streams.size());
+    header.IndexCount = contents.IndexCount;
+    header.IndexSize = contents.IndexSize;
+    header.IndexFlags = contents.IndexFlags;
+    header.SubmeshCount = static_cast<uint32>(contents.Submeshes.size());
+    header.BoundsCenter = contents.Bounds.Center;
+    header.BoundsExtents = contents.Bounds.Extents;
+    header.QuantizationOffset = contents.Quantization.Offset;
+    header.QuantizationScale = contents.Quantization.Scale;
+
+    if (contents.Meshlets)
+    {
+        header.MeshletCount = static_cast<uint32>(contents.Meshlets->Meshlets.size());
+        header.MeshletVertexCount = static_cast<uint32>(contents.Meshlets->VertexIndices.size());
+        header.MeshletTriangleCount = static_cast<uint32>(contents.Meshlets->PrimitiveIndices.size() / 3);
+    }
+
+    // Compress first, the layout depends on the sizes.
+    std::vector<std::vector<std::uint8_t>> encodedStreams(contents.Streams.size());
+    for (std::size_t i = 0; i < contents.Streams.size(); ++i)
+    {
+        const MeshFileContents::Stream& stream = contents.Streams[i];
+        assert(!(stream.Flags & MeshFileQuantized) || stream.Stride == sizeof(QuantizedVertex));
+        if (stream.Flags & MeshFileCompressed)
+        {
+            encodedStreams[i] = MeshCodec::EncodeVertexBuffer(stream.Data, contents.VertexCount, stream.Stride);
+        }
+    }
+    std::vector<std::uint8_t> encodedIndices;
+    if (contents.IndexFlags & MeshFileCompressed)
+    {
+        encodedIndices = MeshCodec::EncodeIndexBuffer(contents.Indices, contents.IndexCount, contents.IndexSize);
+    }
+
+    // Lay the sections out one after the other.
+    std::vector<MeshFileStream> streams(contents.Streams.size());
+    uint64 offset = AlignSection(sizeof(MeshFileHeader));
+    header.StreamTableOffset = offset;
+    offset += AlignSection(streams.size()*sizeof(MeshFileStream));
+    for (std::size_t i = 0; i < streams.size(); ++i)
+    {
+        streams[i].Stride = contents.Streams[i].Stride;
+        streams[i].Flags = contents.Streams[i].Flags;
+        streams[i].Offset = offset;
+        streams[i].Size = (streams[i].Flags & MeshFileCompressed) ? encodedStreams[i].size() :
+            uint64(contents.Streams[i].Stride)*contents.VertexCount;
+        offset += AlignSection(streams[i].Size);
+    }
+    header.IndexOffset = offset;
+    header.IndexDataSize = (header.IndexFlags & MeshFileCompressed) ? encodedIndices.size() :
+        uint64(contents.IndexCount)*contents.IndexSize;
+    offset += AlignSection(header.IndexDataSize);
+    header.SubmeshTableOffset = offset;
+    offset += AlignSection(uint64(header.SubmeshCount)*sizeof(MeshFileSubmesh));
+    header.MeshletOffset = offset;
+    offset += AlignSection(uint64(header.MeshletCount)*sizeof(Meshlet));
+    header.MeshletVertexOffset = offset;
+    offset += AlignSection(uint64(header.MeshletVertexCount)*sizeof(uint32));
+    header.MeshletPrimitiveOffset = offset;
+    offset += AlignSection(uint64(header.MeshletTriangleCount)*3);
+    header.FileSize = offset;
+
+    std::vector<MeshFileSubmesh> submeshes(contents.Submeshes.size());
+    for (std::size_t i = 0; i < submeshes.size(); ++i)
+    {
+        const MeshFileContents::Submesh& source = contents.Submeshes[i];
+        assert(source.Name.size() < sizeof(submeshes[i].Name));
+
+        MeshFileSubmesh& submesh = submeshes[i];
+        std::memset(&submesh, 0, sizeof(submesh));
+        source.Name.copy(submesh.Name, sizeof(submesh.Name) - 1);
+        submesh.IndexCount = source.IndexCount;
+        submesh.StartIndexLocation = source.StartIndexLocation;
+        submesh.BaseVertexLocation = source.BaseVertexLocation;
+        submesh.GeometricError = source.GeometricError;
+        submesh.BoundsCenter = source.Bounds.Center;
+        submesh.BoundsExtents = source.Bounds.Extents;
+    }
+
+    const std::wstring temporaryPath = path + L".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            return false;
+        }
+
+        bool written = WriteSection(file, &header, sizeof(header));
+        written = written && WriteSection(file, streams.data(), streams.size()*sizeof(MeshFileStream));
+        for (std::size_t i = 0; i < streams.size() && written; ++i)
+        {
+            const void* data = (streams[i].Flags & MeshFileCompressed) ? encodedStreams[i].data() : contents.Streams[i].Data;
+            written = WriteSection(file, data, streams[i].Size);
+        }
+        const void* indexData = (header.IndexFlags & MeshFileCompressed) ? encodedIndices.data() : contents.Indices;
+        written = written && WriteSection(file, indexData, header.IndexDataSize);
+        written = written && WriteSection(file, submeshes.data(), submeshes.size()*sizeof(MeshFileSubmesh));
+        if (contents.Meshlets)
+        {
+            const MeshletGeometry& meshlets = *contents.Meshlets;
+            written = written && WriteSection(file, meshlets.Meshlets.data(), meshlets.Meshlets.size()*sizeof(Meshlet));
+            written = written && WriteSection(file, meshlets.VertexIndices.data(), meshlets.VertexIndices.size()*sizeof(uint32));
+            written = written && WriteSection(file, meshlets.PrimitiveIndices.data(), uint64(header.MeshletTriangleCount)*3);
+        }
+
+        file.close();
+        if (!written || file.fail())
+        {
+            DeleteFileW(temporaryPath.c_str());
+            return false;
+        }
+    }
+
+    if (!MoveFileExW(temporaryPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+    {
+        DeleteFileW(temporaryPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool MeshFile::GetSourceStamp(const std::wstring& path, uint64& size, uint64& writeTime)
+{
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &attributes))
+    {
+        return false;
+    }
+
+    size = (uint64(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+    writeTime = (uint64(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+    return true;
+}
+
+bool MeshFile::Open(const std::wstring& path)
+{
+    Close();
+    if (!mFile.Open(path) || mFile.Size() < sizeof(MeshFileHeader))
+    {
+        Close();
+        return false;
+    }
+
+    const MeshFileHeader* header = static_cast<const MeshFileHeader*>(mFile.Data());
+    const uint64 fileSize = mFile.Size();
+
+    bool valid = header->Magic == MeshFileMagic && header->Version == MeshFileVersion &&
+        header->FileSize == fileSize && (header->IndexSize == 2 || header->IndexSize == 4);
+
+    // Every section has to lie inside the file, so nothing handed out later can read past it.
+    valid = valid && SectionFits(header->StreamTableOffset, uint64(header->StreamCount)*sizeof(MeshFileStream), fileSize);
+    const MeshFileStream* streams = reinterpret_cast<const MeshFileStream*>(Bytes() + (valid ? header->StreamTableOffset : 0));
+    for (uint32 i = 0; valid && i < header->StreamCount; ++i)
+    {
+        const MeshFileStream& stream = streams[i];
+        const uint64 decodedSize = uint64(stream.Stride)*header->VertexCount;
+        valid = SectionFits(stream.Offset, stream.Size, fileSize) &&
+            ((stream.Flags & MeshFileCompressed) ? stream.Stride % 4 == 0 : stream.Size == decodedSize) &&
+            (!(stream.Flags & MeshFileQuantized) || stream.Stride == sizeof(QuantizedVertex));
+    }
+    valid = valid && SectionFits(header->IndexOffset, header->IndexDataSize, fileSize) &&
+        ((header->IndexFlags & MeshFileCompressed) || header->IndexDataSize == uint64(header->IndexCount)*header->IndexSize);
+    valid = valid && SectionFits(header->SubmeshTableOffset, uint64(header->SubmeshCount)*sizeof(MeshFileSubmesh), fileSize);
+    valid = valid && SectionFits(header->MeshletOffset, uint64(header->MeshletCount)*sizeof(Meshlet), fileSize);
+    valid = valid && SectionFits(header->MeshletVertexOffset, uint64(header->MeshletVertexCount)*sizeof(uint32), fileSize);
+    valid = valid && SectionFits(header->MeshletPrimitiveOffset, uint64(header->MeshletTriangleCount)*3, fileSize);
+
+    const MeshFileSubmesh* submeshes = reinterpret_cast<const MeshFileSubmesh*>(Bytes() + (valid ? header->SubmeshTableOffset : 0));
+    for (uint32 i = 0; valid && i < header->SubmeshCount; ++i)
+    {
+        valid = submeshes[i].Name[sizeof(submeshes[i].Name) - 1] == '\0' &&
+            uint64(submeshes[i].StartIndexLocation) + submeshes[i].IndexCount <= header->IndexCount;
+    }
+
+    // The contents too, a damaged cache has to fail here rather than on the GPU. Compressed
+    // indices are checked by ReadIndexData once they are decoded.
+    valid = valid && MeshletsInRange(Bytes(), *header);
+    valid = valid && ((header->IndexFlags & MeshFileCompressed) ||
+        IndexDataInRange(Bytes() + header->IndexOffset, *header, submeshes));
+
+    if (!valid)
+    {
+        Close();
+        return false;
+    }
+
+    mHeader = header;
+    return true;
+}
+
+void MeshFile::Close()
+{
+    mHeader = nullptr;
+    mFile.Close();
+}
+
+bool MeshFile::IsCurrent(const std::wstring& sourcePath)const
+{
+    uint64 size = 0;
+    uint64 writeTime = 0;
+    if (!GetSourceStamp(sourcePath, size, writeTime))
+    {
+        return true;
+    }
+
+    return size == mHeader->SourceSize && writeTime == mHeader->SourceWriteTime;
+}
+
+const void* MeshFile::VertexData(uint32 stream)const
+{
+    assert(stream < mHeader->StreamCount && !(Streams()[stream].Flags & MeshFileCompressed));
+    return Bytes() + Streams()[stream].Offset;
+}
+
+MeshFile::uint32 MeshFile::VertexStride(uint32 stream)const
+{
+    assert(stream < mHeader->StreamCount);
+    return Streams()[stream].Stride;
+}
+
+MeshFile::uint32 MeshFile::VertexFlags(uint32 stream)const
+{
+    assert(stream < mHeader->StreamCount);
+    return Streams()[stream].Flags;
+}
+
+bool MeshFile::ReadVertexData(uint32 stream, void* dest)const
+{
+    assert(stream < mHeader->StreamCount);
+    const MeshFileStream& info = Streams()[stream];
+    if (info.Flags & MeshFileCompressed)
+    {
+        return MeshCodec::DecodeVertexBuffer(dest, mHeader->VertexCount, info.Stride, Bytes() + info.Offset,
+            static_cast<std::size_t>(info.Size));
+    }
+
+    std::memcpy(dest, Bytes() + info.Offset, VertexDataSize(stream));
+    return true;
+}
+
+const void* MeshFile::IndexData()const
+{
+    assert(!(mHeader->IndexFlags & MeshFileCompressed));
+    return Bytes() + mHeader->IndexOffset;
+}
+
+bool MeshFile::ReadIndexData(void* dest)const
+{
+    if (mHeader->IndexFlags & MeshFileCompressed)
+    {
+        return MeshCodec::DecodeIndexBuffer(dest, mHeader->IndexCount, mHeader->IndexSize, Bytes() + mHeader->IndexOffset,
+            static_cast<std::size_t>(mHeader->IndexDataSize)) && IndexDataInRange(dest, *mHeader, Submeshes());
+    }
+
+    std::memcpy(dest, Bytes() + mHeader->IndexOffset, IndexDataSize());
+    return true;
+}
+
+PositionQuantization MeshFile::Quantization()const
+{
+    PositionQuantization quantization;
+    quantization.Offset = mHeader->QuantizationOffset;
+    quantization.Scale = mHeader->QuantizationScale;
+    return quantization;
+}
+
+const MeshFileSubmesh* MeshFile::Submeshes()const
+{
+    return reinterpret_cast<const MeshFileSubmesh*>(Bytes() + mHeader->SubmeshTableOffset);
+}
+
+const MeshFileSubmesh* MeshFile::FindSubmesh(const char* name)const
+{
+    const MeshFileSubmesh* submeshes = Submeshes();
+    for (uint32 i = 0; i < mHeader->SubmeshCount; ++i)
+    {
+        if (std::strcmp(submeshes[i].Name, name) == 0)
+        {
+            return &submeshes[i];
+        }
+    }
+    return nullptr;
+}
+
+MeshletGeometry MeshFile::LoadMeshlets()const
+{
+    MeshletGeometry geometry;
+    geometry.Meshlets.resize(mHeader->MeshletCount);
+    geometry.VertexIndices.resize(mHeader->MeshletVertexCount);
+    geometry.PrimitiveIndices.resize(std::size_t(mHeader->MeshletTriangleCount)*3);
+
+    if (!geometry.Meshlets.empty())
+    {
+        std::memcpy(geometry.Meshlets.data(), Bytes() + mHeader->MeshletOffset, geometry.Meshlets.size()*sizeof(Meshlet));
+    }
+    if (!geometry.VertexIndices.empty())
+    {
+        std::memcpy(geometry.VertexIndices.data(), Bytes() + mHeader->MeshletVertexOffset, geometry.VertexIndices.size()*sizeof(uint32));
+    }
+    if (!geometry.PrimitiveIndices.empty())
+    {
+        std::memcpy(geometry.PrimitiveIndices.data(), Bytes() + mHeader->MeshletPrimitiveOffset, geometry.PrimitiveIndices.size());
+    }
+    return geometry;
+}
+
+const MeshFileStream* MeshFile::Streams()const
+{
+    return reinterpret_cast<const MeshFileStream*>(Bytes() + mHeader->StreamTableOffset);
+}
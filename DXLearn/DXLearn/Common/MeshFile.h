@@ -0,0 +1,186 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <DirectXCollision.h>
+#include <DirectXMath.h>
+
+#include "MappedFile.h"
+#include "MeshCodec.h"
+#include "MeshletBuilder.h"
+
+// Binary mesh container, read in place from a memory mapping. The file starts with a
+// MeshFileHeader, followed by the stream table, the vertex streams, the index buffer, the
+// submesh table and the optional meshlet arrays. Every section starts at a multiple of 64
+// bytes and all offsets are from the start of the file.
+
+// MeshFileStream::Flags and MeshFileHeader::IndexFlags.
+enum MeshFileFlags : std::uint32_t
+{
+    MeshFileCompressed = 1 << 0,        // MeshCodec encoded
+    MeshFileQuantized  = 1 << 1,        // QuantizedVertex, vertex streams only
+};
+
+struct MeshFileHeader
+{
+    std::uint32_t Magic;
+    std::uint32_t Version;
+    std::uint64_t FileSize;
+
+    // Size and last write time of the file the mesh was converted from.
+    std::uint64_t SourceSize;
+    std::uint64_t SourceWriteTime;
+
+    std::uint32_t VertexCount;
+    std::uint32_t StreamCount;
+    std::uint32_t IndexCount;
+    std::uint32_t IndexSize;            // 2 or 4 bytes
+    std::uint32_t IndexFlags;
+    std::uint32_t SubmeshCount;
+    std::uint32_t MeshletCount;
+    std::uint32_t MeshletVertexCount;
+    std::uint32_t MeshletTriangleCount;
+    std::uint32_t BuildFlags;           // caller defined, see MeshFileContents::BuildFlags
+
+    std::uint64_t StreamTableOffset;
+    std::uint64_t IndexOffset;
+    std::uint64_t IndexDataSize;        // bytes stored, less than IndexCount*IndexSize if compressed
+    std::uint64_t SubmeshTableOffset;
+    std::uint64_t MeshletOffset;
+    std::uint64_t MeshletVertexOffset;
+    std::uint64_t MeshletPrimitiveOffset;
+
+    DirectX::XMFLOAT3 BoundsCenter;
+    DirectX::XMFLOAT3 BoundsExtents;
+
+    // Position mapping of quantized streams.
+    DirectX::XMFLOAT3 QuantizationOffset;
+    DirectX::XMFLOAT3 QuantizationScale;
+};
+
+struct MeshFileStream
+{
+    std::uint32_t Stride;               // of the decoded vertices
+    std::uint32_t Flags;
+    std::uint64_t Offset;
+    std::uint64_t Size;                 // bytes stored
+};
+
+struct MeshFileSubmesh
+{
+    char Name[48];                      // null terminated
+    std::uint32_t IndexCount;
+    std::uint32_t StartIndexLocation;
+    std::int32_t BaseVertexLocation;
+    float GeometricError;
+    DirectX::XMFLOAT3 BoundsCenter;
+    DirectX::XMFLOAT3 BoundsExtents;
+};
+
+// What MeshFile::Write stores, all pointers are only read during the call.
+struct MeshFileContents
+{
+    struct Stream
+    {
+        const void* Data = nullptr;
+        std::uint32_t Stride = 0;
+        std::uint32_t Flags = 0;        // MeshFileQuantized streams hold QuantizedVertex
+    };
+
+    struct Submesh
+    {
+        std::string Name;               // at most 47 characters
+        std::uint32_t IndexCount = 0;
+        std::uint32_t StartIndexLocation = 0;
+        std::int32_t BaseVertexLocation = 0;
+        float GeometricError = 0.0f;
+        DirectX::BoundingBox Bounds;
+    };
+
+    std::uint32_t VertexCount = 0;
+    std::vector<Stream> Streams;
+
+    const void* Indices = nullptr;
+    std::uint32_t IndexCount = 0;
+    std::uint32_t IndexSize = 4;
+    std::uint32_t IndexFlags = 0;
+
+    std::vector<Submesh> Submeshes;
+    const MeshletGeometry* Meshlets = nullptr;
+    DirectX::BoundingBox Bounds;
+
+    // What the quantized streams were quantized with.
+    PositionQuantization Quantization;
+
+    // See MeshFile::GetSourceStamp.
+    std::uint64_t SourceSize = 0;
+    std::uint64_t SourceWriteTime = 0;
+
+    // Options the mesh was processed with, stored as they are so the caller can tell a cache
+    // built with other settings from a current one.
+    std::uint32_t BuildFlags = 0;
+};
+
+// Writer and zero-copy reader of mesh files. Open() maps the file and checks the layout, the
+// meshlets and the uncompressed indices.
+// Uncompressed buffers are handed out as pointers into the mapping, which can be uploaded
+// as they are. Compressed ones are decoded by ReadVertexData/ReadIndexData, which also
+// copy uncompressed buffers so callers can use them for both.
+class MeshFile
+{
+public:
+    using uint32 = std::uint32_t;
+    using uint64 = std::uint64_t;
+
+    // Writes to a temporary file first, an interrupted write never leaves a broken mesh behind.
+    // Buffers with MeshFileCompressed set are encoded on the way.
+    static bool Write(const std::wstring& path, const MeshFileContents& contents);
+
+    // Size and last write time of a file, false if it doesn't exist.
+    static bool GetSourceStamp(const std::wstring& path, uint64& size, uint64& writeTime);
+
+    bool Open(const std::wstring& path);
+    void Close();
+
+    bool IsOpen()const { return mHeader != nullptr; }
+
+    // False if sourcePath changed since the mesh was converted from it. A missing source
+    // doesn't make the mesh stale, it may have been shipped without it.
+    bool IsCurrent(const std::wstring& sourcePath)const;
+
+    const MeshFileHeader& Header()const { return *mHeader; }
+
+    // Uncompressed streams only.
+    const void* VertexData(uint32 stream)const;
+    uint32 VertexStride(uint32 stream)const;
+    uint32 VertexFlags(uint32 stream)const;
+    std::size_t VertexDataSize(uint32 stream)const { return std::size_t(VertexStride(stream))*mHeader->VertexCount; }
+
+    // Fills VertexDataSize() bytes, false if the compressed data is damaged.
+    bool ReadVertexData(uint32 stream, void* dest)const;
+
+    const void* IndexData()const;
+    uint32 IndexFlags()const { return mHeader->IndexFlags; }
+    std::size_t IndexDataSize()const { return std::size_t(mHeader->IndexCount)*mHeader->IndexSize; }
+
+    // Fills IndexDataSize() bytes, false if the compressed data is damaged or decodes to
+    // indices of vertices the mesh doesn't have.
+    bool ReadIndexData(void* dest)const;
+
+    PositionQuantization Quantization()const;
+
+    const MeshFileSubmesh* Submeshes()const;
+    const MeshFileSubmesh* FindSubmesh(const char* name)const;
+
+    // Copied out, the meshlet tables are small next to the buffers.
+    MeshletGeometry LoadMeshlets()const;
+
+private:
+    const unsigned char* Bytes()const { return static_cast<const unsigned char*>(mFile.Data()); }
+    const MeshFileStream* Streams()const;
+
+    MappedFile mFile;
+    const MeshFileHeader* mHeader = nullptr;
+};
@@ -0,0 +1,433 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+    using uint32 = std::uint32_t;
+
+    const uint32 InvalidIndex = ~0u;
+
+    // Forsyth's scoring parameters, from "Linear-Speed Vertex Cache Optimisation".
+    // The simulated cache is LRU and bigger than the FIFO being optimized for, so
+    // the order degrades gracefully on hardware with a different cache size.
+    const int ForsythCacheSize = 32;
+    const float CacheDecayPower = 1.5f;
+    const float LastTriangleScore = 0.75f;
+    const float ValenceBoostScale = 2.0f;
+    const float ValenceBoostPower = 0.5f;
+
+    // Valences above this use the last entry, the boost is tiny by then anyway.
+    const uint32 MaxScoredValence = 32;
+
+    // Cache size the overdraw clusters are measured with, as in the paper.
+    const uint32 OverdrawCacheSize = 16;
+
+    struct ForsythScores
+    {
+        float Cache[ForsythCacheSize];
+        float Valence[MaxScoredValence + 1];
+
+        ForsythScores()
+        {
+            for (int i = 0; i < ForsythCacheSize; ++i)
+            {
+                // The triangle just emitted gets a fixed score, so no vertex of it is
+                // preferred and the strip doesn't zig-zag.
+                if (i < 3)
+                {
+                    Cache[i] = LastTriangleScore;
+                }
+                else
+                {
+                    const float scaler = 1.0f / (ForsythCacheSize - 3);
+                    Cache[i] = powf(1.0f - (i - 3)*scaler, CacheDecayPower);
+                }
+            }
+
+            Valence[0] = 0.0f;
+            for (uint32 i = 1; i <= MaxScoredValence; ++i)
+            {
+                // Vertices with few triangles left are finished off first, or they stay
+                // behind as lone triangles that need their vertices again later.
+                Valence[i] = ValenceBoostScale * powf(static_cast<float>(i), -ValenceBoostPower);
+            }
+        }
+
+        float VertexScore(int cachePosition, uint32 liveTriangles)const
+        {
+            if (liveTriangles == 0)
+            {
+                return -1.0f;
+            }
+
+            const float cacheScore = cachePosition >= 0 ? Cache[cachePosition] : 0.0f;
+            return cacheScore + Valence[std::min(liveTriangles, MaxScoredValence)];
+        }
+    };
+
+    // FIFO cache emulation by timestamps, a vertex is cached if fewer than cacheSize
+    // vertices were inserted after it. Bumping the timestamp by cacheSize+1 flushes it.
+    inline uint32 UpdateCache(uint32 a, uint32 b, uint32 c, uint32 cacheSize, uint32* cachedAt, uint32& timestamp)
+    {
+        uint32 misses = 0;
+        for (uint32 v : { a, b, c })
+        {
+            if (timestamp - cachedAt[v] > cacheSize)
+            {
+                cachedAt[v] = timestamp++;
+                ++misses;
+            }
+        }
+        return misses;
+    }
+
+    inline const float* PositionAt(const float* positions, std::size_t stride, uint32 vertex)
+    {
+        return reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(positions) + vertex*stride);
+    }
+}
+
+VertexCacheStatistics MeshOptimizer::AnalyzeVertexCache(const uint32* indices, std::size_t indexCount,
+    std::size_t vertexCount, uint32 cacheSize)
+{
+    VertexCacheStatistics stats;
+    if (indexCount < 3 || vertexCount == 0)
+    {
+        return stats;
+    }
+
+    std::vector<uint32> cachedAt(vertexCount, 0);
+    std::vector<bool> used(vertexCount, false);
+    uint32 timestamp = cacheSize + 1;
+    uint32 misses = 0;
+    uint32 usedCount = 0;
+
+    for (std::size_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        misses += UpdateCache(indices[i], indices[i + 1], indices[i + 2], cacheSize, cachedAt.data(), timestamp);
+        for (std::size_t k = i; k < i + 3; ++k)
+        {
+            if (!used[indices[k]])
+            {
+                used[indices[k]] = true;
+                ++usedCount;
+            }
+        }
+    }
+
+    stats.VerticesTransformed = misses;
+    stats.ACMR = static_cast<float>(misses) / (indexCount / 3);
+    stats.ATVR = static_cast<float>(misses) / usedCount;
+    return stats;
+}
+
+void MeshOptimizer::OptimizeVertexCache(uint32* indices, std::size_t indexCount, std::size_t vertexCount)
+{
+    const std::size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    static const ForsythScores scores;
+
+    // Vertex -> triangle adjacency. The live triangles of a vertex are kept at the front
+    // of its range, emitting one swaps it behind them.
+    std::vector<uint32> liveTriangles(vertexCount, 0);
+    for (std::size_t i = 0; i < triangleCount*3; ++i)
+    {
+        assert(indices[i] < vertexCount);
+        ++liveTriangles[indices[i]];
+    }
+
+    std::vector<uint32> adjacencyOffset(vertexCount + 1, 0);
+    for (std::size_t v = 0; v < vertexCount; ++v)
+    {
+        adjacencyOffset[v + 1] = adjacencyOffset[v] + liveTriangles[v];
+    }
+
+    std::vector<uint32> adjacency(triangleCount*3);
+    {
+        std::vector<uint32> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (std::size_t i = 0; i < triangleCount*3; ++i)
+        {
+            adjacency[fill[indices[i]]++] = static_cast<uint32>(i / 3);
+        }
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (std::size_t v = 0; v < vertexCount; ++v)
+    {
+        vertexScore[v] = scores.VertexScore(-1, liveTriangles[v]);
+    }
+
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    uint32 bestTriangle = 0;
+    for (std::size_t t = 0; t < triangleCount; ++t)
+    {
+        triangleScore[t] = vertexScore[indices[t*3]] + vertexScore[indices[t*3 + 1]] + vertexScore[indices[t*3 + 2]];
+        if (triangleScore[t] > triangleScore[bestTriangle])
+        {
+            bestTriangle = static_cast<uint32>(t);
+        }
+    }
+
+    // Room for the three vertices pushed in front before the tail is cut off.
+    uint32 cache[ForsythCacheSize + 3];
+    uint32 newCache[ForsythCacheSize + 3];
+    int cacheCount = 0;
+
+    std::vector<uint32> output(triangleCount*3);
+    std::size_t scanCursor = 0;
+
+    for (std::size_t outTriangle = 0; outTriangle < triangleCount; ++outTriangle)
+    {
+        // Nothing in the cache has triangles left, continue with the first unused one.
+        if (bestTriangle == InvalidIndex)
+        {
+            while (emitted[scanCursor])
+            {
+                ++scanCursor;
+            }
+            bestTriangle = static_cast<uint32>(scanCursor);
+        }
+
+        const uint32* tri = indices + bestTriangle*3;
+        std::memcpy(&output[outTriangle*3], tri, 3*sizeof(uint32));
+        emitted[bestTriangle] = true;
+
+        for (int k = 0; k < 3; ++k)
+        {
+            // A degenerate triangle is listed once per corner, so this stays balanced.
+            const uint32 v = tri[k];
+            uint32* first = adjacency.data() + adjacencyOffset[v];
+            uint32* live = first + liveTriangles[v];
+            uint32* found = std::find(first, live, bestTriangle);
+            assert(found != live);
+
+            std::swap(*found, *(live - 1));
+            --liveTriangles[v];
+        }
+
+        // The emitted vertices go to the front, the rest of the cache follows in order.
+        int newCount = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            if (std::find(newCache, newCache + newCount, tri[k]) == newCache + newCount)
+            {
+                newCache[newCount++] = tri[k];
+            }
+        }
+        for (int i = 0; i < cacheCount; ++i)
+        {
+            const uint32 v = cache[i];
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+            {
+                newCache[newCount++] = v;
+            }
+        }
+
+        // Rescore everything that was or is in the cache, then the live triangles around it.
+        for (int i = 0; i < newCount; ++i)
+        {
+            const uint32 v = newCache[i];
+            cachePosition[v] = i < ForsythCacheSize ? i : -1;
+            vertexScore[v] = scores.VertexScore(cachePosition[v], liveTriangles[v]);
+        }
+
+        bestTriangle = InvalidIndex;
+        float bestScore = -1.0f;
+        for (int i = 0; i < newCount; ++i)
+        {
+            const uint32 v = newCache[i];
+            const uint32* adjacent = &adjacency[adjacencyOffset[v]];
+            for (uint32 a = 0; a < liveTriangles[v]; ++a)
+            {
+                const uint32 t = adjacent[a];
+                const uint32* tv = indices + t*3;
+                triangleScore[t] = vertexScore[tv[0]] + vertexScore[tv[1]] + vertexScore[tv[2]];
+                if (triangleScore[t] > bestScore)
+                {
+                    bestScore = triangleScore[t];
+                    bestTriangle = t;
+                }
+            }
+        }
+
+        cacheCount = std::min(newCount, ForsythCacheSize);
+        std::memcpy(cache, newCache, cacheCount*sizeof(uint32));
+    }
+
+    std::memcpy(indices, output.data(), output.size()*sizeof(uint32));
+}
+
+void MeshOptimizer::OptimizeOverdraw(uint32* indices, std::size_t indexCount, const float* positions,
+    std::size_t positionStride, std::size_t vertexCount, float threshold)
+{
+    const std::size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    std::vector<uint32> cachedAt(vertexCount, 0);
+    uint32 timestamp = OverdrawCacheSize + 1;
+
+    // Hard boundaries: a triangle missing all three vertices starts a new patch, moving
+    // it elsewhere costs nothing the cache would have saved.
+    std::vector<uint32> hardClusters;
+    for (std::size_t t = 0; t < triangleCount; ++t)
+    {
+        const uint32* tri = indices + t*3;
+        const uint32 misses = UpdateCache(tri[0], tri[1], tri[2], OverdrawCacheSize, cachedAt.data(), timestamp);
+        if (t == 0 || misses == 3)
+        {
+            hardClusters.push_back(static_cast<uint32>(t));
+        }
+    }
+
+    // Soft boundaries: split each patch as soon as its running ACMR is within the threshold
+    // of the whole patch's, more clusters give the sort more freedom.
+    std::vector<uint32> clusters;
+    for (std::size_t c = 0; c < hardClusters.size(); ++c)
+    {
+        const uint32 begin = hardClusters[c];
+        const uint32 end = c + 1 < hardClusters.size() ? hardClusters[c + 1] : static_cast<uint32>(triangleCount);
+
+        timestamp += OverdrawCacheSize + 1;
+        uint32 clusterMisses = 0;
+        for (uint32 t = begin; t < end; ++t)
+        {
+            const uint32* tri = indices + t*3;
+            clusterMisses += UpdateCache(tri[0], tri[1], tri[2], OverdrawCacheSize, cachedAt.data(), timestamp);
+        }
+        const float clusterThreshold = threshold * clusterMisses / (end - begin);
+
+        clusters.push_back(begin);
+        timestamp += OverdrawCacheSize + 1;
+        uint32 runningMisses = 0;
+        uint32 runningTriangles = 0;
+        for (uint32 t = begin; t < end; ++t)
+        {
+            const uint32* tri = indices + t*3;
+            runningMisses += UpdateCache(tri[0], tri[1], tri[2], OverdrawCacheSize, cachedAt.data(), timestamp);
+            ++runningTriangles;
+
+            if (static_cast<float>(runningMisses) / runningTriangles <= clusterThreshold)
+            {
+                clusters.push_back(t + 1);
+                timestamp += OverdrawCacheSize + 1;
+                runningMisses = 0;
+                runningTriangles = 0;
+            }
+        }
+
+        // The last split leaves a tail that rarely reaches the target, merge it into the
+        // cluster before. This also drops a boundary that landed exactly on end.
+        if (clusters.back() != begin)
+        {
+            clusters.pop_back();
+        }
+    }
+
+    // Mesh centroid, clusters far out along their own normal are drawn first.
+    XMVECTOR meshCentroid = XMVectorZero();
+    for (std::size_t v = 0; v < vertexCount; ++v)
+    {
+        meshCentroid += XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(PositionAt(positions, positionStride, static_cast<uint32>(v))));
+    }
+    meshCentroid /= static_cast<float>(vertexCount);
+
+    std::vector<float> sortKey(clusters.size());
+    for (std::size_t c = 0; c < clusters.size(); ++c)
+    {
+        const uint32 begin = clusters[c];
+        const uint32 end = c + 1 < clusters.size() ? clusters[c + 1] : static_cast<uint32>(triangleCount);
+
+        // Area weighted centroid and normal of the cluster.
+        XMVECTOR centroid = XMVectorZero();
+        XMVECTOR normal = XMVectorZero();
+        float area = 0.0f;
+        for (uint32 t = begin; t < end; ++t)
+        {
+            const uint32* tri = indices + t*3;
+            const XMVECTOR p0 = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(PositionAt(positions, positionStride, tri[0])));
+            const XMVECTOR p1 = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(PositionAt(positions, positionStride, tri[1])));
+            const XMVECTOR p2 = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(PositionAt(positions, positionStride, tri[2])));
+
+            const XMVECTOR cross = XMVector3Cross(p1 - p0, p2 - p0);
+            const float triangleArea = XMVectorGetX(XMVector3Length(cross));
+
+            centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+            normal += cross;
+            area += triangleArea;
+        }
+
+        if (area > 0.0f)
+        {
+            centroid /= area;
+        }
+        normal = XMVector3Normalize(normal);
+        sortKey[c] = XMVectorGetX(XMVector3Dot(centroid - meshCentroid, normal));
+    }
+
+    std::vector<uint32> order(clusters.size());
+    for (std::size_t c = 0; c < order.size(); ++c)
+    {
+        order[c] = static_cast<uint32>(c);
+    }
+    std::stable_sort(order.begin(), order.end(), [&sortKey](uint32 a, uint32 b) { return sortKey[a] > sortKey[b]; });
+
+    std::vector<uint32> output;
+    output.reserve(triangleCount*3);
+    for (uint32 c : order)
+    {
+        const uint32 begin = clusters[c];
+        const uint32 end = c + 1 < clusters.size() ? clusters[c + 1] : static_cast<uint32>(triangleCount);
+        output.insert(output.end(), indices + begin*3, indices + end*3);
+    }
+
+    std::memcpy(indices, output.data(), output.size()*sizeof(uint32));
+}
+
+std::size_t MeshOptimizer::OptimizeVertexFetch(void* vertices, std::size_t vertexCount, std::size_t vertexSize,
+    uint32* indices, std::size_t indexCount)
+{
+    std::vector<uint32> remap(vertexCount, InvalidIndex);
+    uint32 nextVertex = 0;
+    for (std::size_t i = 0; i < indexCount; ++i)
+    {
+        uint32& target = remap[indices[i]];
+        if (target == InvalidIndex)
+        {
+            target = nextVertex++;
+        }
+        indices[i] = target;
+    }
+
+    unsigned char* bytes = static_cast<unsigned char*>(vertices);
+    std::vector<unsigned char> reordered(nextVertex*vertexSize);
+    for (std::size_t v = 0; v < vertexCount; ++v)
+    {
+        if (remap[v] != InvalidIndex)
+        {
+            std::memcpy(&reordered[remap[v]*vertexSize], bytes + v*vertexSize, vertexSize);
+        }
+    }
+    std::memcpy(bytes, reordered.data(), reordered.size());
+
+    return nextVertex;
+}
+
+MeshOptimizationReport MeshOptimizer::Optimize(GeometryGenerator::MeshData& meshData, float overdrawThreshold)
+{
+    return Optimize(meshData.Vertices, meshData.Indices32, &GeometryGenerator::Vertex::Position, overdrawThreshold);
+}
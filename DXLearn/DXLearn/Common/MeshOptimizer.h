@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "GeometryGenerator.h"
+
+// How well an index order uses a FIFO post-transform vertex cache.
+// ACMR: vertices transformed per triangle, 0.5 is the limit for a regular grid and 3 is no reuse.
+// ATVR: vertices transformed per unique vertex, 1.0 is perfect.
+struct VertexCacheStatistics
+{
+    std::uint32_t VerticesTransformed = 0;
+    float ACMR = 0.0f;
+    float ATVR = 0.0f;
+};
+
+struct MeshOptimizationReport
+{
+    VertexCacheStatistics Before;
+    VertexCacheStatistics After;
+};
+
+// Offline reordering of triangle lists for the GPU, all passes are linear in the mesh size:
+//   1. OptimizeVertexCache: Forsyth's greedy triangle order, keeps recently used vertices hot.
+//   2. OptimizeOverdraw: Sander et al. "Fast Triangle Reordering for Vertex Locality and
+//      Reduced Overdraw". Cuts the cache-ordered list into clusters at points that cost little
+//      cache efficiency and draws clusters that face outward first, so depth testing rejects
+//      more of what is drawn later.
+//   3. OptimizeVertexFetch: renumbers vertices in first-use order so the vertex buffer is
+//      read sequentially, dropping unreferenced vertices.
+// Optimize() runs all three in that order.
+class MeshOptimizer
+{
+public:
+    using uint32 = std::uint32_t;
+
+    // Simulates a FIFO cache of cacheSize entries, 16 is typical of current hardware.
+    static VertexCacheStatistics AnalyzeVertexCache(const uint32* indices, std::size_t indexCount,
+        std::size_t vertexCount, uint32 cacheSize = 16);
+
+    static void OptimizeVertexCache(uint32* indices, std::size_t indexCount, std::size_t vertexCount);
+
+    // Expects a vertex cache optimized order. threshold bounds how much worse than the input the
+    // ACMR of each cluster may get, 1.05 allows 5%. positions points at the first position and
+    // consecutive positions are positionStride bytes apart.
+    static void OptimizeOverdraw(uint32* indices, std::size_t indexCount, const float* positions,
+        std::size_t positionStride, std::size_t vertexCount, float threshold = 1.05f);
+
+    // Reorders vertices (vertexSize bytes each) in place and rewrites the indices to match.
+    // Returns the number of vertices still referenced, they are moved to the front.
+    static std::size_t OptimizeVertexFetch(void* vertices, std::size_t vertexCount, std::size_t vertexSize,
+        uint32* indices, std::size_t indexCount);
+
+    // All passes on a vertex/index vector pair. position selects the member holding the
+    // vertex position, the vertex vector shrinks to the referenced vertices.
+    template<typename VertexT>
+    static MeshOptimizationReport Optimize(std::vector<VertexT>& vertices, std::vector<uint32>& indices,
+        DirectX::XMFLOAT3 VertexT::* position, float overdrawThreshold = 1.05f);
+
+    // Call before GetIndices16(), the 16-bit copy is cached and wouldn't see the new order.
+    static MeshOptimizationReport Optimize(GeometryGenerator::MeshData& meshData, float overdrawThreshold = 1.05f);
+};
+
+template<typename VertexT>
+MeshOptimizationReport MeshOptimizer::Optimize(std::vector<VertexT>& vertices, std::vector<uint32>& indices,
+    DirectX::XMFLOAT3 VertexT::* position, float overdrawThreshold)
+{
+    MeshOptimizationReport report;
+    if (vertices.empty() || indices.empty())
+    {
+        return report;
+    }
+
+    report.Before = AnalyzeVertexCache(indices.data(), indices.size(), vertices.size());
+
+    OptimizeVertexCache(indices.data(), indices.size(), vertices.size());
+    OptimizeOverdraw(indices.data(), indices.size(), &(vertices[0].*position).x, sizeof(VertexT),
+        vertices.size(), overdrawThreshold);
+    vertices.resize(OptimizeVertexFetch(vertices.data(), vertices.size(), sizeof(VertexT),
+        indices.data(), indices.size()));
+
+    report.After = AnalyzeVertexCache(indices.data(), indices.size(), vertices.size());
+    return report;
+}
@@ -0,0 +1,501 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+
+using namespace DirectX;
+
+namespace
+{
+    using uint32 = std::uint32_t;
+    using uint64 = std::uint64_t;
+
+    const std::size_t MaxAttributes = 16;
+
+    // Weight of the planes holding open borders in place, relative to the surface planes.
+    const float BorderWeight = 10.0f;
+
+    // A level that keeps more than this fraction of the previous one isn't worth its index range.
+    const float MinLevelReduction = 0.85f;
+
+    enum class EVertexKind : unsigned char
+    {
+        Manifold,
+        Border,     // on an open boundary, may only slide along it
+        Locked,     // seam, non-manifold or locked border, never moves
+    };
+
+    // x'Ax + 2b'x + c, the weighted sum of squared distances to a set of planes.
+    struct Quadric
+    {
+        double A00 = 0.0, A11 = 0.0, A22 = 0.0, A01 = 0.0, A02 = 0.0, A12 = 0.0;
+        double B0 = 0.0, B1 = 0.0, B2 = 0.0;
+        double C = 0.0;
+        double Weight = 0.0;
+
+        // Plane dot(n, x) + d = 0 with a unit normal.
+        static Quadric FromPlane(const XMFLOAT3& n, float d, float weight)
+        {
+            Quadric q;
+            q.A00 = weight*n.x*n.x;
+            q.A11 = weight*n.y*n.y;
+            q.A22 = weight*n.z*n.z;
+            q.A01 = weight*n.x*n.y;
+            q.A02 = weight*n.x*n.z;
+            q.A12 = weight*n.y*n.z;
+            q.B0 = weight*n.x*d;
+            q.B1 = weight*n.y*d;
+            q.B2 = weight*n.z*d;
+            q.C = weight*d*d;
+            q.Weight = weight;
+            return q;
+        }
+
+        Quadric& operator+=(const Quadric& other)
+        {
+            A00 += other.A00; A11 += other.A11; A22 += other.A22;
+            A01 += other.A01; A02 += other.A02; A12 += other.A12;
+            B0 += other.B0; B1 += other.B1; B2 += other.B2;
+            C += other.C;
+            Weight += other.Weight;
+            return *this;
+        }
+
+        // Weighted mean squared distance of p to the planes.
+        float Error(const XMFLOAT3& p)const
+        {
+            const double x = p.x, y = p.y, z = p.z;
+            const double sum = A00*x*x + A11*y*y + A22*z*z + 2.0*(A01*x*y + A02*x*z + A12*y*z)
+                + 2.0*(B0*x + B1*y + B2*z) + C;
+            return Weight > 0.0 ? static_cast<float>(std::max(sum, 0.0) / Weight) : 0.0f;
+        }
+    };
+
+    struct Collapse
+    {
+        uint32 From;
+        uint32 To;
+        float Cost;     // geometric plus attribute error
+        float Error;    // geometric error alone
+    };
+
+    inline uint64 EdgeKey(uint32 a, uint32 b)
+    {
+        return a < b ? (uint64(a) << 32) | b : (uint64(b) << 32) | a;
+    }
+
+    inline XMVECTOR TriangleNormal(const XMFLOAT3& p0, const XMFLOAT3& p1, const XMFLOAT3& p2)
+    {
+        const XMVECTOR v0 = XMLoadFloat3(&p0);
+        return XMVector3Cross(XMLoadFloat3(&p1) - v0, XMLoadFloat3(&p2) - v0);
+    }
+
+    // Sorted keys of the edges used by exactly one triangle, edges are between position ids.
+    void FindBorderEdges(const uint32* indices, std::size_t indexCount, const std::vector<uint32>& positionId,
+        std::vector<uint64>& edges, std::vector<uint64>& borderEdges, std::vector<uint64>* nonManifoldEdges)
+    {
+        edges.clear();
+        for (std::size_t i = 0; i < indexCount; i += 3)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                edges.push_back(EdgeKey(positionId[indices[i + k]], positionId[indices[i + (k + 1) % 3]]));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+
+        borderEdges.clear();
+        for (std::size_t i = 0; i < edges.size();)
+        {
+            std::size_t run = i + 1;
+            while (run < edges.size() && edges[run] == edges[i])
+            {
+                ++run;
+            }
+
+            if (run - i == 1)
+            {
+                borderEdges.push_back(edges[i]);
+            }
+            else if (run - i > 2 && nonManifoldEdges)
+            {
+                nonManifoldEdges->push_back(edges[i]);
+            }
+            i = run;
+        }
+    }
+}
+
+std::size_t MeshSimplifier::Simplify(uint32* destination, const uint32* indices, std::size_t indexCount,
+    const float* positions, std::size_t positionStride, std::size_t vertexCount,
+    const float* attributes, std::size_t attributeStride, const float* attributeWeights, std::size_t attributeCount,
+    std::size_t targetIndexCount, const SimplifySettings& settings, float* resultError)
+{
+    assert(indexCount % 3 == 0);
+    assert(attributeCount <= MaxAttributes);
+    assert(attributeCount == 0 || (attributes && attributeWeights));
+
+    // Positions scaled into a unit box, so the error limit is relative to the mesh size.
+    std::vector<XMFLOAT3> points(vertexCount);
+    XMFLOAT3 minPoint = { FLT_MAX, FLT_MAX, FLT_MAX };
+    XMFLOAT3 maxPoint = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (std::size_t v = 0; v < vertexCount; ++v)
+    {
+        const XMFLOAT3& p = *reinterpret_cast<const XMFLOAT3*>(reinterpret_cast<const unsigned char*>(positions) + v*positionStride);
+        minPoint = XMFLOAT3(std::min(minPoint.x, p.x), std::min(minPoint.y, p.y), std::min(minPoint.z, p.z));
+        maxPoint = XMFLOAT3(std::max(maxPoint.x, p.x), std::max(maxPoint.y, p.y), std::max(maxPoint.z, p.z));
+        points[v] = p;
+    }
+
+    float extent = std::max(maxPoint.x - minPoint.x, std::max(maxPoint.y - minPoint.y, maxPoint.z - minPoint.z));
+    if (!(extent > 0.0f))
+    {
+        extent = 1.0f;
+    }
+    const float scale = 1.0f / extent;
+    for (XMFLOAT3& p : points)
+    {
+        p = XMFLOAT3((p.x - minPoint.x)*scale, (p.y - minPoint.y)*scale, (p.z - minPoint.z)*scale);
+    }
+
+    auto attribute = [attributes, attributeStride](uint32 v)
+    {
+        return reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(attributes) + v*attributeStride);
+    };
+
+    // Drop degenerate input triangles.
+    std::size_t resultCount = 0;
+    for (std::size_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        const uint32 a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        assert(a < vertexCount && b < vertexCount && c < vertexCount);
+        if (a != b && b != c && a != c)
+        {
+            destination[resultCount++] = a;
+            destination[resultCount++] = b;
+            destination[resultCount++] = c;
+        }
+    }
+
+    // Vertices at the same position share the id of the first of them, borders and collapses are
+    // found on these ids so attribute seams don't look like holes.
+    std::vector<uint32> positionId(vertexCount);
+    std::vector<EVertexKind> kinds(vertexCount, EVertexKind::Manifold);
+    {
+        std::vector<uint32> order(vertexCount);
+        std::iota(order.begin(), order.end(), 0u);
+        auto less = [&points](uint32 a, uint32 b)
+        {
+            const XMFLOAT3& pa = points[a];
+            const XMFLOAT3& pb = points[b];
+            return pa.x != pb.x ? pa.x < pb.x : pa.y != pb.y ? pa.y < pb.y : pa.z < pb.z;
+        };
+        std::sort(order.begin(), order.end(), less);
+
+        for (std::size_t i = 0; i < vertexCount;)
+        {
+            std::size_t run = i + 1;
+            while (run < vertexCount && !less(order[i], order[run]))
+            {
+                ++run;
+            }
+
+            for (std::size_t j = i; j < run; ++j)
+            {
+                positionId[order[j]] = order[i];
+
+                // Moving one side of a seam would tear it open.
+                if (run - i > 1)
+                {
+                    kinds[order[j]] = EVertexKind::Locked;
+                }
+            }
+            i = run;
+        }
+    }
+
+    std::vector<uint64> edges;
+    std::vector<uint64> borderEdges;
+    std::vector<uint64> nonManifoldEdges;
+    FindBorderEdges(destination, resultCount, positionId, edges, borderEdges, &nonManifoldEdges);
+
+    auto isBorderEdge = [&borderEdges, &positionId](uint32 a, uint32 b)
+    {
+        return std::binary_search(borderEdges.begin(), borderEdges.end(), EdgeKey(positionId[a], positionId[b]));
+    };
+
+    for (uint64 edge : borderEdges)
+    {
+        for (uint32 id : { uint32(edge >> 32), uint32(edge) })
+        {
+            if (kinds[id] == EVertexKind::Manifold)
+            {
+                kinds[id] = settings.LockBorder ? EVertexKind::Locked : EVertexKind::Border;
+            }
+        }
+    }
+    for (uint64 edge : nonManifoldEdges)
+    {
+        kinds[uint32(edge >> 32)] = EVertexKind::Locked;
+        kinds[uint32(edge)] = EVertexKind::Locked;
+    }
+
+    // Area weighted triangle planes, plus planes through the border edges perpendicular to the
+    // surface, which keep open borders from shrinking.
+    std::vector<Quadric> quadrics(vertexCount);
+    for (std::size_t i = 0; i < resultCount; i += 3)
+    {
+        const uint32* tri = destination + i;
+        const XMVECTOR n = TriangleNormal(points[tri[0]], points[tri[1]], points[tri[2]]);
+        const float length = XMVectorGetX(XMVector3Length(n));
+        if (length <= 0.0f)
+        {
+            continue;
+        }
+
+        XMFLOAT3 normal;
+        XMStoreFloat3(&normal, n / length);
+        const float d = -XMVectorGetX(XMVector3Dot(n / length, XMLoadFloat3(&points[tri[0]])));
+        const Quadric plane = Quadric::FromPlane(normal, d, 0.5f*length);
+        for (int k = 0; k < 3; ++k)
+        {
+            quadrics[tri[k]] += plane;
+        }
+
+        for (int k = 0; k < 3; ++k)
+        {
+            const uint32 a = tri[k], b = tri[(k + 1) % 3];
+            if (!isBorderEdge(a, b))
+            {
+                continue;
+            }
+
+            const XMVECTOR edge = XMLoadFloat3(&points[b]) - XMLoadFloat3(&points[a]);
+            const float edgeLengthSq = XMVectorGetX(XMVector3LengthSq(edge));
+            const XMVECTOR edgeNormal = XMVector3Normalize(XMVector3Cross(edge, n));
+
+            XMFLOAT3 borderNormal;
+            XMStoreFloat3(&borderNormal, edgeNormal);
+            const float borderD = -XMVectorGetX(XMVector3Dot(edgeNormal, XMLoadFloat3(&points[a])));
+            const Quadric border = Quadric::FromPlane(borderNormal, borderD, BorderWeight*edgeLengthSq);
+            quadrics[a] += border;
+            quadrics[b] += border;
+        }
+    }
+
+    std::vector<uint32> remap(vertexCount);
+    std::vector<bool> passLocked(vertexCount);
+    std::vector<uint32> adjacencyOffset(vertexCount + 1);
+    std::vector<uint32> adjacency;
+    std::vector<Collapse> collapses;
+    float maxError = 0.0f;
+
+    // Each pass collapses the cheapest edges that don't touch each other, then rebuilds.
+    while (resultCount > targetIndexCount)
+    {
+        std::fill(adjacencyOffset.begin(), adjacencyOffset.end(), 0u);
+        for (std::size_t i = 0; i < resultCount; ++i)
+        {
+            ++adjacencyOffset[destination[i] + 1];
+        }
+        for (std::size_t v = 0; v < vertexCount; ++v)
+        {
+            adjacencyOffset[v + 1] += adjacencyOffset[v];
+        }
+        adjacency.resize(resultCount);
+        {
+            std::vector<uint32> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+            for (std::size_t i = 0; i < resultCount; ++i)
+            {
+                adjacency[fill[destination[i]]++] = static_cast<uint32>(i / 3);
+            }
+        }
+
+        FindBorderEdges(destination, resultCount, positionId, edges, borderEdges, nullptr);
+
+        collapses.clear();
+        for (std::size_t i = 0; i < resultCount; ++i)
+        {
+            const uint32 a = destination[i];
+            const uint32 b = destination[i - i % 3 + (i + 1) % 3];
+
+            for (int direction = 0; direction < 2; ++direction)
+            {
+                const uint32 from = direction == 0 ? a : b;
+                const uint32 to = direction == 0 ? b : a;
+
+                if (kinds[from] == EVertexKind::Locked)
+                {
+                    continue;
+                }
+                if (kinds[from] == EVertexKind::Border && (kinds[to] == EVertexKind::Manifold || !isBorderEdge(from, to)))
+                {
+                    continue;
+                }
+
+                Collapse collapse;
+                collapse.From = from;
+                collapse.To = to;
+                collapse.Error = quadrics[from].Error(points[to]);
+                // Attribute differences are scaled by the squared edge length: a normal that changes
+                // by a lot across a short edge is a small error, like tilting that edge would be.
+                float attributeError = 0.0f;
+                for (std::size_t k = 0; k < attributeCount; ++k)
+                {
+                    const float delta = attribute(from)[k] - attribute(to)[k];
+                    attributeError += attributeWeights[k]*delta*delta;
+                }
+                const float edgeLengthSq = XMVectorGetX(XMVector3LengthSq(XMLoadFloat3(&points[to]) - XMLoadFloat3(&points[from])));
+                collapse.Cost = collapse.Error + attributeError*edgeLengthSq;
+                collapses.push_back(collapse);
+            }
+        }
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b)
+        {
+            return a.Cost < b.Cost;
+        });
+
+        for (std::size_t v = 0; v < vertexCount; ++v)
+        {
+            remap[v] = static_cast<uint32>(v);
+        }
+        std::fill(passLocked.begin(), passLocked.end(), false);
+
+        const float errorLimit = settings.MaxError*settings.MaxError;
+        const std::size_t trianglesToRemove = std::max<std::size_t>((resultCount - targetIndexCount) / 3, 1);
+        std::size_t trianglesRemoved = 0;
+        std::size_t collapseCount = 0;
+
+        for (const Collapse& collapse : collapses)
+        {
+            if (collapse.Cost > errorLimit || trianglesRemoved >= trianglesToRemove)
+            {
+                break;
+            }
+
+            // Edges share vertices with their neighbours, one collapse per neighbourhood and pass
+            // keeps the flip test below valid.
+            if (passLocked[collapse.From] || passLocked[collapse.To])
+            {
+                continue;
+            }
+
+            // Moving From onto To must not turn any remaining triangle around.
+            bool flips = false;
+            std::size_t shared = 0;
+            for (uint32 a = adjacencyOffset[collapse.From]; a < adjacencyOffset[collapse.From + 1] && !flips; ++a)
+            {
+                const uint32* tri = destination + adjacency[a]*3;
+                if (positionId[tri[0]] == positionId[collapse.To] || positionId[tri[1]] == positionId[collapse.To] ||
+                    positionId[tri[2]] == positionId[collapse.To])
+                {
+                    ++shared;
+                    continue;
+                }
+
+                const XMFLOAT3* corners[3];
+                const XMFLOAT3* moved[3];
+                for (int k = 0; k < 3; ++k)
+                {
+                    corners[k] = &points[tri[k]];
+                    moved[k] = tri[k] == collapse.From ? &points[collapse.To] : corners[k];
+                }
+
+                const XMVECTOR before = TriangleNormal(*corners[0], *corners[1], *corners[2]);
+                const XMVECTOR after = TriangleNormal(*moved[0], *moved[1], *moved[2]);
+                flips = XMVectorGetX(XMVector3Dot(before, after)) <= 0.0f;
+            }
+            if (flips)
+            {
+                continue;
+            }
+
+            remap[collapse.From] = collapse.To;
+            quadrics[collapse.To] += quadrics[collapse.From];
+            for (uint32 a = adjacencyOffset[collapse.From]; a < adjacencyOffset[collapse.From + 1]; ++a)
+            {
+                const uint32* tri = destination + adjacency[a]*3;
+                passLocked[tri[0]] = passLocked[tri[1]] = passLocked[tri[2]] = true;
+            }
+
+            maxError = std::max(maxError, collapse.Error);
+            trianglesRemoved += shared;
+            ++collapseCount;
+        }
+
+        if (collapseCount == 0)
+        {
+            break;
+        }
+
+        std::size_t write = 0;
+        for (std::size_t i = 0; i < resultCount; i += 3)
+        {
+            const uint32 a = remap[destination[i]], b = remap[destination[i + 1]], c = remap[destination[i + 2]];
+            if (positionId[a] != positionId[b] && positionId[b] != positionId[c] && positionId[a] != positionId[c])
+            {
+                destination[write++] = a;
+                destination[write++] = b;
+                destination[write++] = c;
+            }
+        }
+        resultCount = write;
+    }
+
+    if (resultError)
+    {
+        *resultError = sqrtf(maxError)*extent;
+    }
+    return resultCount;
+}
+
+std::vector<MeshLod> MeshSimplifier::BuildLodChain(std::vector<uint32>& indices, const float* positions,
+    const float* normals, std::size_t vertexStride, std::size_t vertexCount, const LodChainSettings& settings)
+{
+    std::vector<MeshLod> lods(1);
+    lods[0].IndexCount = static_cast<uint32>(indices.size());
+
+    const float normalWeights[3] = { settings.NormalWeight, settings.NormalWeight, settings.NormalWeight };
+
+    SimplifySettings simplify;
+    simplify.MaxError = settings.MaxError;
+    simplify.LockBorder = settings.LockBorder;
+
+    // Each level starts from the previous one, which is much cheaper than starting from the full
+    // mesh every time. Their errors add up.
+    std::vector<uint32> source(indices);
+    std::vector<uint32> level(indices.size());
+    for (uint32 i = 0; i < settings.MaxLevels; ++i)
+    {
+        const std::size_t target = static_cast<std::size_t>(source.size() / 3 * settings.ReductionRatio) * 3;
+
+        float error = 0.0f;
+        const std::size_t count = Simplify(level.data(), source.data(), source.size(), positions, vertexStride,
+            vertexCount, normals, vertexStride, normalWeights, normals ? 3 : 0, target, simplify, &error);
+        if (count == 0 || count > source.size()*MinLevelReduction)
+        {
+            break;
+        }
+
+        MeshLod lod;
+        lod.StartIndex = static_cast<uint32>(indices.size());
+        lod.IndexCount = static_cast<uint32>(count);
+        lod.GeometricError = lods.back().GeometricError + error;
+        lods.push_back(lod);
+
+        indices.insert(indices.end(), level.begin(), level.begin() + count);
+        source.assign(level.begin(), level.begin() + count);
+    }
+
+    return lods;
+}
+
+std::vector<MeshLod> MeshSimplifier::BuildLodChain(GeometryGenerator::MeshData& meshData, const LodChainSettings& settings)
+{
+    return BuildLodChain(meshData.Vertices, meshData.Indices32, &GeometryGenerator::Vertex::Position,
+        &GeometryGenerator::Vertex::Normal, settings);
+}
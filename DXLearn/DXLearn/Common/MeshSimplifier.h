@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "GeometryGenerator.h"
+
+struct SimplifySettings
+{
+    // Largest error allowed, relative to the biggest side of the mesh bounding box.
+    float MaxError = 0.01f;
+
+    // Keep open boundaries where they are. Otherwise border vertices may still slide
+    // along their border edges.
+    bool LockBorder = false;
+};
+
+// One level of a LOD chain, an index range into the shared vertex buffer.
+struct MeshLod
+{
+    std::uint32_t StartIndex = 0;
+    std::uint32_t IndexCount = 0;
+
+    // Upper bound of the distance to the full mesh, in mesh units.
+    float GeometricError = 0.0f;
+};
+
+struct LodChainSettings
+{
+    // Levels generated after the full mesh. The chain ends early once the error limit
+    // stops a level from getting meaningfully smaller.
+    std::uint32_t MaxLevels = 4;
+
+    // Fraction of the previous level's triangles each level aims for.
+    float ReductionRatio = 0.5f;
+
+    // Largest error of a single level, relative to the mesh extent.
+    float MaxError = 0.05f;
+
+    // Weight of the squared normal difference across a collapsed edge, see MeshSimplifier.
+    float NormalWeight = 0.5f;
+
+    bool LockBorder = false;
+};
+
+// Quadric error metric simplification (Garland and Heckbert, "Surface Simplification Using
+// Quadric Error Metrics"). Edges are collapsed onto one of their end points, cheapest first,
+// so every level reuses the vertices of the input and only needs its own index range. On top
+// of the position quadrics, collapsing vertices whose attributes differ costs the weighted
+// squared difference times the squared edge length. Open borders are held in place by edge
+// quadrics or locked outright, and vertices on attribute seams (several vertices at one
+// position) never move.
+class MeshSimplifier
+{
+public:
+    using uint32 = std::uint32_t;
+
+    // Writes at most indexCount indices to destination, aiming for targetIndexCount, and returns
+    // the number written. attributes points at attributeCount floats per vertex, attributeStride
+    // bytes apart, each weighted by attributeWeights; they may be null when attributeCount is 0.
+    // resultError, if given, receives the error of the result in mesh units.
+    static std::size_t Simplify(uint32* destination, const uint32* indices, std::size_t indexCount,
+        const float* positions, std::size_t positionStride, std::size_t vertexCount,
+        const float* attributes, std::size_t attributeStride, const float* attributeWeights, std::size_t attributeCount,
+        std::size_t targetIndexCount, const SimplifySettings& settings, float* resultError = nullptr);
+
+    // Appends the levels of a LOD chain after the full mesh in indices. The first entry returned
+    // is the full mesh itself. position and normal select the vertex members used.
+    template<typename VertexT>
+    static std::vector<MeshLod> BuildLodChain(const std::vector<VertexT>& vertices, std::vector<uint32>& indices,
+        DirectX::XMFLOAT3 VertexT::* position, DirectX::XMFLOAT3 VertexT::* normal, const LodChainSettings& settings);
+
+    // Call before GetIndices16(), the 16-bit copy is cached and wouldn't see the new levels.
+    static std::vector<MeshLod> BuildLodChain(GeometryGenerator::MeshData& meshData, const LodChainSettings& settings);
+
+private:
+    static std::vector<MeshLod> BuildLodChain(std::vector<uint32>& indices, const float* positions,
+        const float* normals, std::size_t vertexStride, std::size_t vertexCount, const LodChainSettings& settings);
+};
+
+template<typename VertexT>
+std::vector<MeshLod> MeshSimplifier::BuildLodChain(const std::vector<VertexT>& vertices, std::vector<uint32>& indices,
+    DirectX::XMFLOAT3 VertexT::* position, DirectX::XMFLOAT3 VertexT::* normal, const LodChainSettings& settings)
+{
+    if (vertices.empty() || indices.empty())
+    {
+        return std::vector<MeshLod>();
+    }
+
+    return BuildLodChain(indices, &(vertices[0].*position).x, &(vertices[0].*normal).x, sizeof(VertexT),
+        vertices.size(), settings);
+}
@@ -0,0 +1,314 @@
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "TaskScheduler.h"
+
+using namespace DirectX;
+
+namespace
+{
+    using uint32 = std::uint32_t;
+
+    const uint32 InvalidIndex = ~0u;
+
+    // Normal cones wider than acos(0.1), about 84 degrees, can't be culled from any
+    // realistic eye position, they are flagged as such instead.
+    const float MinConeSpread = 0.1f;
+
+    // Meshlets handed to a worker at a time when computing bounds.
+    const int BoundsGrainSize = 32;
+
+    inline XMVECTOR LoadPosition(const float* positions, std::size_t stride, uint32 vertex)
+    {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(positions) + vertex*stride;
+        return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(bytes));
+    }
+}
+
+MeshletGeometry MeshletBuilder::Build(uint32* indices, std::size_t indexCount, const float* positions,
+    std::size_t positionStride, std::size_t vertexCount, uint32 maxVertices, uint32 maxTriangles)
+{
+    assert(maxVertices >= 3 && maxVertices <= 256);
+    assert(maxTriangles >= 1);
+
+    MeshletGeometry geometry;
+    const std::size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+    {
+        return geometry;
+    }
+
+    // Vertex -> triangle adjacency.
+    std::vector<uint32> adjacencyOffset(vertexCount + 1, 0);
+    for (std::size_t i = 0; i < triangleCount*3; ++i)
+    {
+        assert(indices[i] < vertexCount);
+        ++adjacencyOffset[indices[i] + 1];
+    }
+    for (std::size_t v = 0; v < vertexCount; ++v)
+    {
+        adjacencyOffset[v + 1] += adjacencyOffset[v];
+    }
+
+    std::vector<uint32> adjacency(triangleCount*3);
+    {
+        std::vector<uint32> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (std::size_t i = 0; i < triangleCount*3; ++i)
+        {
+            adjacency[fill[indices[i]]++] = static_cast<uint32>(i / 3);
+        }
+    }
+
+    // Local index of each mesh vertex in the meshlet being built.
+    std::vector<uint32> localIndex(vertexCount, InvalidIndex);
+    std::vector<bool> used(triangleCount, false);
+
+    std::vector<uint32> reordered;
+    reordered.reserve(triangleCount*3);
+    geometry.VertexIndices.reserve(triangleCount);
+    geometry.PrimitiveIndices.reserve(triangleCount*3);
+
+    Meshlet current;
+    auto finishMeshlet = [&geometry, &current, &localIndex, &reordered]()
+    {
+        for (uint32 i = 0; i < current.VertexCount; ++i)
+        {
+            localIndex[geometry.VertexIndices[current.VertexOffset + i]] = InvalidIndex;
+        }
+        geometry.Meshlets.push_back(current);
+
+        current = Meshlet();
+        current.VertexOffset = static_cast<uint32>(geometry.VertexIndices.size());
+        current.TriangleOffset = static_cast<uint32>(reordered.size() / 3);
+    };
+
+    auto newVertexCount = [&localIndex](const uint32* tri)
+    {
+        uint32 count = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            // Degenerate triangles repeat a vertex, count it once.
+            const bool repeated = (k > 0 && tri[k] == tri[0]) || (k > 1 && tri[k] == tri[1]);
+            if (localIndex[tri[k]] == InvalidIndex && !repeated)
+            {
+                ++count;
+            }
+        }
+        return count;
+    };
+
+    std::size_t seedCursor = 0;
+    uint32 next = InvalidIndex;
+    for (std::size_t added = 0; added < triangleCount; ++added)
+    {
+        // Nothing adjacent is left, start over from the next unused triangle in input order.
+        if (next == InvalidIndex)
+        {
+            while (used[seedCursor])
+            {
+                ++seedCursor;
+            }
+            next = static_cast<uint32>(seedCursor);
+        }
+
+        const uint32* tri = indices + next*3;
+        if (current.VertexCount + newVertexCount(tri) > maxVertices || current.TriangleCount == maxTriangles)
+        {
+            finishMeshlet();
+        }
+
+        for (int k = 0; k < 3; ++k)
+        {
+            uint32& local = localIndex[tri[k]];
+            if (local == InvalidIndex)
+            {
+                local = current.VertexCount++;
+                geometry.VertexIndices.push_back(tri[k]);
+            }
+            geometry.PrimitiveIndices.push_back(static_cast<std::uint8_t>(local));
+            reordered.push_back(tri[k]);
+        }
+        used[next] = true;
+        ++current.TriangleCount;
+
+        // Grow towards the unused neighbour that costs the fewest new vertices.
+        next = InvalidIndex;
+        uint32 bestCost = 3;
+        for (uint32 i = 0; i < current.VertexCount && bestCost > 0; ++i)
+        {
+            const uint32 v = geometry.VertexIndices[current.VertexOffset + i];
+            for (uint32 a = adjacencyOffset[v]; a < adjacencyOffset[v + 1]; ++a)
+            {
+                const uint32 t = adjacency[a];
+                if (used[t])
+                {
+                    continue;
+                }
+
+                const uint32 cost = newVertexCount(indices + t*3);
+                if (cost < bestCost || next == InvalidIndex)
+                {
+                    bestCost = cost;
+                    next = t;
+                    if (cost == 0)
+                    {
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    finishMeshlet();
+
+    std::copy(reordered.begin(), reordered.end(), indices);
+
+    // Bounds only read shared data, every meshlet is independent.
+    TaskScheduler::Get().ParallelFor(0, static_cast<int>(geometry.Meshlets.size()), BoundsGrainSize,
+        [&geometry, positions, positionStride](int i)
+    {
+        Meshlet& meshlet = geometry.Meshlets[i];
+        meshlet.Bounds = ComputeBounds(geometry, meshlet, positions, positionStride);
+    });
+
+    return geometry;
+}
+
+MeshletBounds MeshletBuilder::ComputeBounds(const MeshletGeometry& geometry, const Meshlet& meshlet,
+    const float* positions, std::size_t positionStride)
+{
+    MeshletBounds bounds;
+    const uint32* vertices = &geometry.VertexIndices[meshlet.VertexOffset];
+
+    // Axis aligned box.
+    XMVECTOR minPoint = LoadPosition(positions, positionStride, vertices[0]);
+    XMVECTOR maxPoint = minPoint;
+    for (uint32 i = 1; i < meshlet.VertexCount; ++i)
+    {
+        const XMVECTOR p = LoadPosition(positions, positionStride, vertices[i]);
+        minPoint = XMVectorMin(minPoint, p);
+        maxPoint = XMVectorMax(maxPoint, p);
+    }
+    XMStoreFloat3(&bounds.Box.Center, (minPoint + maxPoint) * 0.5f);
+    XMStoreFloat3(&bounds.Box.Extents, (maxPoint - minPoint) * 0.5f);
+
+    // Ritter's sphere: start from two far apart points, then grow to take in the rest.
+    const XMVECTOR first = LoadPosition(positions, positionStride, vertices[0]);
+    XMVECTOR a = first;
+    XMVECTOR b = first;
+    float farthest = -1.0f;
+    for (uint32 i = 0; i < meshlet.VertexCount; ++i)
+    {
+        const XMVECTOR p = LoadPosition(positions, positionStride, vertices[i]);
+        const float d = XMVectorGetX(XMVector3LengthSq(p - first));
+        if (d > farthest)
+        {
+            farthest = d;
+            a = p;
+        }
+    }
+    farthest = -1.0f;
+    for (uint32 i = 0; i < meshlet.VertexCount; ++i)
+    {
+        const XMVECTOR p = LoadPosition(positions, positionStride, vertices[i]);
+        const float d = XMVectorGetX(XMVector3LengthSq(p - a));
+        if (d > farthest)
+        {
+            farthest = d;
+            b = p;
+        }
+    }
+
+    XMVECTOR center = (a + b) * 0.5f;
+    float radius = 0.5f * sqrtf(farthest);
+    for (uint32 i = 0; i < meshlet.VertexCount; ++i)
+    {
+        const XMVECTOR p = LoadPosition(positions, positionStride, vertices[i]);
+        const float d = XMVectorGetX(XMVector3Length(p - center));
+        if (d > radius)
+        {
+            // Move the center towards p just far enough to touch it.
+            const float newRadius = 0.5f*(radius + d);
+            center += (p - center) * ((newRadius - radius) / d);
+            radius = newRadius;
+        }
+    }
+    XMStoreFloat3(&bounds.Sphere.Center, center);
+    bounds.Sphere.Radius = radius;
+
+    // Normal cone around the average triangle normal.
+    std::vector<XMFLOAT3> normals;
+    std::vector<XMFLOAT3> corners;
+    normals.reserve(meshlet.TriangleCount);
+    corners.reserve(meshlet.TriangleCount);
+
+    XMVECTOR normalSum = XMVectorZero();
+    const std::uint8_t* primitives = &geometry.PrimitiveIndices[meshlet.TriangleOffset*3];
+    for (uint32 t = 0; t < meshlet.TriangleCount; ++t)
+    {
+        const XMVECTOR p0 = LoadPosition(positions, positionStride, vertices[primitives[t*3]]);
+        const XMVECTOR p1 = LoadPosition(positions, positionStride, vertices[primitives[t*3 + 1]]);
+        const XMVECTOR p2 = LoadPosition(positions, positionStride, vertices[primitives[t*3 + 2]]);
+
+        const XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+        const float length = XMVectorGetX(XMVector3Length(n));
+
+        // Zero area triangles can't be seen from either side.
+        if (length <= 0.0f)
+        {
+            continue;
+        }
+
+        XMFLOAT3 normal, corner;
+        XMStoreFloat3(&normal, n / length);
+        XMStoreFloat3(&corner, p0);
+        normals.push_back(normal);
+        corners.push_back(corner);
+        normalSum += n / length;
+    }
+
+    const float sumLength = XMVectorGetX(XMVector3Length(normalSum));
+    if (normals.empty() || sumLength <= 0.0f)
+    {
+        return bounds;
+    }
+
+    const XMVECTOR axis = normalSum / sumLength;
+    float minDot = 1.0f;
+    for (const XMFLOAT3& normal : normals)
+    {
+        minDot = std::min(minDot, XMVectorGetX(XMVector3Dot(XMLoadFloat3(&normal), axis)));
+    }
+
+    if (minDot <= MinConeSpread)
+    {
+        return bounds;
+    }
+
+    // Slide the apex back along the axis until it is behind every triangle's plane, then
+    // the test is exact for perspective views, not only for far away eyes.
+    float maxT = 0.0f;
+    for (std::size_t t = 0; t < normals.size(); ++t)
+    {
+        const XMVECTOR n = XMLoadFloat3(&normals[t]);
+        const float dc = XMVectorGetX(XMVector3Dot(center - XMLoadFloat3(&corners[t]), n));
+        const float dn = XMVectorGetX(XMVector3Dot(axis, n));
+        maxT = std::max(maxT, dc / dn);
+    }
+
+    XMStoreFloat3(&bounds.ConeApex, center - axis*maxT);
+    XMStoreFloat3(&bounds.ConeAxis, axis);
+
+    // The normals are within acos(minDot) of the axis, widening that by 90 degrees on
+    // each side gives the view directions that see only back faces: cos(90 - a) = sin(a).
+    bounds.ConeCutoff = sqrtf(1.0f - minDot*minDot);
+    return bounds;
+}
+
+bool MeshletBuilder::IsBackfacing(const MeshletBounds& bounds, const XMFLOAT3& eyePosition)
+{
+    const XMVECTOR view = XMVector3Normalize(XMLoadFloat3(&bounds.ConeApex) - XMLoadFloat3(&eyePosition));
+    return XMVectorGetX(XMVector3Dot(view, XMLoadFloat3(&bounds.ConeAxis))) >= bounds.ConeCutoff;
+}
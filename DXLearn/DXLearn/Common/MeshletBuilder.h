@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <DirectXCollision.h>
+#include <DirectXMath.h>
+
+// Culling volumes of one meshlet, in the mesh's local space.
+struct MeshletBounds
+{
+    DirectX::BoundingSphere Sphere;
+    DirectX::BoundingBox Box;
+
+    // Normal cone. Every triangle faces away from any eye for which
+    // dot(normalize(ConeApex - eye), ConeAxis) >= ConeCutoff, see MeshletBuilder::IsBackfacing.
+    // A cutoff of 1 means the normals spread too far for the test to ever pass.
+    DirectX::XMFLOAT3 ConeApex = { 0.0f, 0.0f, 0.0f };
+    DirectX::XMFLOAT3 ConeAxis = { 0.0f, 0.0f, 0.0f };
+    float ConeCutoff = 1.0f;
+};
+
+// A cluster of at most MaxVertices vertices and MaxTriangles triangles. Its triangles are
+// contiguous in the reordered index buffer, so it can be drawn on its own with
+// DrawIndexedInstanced(TriangleCount*3, 1, StartIndexLocation + TriangleOffset*3, ...),
+// and its local vertex list is there for mesh shaders.
+struct Meshlet
+{
+    std::uint32_t VertexOffset = 0;     // into MeshletGeometry::VertexIndices
+    std::uint32_t VertexCount = 0;
+    std::uint32_t TriangleOffset = 0;   // in triangles, into the index range of the submesh and into PrimitiveIndices
+    std::uint32_t TriangleCount = 0;
+
+    MeshletBounds Bounds;
+};
+
+struct MeshletGeometry
+{
+    std::vector<Meshlet> Meshlets;
+
+    // Mesh vertex of each meshlet-local vertex.
+    std::vector<std::uint32_t> VertexIndices;
+
+    // Three meshlet-local vertex indices per triangle.
+    std::vector<std::uint8_t> PrimitiveIndices;
+};
+
+// Splits triangle lists into meshlets for cluster culling. Meshlets grow greedily from a
+// seed triangle, always taking the neighbouring triangle that adds the fewest new vertices,
+// so they come out compact and mostly flat, which keeps the normal cones tight. A vertex
+// cache optimized input order (MeshOptimizer) gives the best seeds.
+class MeshletBuilder
+{
+public:
+    using uint32 = std::uint32_t;
+
+    // Common limits of mesh shader hardware. maxVertices can't exceed 256, the local
+    // indices are bytes.
+    static MeshletGeometry Build(uint32* indices, std::size_t indexCount, const float* positions,
+        std::size_t positionStride, std::size_t vertexCount, uint32 maxVertices = 64, uint32 maxTriangles = 124);
+
+    // Same for a vertex/index vector pair, position selects the member holding the position.
+    template<typename VertexT>
+    static MeshletGeometry Build(const std::vector<VertexT>& vertices, std::vector<uint32>& indices,
+        DirectX::XMFLOAT3 VertexT::* position, uint32 maxVertices = 64, uint32 maxTriangles = 124);
+
+    // Normal cone test from the eye position in the mesh's local space.
+    static bool IsBackfacing(const MeshletBounds& bounds, const DirectX::XMFLOAT3& eyePosition);
+
+private:
+    static MeshletBounds ComputeBounds(const MeshletGeometry& geometry, const Meshlet& meshlet,
+        const float* positions, std::size_t positionStride);
+};
+
+template<typename VertexT>
+MeshletGeometry MeshletBuilder::Build(const std::vector<VertexT>& vertices, std::vector<uint32>& indices,
+    DirectX::XMFLOAT3 VertexT::* position, uint32 maxVertices, uint32 maxTriangles)
+{
+    if (vertices.empty() || indices.empty())
+    {
+        return MeshletGeometry();
+    }
+
+    return Build(indices.data(), indices.size(), &(vertices[0].*position).x, sizeof(VertexT),
+        vertices.size(), maxVertices, maxTriangles);
+}
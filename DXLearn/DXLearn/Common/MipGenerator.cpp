@@ -0,0 +1,454 @@
+#include "MipGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <emmintrin.h>
+
+#include "AlignedAllocator.h"
+#include "BCDecoder.h"
+#include "TaskScheduler.h"
+
+namespace
+{
+    using uint8 = std::uint8_t;
+    using uint32 = std::uint32_t;
+
+    // Four floats per texel, every texel one aligned SSE2 vector.
+    using FloatPixels = std::vector<float, AlignedAllocator<float>>;
+
+    // Destination rows a thread filters in one band, and rows converted per task.
+    const int BandGrainSize = 8;
+    const int ConvertGrainSize = 32;
+
+    // Reach of the Kaiser window in destination texels and its shape.
+    const float KaiserRadius = 2.0f;
+    const float KaiserAlpha = 4.0f;
+
+    // Alpha counts as alpha tested when this much of it is 0 or 255.
+    const float AlphaTestedFraction = 0.9f;
+
+    // Linear values are quantized to this many steps to look up their sRGB encoding, fine
+    // enough to hit the right 8 bit value in the darkest part of the curve.
+    const int LinearSteps = 65535;
+
+    const float Pi = 3.14159265358979f;
+
+    // Zeroth order modified Bessel function of the first kind, from its series.
+    float BesselI0(float x)
+    {
+        const float quarterSq = 0.25f*x*x;
+        float sum = 1.0f;
+        float term = 1.0f;
+        for (int k = 1; k < 32 && term > sum*1e-8f; ++k)
+        {
+            term *= quarterSq / static_cast<float>(k*k);
+            sum += term;
+        }
+        return sum;
+    }
+
+    float KaiserSinc(float t)
+    {
+        if (std::fabs(t) >= KaiserRadius)
+        {
+            return 0.0f;
+        }
+        const float sinc = t == 0.0f ? 1.0f : std::sin(Pi*t) / (Pi*t);
+        const float r = t / KaiserRadius;
+        return sinc*BesselI0(KaiserAlpha*std::sqrt(1.0f - r*r)) / BesselI0(KaiserAlpha);
+    }
+
+    struct SRGBTables
+    {
+        float ToLinear[256];
+        uint8 FromLinear[LinearSteps + 1];
+
+        SRGBTables()
+        {
+            for (int i = 0; i < 256; ++i)
+            {
+                const float c = i / 255.0f;
+                ToLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+            for (int i = 0; i <= LinearSteps; ++i)
+            {
+                const float l = static_cast<float>(i) / LinearSteps;
+                const float c = l <= 0.0031308f ? l*12.92f : 1.055f*std::pow(l, 1.0f / 2.4f) - 0.055f;
+                FromLinear[i] = static_cast<uint8>(std::min(std::max(c*255.0f + 0.5f, 0.0f), 255.0f));
+            }
+        }
+    };
+
+    const SRGBTables& GetSRGBTables()
+    {
+        static const SRGBTables tables;
+        return tables;
+    }
+
+    // Source texels and weights of every destination texel along one axis, MaxTaps per texel.
+    // Unused taps repeat the first index with weight 0, so every index is a valid texel.
+    struct FilterTaps
+    {
+        int MaxTaps = 0;
+        std::vector<int> Indices;
+        std::vector<float> Weights;
+
+        FilterTaps(uint32 srcSize, uint32 destSize, MipFilter filter)
+        {
+            const float scale = static_cast<float>(srcSize) / destSize;
+            const float reach = filter == MipFilterBox ? 0.5f*scale : KaiserRadius*scale;
+            MaxTaps = static_cast<int>(std::ceil(2.0f*reach)) + 1;
+            Indices.assign(std::size_t(destSize)*MaxTaps, 0);
+            Weights.assign(std::size_t(destSize)*MaxTaps, 0.0f);
+
+            for (uint32 i = 0; i < destSize; ++i)
+            {
+                int* indices = &Indices[std::size_t(i)*MaxTaps];
+                float* weights = &Weights[std::size_t(i)*MaxTaps];
+                const float center = (i + 0.5f)*scale;
+
+                int count = 0;
+                float sum = 0.0f;
+                const int first = static_cast<int>(std::floor(center - reach));
+                const int last = static_cast<int>(std::ceil(center + reach));
+                for (int j = first; j < last && count < MaxTaps; ++j)
+                {
+                    const float weight = filter == MipFilterBox ?
+                        std::max(std::min(j + 1.0f, center + reach) - std::max(static_cast<float>(j), center - reach), 0.0f) :
+                        KaiserSinc((j + 0.5f - center) / scale);
+                    if (weight != 0.0f)
+                    {
+                        indices[count] = std::min(std::max(j, 0), static_cast<int>(srcSize) - 1);
+                        weights[count] = weight;
+                        sum += weight;
+                        ++count;
+                    }
+                }
+
+                for (int k = 0; k < count; ++k)
+                {
+                    weights[k] /= sum;
+                }
+                for (int k = count; k < MaxTaps; ++k)
+                {
+                    indices[k] = indices[0];
+                }
+            }
+        }
+    };
+
+    // One row of texels filtered horizontally to destWidth texels.
+    void FilterRow(const float* src, const FilterTaps& taps, uint32 destWidth, float* dest)
+    {
+        for (uint32 x = 0; x < destWidth; ++x)
+        {
+            const int* indices = &taps.Indices[std::size_t(x)*taps.MaxTaps];
+            const float* weights = &taps.Weights[std::size_t(x)*taps.MaxTaps];
+            __m128 sum = _mm_setzero_ps();
+            for (int k = 0; k < taps.MaxTaps; ++k)
+            {
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_load_ps(src + 4*indices[k])));
+            }
+            _mm_store_ps(dest + 4*x, sum);
+        }
+    }
+
+    // The next level. Every band of destination rows filters the source rows under it
+    // horizontally into thread local scratch, then filters those vertically. Negative Kaiser
+    // lobes can overshoot, results are clamped to 0..1.
+    void Downsample(const FloatPixels& src, uint32 srcWidth, uint32 srcHeight,
+        uint32 destWidth, uint32 destHeight, MipFilter filter, FloatPixels& dest)
+    {
+        const FilterTaps horizontal(srcWidth, destWidth, filter);
+        const FilterTaps vertical(srcHeight, destHeight, filter);
+        dest.resize(std::size_t(4)*destWidth*destHeight);
+
+        TaskScheduler::Get().ParallelForRange(0, static_cast<int>(destHeight), BandGrainSize, [&](int first, int last)
+        {
+            const auto bandBegin = vertical.Indices.begin() + std::size_t(first)*vertical.MaxTaps;
+            const auto bandEnd = vertical.Indices.begin() + std::size_t(last)*vertical.MaxTaps;
+            const int rowFirst = *std::min_element(bandBegin, bandEnd);
+            const int rowLast = *std::max_element(bandBegin, bandEnd);
+
+            thread_local FloatPixels scratch;
+            const std::size_t scratchPitch = std::size_t(4)*destWidth;
+            scratch.resize(scratchPitch*(rowLast - rowFirst + 1));
+            for (int row = rowFirst; row <= rowLast; ++row)
+            {
+                FilterRow(src.data() + std::size_t(4)*srcWidth*row, horizontal, destWidth,
+                    scratch.data() + scratchPitch*(row - rowFirst));
+            }
+
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 one = _mm_set1_ps(1.0f);
+            for (int y = first; y < last; ++y)
+            {
+                const int* indices = &vertical.Indices[std::size_t(y)*vertical.MaxTaps];
+                const float* weights = &vertical.Weights[std::size_t(y)*vertical.MaxTaps];
+                float* out = dest.data() + scratchPitch*y;
+                for (uint32 x = 0; x < destWidth; ++x)
+                {
+                    __m128 sum = _mm_setzero_ps();
+                    for (int k = 0; k < vertical.MaxTaps; ++k)
+                    {
+                        const float* texel = scratch.data() + scratchPitch*(indices[k] - rowFirst) + 4*x;
+                        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_load_ps(texel)));
+                    }
+                    _mm_store_ps(out + 4*x, _mm_min_ps(_mm_max_ps(sum, zero), one));
+                }
+            }
+        });
+    }
+
+    void ToFloat(const uint8* rgba, std::size_t rowPitch, uint32 width, uint32 height, bool srgb, FloatPixels& pixels)
+    {
+        pixels.resize(std::size_t(4)*width*height);
+        const SRGBTables& tables = GetSRGBTables();
+        TaskScheduler::Get().ParallelFor(0, static_cast<int>(height), ConvertGrainSize, [&](int y)
+        {
+            const uint8* src = rgba + rowPitch*y;
+            float* dest = pixels.data() + std::size_t(4)*width*y;
+            for (uint32 i = 0; i < 4*width; ++i)
+            {
+                dest[i] = srgb && (i & 3) != 3 ? tables.ToLinear[src[i]] : src[i] / 255.0f;
+            }
+        });
+    }
+
+    // A level back to 8 bit, alpha scaled for coverage.
+    void ToBytes(const FloatPixels& pixels, uint32 width, uint32 height, bool srgb, float alphaScale, Surface<uint8>& surface)
+    {
+        surface.Width = width;
+        surface.Height = height;
+        surface.Depth = 1;
+        surface.Pixels.resize(std::size_t(4)*width*height);
+
+        const SRGBTables& tables = GetSRGBTables();
+        const __m128 scale = srgb ? _mm_setr_ps(LinearSteps, LinearSteps, LinearSteps, 255.0f*alphaScale) :
+            _mm_setr_ps(255.0f, 255.0f, 255.0f, 255.0f*alphaScale);
+        const __m128 limit = srgb ? _mm_setr_ps(LinearSteps, LinearSteps, LinearSteps, 255.0f) : _mm_set1_ps(255.0f);
+        TaskScheduler::Get().ParallelFor(0, static_cast<int>(height), ConvertGrainSize, [&](int y)
+        {
+            const float* src = pixels.data() + std::size_t(4)*width*y;
+            uint8* dest = surface.Pixels.data() + std::size_t(4)*width*y;
+            for (uint32 x = 0; x < width; ++x)
+            {
+                const __m128i values = _mm_cvtps_epi32(_mm_min_ps(_mm_mul_ps(_mm_load_ps(src + 4*x), scale), limit));
+                if (srgb)
+                {
+                    alignas(16) int steps[4];
+                    _mm_store_si128(reinterpret_cast<__m128i*>(steps), values);
+                    dest[4*x + 0] = tables.FromLinear[steps[0]];
+                    dest[4*x + 1] = tables.FromLinear[steps[1]];
+                    dest[4*x + 2] = tables.FromLinear[steps[2]];
+                    dest[4*x + 3] = static_cast<uint8>(steps[3]);
+                }
+                else
+                {
+                    const __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(values, values), values);
+                    const int packed = _mm_cvtsi128_si32(bytes);
+                    std::memcpy(dest + 4*x, &packed, 4);
+                }
+            }
+        });
+    }
+
+    bool IsAlphaTested(const uint8* rgba, std::size_t rowPitch, uint32 width, uint32 height)
+    {
+        std::size_t binary = 0;
+        bool anyTransparent = false;
+        for (uint32 y = 0; y < height; ++y)
+        {
+            const uint8* row = rgba + rowPitch*y;
+            for (uint32 x = 0; x < width; ++x)
+            {
+                const uint8 alpha = row[4*x + 3];
+                binary += alpha == 0 || alpha == 255;
+                anyTransparent |= alpha == 0;
+            }
+        }
+        return anyTransparent && binary >= AlphaTestedFraction*width*height;
+    }
+
+    // Fraction of mip 0 that passes the alpha test.
+    float AlphaCoverage(const uint8* rgba, std::size_t rowPitch, uint32 width, uint32 height, float reference)
+    {
+        std::size_t passing = 0;
+        for (uint32 y = 0; y < height; ++y)
+        {
+            const uint8* row = rgba + rowPitch*y;
+            for (uint32 x = 0; x < width; ++x)
+            {
+                passing += row[4*x + 3] >= reference*255.0f;
+            }
+        }
+        return static_cast<float>(passing) / (std::size_t(width)*height);
+    }
+
+    // Scale for the alpha of a level so the same fraction of it passes: the alpha of the texel
+    // at that rank is scaled up or down to the reference.
+    float CoverageScale(const FloatPixels& pixels, float coverage, float reference)
+    {
+        std::vector<float> alpha(pixels.size() / 4);
+        for (std::size_t i = 0; i < alpha.size(); ++i)
+        {
+            alpha[i] = pixels[4*i + 3];
+        }
+
+        const std::size_t passing = std::min(static_cast<std::size_t>(coverage*alpha.size() + 0.5f), alpha.size());
+        if (passing == 0)
+        {
+            return 1.0f;
+        }
+        std::nth_element(alpha.begin(), alpha.begin() + (passing - 1), alpha.end(), std::greater<float>());
+        return reference / std::max(alpha[passing - 1], 1.0f / 255.0f);
+    }
+}
+
+void MipGenerator::Generate(const uint8* rgba, std::size_t rowPitch, uint32 width, uint32 height,
+    const MipGenerateOptions& options, std::vector<Surface<uint8>>& mips)
+{
+    mips.clear();
+    if (width == 0 || height == 0)
+    {
+        return;
+    }
+
+    const bool keepCoverage = options.AlphaCoverage == MipAlphaCoverageOn ||
+        (options.AlphaCoverage == MipAlphaCoverageAuto && IsAlphaTested(rgba, rowPitch, width, height));
+    const float coverage = keepCoverage ? AlphaCoverage(rgba, rowPitch, width, height, options.AlphaReference) : 0.0f;
+
+    FloatPixels current;
+    FloatPixels next;
+    ToFloat(rgba, rowPitch, width, height, options.SRGB, current);
+    while (width > 1 || height > 1)
+    {
+        const uint32 destWidth = std::max(width / 2, 1u);
+        const uint32 destHeight = std::max(height / 2, 1u);
+        Downsample(current, width, height, destWidth, destHeight, options.Filter, next);
+
+        const float alphaScale = keepCoverage ? CoverageScale(next, coverage, options.AlphaReference) : 1.0f;
+        mips.emplace_back();
+        ToBytes(next, destWidth, destHeight, options.SRGB, alphaScale, mips.back());
+
+        current.swap(next);
+        width = destWidth;
+        height = destHeight;
+    }
+}
+
+bool MipGenerator::AddMips(const DDSImage& image, const MipGenerateOptions& options,
+    DDSImage& result, std::vector<std::vector<uint8>>& storage)
+{
+    MipGenerateOptions levelOptions = options;
+    bool isBlockCompressed = false;
+    switch (image.Format)
+    {
+    case DXGI_FORMAT_R8G8B8A8_UNORM:
+    case DXGI_FORMAT_B8G8R8A8_UNORM:
+        break;
+
+    case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+    case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+        levelOptions.SRGB = true;
+        break;
+
+    case DXGI_FORMAT_B8G8R8X8_UNORM:
+        levelOptions.AlphaCoverage = MipAlphaCoverageOff;
+        break;
+
+    case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+        levelOptions.SRGB = true;
+        levelOptions.AlphaCoverage = MipAlphaCoverageOff;
+        break;
+
+    // SNORM isn't listed, 8 bit decoding and encoding don't round trip it exactly.
+    case DXGI_FORMAT_BC1_UNORM_SRGB:
+    case DXGI_FORMAT_BC3_UNORM_SRGB:
+        levelOptions.SRGB = true;
+        isBlockCompressed = true;
+        break;
+
+    case DXGI_FORMAT_BC1_UNORM:
+    case DXGI_FORMAT_BC3_UNORM:
+    case DXGI_FORMAT_BC4_UNORM:
+    case DXGI_FORMAT_BC5_UNORM:
+        isBlockCompressed = true;
+        break;
+
+    default:
+        return false;
+    }
+
+    if (image.MipCount != 1 || image.Dimension != DDSDimensionTexture2D || (image.Width <= 1 && image.Height <= 1))
+    {
+        return false;
+    }
+
+    uint32 mipCount = 1;
+    for (uint32 largest = std::max(image.Width, image.Height); largest > 1; largest >>= 1)
+    {
+        ++mipCount;
+    }
+
+    storage.clear();
+    storage.reserve(std::size_t(image.ArraySize)*(mipCount - 1));
+    for (uint32 slice = 0; slice < image.ArraySize; ++slice)
+    {
+        const DDSSubresource& top = image.Subresource(0, slice);
+        const uint8* rgba = top.Data;
+        std::size_t rowPitch = top.RowPitch;
+
+        Surface<uint8> decoded;
+        if (isBlockCompressed)
+        {
+            decoded.Width = top.Width;
+            decoded.Height = top.Height;
+            decoded.Pixels.resize(std::size_t(4)*top.Width*top.Height);
+            rowPitch = std::size_t(4)*top.Width;
+            BCDecoder::DecodeSurface(image.Format, top.Data, top.RowPitch, top.Width, top.Height, decoded.Pixels.data(), rowPitch);
+            rgba = decoded.Pixels.data();
+        }
+
+        std::vector<Surface<uint8>> mips;
+        Generate(rgba, rowPitch, top.Width, top.Height, levelOptions, mips);
+
+        if (isBlockCompressed)
+        {
+            std::vector<std::vector<uint8>> encoded;
+            BCEncoder::Encode(image.Format, BCQualityFast, mips, encoded);
+            for (std::vector<uint8>& level : encoded)
+            {
+                storage.push_back(std::move(level));
+            }
+        }
+        else
+        {
+            for (Surface<uint8>& level : mips)
+            {
+                storage.push_back(std::move(level.Pixels));
+            }
+        }
+    }
+
+    result = image;
+    result.MipCount = mipCount;
+    result.Subresources.resize(std::size_t(mipCount)*image.ArraySize);
+    for (uint32 slice = 0; slice < image.ArraySize; ++slice)
+    {
+        result.Subresources[slice*mipCount] = image.Subresource(0, slice);
+        for (uint32 mip = 1; mip < mipCount; ++mip)
+        {
+            DDSSubresource& subresource = result.Subresources[slice*mipCount + mip];
+            subresource.Width = std::max(image.Width >> mip, 1u);
+            subresource.Height = std::max(image.Height >> mip, 1u);
+            subresource.Depth = 1;
+            DDSParser::GetSurfaceInfo(subresource.Width, subresource.Height, image.Format,
+                &subresource.SlicePitch, &subresource.RowPitch, &subresource.RowCount);
+            subresource.Data = storage[std::size_t(slice)*(mipCount - 1) + mip - 1].data();
+        }
+    }
+    return true;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "BCEncoder.h"
+#include "DDSParser.h"
+#include "Surface.h"
+
+enum MipFilter
+{
+    MipFilterBox,
+    MipFilterKaiser,
+};
+
+enum MipAlphaCoverage
+{
+    MipAlphaCoverageOff,
+    MipAlphaCoverageOn,
+    MipAlphaCoverageAuto,               // on when nearly all alpha is 0 or 255, as in cutouts
+};
+
+struct MipGenerateOptions
+{
+    MipFilter Filter = MipFilterKaiser;
+    bool SRGB = false;                  // filter in linear light, also implied by _SRGB formats
+
+    // Alpha tested textures thin out in the small mips as alpha blurs below the test, with
+    // coverage on the alpha of every level is scaled so as many texels pass as in mip 0.
+    MipAlphaCoverage AlphaCoverage = MipAlphaCoverageOff;
+    float AlphaReference = 0.5f;        // the threshold the shaders clip at
+};
+
+// CPU mip chains for 8 bit RGBA textures. Every level is filtered from the one above it in
+// float, so rounding doesn't pile up down the chain:
+//   Box      average of the texels under the destination texel.
+//   Kaiser   Kaiser windowed sinc with a radius of two destination texels, four wide, keeps
+//            the small mips sharp where the box blurs.
+// The filters are separable, weights are computed once per level and column, edges clamp.
+// Levels are split in bands of rows, every thread filters the source rows of its band
+// horizontally into its own scratch and then vertically, one SSE2 vector per texel.
+class MipGenerator
+{
+public:
+    using uint8 = std::uint8_t;
+    using uint32 = std::uint32_t;
+
+    // Levels below a width x height image of RGBA (or BGRA) rows rowPitch bytes apart, mips[0]
+    // is the half size one, the last is 1x1.
+    static void Generate(const uint8* rgba, std::size_t rowPitch, uint32 width, uint32 height,
+        const MipGenerateOptions& options, std::vector<Surface<uint8>>& mips);
+
+    // The full chain of an image that only has mip 0, 2D 8 bit RGBA/BGRA or a format BCEncoder
+    // writes (decoded, filtered, encoded at fast quality). Mip 0 keeps pointing into the image,
+    // the new levels live in storage, which has to outlive result. False if there is nothing
+    // to do or the format isn't supported.
+    static bool AddMips(const DDSImage& image, const MipGenerateOptions& options,
+        DDSImage& result, std::vector<std::vector<uint8>>& storage);
+};
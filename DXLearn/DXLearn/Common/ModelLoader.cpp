@@ -0,0 +1,471 @@
+#include "ModelLoader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "MappedFile.h"
+#include "TangentGenerator.h"
+#include "TaskScheduler.h"
+
+using namespace DirectX;
+
+namespace
+{
+    using uint32 = std::uint32_t;
+    using uint64 = std::uint64_t;
+
+    // Bytes of text per parallel work item.
+    const std::size_t ChunkSize = 64*1024;
+
+    // Vertex columns a model may have, offsets into GeometryGenerator::Vertex.
+    struct Column
+    {
+        const char* Name;
+        std::size_t Offset;
+        int FloatCount;
+    };
+
+    const Column KnownColumns[] =
+    {
+        { "pos", offsetof(GeometryGenerator::Vertex, Position), 3 },
+        { "normal", offsetof(GeometryGenerator::Vertex, Normal), 3 },
+        { "tangent", offsetof(GeometryGenerator::Vertex, TangentU), 3 },
+        { "texC", offsetof(GeometryGenerator::Vertex, TexC), 2 },
+    };
+
+    const int MaxColumns = 4;
+
+    inline bool IsDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    inline bool IsBlank(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    inline bool IsSpace(char c)
+    {
+        return IsBlank(c) || c == '\n';
+    }
+
+    inline void SkipBlanks(const char*& p, const char* end)
+    {
+        while (p < end && IsBlank(*p))
+        {
+            ++p;
+        }
+    }
+
+    inline void SkipSpaces(const char*& p, const char* end)
+    {
+        while (p < end && IsSpace(*p))
+        {
+            ++p;
+        }
+    }
+
+    // Skips white space, then consumes word if it comes next.
+    bool Expect(const char*& p, const char* end, const char* word)
+    {
+        SkipSpaces(p, end);
+        const std::size_t length = std::strlen(word);
+        if (static_cast<std::size_t>(end - p) < length || std::memcmp(p, word, length) != 0)
+        {
+            return false;
+        }
+        p += length;
+        return true;
+    }
+
+    bool ParseUInt(const char*& p, const char* end, uint32& value)
+    {
+        const char* s = p;
+        uint64 result = 0;
+        while (s < end && IsDigit(*s))
+        {
+            result = result*10 + (*s - '0');
+            if (result > 0xffffffffull)
+            {
+                return false;
+            }
+            ++s;
+        }
+        if (s == p)
+        {
+            return false;
+        }
+
+        value = static_cast<uint32>(result);
+        p = s;
+        return true;
+    }
+
+    // "name: value" on the header lines.
+    bool ExpectCount(const char*& p, const char* end, const char* name, uint32& value)
+    {
+        if (!Expect(p, end, name))
+        {
+            return false;
+        }
+        SkipBlanks(p, end);
+        return ParseUInt(p, end, value);
+    }
+
+    double PowerOf10(int exponent)
+    {
+        // Exact in double up to 1e22, so short decimals convert without error.
+        static const double table[] =
+        {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+        };
+        return exponent < 23 ? table[exponent] : pow(10.0, exponent);
+    }
+
+    // [+-]digits[.digits][(e|E)[+-]digits], always with '.' as the decimal point.
+    bool ParseFloat(const char*& p, const char* end, float& value)
+    {
+        const char* s = p;
+        bool negative = false;
+        if (s < end && (*s == '-' || *s == '+'))
+        {
+            negative = *s == '-';
+            ++s;
+        }
+
+        // Digits past the 18th can't change a float, they only move the exponent.
+        const uint64 mantissaLimit = 100000000000000000ull;
+        uint64 mantissa = 0;
+        int exponent = 0;
+        bool anyDigit = false;
+        for (; s < end && IsDigit(*s); ++s)
+        {
+            anyDigit = true;
+            if (mantissa < mantissaLimit)
+            {
+                mantissa = mantissa*10 + (*s - '0');
+            }
+            else
+            {
+                ++exponent;
+            }
+        }
+        if (s < end && *s == '.')
+        {
+            for (++s; s < end && IsDigit(*s); ++s)
+            {
+                anyDigit = true;
+                if (mantissa < mantissaLimit)
+                {
+                    mantissa = mantissa*10 + (*s - '0');
+                    --exponent;
+                }
+            }
+        }
+        if (!anyDigit)
+        {
+            return false;
+        }
+
+        if (s < end && (*s == 'e' || *s == 'E'))
+        {
+            const char* e = s + 1;
+            bool negativeExponent = false;
+            if (e < end && (*e == '-' || *e == '+'))
+            {
+                negativeExponent = *e == '-';
+                ++e;
+            }
+
+            int written = 0;
+            const char* digits = e;
+            for (; e < end && IsDigit(*e); ++e)
+            {
+                written = std::min(written*10 + (*e - '0'), 100000);
+            }
+
+            // A lone 'e' isn't part of the number, the caller rejects what follows.
+            if (e != digits)
+            {
+                exponent += negativeExponent ? -written : written;
+                s = e;
+            }
+        }
+
+        double result = static_cast<double>(mantissa);
+        if (mantissa != 0)
+        {
+            result = exponent < 0 ? result / PowerOf10(std::min(-exponent, 400)) : result * PowerOf10(std::min(exponent, 400));
+        }
+
+        value = static_cast<float>(negative ? -result : result);
+        p = s;
+        return true;
+    }
+
+    // Lines with anything but white space on them.
+    std::size_t CountLines(const char* begin, const char* end)
+    {
+        std::size_t count = 0;
+        bool content = false;
+        for (const char* p = begin; p < end; ++p)
+        {
+            if (*p == '\n')
+            {
+                count += content;
+                content = false;
+            }
+            else if (!IsBlank(*p))
+            {
+                content = true;
+            }
+        }
+        return count + content;
+    }
+
+    // Splits [begin, end) into chunks at line breaks and calls parseLine(chunk, line, lineBegin, lineEnd)
+    // for every non-blank line, line counting from 0 over the whole range. False if there aren't
+    // exactly lineCount lines or parseLine fails on any of them.
+    template<typename ParseLine>
+    bool ParseLines(const char* begin, const char* end, std::size_t lineCount, std::size_t& chunkCount,
+        const ParseLine& parseLine)
+    {
+        chunkCount = std::max<std::size_t>(1, (end - begin) / ChunkSize);
+
+        std::vector<const char*> chunkBegin(chunkCount + 1, end);
+        chunkBegin[0] = begin;
+        for (std::size_t c = 1; c < chunkCount; ++c)
+        {
+            const char* p = std::max(begin + c*ChunkSize, chunkBegin[c - 1]);
+            const char* lineBreak = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            chunkBegin[c] = lineBreak ? lineBreak + 1 : end;
+        }
+
+        // Line numbers come from a count of every chunk first, then each chunk can write its
+        // lines straight to their place.
+        std::vector<std::size_t> firstLine(chunkCount + 1, 0);
+        TaskScheduler::Get().ParallelFor(0, static_cast<int>(chunkCount), 1, [&](int c)
+        {
+            firstLine[c + 1] = CountLines(chunkBegin[c], chunkBegin[c + 1]);
+        });
+        for (std::size_t c = 0; c < chunkCount; ++c)
+        {
+            firstLine[c + 1] += firstLine[c];
+        }
+        if (firstLine[chunkCount] != lineCount)
+        {
+            return false;
+        }
+
+        std::vector<char> chunkValid(chunkCount, 1);
+        TaskScheduler::Get().ParallelFor(0, static_cast<int>(chunkCount), 1, [&](int c)
+        {
+            std::size_t line = firstLine[c];
+            const char* chunkEnd = chunkBegin[c + 1];
+            for (const char* p = chunkBegin[c]; p < chunkEnd;)
+            {
+                const char* lineBreak = static_cast<const char*>(std::memchr(p, '\n', chunkEnd - p));
+                const char* lineEnd = lineBreak ? lineBreak : chunkEnd;
+
+                const char* content = p;
+                SkipBlanks(content, lineEnd);
+                if (content < lineEnd && !parseLine(c, line++, content, lineEnd))
+                {
+                    chunkValid[c] = 0;
+                    return;
+                }
+                p = lineEnd + 1;
+            }
+        });
+
+        return std::find(chunkValid.begin(), chunkValid.end(), 0) == chunkValid.end();
+    }
+
+    // Everything after the numbers of a line has to be blank.
+    inline bool AtLineEnd(const char*& p, const char* lineEnd)
+    {
+        SkipBlanks(p, lineEnd);
+        return p == lineEnd;
+    }
+}
+
+bool ModelLoader::Load(const std::wstring& path, ModelData& model)
+{
+    MappedFile file;
+    if (!file.Open(path))
+    {
+        model = ModelData();
+        return false;
+    }
+
+    return Parse(static_cast<const char*>(file.Data()), file.Size(), model);
+}
+
+bool ModelLoader::Parse(const char* text, std::size_t size, ModelData& model)
+{
+    model = ModelData();
+
+    const char* p = text;
+    const char* end = text + size;
+
+    uint32 vertexCount = 0;
+    uint32 triangleCount = 0;
+    if (!ExpectCount(p, end, "VertexCount:", vertexCount) ||
+        !ExpectCount(p, end, "TriangleCount:", triangleCount) ||
+        !Expect(p, end, "VertexList"))
+    {
+        return false;
+    }
+
+    // Column list, positions and normals when there is none.
+    const Column* columns[MaxColumns] = { &KnownColumns[0], &KnownColumns[1] };
+    int columnCount = 2;
+    SkipBlanks(p, end);
+    if (p < end && *p == '(')
+    {
+        columnCount = 0;
+        for (++p; ;)
+        {
+            while (p < end && (IsBlank(*p) || *p == ','))
+            {
+                ++p;
+            }
+            if (p < end && *p == ')')
+            {
+                ++p;
+                break;
+            }
+
+            const char* name = p;
+            while (p < end && (std::isalnum(static_cast<unsigned char>(*p)) || *p == '_'))
+            {
+                ++p;
+            }
+
+            const Column* column = nullptr;
+            for (const Column& known : KnownColumns)
+            {
+                if (std::strlen(known.Name) == static_cast<std::size_t>(p - name) && std::memcmp(known.Name, name, p - name) == 0)
+                {
+                    column = &known;
+                }
+            }
+            if (!column || columnCount == MaxColumns)
+            {
+                return false;
+            }
+            columns[columnCount++] = column;
+        }
+    }
+
+    if (!Expect(p, end, "{"))
+    {
+        return false;
+    }
+    const char* vertexBegin = p;
+    const char* vertexEnd = static_cast<const char*>(std::memchr(p, '}', end - p));
+    if (!vertexEnd)
+    {
+        return false;
+    }
+
+    p = vertexEnd + 1;
+    if (!Expect(p, end, "TriangleList") || !Expect(p, end, "{"))
+    {
+        return false;
+    }
+    const char* indexBegin = p;
+    const char* indexEnd = static_cast<const char*>(std::memchr(p, '}', end - p));
+    if (!indexEnd)
+    {
+        return false;
+    }
+
+    GeometryGenerator::MeshData& mesh = model.Mesh;
+    // Columns the file doesn't have stay zero.
+    mesh.Vertices.resize(vertexCount, GeometryGenerator::Vertex(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f));
+    mesh.Indices32.resize(std::size_t(triangleCount)*3);
+
+    // Bounds are gathered per chunk and merged afterwards.
+    std::vector<XMFLOAT3> chunkMin(size / ChunkSize + 1, XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX));
+    std::vector<XMFLOAT3> chunkMax(size / ChunkSize + 1, XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+
+    std::size_t vertexChunks = 0;
+    const bool verticesValid = ParseLines(vertexBegin, vertexEnd, vertexCount, vertexChunks,
+        [&](std::size_t chunk, std::size_t line, const char* s, const char* lineEnd)
+    {
+        GeometryGenerator::Vertex& vertex = mesh.Vertices[line];
+        for (int c = 0; c < columnCount; ++c)
+        {
+            float* values = reinterpret_cast<float*>(reinterpret_cast<unsigned char*>(&vertex) + columns[c]->Offset);
+            for (int i = 0; i < columns[c]->FloatCount; ++i)
+            {
+                SkipBlanks(s, lineEnd);
+                if (!ParseFloat(s, lineEnd, values[i]))
+                {
+                    return false;
+                }
+            }
+        }
+
+        XMFLOAT3& minPoint = chunkMin[chunk];
+        XMFLOAT3& maxPoint = chunkMax[chunk];
+        minPoint = XMFLOAT3(std::min(minPoint.x, vertex.Position.x), std::min(minPoint.y, vertex.Position.y), std::min(minPoint.z, vertex.Position.z));
+        maxPoint = XMFLOAT3(std::max(maxPoint.x, vertex.Position.x), std::max(maxPoint.y, vertex.Position.y), std::max(maxPoint.z, vertex.Position.z));
+        return AtLineEnd(s, lineEnd);
+    });
+
+    std::size_t indexChunks = 0;
+    const bool indicesValid = verticesValid && ParseLines(indexBegin, indexEnd, triangleCount, indexChunks,
+        [&](std::size_t, std::size_t line, const char* s, const char* lineEnd)
+    {
+        uint32* triangle = &mesh.Indices32[line*3];
+        for (int i = 0; i < 3; ++i)
+        {
+            SkipBlanks(s, lineEnd);
+            if (!ParseUInt(s, lineEnd, triangle[i]) || triangle[i] >= vertexCount)
+            {
+                return false;
+            }
+        }
+        return AtLineEnd(s, lineEnd);
+    });
+
+    if (!indicesValid)
+    {
+        model = ModelData();
+        return false;
+    }
+
+    XMVECTOR minPoint = XMVectorReplicate(FLT_MAX);
+    XMVECTOR maxPoint = XMVectorReplicate(-FLT_MAX);
+    for (std::size_t c = 0; c < vertexChunks; ++c)
+    {
+        minPoint = XMVectorMin(minPoint, XMLoadFloat3(&chunkMin[c]));
+        maxPoint = XMVectorMax(maxPoint, XMLoadFloat3(&chunkMax[c]));
+    }
+    if (vertexCount > 0)
+    {
+        BoundingBox::CreateFromPoints(model.Bounds, minPoint, maxPoint);
+    }
+
+    // Normal mapped models without tangents get them from their texture coordinates.
+    auto hasColumn = [&](const char* name)
+    {
+        return std::find_if(columns, columns + columnCount, [name](const Column* c) { return std::strcmp(c->Name, name) == 0; }) !=
+            columns + columnCount;
+    };
+    if (hasColumn("normal") && hasColumn("texC") && !hasColumn("tangent"))
+    {
+        TangentGenerator::Generate(mesh);
+    }
+
+    return true;
+}
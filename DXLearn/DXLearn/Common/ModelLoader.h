@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <DirectXCollision.h>
+
+#include "GeometryGenerator.h"
+
+struct ModelData
+{
+    GeometryGenerator::MeshData Mesh;
+
+    // Box around all vertices.
+    DirectX::BoundingBox Bounds;
+};
+
+// Loader of the text models in AppFactory/Models:
+//
+//   VertexCount: 31076
+//   TriangleCount: 60339
+//   VertexList (pos, normal)
+//   {
+//       one vertex per line, the columns named in the parentheses
+//   }
+//   TriangleList
+//   {
+//       three indices per line
+//   }
+//
+// The columns may be pos, normal, tangent and texC, in any order. Tangents are generated when
+// there are normals and texture coordinates but no tangents. The file is memory mapped,
+// split into chunks at line breaks and the chunks are parsed in parallel on the TaskScheduler.
+// Numbers are read by hand, not with streams or strtod, so the result doesn't depend on the
+// C locale and no time goes to locale lookups.
+class ModelLoader
+{
+public:
+    // False if the file is missing or malformed, the model is left empty then.
+    static bool Load(const std::wstring& path, ModelData& model);
+
+    // Same for a model already in memory, text doesn't need to be null terminated.
+    static bool Parse(const char* text, std::size_t size, ModelData& model);
+};
@@ -1 +1,76 @@
 ﻿#include "RenderItem.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+    float MaxScale(FXMMATRIX m)
+    {
+        return sqrtf(std::max(XMVectorGetX(XMVector3LengthSq(m.r[0])),
+            std::max(XMVectorGetX(XMVector3LengthSq(m.r[1])), XMVectorGetX(XMVector3LengthSq(m.r[2])))));
+    }
+}
+
+void RenderItem::SelectLod(const XMFLOAT3& eyePosW, float pixelsPerUnit, float maxPixelError)
+{
+    if (Lods.empty())
+    {
+        return;
+    }
+
+    const XMMATRIX world = XMLoadFloat4x4(&World);
+
+    // Errors grow with the largest scale of the world matrix.
+    const float scale = MaxScale(world);
+
+    // The nearest point of the bounds decides, inside them everything is drawn at full detail.
+    const BoundingBox& bounds = Lods[0].Bounds;
+    const XMVECTOR center = XMVector3TransformCoord(XMLoadFloat3(&bounds.Center), world);
+    const float radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Extents)))*scale;
+    const float distance = XMVectorGetX(XMVector3Length(center - XMLoadFloat3(&eyePosW))) - radius;
+
+    size_t level = 0;
+    if (distance > 0.0f)
+    {
+        while (level + 1 < Lods.size() && Lods[level + 1].GeometricError*scale*pixelsPerUnit <= maxPixelError*distance)
+        {
+            ++level;
+        }
+    }
+
+    IndexCount = Lods[level].IndexCount;
+    StartIndexLocation = Lods[level].StartIndexLocation;
+    BaseVertexLocation = Lods[level].BaseVertexLocation;
+}
+
+float RenderItem::TextureLod(const XMFLOAT3& eyePosW, float pixelsPerUnit, float textureSize) const
+{
+    const XMMATRIX world = XMLoadFloat4x4(&World);
+    const float scale = MaxScale(world);
+
+    const XMVECTOR center = XMVector3TransformCoord(XMLoadFloat3(&Bounds.Center), world);
+    const float localRadius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&Bounds.Extents)));
+    const float distance = XMVectorGetX(XMVector3Length(center - XMLoadFloat3(&eyePosW))) - localRadius*scale;
+
+    // The texture repeats as often as the largest scale of the texture transforms says.
+    XMMATRIX texTransform = XMLoadFloat4x4(&TexTransform);
+    if (Mat)
+    {
+        texTransform = XMMatrixMultiply(texTransform, XMLoadFloat4x4(&Mat->MatTransform));
+    }
+    const float repeat = sqrtf(std::max(XMVectorGetX(XMVector2LengthSq(texTransform.r[0])),
+        XMVectorGetX(XMVector2LengthSq(texTransform.r[1]))));
+
+    // World units one repetition of the texture covers.
+    const float extent = (TexCoordExtent > 0.0f ? TexCoordExtent : 2.0f*localRadius)*scale/std::max(repeat, 1e-6f);
+    if (distance <= 0.0f || extent <= 0.0f)
+    {
+        return 0.0f;
+    }
+
+    // textureSize/extent texels and pixelsPerUnit/distance pixels per world unit.
+    return log2f(textureSize*distance/(extent*pixelsPerUnit));
+}
@@ -13,6 +13,16 @@ public:
 
     virtual ~RenderItem() = default;
 
+    // Draws the coarsest level of Lods whose error, projected to the screen, stays within
+    // maxPixelError. pixelsPerUnit is the size in pixels of one unit at a distance of one,
+    // proj._22 * height / 2.
+    void SelectLod(const DirectX::XMFLOAT3& eyePosW, float pixelsPerUnit, float maxPixelError);
+
+    // The mip of a texture textureSize texels across the item is seen at, log2 of texels per
+    // pixel at the nearest point of Bounds, below 0 when magnified. Texture coordinates are
+    // scaled by TexTransform and the material's MatTransform, as in the shaders.
+    float TextureLod(const DirectX::XMFLOAT3& eyePosW, float pixelsPerUnit, float textureSize) const;
+
 public:
     // World matrix of the shape that describe the object's local space
     // relative to the world space, which define the position, orientation,
@@ -39,4 +49,12 @@ public:
     UINT IndexCount = 0;
     UINT StartIndexLocation = 0;
     UINT BaseVertexLocation = 0;
+
+    // LOD chain, finest first, all sharing Geo. Empty if the item has a single level.
+    std::vector<SubMeshGeometry> Lods;
+
+    // Of the drawn submesh, see SubMeshGeometry. With TexCoordExtent 0 a unit of texture
+    // coordinates is taken to cover the bounds.
+    DirectX::BoundingBox Bounds;
+    float TexCoordExtent = 0.0f;
 };
@@ -0,0 +1,126 @@
+#include "SimdUtil.h"
+
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+namespace
+{
+    struct CpuFeatures
+    {
+        bool SSE41 = false;
+        bool AVX2 = false;
+        bool F16C = false;
+
+        CpuFeatures()
+        {
+            unsigned int leaf1[4] = {};
+            unsigned int leaf7[4] = {};
+#if defined(_MSC_VER)
+            int regs[4];
+            __cpuid(regs, 0);
+            int maxLeaf = regs[0];
+            __cpuidex(regs, 1, 0);
+            for (int i = 0; i < 4; ++i) leaf1[i] = static_cast<unsigned int>(regs[i]);
+            if (maxLeaf >= 7)
+            {
+                __cpuidex(regs, 7, 0);
+                for (int i = 0; i < 4; ++i) leaf7[i] = static_cast<unsigned int>(regs[i]);
+            }
+#else
+            unsigned int maxLeaf = __get_cpuid_max(0, nullptr);
+            __cpuid_count(1, 0, leaf1[0], leaf1[1], leaf1[2], leaf1[3]);
+            if (maxLeaf >= 7)
+            {
+                __cpuid_count(7, 0, leaf7[0], leaf7[1], leaf7[2], leaf7[3]);
+            }
+#endif
+            const unsigned int ecx1 = leaf1[2];
+            const unsigned int ebx7 = leaf7[1];
+
+            // AVX state has to be enabled by the OS (OSXSAVE + XCR0 bits 1 and 2),
+            // otherwise the first ymm instruction faults even if the CPU has it.
+            bool osAvx = false;
+            if ((ecx1 & (1u << 27)) && (ecx1 & (1u << 28)))
+            {
+#if defined(_MSC_VER)
+                unsigned long long xcr0 = _xgetbv(0);
+#else
+                unsigned int eax, edx;
+                __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+                unsigned long long xcr0 = (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+                osAvx = (xcr0 & 0x6) == 0x6;
+            }
+
+            SSE41 = (ecx1 & (1u << 19)) != 0;
+            AVX2 = osAvx && (ebx7 & (1u << 5)) != 0;
+            F16C = osAvx && (ecx1 & (1u << 29)) != 0;
+        }
+    };
+
+    const CpuFeatures& GetCpuFeatures()
+    {
+        static CpuFeatures features;
+        return features;
+    }
+
+    SIMD_TARGET_F16C std::size_t HalfToFloatF16C(const std::uint16_t* src, float* dst, std::size_t count)
+    {
+        std::size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            const __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+        }
+        return i;
+    }
+
+    SIMD_TARGET_F16C std::size_t FloatToHalfF16C(const float* src, std::uint16_t* dst, std::size_t count)
+    {
+        std::size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            const __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), h);
+        }
+        return i;
+    }
+}
+
+bool SimdUtil::HasSSE41()
+{
+    return GetCpuFeatures().SSE41;
+}
+
+bool SimdUtil::HasAVX2()
+{
+    return GetCpuFeatures().AVX2;
+}
+
+bool SimdUtil::HasF16C()
+{
+    return GetCpuFeatures().F16C;
+}
+
+void SimdUtil::HalfToFloat(const std::uint16_t* src, float* dst, std::size_t count)
+{
+    std::size_t i = HasF16C() ? HalfToFloatF16C(src, dst, count) : 0;
+    for (; i < count; ++i)
+    {
+        dst[i] = HalfToFloat(src[i]);
+    }
+}
+
+void SimdUtil::FloatToHalf(const float* src, std::uint16_t* dst, std::size_t count)
+{
+    std::size_t i = HasF16C() ? FloatToHalfF16C(src, dst, count) : 0;
+    for (; i < count; ++i)
+    {
+        dst[i] = FloatToHalf(src[i]);
+    }
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// MSVC lets any translation unit use AVX intrinsics, gcc/clang need the function
+// to be tagged with the target ISA. Kernels guarded by a runtime check use this.
+#if defined(_MSC_VER)
+#define SIMD_TARGET_AVX2
+#define SIMD_TARGET_F16C
+#else
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#define SIMD_TARGET_F16C __attribute__((target("avx,f16c")))
+#endif
+
+class SimdUtil
+{
+public:
+    // Query once and cache, the result can't change while the process runs.
+    static bool HasSSE41();
+    static bool HasAVX2();
+    static bool HasF16C();
+
+    // IEEE half <-> float, rounding to nearest even. The scalar versions give the same
+    // bits as the F16C instructions for every non-NaN input, so data converted on
+    // different machines or paths matches.
+    static float HalfToFloat(std::uint16_t h);
+    static std::uint16_t FloatToHalf(float f);
+
+    // Bulk versions, F16C when the CPU has it.
+    static void HalfToFloat(const std::uint16_t* src, float* dst, std::size_t count);
+    static void FloatToHalf(const float* src, std::uint16_t* dst, std::size_t count);
+};
+
+inline float SimdUtil::HalfToFloat(std::uint16_t h)
+{
+    // Move exponent and mantissa into place and rebias, then fix up the special cases.
+    const std::uint32_t shiftedExp = 0x7c00u << 13;
+    std::uint32_t bits = (h & 0x7fffu) << 13;
+    const std::uint32_t exp = bits & shiftedExp;
+    bits += (127 - 15) << 23;
+
+    float f;
+    if (exp == shiftedExp)
+    {
+        // Inf/NaN
+        bits += (128 - 16) << 23;
+        memcpy(&f, &bits, sizeof(f));
+    }
+    else if (exp == 0)
+    {
+        // Zero/subnormal, renormalize with a float subtract.
+        bits += 1 << 23;
+        const std::uint32_t magicBits = 113u << 23;
+        float magic;
+        memcpy(&f, &bits, sizeof(f));
+        memcpy(&magic, &magicBits, sizeof(magic));
+        f -= magic;
+    }
+    else
+    {
+        memcpy(&f, &bits, sizeof(f));
+    }
+
+    std::uint32_t result;
+    memcpy(&result, &f, sizeof(result));
+    result |= static_cast<std::uint32_t>(h & 0x8000u) << 16;
+    memcpy(&f, &result, sizeof(f));
+    return f;
+}
+
+inline std::uint16_t SimdUtil::FloatToHalf(float f)
+{
+    std::uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    const std::uint32_t sign = bits & 0x80000000u;
+    bits ^= sign;
+
+    std::uint32_t half;
+    if (bits >= (127u + 16) << 23)
+    {
+        // Too large for a half, Inf or NaN.
+        half = bits > 0x7f800000u ? 0x7e00u : 0x7c00u;
+    }
+    else if (bits < 113u << 23)
+    {
+        // Subnormal or zero. Adding the magic value lines the 10 mantissa bits up at the
+        // bottom of the float, the FPU does the round to nearest even.
+        const std::uint32_t magicBits = ((127u - 15) + (23 - 10) + 1) << 23;
+        float magic;
+        float value;
+        memcpy(&magic, &magicBits, sizeof(magic));
+        memcpy(&value, &bits, sizeof(value));
+        value += magic;
+        memcpy(&half, &value, sizeof(half));
+        half -= magicBits;
+    }
+    else
+    {
+        // Normal, rebias and round to nearest even by hand. A carry out of the mantissa
+        // correctly bumps the exponent, up to Inf.
+        const std::uint32_t mantissaOdd = (bits >> 13) & 1;
+        bits += ((15u - 127) << 23) + 0xfff + mantissaOdd;
+        half = bits >> 13;
+    }
+
+    return static_cast<std::uint16_t>(half | (sign >> 16));
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// RGBA pixels in memory, rows tightly packed, depth slices one after the other.
+template<typename T>
+struct Surface
+{
+    std::uint32_t Width = 0;
+    std::uint32_t Height = 0;
+    std::uint32_t Depth = 1;
+    std::vector<T> Pixels;              // 4 values per pixel
+};
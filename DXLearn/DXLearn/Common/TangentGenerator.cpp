@@ -0,0 +1,172 @@
+#include "TangentGenerator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <DirectXMath.h>
+
+#include "TaskScheduler.h"
+
+using namespace DirectX;
+
+namespace
+{
+    using uint32 = std::uint32_t;
+
+    // Triangles and vertices handed to a worker at a time.
+    const int TriangleGrainSize = 2048;
+    const int VertexGrainSize = 4096;
+
+    // Below this a gradient or projection counts as zero.
+    const float Epsilon = 1e-20f;
+
+    struct CornerFrame
+    {
+        XMFLOAT3 Tangent;               // angle weighted
+        XMFLOAT3 Bitangent;
+    };
+
+    template<int Count>
+    inline XMVECTOR Load(const float* base, std::size_t stride, uint32 vertex)
+    {
+        const float* p = reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(base) + vertex*stride);
+        return Count == 2 ? XMVectorSet(p[0], p[1], 0.0f, 0.0f) : XMVectorSet(p[0], p[1], p[2], 0.0f);
+    }
+
+    // v minus its part along the unit vector n, normalized, or zero.
+    inline XMVECTOR ProjectNormalize(FXMVECTOR v, FXMVECTOR n)
+    {
+        const XMVECTOR projected = XMVectorSubtract(v, XMVectorMultiply(n, XMVector3Dot(n, v)));
+        const float lengthSq = XMVectorGetX(XMVector3LengthSq(projected));
+        return lengthSq > Epsilon ? XMVectorScale(projected, 1.0f / std::sqrt(lengthSq)) : XMVectorZero();
+    }
+}
+
+void TangentGenerator::Generate(const uint32* indices, std::size_t indexCount, const float* positions,
+    const float* normals, const float* texCoords, float* tangents, std::size_t stride,
+    std::size_t vertexCount, float* bitangentSigns)
+{
+    const std::size_t triangleCount = indexCount / 3;
+
+    // Contribution of every corner to its vertex.
+    std::vector<CornerFrame> corners(triangleCount*3);
+    TaskScheduler::Get().ParallelForRange(0, static_cast<int>(triangleCount), TriangleGrainSize,
+        [&](int first, int last)
+    {
+        for (int t = first; t < last; ++t)
+        {
+            const uint32* tri = indices + 3*t;
+            const XMVECTOR p[3] = { Load<3>(positions, stride, tri[0]), Load<3>(positions, stride, tri[1]), Load<3>(positions, stride, tri[2]) };
+            const XMVECTOR uv[3] = { Load<2>(texCoords, stride, tri[0]), Load<2>(texCoords, stride, tri[1]), Load<2>(texCoords, stride, tri[2]) };
+
+            // Gradients of the texture coordinates over the triangle.
+            const XMVECTOR e1 = XMVectorSubtract(p[1], p[0]);
+            const XMVECTOR e2 = XMVectorSubtract(p[2], p[0]);
+            const XMFLOAT2 duv1(XMVectorGetX(uv[1]) - XMVectorGetX(uv[0]), XMVectorGetY(uv[1]) - XMVectorGetY(uv[0]));
+            const XMFLOAT2 duv2(XMVectorGetX(uv[2]) - XMVectorGetX(uv[0]), XMVectorGetY(uv[2]) - XMVectorGetY(uv[0]));
+            const float signedArea = duv1.x*duv2.y - duv1.y*duv2.x;
+
+            XMVECTOR faceTangent = XMVectorZero();
+            XMVECTOR faceBitangent = XMVectorZero();
+            if (std::fabs(signedArea) > Epsilon)
+            {
+                // Only the directions matter, the sign of the area keeps them pointing along +u and +v.
+                const float orientation = signedArea > 0.0f ? 1.0f : -1.0f;
+                faceTangent = XMVectorScale(XMVectorSubtract(XMVectorScale(e1, duv2.y), XMVectorScale(e2, duv1.y)), orientation);
+                faceBitangent = XMVectorScale(XMVectorSubtract(XMVectorScale(e2, duv1.x), XMVectorScale(e1, duv2.x)), orientation);
+                faceTangent = XMVector3Normalize(faceTangent);
+                faceBitangent = XMVector3Normalize(faceBitangent);
+            }
+
+            for (int k = 0; k < 3; ++k)
+            {
+                CornerFrame& corner = corners[3*t + k];
+                const XMVECTOR n = XMVector3Normalize(Load<3>(normals, stride, tri[k]));
+
+                // Corner angle between the edges as seen along the normal.
+                const XMVECTOR toNext = ProjectNormalize(XMVectorSubtract(p[(k + 1) % 3], p[k]), n);
+                const XMVECTOR toPrev = ProjectNormalize(XMVectorSubtract(p[(k + 2) % 3], p[k]), n);
+                const float cosAngle = std::min(std::max(XMVectorGetX(XMVector3Dot(toNext, toPrev)), -1.0f), 1.0f);
+                const float angle = std::acos(cosAngle);
+
+                XMStoreFloat3(&corner.Tangent, XMVectorScale(ProjectNormalize(faceTangent, n), angle));
+                XMStoreFloat3(&corner.Bitangent, XMVectorScale(ProjectNormalize(faceBitangent, n), angle));
+            }
+        }
+    });
+
+    // Vertex -> corner lists, in index order.
+    std::vector<uint32> cornerOffset(vertexCount + 1, 0);
+    for (std::size_t i = 0; i < triangleCount*3; ++i)
+    {
+        assert(indices[i] < vertexCount);
+        ++cornerOffset[indices[i] + 1];
+    }
+    for (std::size_t v = 0; v < vertexCount; ++v)
+    {
+        cornerOffset[v + 1] += cornerOffset[v];
+    }
+
+    std::vector<uint32> vertexCorners(triangleCount*3);
+    {
+        std::vector<uint32> fill(cornerOffset.begin(), cornerOffset.end() - 1);
+        for (std::size_t i = 0; i < triangleCount*3; ++i)
+        {
+            vertexCorners[fill[indices[i]]++] = static_cast<uint32>(i);
+        }
+    }
+
+    TaskScheduler::Get().ParallelForRange(0, static_cast<int>(vertexCount), VertexGrainSize,
+        [&](int first, int last)
+    {
+        for (int v = first; v < last; ++v)
+        {
+            XMVECTOR tangent = XMVectorZero();
+            XMVECTOR bitangent = XMVectorZero();
+            for (uint32 c = cornerOffset[v]; c < cornerOffset[v + 1]; ++c)
+            {
+                const CornerFrame& corner = corners[vertexCorners[c]];
+                tangent = XMVectorAdd(tangent, XMLoadFloat3(&corner.Tangent));
+                bitangent = XMVectorAdd(bitangent, XMLoadFloat3(&corner.Bitangent));
+            }
+
+            const XMVECTOR n = XMVector3Normalize(Load<3>(normals, stride, v));
+            tangent = ProjectNormalize(tangent, n);
+            if (XMVector3Equal(tangent, XMVectorZero()))
+            {
+                // Any direction in the tangent plane, starting from the axis least aligned with n.
+                const XMVECTOR absN = XMVectorAbs(n);
+                const XMVECTOR axis = XMVectorGetX(absN) < 0.9f ? XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f) : XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+                tangent = ProjectNormalize(axis, n);
+            }
+
+            float* dest = reinterpret_cast<float*>(reinterpret_cast<unsigned char*>(tangents) + v*stride);
+            dest[0] = XMVectorGetX(tangent);
+            dest[1] = XMVectorGetY(tangent);
+            dest[2] = XMVectorGetZ(tangent);
+
+            if (bitangentSigns)
+            {
+                const float handedness = XMVectorGetX(XMVector3Dot(XMVector3Cross(n, tangent), bitangent));
+                bitangentSigns[v] = handedness < 0.0f ? -1.0f : 1.0f;
+            }
+        }
+    });
+}
+
+void TangentGenerator::Generate(GeometryGenerator::MeshData& meshData, std::vector<float>* bitangentSigns)
+{
+    std::vector<GeometryGenerator::Vertex>& vertices = meshData.Vertices;
+    if (bitangentSigns)
+    {
+        bitangentSigns->resize(vertices.size());
+    }
+    if (vertices.empty())
+    {
+        return;
+    }
+
+    Generate(meshData.Indices32.data(), meshData.Indices32.size(), &vertices[0].Position.x, &vertices[0].Normal.x,
+        &vertices[0].TexC.x, &vertices[0].TangentU.x, sizeof(GeometryGenerator::Vertex), vertices.size(),
+        bitangentSigns ? bitangentSigns->data() : nullptr);
+}
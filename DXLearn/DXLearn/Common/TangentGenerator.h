@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "GeometryGenerator.h"
+
+// Per-vertex tangents for normal mapping, following the MikkTSpace rules so maps baked by
+// tools that use it (Blender, Substance, xNormal) light correctly:
+//   - each triangle's tangent and bitangent come from its texture coordinate gradients,
+//     normalized, so large and small triangles count the same,
+//   - at every corner both are projected into the plane of the vertex normal and weighted by
+//     the corner angle measured in that plane,
+//   - the tangent is the normalized sum, the bitangent is sign * cross(normal, tangent) with
+//     the sign taken from the summed bitangent, -1 where the texture is mirrored.
+// Unlike MikkTSpace vertices are not split, a vertex shared by mirrored and regular triangles
+// keeps one frame, and triangles without texture area don't contribute. A vertex left with
+// no tangent gets an arbitrary one perpendicular to its normal.
+//
+// Triangles are processed in parallel chunks, each corner writes its own contribution and the
+// contributions of a vertex are summed in index order, so the result doesn't depend on the
+// thread count.
+class TangentGenerator
+{
+public:
+    using uint32 = std::uint32_t;
+
+    // positions, normals, texCoords and tangents point at the first vertex's member and advance
+    // by stride bytes. bitangentSigns receives vertexCount values of +1 or -1 if not null.
+    static void Generate(const uint32* indices, std::size_t indexCount, const float* positions,
+        const float* normals, const float* texCoords, float* tangents, std::size_t stride,
+        std::size_t vertexCount, float* bitangentSigns = nullptr);
+
+    // Fills TangentU of every vertex from Position, Normal and TexC.
+    static void Generate(GeometryGenerator::MeshData& meshData, std::vector<float>* bitangentSigns = nullptr);
+};
@@ -0,0 +1,312 @@
+#include "TaskScheduler.h"
+
+namespace
+{
+    // Lets a thread find its own deque without a lookup. Set once per worker thread.
+    thread_local const TaskScheduler* tlsScheduler = nullptr;
+    thread_local int tlsWorkerIndex = -1;
+
+    // Failed attempts at finding a task before a waiting thread goes to sleep.
+    const int SpinCount = 64;
+}
+
+TaskScheduler::TaskScheduler(unsigned int workerCount)
+    : mQueuedCount(0), mSleepingCount(0), mWaitingCount(0), mConcurrencyLimit(0), mQuit(false)
+{
+    if (workerCount == 0)
+    {
+        const unsigned int hardwareThreads = std::thread::hardware_concurrency();
+        workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    }
+
+    mWorkers.reserve(workerCount);
+    for (unsigned int i = 0; i < workerCount; ++i)
+    {
+        mWorkers.push_back(std::make_unique<Worker>());
+    }
+
+    // Start the threads only after every deque exists, they steal from each other right away.
+    for (unsigned int i = 0; i < workerCount; ++i)
+    {
+        mWorkers[i]->Thread = std::thread(&TaskScheduler::WorkerLoop, this, i);
+    }
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(mSleepLock);
+        mQuit.store(true);
+    }
+    mWakeUp.notify_all();
+
+    for (auto& worker : mWorkers)
+    {
+        worker->Thread.join();
+    }
+}
+
+TaskScheduler& TaskScheduler::Get()
+{
+    static TaskScheduler scheduler;
+    return scheduler;
+}
+
+unsigned int TaskScheduler::WorkerCount()const
+{
+    return static_cast<unsigned int>(mWorkers.size());
+}
+
+unsigned int TaskScheduler::Concurrency()const
+{
+    return WorkerCount() + 1;
+}
+
+void TaskScheduler::SetConcurrencyLimit(unsigned int limit)
+{
+    mConcurrencyLimit.store(limit, std::memory_order_relaxed);
+}
+
+void TaskScheduler::Submit(Task task)
+{
+    const int workerIndex = CurrentWorkerIndex();
+    if (workerIndex >= 0)
+    {
+        Worker& worker = *mWorkers[workerIndex];
+        std::lock_guard<std::mutex> lock(worker.Lock);
+        worker.Tasks.push_back(std::move(task));
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock(mSharedLock);
+        mSharedTasks.push_back(std::move(task));
+    }
+
+    // The count goes up before the sleeper check, a worker that is about to sleep
+    // re-reads it under mSleepLock, so the wake up can't get lost.
+    mQueuedCount.fetch_add(1);
+    if (mSleepingCount.load() > 0 || mWaitingCount.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(mSleepLock);
+        mWakeUp.notify_one();
+        mTaskDone.notify_all();
+    }
+}
+
+bool TaskScheduler::RunOne()
+{
+    Task task;
+    if (!PopTask(task))
+    {
+        return false;
+    }
+
+    task();
+
+    // The task may have been the last one a parked WaitUntil is waiting for. Same ordering
+    // as in Submit: the counter moved inside the task, before the waiter check.
+    if (mWaitingCount.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(mSleepLock);
+        mTaskDone.notify_all();
+    }
+    return true;
+}
+
+void TaskScheduler::WorkerLoop(unsigned int index)
+{
+    tlsScheduler = this;
+    tlsWorkerIndex = static_cast<int>(index);
+
+    for (;;)
+    {
+        if (RunOne())
+        {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mSleepLock);
+        mSleepingCount.fetch_add(1);
+        mWakeUp.wait(lock, [this]() { return mQueuedCount.load() > 0 || mQuit.load(); });
+        mSleepingCount.fetch_sub(1);
+
+        if (mQuit.load() && mQueuedCount.load() == 0)
+        {
+            return;
+        }
+    }
+}
+
+bool TaskScheduler::PopTask(Task& task)
+{
+    const int workerIndex = CurrentWorkerIndex();
+
+    // Newest local task first, it's the one most likely to still be in cache.
+    if (workerIndex >= 0)
+    {
+        Worker& worker = *mWorkers[workerIndex];
+        std::lock_guard<std::mutex> lock(worker.Lock);
+        if (!worker.Tasks.empty())
+        {
+            task = std::move(worker.Tasks.back());
+            worker.Tasks.pop_back();
+            mQueuedCount.fetch_sub(1);
+            return true;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mSharedLock);
+        if (!mSharedTasks.empty())
+        {
+            task = std::move(mSharedTasks.front());
+            mSharedTasks.pop_front();
+            mQueuedCount.fetch_sub(1);
+            return true;
+        }
+    }
+
+    return StealTask(workerIndex >= 0 ? static_cast<unsigned int>(workerIndex) : 0, task);
+}
+
+bool TaskScheduler::StealTask(unsigned int thief, Task& task)
+{
+    // Start at the neighbour so the thieves don't all hammer worker 0. Busy deques are
+    // skipped on the first pass and waited for on the second, so a steal that loses the
+    // race for a lock doesn't turn into a spin while tasks are still queued.
+    const unsigned int count = WorkerCount();
+    bool skipped = false;
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        for (unsigned int i = 1; i <= count; ++i)
+        {
+            Worker& victim = *mWorkers[(thief + i) % count];
+            std::unique_lock<std::mutex> lock(victim.Lock, std::defer_lock);
+            if (pass == 0 && !lock.try_lock())
+            {
+                skipped = true;
+                continue;
+            }
+            if (pass == 1)
+            {
+                lock.lock();
+            }
+            if (!victim.Tasks.empty())
+            {
+                task = std::move(victim.Tasks.front());
+                victim.Tasks.pop_front();
+                mQueuedCount.fetch_sub(1);
+                return true;
+            }
+        }
+        if (!skipped)
+        {
+            break;
+        }
+    }
+
+    return false;
+}
+
+int TaskScheduler::CurrentWorkerIndex()const
+{
+    return tlsScheduler == this ? tlsWorkerIndex : -1;
+}
+
+void TaskScheduler::WaitUntil(const std::atomic<int>& counter, int target)
+{
+    int idleTries = 0;
+    while (counter.load() != target)
+    {
+        if (RunOne())
+        {
+            idleTries = 0;
+            continue;
+        }
+
+        // What is left runs on other threads. It's usually short, spin a little before parking
+        // until a task finishes or a new one is queued.
+        if (++idleTries < SpinCount)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mSleepLock);
+        mWaitingCount.fetch_add(1);
+        mTaskDone.wait(lock, [&]() { return counter.load() == target || mQueuedCount.load() > 0; });
+        mWaitingCount.fetch_sub(1);
+        idleTries = 0;
+    }
+}
+
+TaskGroup::TaskGroup(TaskScheduler& scheduler)
+    : mScheduler(scheduler), mPendingCount(0)
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+    Wait();
+}
+
+void TaskGroup::Run(TaskScheduler::Task task)
+{
+    mPendingCount.fetch_add(1);
+    Launch(std::move(task));
+}
+
+void TaskGroup::Then(TaskScheduler::Task continuation)
+{
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mPendingCount.load() > 0)
+        {
+            mContinuations.push_back(std::move(continuation));
+            return;
+        }
+        mPendingCount.fetch_add(1);
+    }
+
+    // Nothing in flight, the continuation can start straight away.
+    Launch(std::move(continuation));
+}
+
+void TaskGroup::Wait()
+{
+    mScheduler.WaitUntil(mPendingCount, 0);
+
+    // The last Finish() drops the count while holding mLock, take it once so that call
+    // is done with the group before the caller is allowed to destroy it.
+    std::lock_guard<std::mutex> lock(mLock);
+}
+
+void TaskGroup::Launch(TaskScheduler::Task task)
+{
+    mScheduler.Submit([this, task = std::move(task)]()
+    {
+        task();
+        Finish();
+    });
+}
+
+void TaskGroup::Finish()
+{
+    std::vector<TaskScheduler::Task> ready;
+    {
+        // Continuations are claimed while the last task still counts as pending,
+        // so Wait() never sees the group drained in between.
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mPendingCount.load() == 1 && !mContinuations.empty())
+        {
+            ready.swap(mContinuations);
+            mPendingCount.fetch_add(static_cast<int>(ready.size()));
+        }
+        mPendingCount.fetch_sub(1);
+    }
+
+    for (auto& task : ready)
+    {
+        Launch(std::move(task));
+    }
+}
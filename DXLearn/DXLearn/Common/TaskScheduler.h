@@ -0,0 +1,181 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Portable work-stealing thread pool.
+// Every worker owns a deque: it pushes and pops its own tasks at the back, idle workers
+// steal the oldest task from the front of someone else's deque. Threads outside the pool
+// submit into a shared queue. A thread that waits on work always helps run tasks, so
+// nested ParallelFor / TaskGroup::Wait calls from inside a task can't deadlock the pool.
+// Threads with nothing to run spin for a few tries, then sleep until a task is submitted
+// or, for waiters, finishes.
+class TaskScheduler
+{
+public:
+    using Task = std::function<void()>;
+
+    // workerCount == 0 sizes the pool to the machine, leaving a core for the caller.
+    explicit TaskScheduler(unsigned int workerCount = 0);
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    // Pool shared by the apps and Common code.
+    static TaskScheduler& Get();
+
+    unsigned int WorkerCount()const;
+
+    // Number of threads that execute a ParallelFor: the workers plus the caller.
+    unsigned int Concurrency()const;
+
+    // Caps the threads a ParallelFor runs on, the caller included, 0 lifts the cap. For
+    // measuring how work scales, the workers stay up and chunking doesn't change.
+    void SetConcurrencyLimit(unsigned int limit);
+
+    void Submit(Task task);
+
+    // Runs one queued task on the calling thread. Returns false when nothing was found.
+    bool RunOne();
+
+    // Calls body(i) for every i in [begin, end).
+    // Indices are handed out in chunks of grainSize (<= 0 picks one from the range and the
+    // thread count). A range that fits in a single chunk runs inline on the caller.
+    template<typename Body>
+    void ParallelFor(int begin, int end, int grainSize, const Body& body);
+
+    // Same as ParallelFor but body(chunkBegin, chunkEnd) is called once per chunk.
+    template<typename Body>
+    void ParallelForRange(int begin, int end, int grainSize, const Body& body);
+
+private:
+    friend class TaskGroup;
+
+    struct Worker
+    {
+        std::mutex Lock;
+        std::deque<Task> Tasks;
+        std::thread Thread;
+    };
+
+    void WorkerLoop(unsigned int index);
+    bool PopTask(Task& task);
+    bool StealTask(unsigned int thief, Task& task);
+    int CurrentWorkerIndex()const;
+    void WaitUntil(const std::atomic<int>& counter, int target);
+
+    std::vector<std::unique_ptr<Worker>> mWorkers;
+
+    std::mutex mSharedLock;
+    std::deque<Task> mSharedTasks;
+
+    std::mutex mSleepLock;
+    std::condition_variable mWakeUp;            // idle workers, on submit
+    std::condition_variable mTaskDone;          // parked WaitUntil callers, on submit and finish
+    std::atomic<int> mQueuedCount;
+    std::atomic<int> mSleepingCount;
+    std::atomic<int> mWaitingCount;
+    std::atomic<unsigned int> mConcurrencyLimit;
+    std::atomic<bool> mQuit;
+};
+
+// Set of tasks that can be waited on together.
+// Then() registers continuations that are submitted once the group has no task left in
+// flight, without blocking the caller. Wait() also covers those continuations.
+class TaskGroup
+{
+public:
+    explicit TaskGroup(TaskScheduler& scheduler = TaskScheduler::Get());
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void Run(TaskScheduler::Task task);
+    void Then(TaskScheduler::Task continuation);
+    void Wait();
+
+private:
+    void Launch(TaskScheduler::Task task);
+    void Finish();
+
+    TaskScheduler& mScheduler;
+    std::atomic<int> mPendingCount;
+    std::mutex mLock;
+    std::vector<TaskScheduler::Task> mContinuations;
+};
+
+template<typename Body>
+void TaskScheduler::ParallelForRange(int begin, int end, int grainSize, const Body& body)
+{
+    if (end <= begin)
+    {
+        return;
+    }
+
+    const int count = end - begin;
+    if (grainSize <= 0)
+    {
+        // A few chunks per thread so uneven rows still balance out.
+        grainSize = std::max(1, count / static_cast<int>(Concurrency() * 4));
+    }
+
+    const int chunkCount = (count + grainSize - 1) / grainSize;
+    const unsigned int limit = mConcurrencyLimit.load(std::memory_order_relaxed);
+    if (chunkCount <= 1 || mWorkers.empty() || limit == 1)
+    {
+        body(begin, end);
+        return;
+    }
+
+    // Chunks are claimed from a shared counter instead of being pre-assigned, so a thread
+    // that finishes early just grabs the next one.
+    std::atomic<int> nextChunk(0);
+    std::atomic<int> helpersDone(0);
+    auto runChunks = [&]()
+    {
+        for (int chunk = nextChunk.fetch_add(1); chunk < chunkCount; chunk = nextChunk.fetch_add(1))
+        {
+            const int chunkBegin = begin + chunk * grainSize;
+            body(chunkBegin, std::min(end, chunkBegin + grainSize));
+        }
+    };
+
+    int helperCount = std::min(chunkCount - 1, static_cast<int>(mWorkers.size()));
+    if (limit > 1)
+    {
+        helperCount = std::min(helperCount, static_cast<int>(limit) - 1);
+    }
+    for (int i = 0; i < helperCount; ++i)
+    {
+        Submit([&]()
+        {
+            runChunks();
+            helpersDone.fetch_add(1);
+        });
+    }
+
+    runChunks();
+
+    // The helpers reference this stack frame, wait until every one of them has run.
+    WaitUntil(helpersDone, helperCount);
+}
+
+template<typename Body>
+void TaskScheduler::ParallelFor(int begin, int end, int grainSize, const Body& body)
+{
+    ParallelForRange(begin, end, grainSize, [&body](int chunkBegin, int chunkEnd)
+    {
+        for (int i = chunkBegin; i < chunkEnd; ++i)
+        {
+            body(i);
+        }
+    });
+}
@@ -0,0 +1,169 @@
+#include "TextureConverter.h"
+
+#include <atomic>
+
+#include "BitmapFile.h"
+#include "DDSWriter.h"
+#include "MipGenerator.h"
+#include "TaskScheduler.h"
+
+namespace
+{
+    using uint8 = std::uint8_t;
+    using uint32 = std::uint32_t;
+
+    DXGI_FORMAT OutputFormat(const TextureConvertOptions& options)
+    {
+        if (options.SRGB)
+        {
+            switch (options.Format)
+            {
+            case DXGI_FORMAT_BC1_UNORM: return DXGI_FORMAT_BC1_UNORM_SRGB;
+            case DXGI_FORMAT_BC3_UNORM: return DXGI_FORMAT_BC3_UNORM_SRGB;
+            default: break;
+            }
+        }
+        return options.Format;
+    }
+}
+
+bool TextureConverter::Convert(const std::wstring& source, const std::wstring& destination, const TextureConvertOptions& options)
+{
+    const DXGI_FORMAT format = OutputFormat(options);
+    if (!BCEncoder::IsSupported(format))
+    {
+        return false;
+    }
+
+    Surface<uint8> top;
+    if (!BitmapFile::Load(source, top))
+    {
+        return false;
+    }
+
+    std::vector<Surface<uint8>> mips;
+    if (options.GenerateMips)
+    {
+        MipGenerateOptions mipOptions;
+        mipOptions.Filter = options.Filter;
+        mipOptions.SRGB = options.SRGB;
+        mipOptions.AlphaCoverage = options.AlphaCoverage;
+        MipGenerator::Generate(top.Pixels.data(), std::size_t(4)*top.Width, top.Width, top.Height, mipOptions, mips);
+    }
+    mips.insert(mips.begin(), std::move(top));
+
+    std::vector<std::vector<uint8>> encoded;
+    if (!BCEncoder::Encode(format, options.Quality, mips, encoded))
+    {
+        return false;
+    }
+
+    DDSImage image;
+    image.Format = format;
+    image.Dimension = DDSDimensionTexture2D;
+    image.Width = mips[0].Width;
+    image.Height = mips[0].Height;
+    image.Depth = 1;
+    image.MipCount = static_cast<uint32>(mips.size());
+    image.ArraySize = 1;
+    image.Subresources.resize(mips.size());
+    for (std::size_t i = 0; i < mips.size(); ++i)
+    {
+        DDSSubresource& subresource = image.Subresources[i];
+        DDSParser::GetSurfaceInfo(mips[i].Width, mips[i].Height, format,
+            &subresource.SlicePitch, &subresource.RowPitch, &subresource.RowCount);
+        subresource.Data = encoded[i].data();
+        subresource.Width = mips[i].Width;
+        subresource.Height = mips[i].Height;
+        subresource.Depth = 1;
+    }
+
+    return DDSWriter::Write(destination, image);
+}
+
+int TextureConverter::ConvertAll(const std::vector<TextureConvertJob>& jobs)
+{
+    std::atomic<int> failed(0);
+    TaskScheduler::Get().ParallelFor(0, static_cast<int>(jobs.size()), 1, [&](int i)
+    {
+        if (!Convert(jobs[i].Source, jobs[i].Destination, jobs[i].Options))
+        {
+            ++failed;
+        }
+    });
+    return failed;
+}
+
+int TextureConverter::RunCommandLine(int argc, wchar_t** argv)
+{
+    std::vector<TextureConvertJob> jobs;
+    TextureConvertOptions options;
+    const wchar_t* source = nullptr;
+    for (int i = 0; i < argc; ++i)
+    {
+        const std::wstring argument = argv[i];
+        if (argument == L"-bc1")
+        {
+            options.Format = DXGI_FORMAT_BC1_UNORM;
+        }
+        else if (argument == L"-bc3")
+        {
+            options.Format = DXGI_FORMAT_BC3_UNORM;
+        }
+        else if (argument == L"-bc4")
+        {
+            options.Format = DXGI_FORMAT_BC4_UNORM;
+        }
+        else if (argument == L"-bc5")
+        {
+            options.Format = DXGI_FORMAT_BC5_UNORM;
+        }
+        else if (argument == L"-fast")
+        {
+            options.Quality = BCQualityFast;
+        }
+        else if (argument == L"-high")
+        {
+            options.Quality = BCQualityHigh;
+        }
+        else if (argument == L"-nomips")
+        {
+            options.GenerateMips = false;
+        }
+        else if (argument == L"-srgb")
+        {
+            options.SRGB = true;
+        }
+        else if (argument == L"-box")
+        {
+            options.Filter = MipFilterBox;
+        }
+        else if (argument == L"-coverage")
+        {
+            options.AlphaCoverage = MipAlphaCoverageOn;
+        }
+        else if (argument == L"-nocoverage")
+        {
+            options.AlphaCoverage = MipAlphaCoverageOff;
+        }
+        else if (argument[0] == L'-')
+        {
+            return 2;
+        }
+        else if (!source)
+        {
+            source = argv[i];
+        }
+        else
+        {
+            jobs.push_back({ source, argument, options });
+            source = nullptr;
+        }
+    }
+    if (jobs.empty() || source)
+    {
+        return 2;
+    }
+
+    return ConvertAll(jobs) == 0 ? 0 : 1;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <dxgiformat.h>
+
+#include "BCEncoder.h"
+#include "MipGenerator.h"
+
+struct TextureConvertOptions
+{
+    DXGI_FORMAT Format = DXGI_FORMAT_BC1_UNORM;
+    BCQuality Quality = BCQualityNormal;
+    bool GenerateMips = true;
+    MipFilter Filter = MipFilterKaiser;     // of the mips
+    MipAlphaCoverage AlphaCoverage = MipAlphaCoverageAuto;
+    bool SRGB = false;                  // mips filtered in linear light, BC1 and BC3 get the _SRGB format
+};
+
+struct TextureConvertJob
+{
+    std::wstring Source;
+    std::wstring Destination;
+    TextureConvertOptions Options;
+};
+
+// Offline texture pipeline: a bitmap in, a block compressed DDS with its full mip chain out,
+// ready for CreateDDSTextureFromFile12. Textures, their mips and the rows of blocks in them
+// are all encoded in parallel on the TaskScheduler.
+//
+// Run from the command line as
+//
+//   DXLearn.exe -convert [-bc1|-bc3|-bc4|-bc5] [-fast|-high] [-nomips] [-box] [-coverage|-nocoverage]
+//                        [-srgb] source.bmp dest.dds ...
+//
+// options apply to every pair of files after them. Mips are Kaiser filtered by MipGenerator,
+// alpha coverage is kept for textures that look alpha tested unless told otherwise.
+class TextureConverter
+{
+public:
+    static bool Convert(const std::wstring& source, const std::wstring& destination, const TextureConvertOptions& options);
+
+    // Returns how many jobs failed.
+    static int ConvertAll(const std::vector<TextureConvertJob>& jobs);
+
+    // Arguments after -convert, returns the process exit code.
+    static int RunCommandLine(int argc, wchar_t** argv);
+};
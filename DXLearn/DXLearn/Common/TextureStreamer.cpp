@@ -0,0 +1,532 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "d3dx12.h"
+#include "MipGenerator.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+    using uint32 = std::uint32_t;
+    using uint64 = std::uint64_t;
+
+    // Mips at most this many texels across are loaded with the texture and never evicted.
+    const uint32 TailSize = 64;
+
+    const D3D12_RESOURCE_STATES ResidentState = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+
+    inline bool IsCompressed(DXGI_FORMAT format)
+    {
+        return (format >= DXGI_FORMAT_BC1_TYPELESS && format <= DXGI_FORMAT_BC5_SNORM) ||
+            (format >= DXGI_FORMAT_BC6H_TYPELESS && format <= DXGI_FORMAT_BC7_UNORM_SRGB);
+    }
+
+    inline uint64 Align(uint64 value, uint64 alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+TextureStreamer::TextureStreamer(uint64 budget, uint64 uploadBudget)
+    : mBudget(budget), mUploadBudget(uploadBudget)
+{
+}
+
+HRESULT TextureStreamer::Add(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, const std::wstring& path, UINT* index)
+{
+    if (!device || !cmdList || !index)
+    {
+        return E_INVALIDARG;
+    }
+    mDevice = device;
+
+    auto texture = std::make_unique<StreamedTexture>();
+    if (!texture->File.Open(path))
+    {
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    }
+
+    const DDSImage& image = texture->File.Image();
+    if (image.Dimension != DDSDimensionTexture2D || image.IsCubeMap)
+    {
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+    }
+
+    // Same as CreateDDSTextureFromFile12, files with only mip 0 get the rest generated. Those
+    // levels stay in memory, mip 0 is still read from the file when it's needed. Filtering a
+    // full size mip 0 takes milliseconds, so it runs on a task and Update() uploads the tail.
+    StreamedTexture& streamed = *texture;
+    streamed.Image = image;
+    if (image.MipCount == 1 && std::max(image.Width, image.Height) > TailSize)
+    {
+        streamed.MipsPending = true;
+        streamed.ResidentMip = image.MipCount;
+        *index = Count();
+        mTextures.push_back(std::move(texture));
+
+        StreamedTexture* pending = &streamed;
+        mMipTasks.Run([pending]()
+        {
+            MipGenerateOptions mipOptions;
+            mipOptions.AlphaCoverage = MipAlphaCoverageAuto;
+            if (!MipGenerator::AddMips(pending->File.Image(), mipOptions, pending->GeneratedImage, pending->MipStorage))
+            {
+                pending->GeneratedImage = pending->File.Image();
+            }
+            pending->MipsGenerated.store(true, std::memory_order_release);
+        });
+        return S_OK;
+    }
+
+    // Levels below a mip 0 no larger than the tail are cheap enough to generate here.
+    MipGenerateOptions mipOptions;
+    mipOptions.AlphaCoverage = MipAlphaCoverageAuto;
+    if (!MipGenerator::AddMips(image, mipOptions, streamed.Image, streamed.MipStorage))
+    {
+        streamed.Image = image;
+    }
+    FindTail(streamed);
+    streamed.ResidentMip = streamed.TailMip;
+
+    // The tail goes up through its own staging buffer, released after the first frame.
+    PendingCopy copy;
+    copy.Texture = &streamed;
+    copy.DestinationMip = streamed.TailMip;
+    const uint64 uploadSize = PlaceUploads(streamed, streamed.TailMip, streamed.Image.MipCount, 0, &copy.Uploads);
+
+    const D3D12_RESOURCE_DESC desc = ResourceDesc(streamed, streamed.TailMip);
+    HRESULT hr = device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+        D3D12_HEAP_FLAG_NONE, &desc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&copy.Destination));
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    RetiredResource staging;
+    staging.Staging = std::make_unique<UploadBuffer<uint8>>(device, static_cast<UINT>(uploadSize), false);
+    WriteUploads(copy.Uploads, staging.Staging->GetMappedData());
+    copy.Upload = staging.Staging->GetResource();
+    Record(cmdList, std::vector<PendingCopy>(1, copy));
+    mRetired.push_back(std::move(staging));
+
+    streamed.Resource = copy.Destination;
+    streamed.ResidentBytes = AllocationSize(streamed, streamed.TailMip);
+    streamed.NumFramesDirty = gNumFrameResources;
+    mResidentBytes += streamed.ResidentBytes;
+
+    *index = Count();
+    mTextures.push_back(std::move(texture));
+    return S_OK;
+}
+
+TextureStreamer::uint32 TextureStreamer::Size(UINT index)const
+{
+    const DDSImage& image = mTextures[index]->Image;
+    return std::max(image.Width, image.Height);
+}
+
+void TextureStreamer::CreateViews(ID3D12DescriptorHeap* heap, UINT descriptorSize)
+{
+    mHeap = heap;
+    mDescriptorSize = descriptorSize;
+    for (UINT i = 0; i < Count(); ++i)
+    {
+        for (int frameIndex = 0; frameIndex < gNumFrameResources; ++frameIndex)
+        {
+            WriteView(*mTextures[i], i, frameIndex);
+        }
+        mTextures[i]->NumFramesDirty = 0;
+    }
+}
+
+void TextureStreamer::Request(UINT index, float lod)
+{
+    StreamedTexture& texture = *mTextures[index];
+    uint32 mip = 0;
+    if (lod >= static_cast<float>(texture.TailMip))
+    {
+        mip = texture.TailMip;
+    }
+    else if (lod > 0.0f)
+    {
+        // Trilinear filtering blends in the finer of the two mips around lod.
+        mip = static_cast<uint32>(lod);
+    }
+
+    if (texture.LastRequested != mFrame)
+    {
+        texture.LastRequested = mFrame;
+        texture.RequestedMip = mip;
+    }
+    else
+    {
+        texture.RequestedMip = std::min(texture.RequestedMip, mip);
+    }
+}
+
+void TextureStreamer::Update(int frameIndex, uint64 completedFence, uint64 frameFence)
+{
+    mFrameIndex = frameIndex;
+    mFrameFence = frameFence;
+
+    for (RetiredResource& retired : mRetired)
+    {
+        if (retired.Fence == 0)
+        {
+            retired.Fence = frameFence;
+        }
+    }
+    mRetired.erase(std::remove_if(mRetired.begin(), mRetired.end(),
+        [completedFence](const RetiredResource& retired) { return retired.Fence <= completedFence; }), mRetired.end());
+
+    // Textures whose mips are done, nothing of them is resident yet.
+    for (auto& texture : mTextures)
+    {
+        if (texture->MipsPending && texture->MipsGenerated.load(std::memory_order_acquire))
+        {
+            texture->MipsPending = false;
+            texture->Image = texture->GeneratedImage;
+            FindTail(*texture);
+            texture->ResidentMip = texture->Image.MipCount;
+        }
+    }
+
+    // This frame resource's fence has passed, so has every use of its upload buffer.
+    const uint64 uploadSize = std::max(mUploadBudget, mLargestUpload);
+    if (mUploadSizes[frameIndex] < uploadSize)
+    {
+        mUploads[frameIndex] = std::make_unique<UploadBuffer<uint8>>(mDevice, static_cast<UINT>(uploadSize), false);
+        mUploadSizes[frameIndex] = uploadSize;
+    }
+
+    // Their tails go first, those that don't fit wait for the next frame.
+    uint64 uploadOffset = 0;
+    for (auto& texture : mTextures)
+    {
+        if (!texture->Resource && !texture->MipsPending &&
+            PlaceUploads(*texture, texture->TailMip, texture->Image.MipCount, uploadOffset, nullptr) <= uploadSize)
+        {
+            uploadOffset = Resize(*texture, texture->TailMip, uploadOffset);
+        }
+    }
+
+    // The textures furthest from the mip they are seen at first, the most recently requested
+    // of those before the others.
+    std::vector<StreamedTexture*> growing;
+    for (auto& texture : mTextures)
+    {
+        if (texture->Resource && WantedMip(*texture) < texture->ResidentMip)
+        {
+            growing.push_back(texture.get());
+        }
+    }
+    std::sort(growing.begin(), growing.end(), [this](const StreamedTexture* a, const StreamedTexture* b)
+    {
+        const uint32 missingA = a->ResidentMip - WantedMip(*a);
+        const uint32 missingB = b->ResidentMip - WantedMip(*b);
+        return missingA != missingB ? missingA > missingB : a->LastRequested > b->LastRequested;
+    });
+
+    for (StreamedTexture* texture : growing)
+    {
+        // The next finer mip, and more while they fit in this frame's uploads. A mip larger
+        // than the whole upload budget still comes in when it is the first of the frame.
+        const uint32 wanted = WantedMip(*texture);
+        uint32 topMip = ValidMip(*texture, texture->ResidentMip - 1);
+        uint64 uploadEnd = PlaceUploads(*texture, topMip, texture->ResidentMip, uploadOffset, nullptr);
+        if (uploadEnd > uploadSize || (uploadOffset > 0 && uploadEnd > mUploadBudget))
+        {
+            continue;
+        }
+        while (topMip > wanted)
+        {
+            const uint32 nextMip = ValidMip(*texture, topMip - 1);
+            const uint64 nextEnd = PlaceUploads(*texture, nextMip, texture->ResidentMip, uploadOffset, nullptr);
+            if (nextEnd > mUploadBudget)
+            {
+                break;
+            }
+            topMip = nextMip;
+            uploadEnd = nextEnd;
+        }
+
+        if (!MakeRoom(AllocationSize(*texture, topMip) - texture->ResidentBytes))
+        {
+            continue;
+        }
+        uploadOffset = Resize(*texture, topMip, uploadOffset);
+    }
+
+    if (mHeap)
+    {
+        for (UINT i = 0; i < Count(); ++i)
+        {
+            StreamedTexture& texture = *mTextures[i];
+            if (texture.NumFramesDirty > 0)
+            {
+                WriteView(texture, i, frameIndex);
+                texture.NumFramesDirty--;
+            }
+        }
+    }
+
+    ++mFrame;
+}
+
+void TextureStreamer::RecordUploads(ID3D12GraphicsCommandList* cmdList)
+{
+    if (!mPendingCopies.empty())
+    {
+        Record(cmdList, mPendingCopies);
+        mPendingCopies.clear();
+    }
+}
+
+void TextureStreamer::FindTail(StreamedTexture& texture)
+{
+    uint32 tailMip = 0;
+    while (tailMip + 1 < texture.Image.MipCount)
+    {
+        const DDSSubresource& mip = texture.Image.Subresource(tailMip, 0);
+        if (std::max(mip.Width, mip.Height) <= TailSize)
+        {
+            break;
+        }
+        ++tailMip;
+    }
+    texture.TailMip = ValidMip(texture, tailMip);
+    texture.RequestedMip = texture.TailMip;
+    mLargestUpload = std::max(mLargestUpload, PlaceUploads(texture, 0, 1, 0, nullptr));
+}
+
+D3D12_RESOURCE_DESC TextureStreamer::ResourceDesc(const StreamedTexture& texture, uint32 topMip)const
+{
+    const DDSImage& image = texture.Image;
+    const DDSSubresource& top = image.Subresource(topMip, 0);
+    return CD3DX12_RESOURCE_DESC::Tex2D(image.Format, top.Width, top.Height,
+        static_cast<UINT16>(image.ArraySize), static_cast<UINT16>(image.MipCount - topMip));
+}
+
+uint64 TextureStreamer::AllocationSize(const StreamedTexture& texture, uint32 topMip)const
+{
+    const D3D12_RESOURCE_DESC desc = ResourceDesc(texture, topMip);
+    return mDevice->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+}
+
+TextureStreamer::uint32 TextureStreamer::ValidMip(const StreamedTexture& texture, uint32 mip)const
+{
+    if (!IsCompressed(texture.Image.Format))
+    {
+        return mip;
+    }
+    while (mip > 0)
+    {
+        const DDSSubresource& top = texture.Image.Subresource(mip, 0);
+        if (top.Width % 4 == 0 && top.Height % 4 == 0)
+        {
+            break;
+        }
+        --mip;
+    }
+    return mip;
+}
+
+TextureStreamer::uint32 TextureStreamer::WantedMip(const StreamedTexture& texture)const
+{
+    return ValidMip(texture, texture.LastRequested == mFrame ? texture.RequestedMip : texture.TailMip);
+}
+
+uint64 TextureStreamer::PlaceUploads(const StreamedTexture& texture, uint32 topMip, uint32 endMip, uint64 offset,
+    std::vector<MipUpload>* uploads)const
+{
+    const D3D12_RESOURCE_DESC desc = ResourceDesc(texture, topMip);
+    const UINT mipCount = texture.Image.MipCount - topMip;
+    const UINT count = endMip - topMip;
+
+    std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints(count);
+    std::vector<UINT> rowCounts(count);
+    std::vector<UINT64> rowSizes(count);
+    for (uint32 slice = 0; slice < texture.Image.ArraySize; ++slice)
+    {
+        offset = Align(offset, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+        UINT64 bytes = 0;
+        mDevice->GetCopyableFootprints(&desc, slice*mipCount, count, offset,
+            footprints.data(), rowCounts.data(), rowSizes.data(), &bytes);
+        if (uploads)
+        {
+            for (UINT i = 0; i < count; ++i)
+            {
+                MipUpload upload;
+                upload.Subresource = slice*mipCount + i;
+                upload.Footprint = footprints[i];
+                upload.RowCount = rowCounts[i];
+                upload.RowSize = rowSizes[i];
+                upload.Source = &texture.Image.Subresource(topMip + i, slice);
+                uploads->push_back(upload);
+            }
+        }
+        offset += bytes;
+    }
+    return offset;
+}
+
+void TextureStreamer::WriteUploads(const std::vector<MipUpload>& uploads, BYTE* mappedData)
+{
+    // Straight from the mapped file, only the pages of the mips that are loaded are read.
+    for (const MipUpload& upload : uploads)
+    {
+        BYTE* dest = mappedData + upload.Footprint.Offset;
+        const std::uint8_t* src = upload.Source->Data;
+        for (UINT row = 0; row < upload.RowCount; ++row)
+        {
+            std::memcpy(dest + std::size_t(row)*upload.Footprint.Footprint.RowPitch,
+                src + row*upload.Source->RowPitch, static_cast<std::size_t>(upload.RowSize));
+        }
+    }
+}
+
+uint64 TextureStreamer::Resize(StreamedTexture& texture, uint32 topMip, uint64 uploadOffset)
+{
+    PendingCopy copy;
+    copy.Texture = &texture;
+    copy.DestinationMip = topMip;
+    copy.Source = texture.Resource;
+    copy.SourceMip = texture.ResidentMip;
+
+    const D3D12_RESOURCE_DESC desc = ResourceDesc(texture, topMip);
+    ThrowIfFailed(mDevice->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+        D3D12_HEAP_FLAG_NONE, &desc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&copy.Destination)));
+
+    uint64 uploadEnd = uploadOffset;
+    if (topMip < texture.ResidentMip)
+    {
+        uploadEnd = PlaceUploads(texture, topMip, texture.ResidentMip, uploadOffset, &copy.Uploads);
+        WriteUploads(copy.Uploads, mUploads[mFrameIndex]->GetMappedData());
+        copy.Upload = mUploads[mFrameIndex]->GetResource();
+    }
+
+    // Frames in flight may still sample the old resource, and this frame copies out of it.
+    if (texture.Resource)
+    {
+        RetiredResource retired;
+        retired.Fence = mFrameFence;
+        retired.Resource = texture.Resource;
+        mRetired.push_back(std::move(retired));
+    }
+
+    const uint64 bytes = AllocationSize(texture, topMip);
+    mResidentBytes = mResidentBytes - texture.ResidentBytes + bytes;
+    texture.Resource = copy.Destination;
+    texture.ResidentMip = topMip;
+    texture.ResidentBytes = bytes;
+    texture.NumFramesDirty = gNumFrameResources;
+
+    mPendingCopies.push_back(std::move(copy));
+    return uploadEnd;
+}
+
+bool TextureStreamer::MakeRoom(uint64 bytes)
+{
+    while (mResidentBytes + bytes > mBudget)
+    {
+        // The least recently requested texture with finer mips than it is seen at. Textures
+        // are only ever evicted down to what they were last requested at, or to their tail.
+        StreamedTexture* victim = nullptr;
+        for (auto& texture : mTextures)
+        {
+            if (WantedMip(*texture) > texture->ResidentMip &&
+                (!victim || texture->LastRequested < victim->LastRequested))
+            {
+                victim = texture.get();
+            }
+        }
+        if (!victim)
+        {
+            return false;
+        }
+        Resize(*victim, WantedMip(*victim), 0);
+    }
+    return true;
+}
+
+void TextureStreamer::WriteView(const StreamedTexture& texture, UINT index, int frameIndex)
+{
+    // Textures still generating their mips get a null view, they sample as black.
+    const UINT mipCount = texture.Resource ? texture.Image.MipCount - texture.ResidentMip : 1;
+
+    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    srvDesc.Format = texture.Image.Format;
+    if (texture.Image.ArraySize > 1)
+    {
+        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+        srvDesc.Texture2DArray.MostDetailedMip = 0;
+        srvDesc.Texture2DArray.MipLevels = mipCount;
+        srvDesc.Texture2DArray.FirstArraySlice = 0;
+        srvDesc.Texture2DArray.ArraySize = texture.Image.ArraySize;
+    }
+    else
+    {
+        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+        srvDesc.Texture2D.MostDetailedMip = 0;
+        srvDesc.Texture2D.MipLevels = mipCount;
+        srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
+    }
+
+    CD3DX12_CPU_DESCRIPTOR_HANDLE handle(mHeap->GetCPUDescriptorHandleForHeapStart(),
+        frameIndex*static_cast<INT>(Count()) + static_cast<INT>(index), mDescriptorSize);
+    mDevice->CreateShaderResourceView(texture.Resource.Get(), &srvDesc, handle);
+}
+
+void TextureStreamer::Record(ID3D12GraphicsCommandList* cmdList, const std::vector<PendingCopy>& copies)
+{
+    // The old resources are only copied from now on, they are released after this frame.
+    std::vector<D3D12_RESOURCE_BARRIER> barriers;
+    for (const PendingCopy& copy : copies)
+    {
+        if (copy.Source)
+        {
+            barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(copy.Source.Get(),
+                ResidentState, D3D12_RESOURCE_STATE_COPY_SOURCE));
+        }
+    }
+    if (!barriers.empty())
+    {
+        cmdList->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+    }
+
+    barriers.clear();
+    for (const PendingCopy& copy : copies)
+    {
+        const DDSImage& image = copy.Texture->Image;
+        if (copy.Source)
+        {
+            // The mips both resources have.
+            const uint32 mipCount = image.MipCount - copy.DestinationMip;
+            const uint32 sourceMipCount = image.MipCount - copy.SourceMip;
+            for (uint32 slice = 0; slice < image.ArraySize; ++slice)
+            {
+                for (uint32 mip = std::max(copy.SourceMip, copy.DestinationMip); mip < image.MipCount; ++mip)
+                {
+                    CD3DX12_TEXTURE_COPY_LOCATION dest(copy.Destination.Get(), slice*mipCount + mip - copy.DestinationMip);
+                    CD3DX12_TEXTURE_COPY_LOCATION src(copy.Source.Get(), slice*sourceMipCount + mip - copy.SourceMip);
+                    cmdList->CopyTextureRegion(&dest, 0, 0, 0, &src, nullptr);
+                }
+            }
+        }
+
+        for (const MipUpload& upload : copy.Uploads)
+        {
+            CD3DX12_TEXTURE_COPY_LOCATION dest(copy.Destination.Get(), upload.Subresource);
+            CD3DX12_TEXTURE_COPY_LOCATION src(copy.Upload, upload.Footprint);
+            cmdList->CopyTextureRegion(&dest, 0, 0, 0, &src, nullptr);
+        }
+
+        barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(copy.Destination.Get(),
+            D3D12_RESOURCE_STATE_COPY_DEST, ResidentState));
+    }
+    cmdList->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+}
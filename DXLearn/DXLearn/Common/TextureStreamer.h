@@ -0,0 +1,172 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "D3dUtil.h"
+#include "DDSParser.h"
+#include "TaskScheduler.h"
+#include "UploadBuffer.h"
+
+// Streams the mips of 2D DDS textures (and 2D arrays) under a memory budget. Add() maps the
+// file and uploads only its tail, the mips at most 64 texels across, so loading costs the
+// same whatever the size of the textures. Every frame the app asks for the finest mip each
+// texture is seen at with Request(), and Update() moves the textures towards it:
+//   Finer mips come in one or more at a time, up to the upload budget of a frame.
+//   Past the memory budget the least recently requested textures holding finer mips than
+//   they need give them back. The tails are never evicted.
+// A texture lives in a committed resource with its resident mips only. A change of mips
+// creates the new resource, copies the mips both have on the GPU and the rest from the
+// mapped file, the old resource is released once the GPU is done with it.
+// Files with only mip 0 get the rest generated on the TaskScheduler. Their view is null until
+// the generated tail goes up with the uploads of an Update(), finer mips follow as usual.
+//
+// Views are written once per frame resource, the view of texture i for frame resource f is
+// at f*Count() + i. A frame only rewrites the views of the frame resource it just waited for,
+// so the views in flight never change under the GPU.
+class TextureStreamer
+{
+public:
+    using uint8 = std::uint8_t;
+    using uint32 = std::uint32_t;
+    using uint64 = std::uint64_t;
+
+    // budget bytes of resident textures, tails included, uploadBudget bytes copied in a frame.
+    TextureStreamer(uint64 budget, uint64 uploadBudget);
+
+    TextureStreamer(const TextureStreamer& other) = delete;
+    TextureStreamer& operator=(const TextureStreamer& other) = delete;
+
+public:
+    // Maps path and records the upload of its tail on cmdList, or starts generating its mips
+    // when the file only has mip 0. index is the texture's view in the views of a frame
+    // resource, textures are numbered in the order they are added.
+    HRESULT Add(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, const std::wstring& path, UINT* index);
+
+    UINT Count()const { return static_cast<UINT>(mTextures.size()); }
+
+    // Texels across mip 0, the larger of its width and height.
+    uint32 Size(UINT index)const;
+
+    uint64 ResidentBytes()const { return mResidentBytes; }
+
+    // Writes the gNumFrameResources*Count() views from the start of heap.
+    void CreateViews(ID3D12DescriptorHeap* heap, UINT descriptorSize);
+
+    // lod 0 is mip 0, a texture may be requested by all its users, the finest mip wins.
+    // Textures nobody requests keep their mips until the budget needs them.
+    void Request(UINT index, float lod);
+
+    // Once a frame, after waiting for frame resource frameIndex. completedFence is the fence
+    // the GPU has passed, frameFence the one this frame will signal.
+    void Update(int frameIndex, uint64 completedFence, uint64 frameFence);
+
+    // Records the copies Update() planned, before any draw of the frame.
+    void RecordUploads(ID3D12GraphicsCommandList* cmdList);
+
+private:
+    struct StreamedTexture
+    {
+        DDSFile File;
+        DDSImage Image;                         // File's or one with generated mips
+        std::vector<std::vector<uint8>> MipStorage;
+
+        // Set while the mip task fills GeneratedImage, Image stays File's until it is done.
+        bool MipsPending = false;
+        std::atomic<bool> MipsGenerated{ false };
+        DDSImage GeneratedImage;
+
+        uint32 TailMip = 0;                     // first mip of the tail
+        uint32 ResidentMip = 0;                 // first mip in Resource
+        uint32 RequestedMip = 0;                // finest mip requested in LastRequested
+        uint64 LastRequested = 0;               // frame of the last request
+
+        Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+        uint64 ResidentBytes = 0;
+
+        // Frame resources whose view still points at an older Resource.
+        int NumFramesDirty = 0;
+    };
+
+    struct MipUpload
+    {
+        UINT Subresource = 0;                   // in the new resource
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT Footprint;
+        UINT RowCount = 0;
+        UINT64 RowSize = 0;
+        const DDSSubresource* Source = nullptr;
+    };
+
+    struct PendingCopy
+    {
+        const StreamedTexture* Texture = nullptr;
+        Microsoft::WRL::ComPtr<ID3D12Resource> Destination;
+        uint32 DestinationMip = 0;
+        Microsoft::WRL::ComPtr<ID3D12Resource> Source;  // null for new textures
+        uint32 SourceMip = 0;
+        ID3D12Resource* Upload = nullptr;
+        std::vector<MipUpload> Uploads;
+    };
+
+    struct RetiredResource
+    {
+        uint64 Fence = 0;                       // 0 until the next Update() knows it
+        Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+        std::unique_ptr<UploadBuffer<uint8>> Staging;
+    };
+
+private:
+    // Finds the tail of texture's Image, the first mip no larger than TailSize.
+    void FindTail(StreamedTexture& texture);
+
+    D3D12_RESOURCE_DESC ResourceDesc(const StreamedTexture& texture, uint32 topMip)const;
+    uint64 AllocationSize(const StreamedTexture& texture, uint32 topMip)const;
+
+    // mip, or the nearest finer one if a resource can't start at it: block compressed
+    // resources have to be a whole number of blocks.
+    uint32 ValidMip(const StreamedTexture& texture, uint32 mip)const;
+    uint32 WantedMip(const StreamedTexture& texture)const;
+
+    // Places mips [topMip, endMip) of every slice of a resource starting at topMip in an
+    // upload buffer from offset on, returns the end.
+    uint64 PlaceUploads(const StreamedTexture& texture, uint32 topMip, uint32 endMip, uint64 offset,
+        std::vector<MipUpload>* uploads)const;
+    static void WriteUploads(const std::vector<MipUpload>& uploads, BYTE* mappedData);
+
+    // Moves texture to a new resource starting at topMip, new mips are placed at uploadOffset
+    // in this frame's upload buffer. Returns the end of its uploads.
+    uint64 Resize(StreamedTexture& texture, uint32 topMip, uint64 uploadOffset);
+
+    // Evicts until bytes more fit in the budget, false if they can't.
+    bool MakeRoom(uint64 bytes);
+
+    void WriteView(const StreamedTexture& texture, UINT index, int frameIndex);
+    static void Record(ID3D12GraphicsCommandList* cmdList, const std::vector<PendingCopy>& copies);
+
+private:
+    ID3D12Device* mDevice = nullptr;
+    ID3D12DescriptorHeap* mHeap = nullptr;
+    UINT mDescriptorSize = 0;
+
+    uint64 mBudget = 0;
+    uint64 mUploadBudget = 0;
+    uint64 mResidentBytes = 0;
+    uint64 mLargestUpload = 0;                  // mip 0 of the largest texture, always fits
+
+    std::vector<std::unique_ptr<StreamedTexture>> mTextures;
+    std::vector<PendingCopy> mPendingCopies;
+    std::vector<RetiredResource> mRetired;
+
+    // After mTextures, so it waits for the mip tasks before the textures go away.
+    TaskGroup mMipTasks;
+
+    std::unique_ptr<UploadBuffer<uint8>> mUploads[gNumFrameResources];
+    uint64 mUploadSizes[gNumFrameResources] = {};
+
+    uint64 mFrame = 1;
+    int mFrameIndex = 0;
+    uint64 mFrameFence = 0;
+};
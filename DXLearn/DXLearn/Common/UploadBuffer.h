@@ -19,6 +19,9 @@ public:
 
     UINT GetElementByteSize() const {return mElementByteSize;}
 
+    // The buffer stays mapped for its whole lifetime, producers can write into it directly.
+    BYTE* GetMappedData() const {return mMappedData;}
+
 private:
     Microsoft::WRL::ComPtr<ID3D12Resource> mUploaderBuffer;
     BYTE* mMappedData = nullptr;
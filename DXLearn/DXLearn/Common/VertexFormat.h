@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+#include <d3d12.h>
+#include <DirectXMath.h>
+
+#include "GeometryGenerator.h"
+
+// Compile-time vertex layouts. A format is the ordered list of attributes a vertex struct
+// stores, tightly packed:
+//
+//   using LWVertexFormat = VertexFormat<VertexPosition, VertexColor>;
+//
+// From it come the D3D12 input layout, the byte offsets for in-place writers, the mask of
+// attributes GeometryGenerator has to compute and a writer that copies exactly those out
+// of a generated vertex. The struct and its input layout can't drift apart, and nothing
+// computes tangents for a vertex that only has a position and a color.
+
+// Attribute tags. Type is what the vertex stores, GeneratorMask the GeometryGenerator
+// attribute it is copied from, 0 for the ones the caller fills in itself.
+struct VertexPosition
+{
+    using Type = DirectX::XMFLOAT3;
+    static const char* Semantic() { return "POSITION"; }
+    static const DXGI_FORMAT Format = DXGI_FORMAT_R32G32B32_FLOAT;
+    static const GeometryGenerator::uint32 GeneratorMask = GeometryGenerator::AttributePosition;
+    static void FromGenerator(Type& dst, const GeometryGenerator::Vertex& src) { dst = src.Position; }
+};
+
+struct VertexNormal
+{
+    using Type = DirectX::XMFLOAT3;
+    static const char* Semantic() { return "NORMAL"; }
+    static const DXGI_FORMAT Format = DXGI_FORMAT_R32G32B32_FLOAT;
+    static const GeometryGenerator::uint32 GeneratorMask = GeometryGenerator::AttributeNormal;
+    static void FromGenerator(Type& dst, const GeometryGenerator::Vertex& src) { dst = src.Normal; }
+};
+
+struct VertexTangent
+{
+    using Type = DirectX::XMFLOAT3;
+    static const char* Semantic() { return "TANGENT"; }
+    static const DXGI_FORMAT Format = DXGI_FORMAT_R32G32B32_FLOAT;
+    static const GeometryGenerator::uint32 GeneratorMask = GeometryGenerator::AttributeTangentU;
+    static void FromGenerator(Type& dst, const GeometryGenerator::Vertex& src) { dst = src.TangentU; }
+};
+
+struct VertexTexC
+{
+    using Type = DirectX::XMFLOAT2;
+    static const char* Semantic() { return "TEXCOORD"; }
+    static const DXGI_FORMAT Format = DXGI_FORMAT_R32G32_FLOAT;
+    static const GeometryGenerator::uint32 GeneratorMask = GeometryGenerator::AttributeTexC;
+    static void FromGenerator(Type& dst, const GeometryGenerator::Vertex& src) { dst = src.TexC; }
+};
+
+struct VertexColor
+{
+    using Type = DirectX::XMFLOAT4;
+    static const char* Semantic() { return "COLOR"; }
+    static const DXGI_FORMAT Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+    static const GeometryGenerator::uint32 GeneratorMask = 0;
+    static void FromGenerator(Type& dst, const GeometryGenerator::Vertex& src) {}
+};
+
+// Billboard extent, expanded to a quad by the geometry shader.
+struct VertexSize
+{
+    using Type = DirectX::XMFLOAT2;
+    static const char* Semantic() { return "SIZE"; }
+    static const DXGI_FORMAT Format = DXGI_FORMAT_R32G32_FLOAT;
+    static const GeometryGenerator::uint32 GeneratorMask = 0;
+    static void FromGenerator(Type& dst, const GeometryGenerator::Vertex& src) {}
+};
+
+namespace VertexFormatDetail
+{
+    template<typename... Attrs>
+    struct AttributeList;
+
+    template<>
+    struct AttributeList<>
+    {
+        static constexpr UINT Stride() { return 0; }
+        static constexpr GeometryGenerator::uint32 GeneratorMask() { return 0; }
+
+        // Not in the list. Large enough to stay past the stride after the sizes of the
+        // preceding attributes are added, which is what OffsetOf() checks.
+        template<typename Attr>
+        static constexpr UINT OffsetOf() { return 0x40000000u; }
+
+        static void AppendElements(std::vector<D3D12_INPUT_ELEMENT_DESC>& layout, UINT offset, UINT inputSlot) {}
+        static void FromGenerator(unsigned char* dst, const GeometryGenerator::Vertex& src) {}
+    };
+
+    template<typename First, typename... Rest>
+    struct AttributeList<First, Rest...>
+    {
+        using Tail = AttributeList<Rest...>;
+
+        static constexpr UINT Stride() { return sizeof(typename First::Type) + Tail::Stride(); }
+        static constexpr GeometryGenerator::uint32 GeneratorMask() { return First::GeneratorMask | Tail::GeneratorMask(); }
+
+        template<typename Attr>
+        static constexpr UINT OffsetOf()
+        {
+            return std::is_same<Attr, First>::value ? 0 : sizeof(typename First::Type) + Tail::template OffsetOf<Attr>();
+        }
+
+        static void AppendElements(std::vector<D3D12_INPUT_ELEMENT_DESC>& layout, UINT offset, UINT inputSlot)
+        {
+            layout.push_back({ First::Semantic(), 0, First::Format, inputSlot, offset,
+                D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+            Tail::AppendElements(layout, offset + sizeof(typename First::Type), inputSlot);
+        }
+
+        static void FromGenerator(unsigned char* dst, const GeometryGenerator::Vertex& src)
+        {
+            First::FromGenerator(*reinterpret_cast<typename First::Type*>(dst), src);
+            Tail::FromGenerator(dst + sizeof(typename First::Type), src);
+        }
+    };
+}
+
+template<typename... Attrs>
+class VertexFormat
+{
+    using List = VertexFormatDetail::AttributeList<Attrs...>;
+
+public:
+    static constexpr UINT Stride() { return List::Stride(); }
+
+    template<typename Attr>
+    static constexpr UINT OffsetOf()
+    {
+        static_assert(List::template OffsetOf<Attr>() < List::Stride(), "attribute is not part of this vertex format");
+        return List::template OffsetOf<Attr>();
+    }
+
+    // GeometryGenerator::EAttribute mask for the Write* functions.
+    static constexpr GeometryGenerator::uint32 GeneratorMask() { return List::GeneratorMask(); }
+
+    static std::vector<D3D12_INPUT_ELEMENT_DESC> InputLayout(UINT inputSlot = 0)
+    {
+        std::vector<D3D12_INPUT_ELEMENT_DESC> layout;
+        layout.reserve(sizeof...(Attrs));
+        List::AppendElements(layout, 0, inputSlot);
+        return layout;
+    }
+
+    // Writer for GeometryGenerator::Write*. Copies the generated attributes of the
+    // format and leaves the others (colors, sizes) to the caller.
+    struct Writer
+    {
+        template<typename VertexT>
+        void operator()(VertexT& dst, const GeometryGenerator::Vertex& src)const
+        {
+            static_assert(sizeof(VertexT) == Stride(), "vertex struct doesn't match its format");
+            List::FromGenerator(reinterpret_cast<unsigned char*>(&dst), src);
+        }
+    };
+};
@@ -1,8 +1,12 @@
 
 #include <DirectXColors.h>
+#include <windows.h>
+#include <shellapi.h>
 
 #include "AppFactory/TreeBillboardsApp/TreeBillboardsApp.h"
 #include "Common/BaseWindow.h"
+#include "Common/Benchmark.h"
+#include "Common/TextureConverter.h"
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, int showCmd)
 {
@@ -11,6 +15,31 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, in
     _CrtSetDbgFlag( _CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF );
 #endif
 
+    // DXLearn.exe -convert ... runs the texture pipeline instead of the app.
+    int argc = 0;
+    wchar_t** argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    if (argv && argc > 1 && std::wstring(argv[1]) == L"-convert")
+    {
+        const int result = TextureConverter::RunCommandLine(argc - 2, argv + 2);
+        LocalFree(argv);
+        return result;
+    }
+
+    // DXLearn.exe -bench [name ...] runs the headless checks and benchmarks.
+    if (argv && argc > 1 && std::wstring(argv[1]) == L"-bench")
+    {
+        // Windows subsystem builds have no console of their own, report into the caller's.
+        if (AttachConsole(ATTACH_PARENT_PROCESS))
+        {
+            FILE* stream = nullptr;
+            freopen_s(&stream, "CONOUT$", "w", stdout);
+        }
+        const int result = Benchmark::RunCommandLine(argc - 2, argv + 2);
+        LocalFree(argv);
+        return result;
+    }
+    LocalFree(argv);
+
     try
     {
         TreeBillboardsApp theApp(hInstance);